@@ -6,7 +6,90 @@ The time evolution equation is expressed as:
 \frac{\partial \phi}{\partial t}=\mu \nabla^2 \left[ f - \kappa \nabla^2\phi \right] \hspace{1cm}:\left[  \nabla^2 =  \frac{\partial^2 }{\partial x^2 } + \frac{\partial^2 }{\partial y^2} \right]
 \f]
 The kernel is divided into two functions because of the complex evolution equation. The CHInnerEvol() function computes the inner evolution i.e. inside the squar brackets and the CHOuterEvol() function computes the outer evolution.
+
+The outer evolution of a cell reads the inner bracket of its neighbours, which may belong to another work-group. So the two halves either run as two kernels (ch_inner_kern() and ch_outer_kern()), or as one kernel that recomputes the inner bracket over a 1-cell halo in local memory (phase_field_evol_kern()).
+ch_ensemble_kern() is the tiled kernel for an ensemble of replicas with their own MOBILITY and KAPPA, see ensemble_funcs.h .
+ch_inner_3d_kern() and ch_outer_3d_kern() are the two halves of the step on a 3D grid, each a 7-point stencil blocked in 2.5D.
+ch_inner_strip_kern() and ch_outer_strip_kern() update some rows of a strip of the grid in the multi-device mode, see multi_device_funcs.h .
+ch_spectral_pack_kern(), fft_rows_kern(), fft_cols_kern(), ch_spectral_update_kern() and ch_spectral_unpack_kern() are the semi-implicit Fourier-spectral step, see spectral_funcs.h .
+
+The grid is NX*NY cells, the rows are PITCH floats apart. The global work size is rounded up to the work-group size, the work items outside the grid write nothing.
+A 3D grid is NZ planes of NY rows, the planes are PITCH*NY floats apart.
+*/
+
+// Precision of the fields, -DPRECISION=n from getKernelFromFile(): 0 float, 1 half storage with float compute, 2 double.
+// The fields are read with LOAD() and written with STORE(), the arithmetic and the local memory tiles are in real.
+#if PRECISION == 2
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#elif PRECISION == 1
+typedef float real;
+typedef half store;
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
+#else
+typedef float real;
+typedef float store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#endif
+
+// The time step: the DT build option, or with -DADAPTIVE_DT the last argument dt of the kernels that step in time, see adaptive_dt_funcs.h .
+// The functions that use DT take DT_ARG last and are called with DT_PASS, both empty without ADAPTIVE_DT.
+#ifdef ADAPTIVE_DT
+#undef DT
+#define DT dt
+#define DT_ARG , real dt
+#define DT_PASS , dt
+#else
+#define DT_ARG
+#define DT_PASS
+#endif
+
+
+/**
+@brief The inner bracket of one cell.
+@param M The concentration of the cell.
+@param Top The concentration of the top neighbour.
+@param Bottom The concentration of the bottom neighbour.
+@param Right The concentration of the right neighbour.
+@param Left The concentration of the left neighbour.
+@return \f$ f - \kappa \nabla^2\phi \f$ of the cell.
+*/
+real CHInnerBracket(real M, real Top, real Bottom, real Right, real Left){
+    // Calculate g(C)
+    real g = (real)2*M*(0.9-M)*(1-2*M);
+    real del2C = Top +Bottom +Right +Left -4*M;
+    return g - KAPPA*2.0*(real)del2C;
+}
+
+/**
+@brief The integrated concentration of one cell.
+@param C The concentration of the cell at time t=n .
+@param M The inner bracket of the cell.
+@param Top The inner bracket of the top neighbour.
+@param Bottom The inner bracket of the bottom neighbour.
+@param Right The inner bracket of the right neighbour.
+@param Left The inner bracket of the left neighbour.
+@return The concentration of the cell at time t=n+1, clamped to [0,1].
 */
+real CHOuterConc(real C, real M, real Top, real Bottom, real Right, real Left DT_ARG){
+    real del2M = Top +Bottom +Right +Left -4*M;
+    del2M = (1.0f/(H*H))*del2M ;
+
+    real out = C + DT*MOBILITY*del2M;
+
+    if (out > 1.0){
+         out = 1.0 ;
+    }
+    else if (out < 0.0){
+        out = 0.0 ;
+    }
+    return out ;
+}
 
 
 /**
@@ -20,42 +103,42 @@ The kernel computes the following :
 \f]
 */
 void CHInnerEvol(
-                        __global float* IN,
-                        __global float* OUT){
+                        __global store* IN,
+                        __global store* OUT){
     int gx = get_global_id(0);
     int gy = get_global_id(1);
+    if(gx >= NX || gy >= NY){
+        return;
+    }
 
-    float M, Right, Left, Top, Bottom ;
+    real M, Right, Left, Top, Bottom ;
     
-    M = IN[SIZE*gy +gx];
-    // Calculate g(C)
-    float g = (float)2*M*(0.9-M)*(1-2*M);
+    M = LOAD(IN, PITCH*gy +gx);
 
     // Calculate the laplacian
     if(gy==0){
-        Top = IN[SIZE*(SIZE-1)+gx];
+        Top = LOAD(IN, PITCH*(NY-1)+gx);
     }else{
-        Top = IN[SIZE*(gy-1) +gx];
+        Top = LOAD(IN, PITCH*(gy-1) +gx);
     }
 
     if(gx==0){
-        Left = IN[SIZE*gy + (SIZE-1)];
+        Left = LOAD(IN, PITCH*gy + (NX-1));
     }else{
-        Left = IN[SIZE*gy +gx -1];
+        Left = LOAD(IN, PITCH*gy +gx -1);
     }
-    if(gy==(SIZE-1)){
-        Bottom = IN[gx];
+    if(gy==(NY-1)){
+        Bottom = LOAD(IN, gx);
     }else{
-        Bottom = IN[SIZE*(gy+1)+gx];
+        Bottom = LOAD(IN, PITCH*(gy+1)+gx);
     }
-    if(gx==(SIZE-1)){
-        Right = IN[SIZE*gy];
+    if(gx==(NX-1)){
+        Right = LOAD(IN, PITCH*gy);
     }else{
-        Right = IN[SIZE*gy +gx + 1];
+        Right = LOAD(IN, PITCH*gy +gx + 1);
     }
 
-    float del2C = Top +Bottom +Right +Left -4*M;
-    OUT[gy*SIZE+gx] =  g - KAPPA*2.0*(float)del2C;
+    STORE(OUT, gy*PITCH+gx, CHInnerBracket(M, Top, Bottom, Right, Left));
 }
 
 
@@ -72,61 +155,121 @@ The kernel computes the following :
 
 */
 void CHOuterEvol(
-                          __global float* InBracM,
-                          __global float* CONC,
-                          __global float* OUT){
+                          __global store* InBracM,
+                          __global store* CONC,
+                          __global store* OUT DT_ARG){
 int gx = get_global_id(0);
 int gy = get_global_id(1);
+if(gx >= NX || gy >= NY){
+    return;
+}
 
-float C, M, Right, Left, Top, Bottom ;
-M = InBracM[SIZE*gy +gx];
-C = CONC[SIZE*gy +gx];
+real C, M, Right, Left, Top, Bottom ;
+M = LOAD(InBracM, PITCH*gy +gx);
+C = LOAD(CONC, PITCH*gy +gx);
 
 if(gy==0){
-    Top = InBracM[SIZE*(SIZE-1)+gx];
+    Top = LOAD(InBracM, PITCH*(NY-1)+gx);
 }else{
-    Top = InBracM[SIZE*(gy-1) +gx];
+    Top = LOAD(InBracM, PITCH*(gy-1) +gx);
 }
 
 if(gx==0){
-    Left = InBracM[SIZE*gy + (SIZE-1)];
+    Left = LOAD(InBracM, PITCH*gy + (NX-1));
 }else{
-    Left = InBracM[SIZE*gy +gx -1];
+    Left = LOAD(InBracM, PITCH*gy +gx -1);
 }
-if(gy==(SIZE-1)){
-    Bottom = InBracM[gx];
+if(gy==(NY-1)){
+    Bottom = LOAD(InBracM, gx);
 }else{
-    Bottom = InBracM[SIZE*(gy+1)+gx];
+    Bottom = LOAD(InBracM, PITCH*(gy+1)+gx);
 }
-if(gx==(SIZE-1)){
-    Right = InBracM[SIZE*gy];
+if(gx==(NX-1)){
+    Right = LOAD(InBracM, PITCH*gy);
 }else{
-    Right = InBracM[SIZE*gy +gx + 1];
+    Right = LOAD(InBracM, PITCH*gy +gx + 1);
 }
 
-float del2M = Top +Bottom +Right +Left -4*M;
-del2M = (1.0f/(H*H))*del2M ;
+STORE(OUT, gy*PITCH+gx, CHOuterConc(C, M, Top, Bottom, Right, Left DT_PASS));
 
-float out = C + DT*MOBILITY*del2M;
+}
 
-if (out > 1.0){
-     out = 1.0 ;
+/**
+@brief The first half of the two-kernel Cahn-Hilliard step.
+@param PHASE1 The input concentration field at time t=n .
+@param InBracM The global float array where the inner bracket is written.
+*/
+__kernel void ch_inner_kern(
+                            __global store* PHASE1,
+                            __global store* InBracM){
+    CHInnerEvol(PHASE1, InBracM);
 }
-else if (out < 0.0){
-    out = 0.0 ;
+
+/**
+@brief The second half of the two-kernel Cahn-Hilliard step.
+@param InBracM The inner bracket written by ch_inner_kern() .
+@param PHASE1 The input concentration field at time t=n .
+@param PHASE2 The output concentration field at time t=n+1 .
+
+It has to be enqueued after ch_inner_kern() has completed on the whole grid, which an in-order queue guarantees.
+*/
+__kernel void ch_outer_kern(
+                            __global store* InBracM,
+                            __global store* PHASE1,
+                            __global store* PHASE2 DT_ARG){
+    CHOuterEvol(InBracM, PHASE1, PHASE2 DT_PASS);
 }
 
-OUT[gy*SIZE+gx] = out ;
+/**
+@brief The first half of the Cahn-Hilliard step on the rows of a strip of the grid.
+@param PHASE1 The input concentration strip, its rows with 2 halo rows above and below, PITCH floats each.
+@param InBracM The inner bracket strip.
 
+The rows to update are given by the global work offset and size in y. The rows above and below are read without wrapping.
+*/
+__kernel void ch_inner_strip_kern(
+                            __global store* PHASE1,
+                            __global store* InBracM){
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    if(gx >= NX){
+        return;
+    }
+    int c = PITCH*gy +gx;
+    real Left = (gx==0) ? LOAD(PHASE1, c + NX-1) : LOAD(PHASE1, c-1);
+    real Right = (gx==(NX-1)) ? LOAD(PHASE1, c - (NX-1)) : LOAD(PHASE1, c+1);
+    STORE(InBracM, c, CHInnerBracket(LOAD(PHASE1, c), LOAD(PHASE1, c-PITCH), LOAD(PHASE1, c+PITCH), Right, Left));
 }
 
 /**
-@brief The Cahn-Hilliard evolutin kernel. 
-@param InBracM A global float array to temporarily hold the inner evolution calculations.
+@brief The second half of the Cahn-Hilliard step on the rows of a strip of the grid.
+@param InBracM The inner bracket strip written by ch_inner_strip_kern(), valid 1 row beyond the updated rows.
+@param PHASE1 The input concentration strip.
+@param PHASE2 The output concentration strip.
+*/
+__kernel void ch_outer_strip_kern(
+                            __global store* InBracM,
+                            __global store* PHASE1,
+                            __global store* PHASE2 DT_ARG){
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    if(gx >= NX){
+        return;
+    }
+    int c = PITCH*gy +gx;
+    real Left = (gx==0) ? LOAD(InBracM, c + NX-1) : LOAD(InBracM, c-1);
+    real Right = (gx==(NX-1)) ? LOAD(InBracM, c - (NX-1)) : LOAD(InBracM, c+1);
+    STORE(PHASE2, c, CHOuterConc(LOAD(PHASE1, c), LOAD(InBracM, c), LOAD(InBracM, c-PITCH), LOAD(InBracM, c+PITCH), Right, Left DT_PASS));
+}
+
+/**
+@brief The Cahn-Hilliard evolutin kernel, tiled in local memory.
 @param PHASE1 The input concentration field at time t=n .
 @param PHASE2 The output concentration field at time t=n+1 .
+@param CTILE Local memory for the concentration tile, (LX+4)*(LY+4) floats for a LX*LY work-group.
+@param MTILE Local memory for the inner bracket tile, (LX+2)*(LY+2) floats.
 
-The kernel combines the inner and outer evolution function and the computations can be expressed as : 
+The work-group loads its tile of PHASE1 with a 2-cell periodic halo, computes the inner bracket over the tile and a 1-cell halo, and then the outer evolution of its own cells. The halo of the inner bracket is recomputed by the neighbouring groups instead of being exchanged through global memory, so a single launch is race free.
 \f[
 
 \text{PHASE2} = \text{PHASE1} +  \delta t * \mu \nabla^2 \left[ f - \kappa \nabla^2\text{PHASE1} \right]
@@ -134,11 +277,430 @@ The kernel combines the inner and outer evolution function and the computations
 \f]
 */
 __kernel void phase_field_evol_kern(
-                                    __global float* InBracM,
-                                    __global float* PHASE1,
-                                    __global float* PHASE2){
+                                    __global store* PHASE1,
+                                    __global store* PHASE2,
+                                    __local real* CTILE,
+                                    __local real* MTILE DT_ARG){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int gx0 = get_group_id(0)*LX;
+    int gy0 = get_group_id(1)*LY;
+    int lid = ly*LX +lx;
+    int NL = LX*LY;
+
+    // Load the concentration tile with a 2-cell halo
+    int CW = LX+4;
+    for(int i = lid; i < CW*(LY+4); i += NL){
+        int x = (gx0 + i%CW - 2 + NX)%NX;
+        int y = (gy0 + i/CW - 2 + NY)%NY;
+        CTILE[i] = LOAD(PHASE1, PITCH*y +x);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Inner bracket over the tile and a 1-cell halo
+    int MW = LX+2;
+    for(int i = lid; i < MW*(LY+2); i += NL){
+        int c = (i/MW +1)*CW + i%MW +1;
+        MTILE[i] = CHInnerBracket(CTILE[c], CTILE[c-CW], CTILE[c+CW], CTILE[c+1], CTILE[c-1]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Outer evolution of the own cell, if it is inside the grid
+    int m = (ly+1)*MW + lx+1;
+    real C = CTILE[(ly+2)*CW + lx+2];
+    if(gx0+lx < NX && gy0+ly < NY){
+        STORE(PHASE2, PITCH*(gy0+ly) + gx0+lx, CHOuterConc(C, MTILE[m], MTILE[m-MW], MTILE[m+MW], MTILE[m+1], MTILE[m-1] DT_PASS));
+    }
+}
+
+/**
+@brief The original single-launch Cahn-Hilliard kernel.
+@param InBracM A global float array to temporarily hold the inner evolution calculations.
+@param PHASE1 The input concentration field at time t=n .
+@param PHASE2 The output concentration field at time t=n+1 .
+
+barrier() only synchronizes the work-items of one work-group, so the outer evolution at the edge of a group reads InBracM values of the neighbouring group that may not be written yet. The result is only correct when the whole grid fits in one work-group. The kernel is kept as the baseline of benchCahnHilliardKernels().
+*/
+__kernel void ch_legacy_evol_kern(
+                                    __global store* InBracM,
+                                    __global store* PHASE1,
+                                    __global store* PHASE2 DT_ARG){
     CHInnerEvol(PHASE1,InBracM);
     barrier(CLK_GLOBAL_MEM_FENCE);
-    CHOuterEvol(InBracM, PHASE1, PHASE2);
+    CHOuterEvol(InBracM, PHASE1, PHASE2 DT_PASS);
+}
+
+/**
+@brief The inner bracket of one cell with the KAPPA of an ensemble replica, see CHInnerBracket().
+@param M The concentration of the cell.
+@param Top The concentration of the top neighbour.
+@param Bottom The concentration of the bottom neighbour.
+@param Right The concentration of the right neighbour.
+@param Left The concentration of the left neighbour.
+@param kappa The KAPPA of the replica.
+@return \f$ f - \kappa \nabla^2\phi \f$ of the cell.
+*/
+real CHInnerBracketReplica(real M, real Top, real Bottom, real Right, real Left, real kappa){
+    real g = (real)2*M*(0.9-M)*(1-2*M);
+    real del2C = Top +Bottom +Right +Left -4*M;
+    return g - kappa*2.0*(real)del2C;
+}
+
+/**
+@brief The integrated concentration of one cell with the MOBILITY of an ensemble replica, see CHOuterConc().
+@param C The concentration of the cell at time t=n .
+@param M The inner bracket of the cell.
+@param Top The inner bracket of the top neighbour.
+@param Bottom The inner bracket of the bottom neighbour.
+@param Right The inner bracket of the right neighbour.
+@param Left The inner bracket of the left neighbour.
+@param mobility The MOBILITY of the replica.
+@return The concentration of the cell at time t=n+1, clamped to [0,1].
+*/
+real CHOuterConcReplica(real C, real M, real Top, real Bottom, real Right, real Left, real mobility DT_ARG){
+    real del2M = Top +Bottom +Right +Left -4*M;
+    del2M = (1.0f/(H*H))*del2M ;
+    return clamp(C + DT*mobility*del2M, (real)0, (real)1);
+}
+
+/**
+@brief The Cahn-Hilliard evolution kernel of an ensemble, tiled in local memory.
+@param PHASE1 The input concentration fields of all the replicas, PITCH*NY floats each, one after the other.
+@param PHASE2 The output concentration fields.
+@param PARAMS The parameters of the replicas, 2 floats each : MOBILITY, KAPPA.
+@param CTILE Local memory for the concentration tile, (LX+4)*(LY+4) floats for a LX*LY*1 work-group.
+@param MTILE Local memory for the inner bracket tile, (LX+2)*(LY+2) floats.
+
+The replica is the third dimension of the NDRange. Each replica evolves like in phase_field_evol_kern(), with its own MOBILITY and KAPPA.
+*/
+__kernel void ch_ensemble_kern(
+                                    __global store* PHASE1,
+                                    __global store* PHASE2,
+                                    __constant float* PARAMS,
+                                    __local real* CTILE,
+                                    __local real* MTILE DT_ARG){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int gx0 = get_group_id(0)*LX;
+    int gy0 = get_group_id(1)*LY;
+    int lid = ly*LX +lx;
+    int NL = LX*LY;
+
+    // The fields and parameters of the replica
+    int r = get_global_id(2);
+    __global store* IN = PHASE1 + (size_t)PITCH*NY*r;
+    __global store* OUT = PHASE2 + (size_t)PITCH*NY*r;
+    real mobility = PARAMS[2*r];
+    real kappa = PARAMS[2*r+1];
+
+    // Load the concentration tile with a 2-cell halo
+    int CW = LX+4;
+    for(int i = lid; i < CW*(LY+4); i += NL){
+        int x = (gx0 + i%CW - 2 + NX)%NX;
+        int y = (gy0 + i/CW - 2 + NY)%NY;
+        CTILE[i] = LOAD(IN, PITCH*y +x);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Inner bracket over the tile and a 1-cell halo
+    int MW = LX+2;
+    for(int i = lid; i < MW*(LY+2); i += NL){
+        int c = (i/MW +1)*CW + i%MW +1;
+        MTILE[i] = CHInnerBracketReplica(CTILE[c], CTILE[c-CW], CTILE[c+CW], CTILE[c+1], CTILE[c-1], kappa);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Outer evolution of the own cell, if it is inside the grid
+    int m = (ly+1)*MW + lx+1;
+    real C = CTILE[(ly+2)*CW + lx+2];
+    if(gx0+lx < NX && gy0+ly < NY){
+        STORE(OUT, PITCH*(gy0+ly) + gx0+lx, CHOuterConcReplica(C, MTILE[m], MTILE[m-MW], MTILE[m+MW], MTILE[m+1], MTILE[m-1], mobility DT_PASS));
+    }
+}
+
+/**
+@brief The inner bracket of one cell of a 3D grid, see CHInnerBracket().
+@param M The concentration of the cell.
+@param Top The concentration of the top neighbour.
+@param Bottom The concentration of the bottom neighbour.
+@param Right The concentration of the right neighbour.
+@param Left The concentration of the left neighbour.
+@param Back The concentration of the neighbour in the plane below.
+@param Front The concentration of the neighbour in the plane above.
+@return \f$ f - \kappa \nabla^2\phi \f$ of the cell.
+*/
+real CHInnerBracket3D(real M, real Top, real Bottom, real Right, real Left, real Back, real Front){
+    real g = (real)2*M*(0.9-M)*(1-2*M);
+    real del2C = Top +Bottom +Right +Left +Back +Front -6*M;
+    return g - KAPPA*2.0*(real)del2C;
+}
+
+/**
+@brief The integrated concentration of one cell of a 3D grid, see CHOuterConc().
+@param C The concentration of the cell at time t=n .
+@param M The inner bracket of the cell.
+@param Top The inner bracket of the top neighbour.
+@param Bottom The inner bracket of the bottom neighbour.
+@param Right The inner bracket of the right neighbour.
+@param Left The inner bracket of the left neighbour.
+@param Back The inner bracket of the neighbour in the plane below.
+@param Front The inner bracket of the neighbour in the plane above.
+@return The concentration of the cell at time t=n+1, clamped to [0,1].
+*/
+real CHOuterConc3D(real C, real M, real Top, real Bottom, real Right, real Left, real Back, real Front DT_ARG){
+    real del2M = Top +Bottom +Right +Left +Back +Front -6*M;
+    del2M = (1.0f/(H*H))*del2M ;
+    return clamp(C + DT*MOBILITY*del2M, (real)0, (real)1);
+}
+
+/**
+@brief Loads the halo of a 2D tile of one plane of a 3D grid into local memory.
+@param IN The plane, NY rows of PITCH floats.
+@param TILE The tile, (LX+2)*(LY+2) floats for a LX*LY work-group. The work items store the interior themselves.
+@param gx0 The x of the first cell of the tile.
+@param gy0 The y of the first cell of the tile.
+
+The halo is the 1-cell periodic ring around the tile, 2*(LX+2) + 2*LY cells that the work items of the group load in turn.
+*/
+void load_plane_halo(__global store* IN, __local real* TILE, int gx0, int gy0){
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int W = LX + 2;
+    int NH = 2*W + 2*LY;
+    for(int i = get_local_id(1)*LX + get_local_id(0); i < NH; i += LX*LY){
+        int tx, ty;
+        if(i < W){
+            tx = i; ty = 0;
+        }else if(i < 2*W){
+            tx = i - W; ty = LY + 1;
+        }else{
+            tx = ((i - 2*W)%2) ? W - 1 : 0; ty = 1 + (i - 2*W)/2;
+        }
+        int x = ((gx0 + tx - 1)%NX + NX)%NX;
+        int y = ((gy0 + ty - 1)%NY + NY)%NY;
+        TILE[ty*W + tx] = LOAD(IN, PITCH*y + x);
+    }
+}
+
+/**
+@brief The first half of the Cahn-Hilliard step on a 3D grid, 2.5D blocked.
+@param PHASE1 The input concentration field at time t=n .
+@param InBracM The global float array where the inner bracket is written.
+@param TILE Local memory for the tile of the current plane with a 1-cell halo, (LX+2)*(LY+2) floats for a LX*LY work-group.
+
+The NDRange is 2D. Every work item owns a column of cells and marches it in z with the planes below and above in registers,
+the in-plane neighbours are read from the tile of the current plane in local memory. The boundaries are periodic.
+*/
+__kernel void ch_inner_3d_kern(
+                            __global store* PHASE1,
+                            __global store* InBracM,
+                            __local real* TILE){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    int W = get_local_size(0) + 2;
+    int inside = (gx < NX) && (gy < NY);
+    size_t plane = (size_t)PITCH*NY;
+    size_t c = (size_t)PITCH*(gy%NY) + gx%NX;
+    int t = (ly+1)*W + lx+1;
+
+    real Back = LOAD(PHASE1, c + plane*(NZ-1));
+    real M = LOAD(PHASE1, c);
+    for(int z = 0; z < NZ; z++){
+        real Front = LOAD(PHASE1, c + plane*((z == NZ-1) ? 0 : z+1));
+        barrier(CLK_LOCAL_MEM_FENCE);
+        TILE[t] = M;
+        load_plane_halo(PHASE1 + plane*z, TILE, gx-lx, gy-ly);
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(inside){
+            STORE(InBracM, c + plane*z, CHInnerBracket3D(M, TILE[t-W], TILE[t+W], TILE[t+1], TILE[t-1], Back, Front));
+        }
+        Back = M;
+        M = Front;
+    }
+}
+
+/**
+@brief The second half of the Cahn-Hilliard step on a 3D grid, 2.5D blocked like ch_inner_3d_kern().
+@param InBracM The inner bracket written by ch_inner_3d_kern() .
+@param PHASE1 The input concentration field at time t=n .
+@param PHASE2 The output concentration field at time t=n+1 .
+@param TILE Local memory for the tile of the inner bracket of the current plane, (LX+2)*(LY+2) floats.
+
+It has to be enqueued after ch_inner_3d_kern() has completed on the whole grid, which an in-order queue guarantees.
+*/
+__kernel void ch_outer_3d_kern(
+                            __global store* InBracM,
+                            __global store* PHASE1,
+                            __global store* PHASE2,
+                            __local real* TILE DT_ARG){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    int W = get_local_size(0) + 2;
+    int inside = (gx < NX) && (gy < NY);
+    size_t plane = (size_t)PITCH*NY;
+    size_t c = (size_t)PITCH*(gy%NY) + gx%NX;
+    int t = (ly+1)*W + lx+1;
+
+    real Back = LOAD(InBracM, c + plane*(NZ-1));
+    real M = LOAD(InBracM, c);
+    for(int z = 0; z < NZ; z++){
+        real Front = LOAD(InBracM, c + plane*((z == NZ-1) ? 0 : z+1));
+        barrier(CLK_LOCAL_MEM_FENCE);
+        TILE[t] = M;
+        load_plane_halo(InBracM + plane*z, TILE, gx-lx, gy-ly);
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(inside){
+            real C = LOAD(PHASE1, c + plane*z);
+            STORE(PHASE2, c + plane*z, CHOuterConc3D(C, M, TILE[t-W], TILE[t+W], TILE[t+1], TILE[t-1], Back, Front DT_PASS));
+        }
+        Back = M;
+        M = Front;
+    }
+}
+
+// The complex values of the spectral step, real and imaginary part
+#if PRECISION == 2
+typedef double2 real2;
+#define PI_REAL M_PI
+#else
+typedef float2 real2;
+#define PI_REAL M_PI_F
+#endif
+
+/**
+@brief Packs the concentration and its g(C) into one complex field, the input of the forward FFT of the spectral step.
+@param PHASE1 The concentration field.
+@param Z The complex field of NX*NY values without the padding, C + i g(C).
+
+g(C) is the bulk term of CHInnerBracket(). One complex FFT of Z transforms both real fields at once.
+*/
+__kernel void ch_spectral_pack_kern(
+                                    __global store* PHASE1,
+                                    __global real2* Z){
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    if(gx >= NX || gy >= NY){
+        return;
+    }
+    real M = LOAD(PHASE1, PITCH*gy +gx);
+    real g = (real)2*M*(0.9-M)*(1-2*M);
+    Z[NX*gy +gx] = (real2)(M, g);
+}
+
+/**
+@brief One radix-2 butterfly of a stage of a Stockham FFT of length N.
+@param IN The input of the stage.
+@param OUT The output of the stage.
+@param base The index of the first value of the transformed line.
+@param stride The distance of the values of the line.
+@param N The length of the line, a power of two.
+@param p The stage, 1, 2, 4 ... N/2 .
+@param i The butterfly, 0 to N/2-1 .
+@param sign -1 for the forward and 1 for the inverse transform.
+
+After the log2(N) stages OUT holds the transform in natural order, the inverse is not scaled.
+*/
+void fft_radix2(__global const real2* IN, __global real2* OUT, size_t base, int stride, int N, int p, int i, int sign){
+    int k = i & (p-1);
+    real2 u0 = IN[base + (size_t)i*stride];
+    real2 u1 = IN[base + (size_t)(i + N/2)*stride];
+    real c;
+    real s = sincos(sign*PI_REAL*k/p, &c);
+    u1 = (real2)(u1.x*c - u1.y*s, u1.x*s + u1.y*c);
+    int j = (i << 1) - k;
+    OUT[base + (size_t)j*stride] = u0 + u1;
+    OUT[base + (size_t)(j + p)*stride] = u0 - u1;
+}
+
+/**
+@brief One stage of the FFTs of all the rows of a complex field of NX*NY values.
+@param IN The input of the stage.
+@param OUT The output of the stage.
+@param p The stage.
+@param sign -1 for the forward and 1 for the inverse transform.
+
+The NDRange is NX/2 x NY, one butterfly per work item.
+*/
+__kernel void fft_rows_kern(
+                            __global const real2* IN,
+                            __global real2* OUT,
+                            int p,
+                            int sign){
+    int i = get_global_id(0);
+    int y = get_global_id(1);
+    if(i >= NX/2 || y >= NY){
+        return;
+    }
+    fft_radix2(IN, OUT, (size_t)NX*y, 1, NX, p, i, sign);
+}
+
+/**
+@brief One stage of the FFTs of all the columns of a complex field of NX*NY values.
+@param IN The input of the stage.
+@param OUT The output of the stage.
+@param p The stage.
+@param sign -1 for the forward and 1 for the inverse transform.
+
+The NDRange is NX x NY/2, the neighbouring work items transform neighbouring columns, so the reads and writes are coalesced.
+*/
+__kernel void fft_cols_kern(
+                            __global const real2* IN,
+                            __global real2* OUT,
+                            int p,
+                            int sign){
+    int x = get_global_id(0);
+    int i = get_global_id(1);
+    if(x >= NX || i >= NY/2){
+        return;
+    }
+    fft_radix2(IN, OUT, x, NX, NY, p, i, sign);
+}
+
+/**
+@brief The semi-implicit update in Fourier space.
+@param Z The transform of C + i g(C), replaced with the transform whose real part is the concentration at t=n+1 .
+@param MULT The multipliers (a, b) of every wavevector from CHSpectralMultipliers(), the 1/(NX*NY) of the inverse FFT included.
+
+The new concentration is a C + b g in Fourier space. a and b are real and even in k, so the real part of the inverse transform
+of (a - i b)(C + i g) is that concentration.
+*/
+__kernel void ch_spectral_update_kern(
+                                    __global real2* Z,
+                                    __global const real2* MULT){
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    if(gx >= NX || gy >= NY){
+        return;
+    }
+    int c = NX*gy +gx;
+    real2 z = Z[c];
+    real2 m = MULT[c];
+    Z[c] = (real2)(m.x*z.x + m.y*z.y, m.x*z.y - m.y*z.x);
+}
+
+/**
+@brief Stores the real part of the inverse transform as the new concentration.
+@param Z The inverse transform.
+@param PHASE2 The concentration field at t=n+1 .
+*/
+__kernel void ch_spectral_unpack_kern(
+                                    __global const real2* Z,
+                                    __global store* PHASE2){
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    if(gx >= NX || gy >= NY){
+        return;
+    }
+    STORE(PHASE2, PITCH*gy +gx, Z[NX*gy +gx].x);
 }
 //END OF FILE
\ No newline at end of file
@@ -6,8 +6,61 @@ The time evolution expression can be expressed as :
  \frac{\partial \phi}{\partial t} = D \nabla^2\phi  \hspace{1cm}:\left[  \nabla^2 =  \frac{\partial^2 }{\partial x^2 } + \frac{\partial^2 }{\partial y^2} \right]
 \f]
 where D is the diffusion coefficient.
+
+phase_field_evol_kern() advances one time step per launch. phase_field_evol_tblock_kern() advances several time steps per launch inside local memory (temporal blocking).
+phase_field_evol_3d_kern() is the 7-point stencil of a 3D grid, blocked in 2.5D.
+phase_field_evol_strip_kern() updates some rows of a strip of the grid in the multi-device mode, see multi_device_funcs.h .
+
+The grid is NX*NY cells, the rows are PITCH floats apart. The global work size is rounded up to the work-group size, the work items outside the grid write nothing.
+A 3D grid is NZ planes of NY rows, the planes are PITCH*NY floats apart.
 */ 
 
+// Precision of the fields, -DPRECISION=n from getKernelFromFile(): 0 float, 1 half storage with float compute, 2 double.
+// The fields are read with LOAD() and written with STORE(), the arithmetic and the local memory tiles are in real.
+#if PRECISION == 2
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#elif PRECISION == 1
+typedef float real;
+typedef half store;
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
+#else
+typedef float real;
+typedef float store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#endif
+
+// The time step: the DT build option, or with -DADAPTIVE_DT the last argument dt of the kernels, see adaptive_dt_funcs.h .
+// The functions that use DT take DT_ARG last and are called with DT_PASS, both empty without ADAPTIVE_DT.
+#ifdef ADAPTIVE_DT
+#undef DT
+#define DT dt
+#define DT_ARG , real dt
+#define DT_PASS , dt
+#else
+#define DT_ARG
+#define DT_PASS
+#endif
+
+/**
+@brief The explicit update of one cell.
+@param M The value of the cell at time t=n .
+@param Top The value of the top neighbour.
+@param Bottom The value of the bottom neighbour.
+@param Right The value of the right neighbour.
+@param Left The value of the left neighbour.
+@return The value of the cell at time t=n+1 .
+*/
+real diffusion_update(real M, real Top, real Bottom, real Right, real Left DT_ARG){
+    real p = Top +Bottom +Right +Left - 4*M;
+    return M + DT*COEFF*p/(H*H) ;
+}
+
 /**
 @brief The phase-field evolution equation.
 @param gMAT1 Global Matrix 1 buffer, the input buffer
@@ -19,43 +72,203 @@ The computations of the kernel can be expressed as:
 \f]
 */
 __kernel void phase_field_evol_kern(
-                        __global float* gMAT1,
-                        __global float* gMAT2){
+                        __global store* gMAT1,
+                        __global store* gMAT2 DT_ARG){
 
 int gx = get_global_id(0);
 int gy = get_global_id(1);
+if(gx >= NX || gy >= NY){
+    return;
+}
 
-float M, Right, Left, Top, Bottom ;
+real M, Right, Left, Top, Bottom ;
 
-M = gMAT1[SIZE*gy +gx];
+M = LOAD(gMAT1, PITCH*gy +gx);
 
 // Apply periodic boundary conditions
 if(gy==0){
-    Top = gMAT1[SIZE*(SIZE-1)+gx];
+    Top = LOAD(gMAT1, PITCH*(NY-1)+gx);
 }else{
-    Top = gMAT1[SIZE*(gy-1) +gx];
+    Top = LOAD(gMAT1, PITCH*(gy-1) +gx);
 }
 
 if(gx==0){
-    Left = gMAT1[SIZE*gy + (SIZE-1)];
+    Left = LOAD(gMAT1, PITCH*gy + (NX-1));
 }else{
-    Left = gMAT1[SIZE*gy +gx -1];
+    Left = LOAD(gMAT1, PITCH*gy +gx -1);
 }
-if(gy==(SIZE-1)){
-    Bottom = gMAT1[gx];
+if(gy==(NY-1)){
+    Bottom = LOAD(gMAT1, gx);
 }else{
-    Bottom = gMAT1[SIZE*(gy+1)+gx];
+    Bottom = LOAD(gMAT1, PITCH*(gy+1)+gx);
 }
-if(gx==(SIZE-1)){
-    Right = gMAT1[SIZE*gy];
+if(gx==(NX-1)){
+    Right = LOAD(gMAT1, PITCH*gy);
 }else{
-    Right = gMAT1[SIZE*gy +gx + 1];
+    Right = LOAD(gMAT1, PITCH*gy +gx + 1);
 }
 
-float p = Top +Bottom +Right +Left - 4*M;
-float out = M + DT*COEFF*p/(H*H) ;
+STORE(gMAT2, gy*PITCH+gx, diffusion_update(M, Top, Bottom, Right, Left DT_PASS));
+
+}
+
+/**
+@brief The phase-field evolution equation on the rows of a strip of the grid.
+@param gMAT1 The input strip, its rows with a halo row above and below, PITCH floats each.
+@param gMAT2 The output strip.
+
+The rows to update are given by the global work offset and size in y, which stay 1 row inside the halo rows.
+The rows above and below are read without wrapping, the halo rows hold them. The x direction is periodic.
+*/
+__kernel void phase_field_evol_strip_kern(
+                        __global store* gMAT1,
+                        __global store* gMAT2 DT_ARG){
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    if(gx >= NX){
+        return;
+    }
+    int c = PITCH*gy +gx;
+    real Left = (gx==0) ? LOAD(gMAT1, c + NX-1) : LOAD(gMAT1, c-1);
+    real Right = (gx==(NX-1)) ? LOAD(gMAT1, c - (NX-1)) : LOAD(gMAT1, c+1);
+    STORE(gMAT2, c, diffusion_update(LOAD(gMAT1, c), LOAD(gMAT1, c-PITCH), LOAD(gMAT1, c+PITCH), Right, Left DT_PASS));
+}
+
+/**
+@brief The phase-field evolution equation, advancing NSTEPS time steps in one launch.
+@param gMAT1 Global Matrix 1 buffer, the input buffer at time t=n .
+@param gMAT2 Global Matrix 2 buffer, the output buffer at time t=n+NSTEPS .
+@param NSTEPS The number of time steps to advance.
+@param TILE_A Local memory for the tile with an NSTEPS-cell halo, (LX+2*NSTEPS)*(LY+2*NSTEPS) floats for a LX*LY work-group.
+@param TILE_B Local memory of the same size as TILE_A.
+
+Overlapped tiling: every work-group loads its tile with a periodic halo NSTEPS cells wide and ping-pongs TILE_A and TILE_B NSTEPS times.
+Step s updates the cells that are at least s+1 cells away from the edge of the loaded region, so after NSTEPS steps the cells of the tile itself are exact.
+The halo is recomputed redundantly by the neighbouring groups, which trades a little compute for NSTEPS times less global memory traffic.
+The tile loads wrap around NX and NY, so the tiles that stick out of the grid hold periodic images and only the cells inside the grid are stored.
+*/
+__kernel void phase_field_evol_tblock_kern(
+                        __global store* gMAT1,
+                        __global store* gMAT2,
+                        int NSTEPS,
+                        __local real* TILE_A,
+                        __local real* TILE_B DT_ARG){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int gx0 = get_group_id(0)*LX;
+    int gy0 = get_group_id(1)*LY;
+    int lid = ly*LX +lx;
+    int NL = LX*LY;
+    int R = NSTEPS;
+    int W = LX + 2*R;
+    int N = W*(LY + 2*R);
+
+    // Load the tile with a periodic halo R cells wide
+    for(int i = lid; i < N; i += NL){
+        int x = ((gx0 + i%W - R)%NX + NX)%NX;
+        int y = ((gy0 + i/W - R)%NY + NY)%NY;
+        TILE_A[i] = LOAD(gMAT1, PITCH*y +x);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    __local real* IN = TILE_A;
+    __local real* OUT = TILE_B;
+    for(int s = 0; s < R; s++){
+        for(int i = lid; i < N; i += NL){
+            int tx = i%W;
+            int ty = i/W;
+            if((tx > s) && (tx < W-1-s) && (ty > s) && (ty < LY+2*R-1-s)){
+                OUT[i] = diffusion_update(IN[i], IN[i-W], IN[i+W], IN[i+1], IN[i-1] DT_PASS);
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        __local real* tmp = IN;
+        IN = OUT;
+        OUT = tmp;
+    }
+
+    if(gx0+lx < NX && gy0+ly < NY){
+        STORE(gMAT2, PITCH*(gy0+ly) + gx0+lx, IN[(ly+R)*W + lx+R]);
+    }
+}
+
+/**
+@brief Loads the halo of a 2D tile of one plane of a 3D grid into local memory.
+@param IN The plane, NY rows of PITCH floats.
+@param TILE The tile, (LX+2)*(LY+2) floats for a LX*LY work-group. The work items store the interior themselves.
+@param gx0 The x of the first cell of the tile.
+@param gy0 The y of the first cell of the tile.
+
+The halo is the 1-cell periodic ring around the tile, 2*(LX+2) + 2*LY cells that the work items of the group load in turn.
+*/
+void load_plane_halo(__global store* IN, __local real* TILE, int gx0, int gy0){
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int W = LX + 2;
+    int NH = 2*W + 2*LY;
+    for(int i = get_local_id(1)*LX + get_local_id(0); i < NH; i += LX*LY){
+        int tx, ty;
+        if(i < W){
+            tx = i; ty = 0;
+        }else if(i < 2*W){
+            tx = i - W; ty = LY + 1;
+        }else{
+            tx = ((i - 2*W)%2) ? W - 1 : 0; ty = 1 + (i - 2*W)/2;
+        }
+        int x = ((gx0 + tx - 1)%NX + NX)%NX;
+        int y = ((gy0 + ty - 1)%NY + NY)%NY;
+        TILE[ty*W + tx] = LOAD(IN, PITCH*y + x);
+    }
+}
+
+/**
+@brief The phase-field evolution equation on a 3D grid, 2.5D blocked.
+@param gMAT1 Global Matrix 1 buffer, the input buffer at time t=n .
+@param gMAT2 Global Matrix 2 buffer, the output buffer at time t=n+1 .
+@param TILE Local memory for the tile of the current plane with a 1-cell halo, (LX+2)*(LY+2) floats for a LX*LY work-group.
+
+The NDRange is 2D. Every work item owns a column of cells and marches it in z: the cell below, the cell itself and the cell above
+are held in registers, and the in-plane neighbours are read from the tile of the current plane in local memory. Each plane is read
+from global memory once per group plus its halo, instead of 7 times by a naive 3D stencil.
+All the boundaries are periodic. The work items outside the grid hold the periodic image of their cell, so the tiles are complete.
+\f[
+ \text{gMAT2} = \text{gMAT1} + \delta t * D \nabla^2\text{gMAT1}  \hspace{1cm}:\left[  \nabla^2 =  \frac{\partial^2 }{\partial x^2 } + \frac{\partial^2 }{\partial y^2} + \frac{\partial^2 }{\partial z^2} \right]
+\f]
+*/
+__kernel void phase_field_evol_3d_kern(
+                        __global store* gMAT1,
+                        __global store* gMAT2,
+                        __local real* TILE DT_ARG){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int gx = get_global_id(0);
+    int gy = get_global_id(1);
+    int gx0 = gx - lx;
+    int gy0 = gy - ly;
+    int W = get_local_size(0) + 2;
+    int inside = (gx < NX) && (gy < NY);
+    size_t plane = (size_t)PITCH*NY;
+    size_t c = (size_t)PITCH*(gy%NY) + gx%NX;
+    int t = (ly+1)*W + lx+1;
 
-gMAT2[gy*SIZE+gx] = out;
+    real Back = LOAD(gMAT1, c + plane*(NZ-1));
+    real M = LOAD(gMAT1, c);
+    for(int z = 0; z < NZ; z++){
+        real Front = LOAD(gMAT1, c + plane*((z == NZ-1) ? 0 : z+1));
+        // The tile of the previous plane is still being read
+        barrier(CLK_LOCAL_MEM_FENCE);
+        TILE[t] = M;
+        load_plane_halo(gMAT1 + plane*z, TILE, gx0, gy0);
+        barrier(CLK_LOCAL_MEM_FENCE);
 
+        real p = TILE[t-W] + TILE[t+W] + TILE[t+1] + TILE[t-1] + Back + Front - 6*M;
+        if(inside){
+            STORE(gMAT2, c + plane*z, M + DT*COEFF*p/(H*H));
+        }
+        Back = M;
+        M = Front;
+    }
 }
 //END OF FILE
\ No newline at end of file
@@ -1,8 +1,45 @@
 /**
 @file KobayashiAnisoKern.cl
 @brief The OpenCL kernel code for the Kobayashi anisotropic dendrite growth.
+
+Two kernels evolve the same equations. phase_field_evol_kern() evaluates the anisotropy functions on the four neighbours of every cell straight from global memory. phase_field_evol_tiled_kern() loads a tile into local memory and evaluates them once per cell of the tile and its halo.
+phase_field_evol_ensemble_kern() is the tiled kernel for an ensemble of replicas with their own parameters, see ensemble_funcs.h .
+phase_field_evol_sparse_kern() is the tiled kernel over the list of active tiles made by active_tiles_kern(), see active_tiles_funcs.h .
+
+The grid is NX*NY cells, the rows are PITCH floats apart. The global work size is rounded up to the work-group size, the work items outside the grid write nothing.
 */
 
+// Precision of the fields, -DPRECISION=n from getKernelFromFile(): 0 float, 1 half storage with float compute, 2 double.
+// The fields are read with LOAD() and written with STORE(), the arithmetic and the local memory tiles are in real.
+#if PRECISION == 2
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#elif PRECISION == 1
+typedef float real;
+typedef half store;
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
+#else
+typedef float real;
+typedef float store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#endif
+
+// The time step: the DT build option, or with -DADAPTIVE_DT the last argument dt of the kernels that step in time, see adaptive_dt_funcs.h .
+#ifdef ADAPTIVE_DT
+#undef DT
+#define DT dt
+#define DT_ARG , real dt
+#define DT_PASS , dt
+#else
+#define DT_ARG
+#define DT_PASS
+#endif
+
 /**
 @brief A function to get the laplacian of the temperature field.
 @param TEMP The pointer to the global temperature buffer.
@@ -10,14 +47,14 @@
 @param y The spatial y coordinate. The global ID 1 of the work item.
 @return The laplacian calculated using the five point stencil within the finite difference approximation.
 */
-float get_temp_laplacian(__global float* TEMP, int x, int y){
-float lap = 0.0f ;
-float T = TEMP[SIZE*y+x] ;
-
-lap += TEMP[SIZE*y +x -1];
-lap += TEMP[SIZE*y +x +1];
-lap += TEMP[SIZE*(y-1) +x];
-lap += TEMP[SIZE*(y+1) +x];
+real get_temp_laplacian(__global store* TEMP, int x, int y){
+real lap = 0.0f ;
+real T = LOAD(TEMP, PITCH*y+x) ;
+
+lap += LOAD(TEMP, PITCH*y +x -1);
+lap += LOAD(TEMP, PITCH*y +x +1);
+lap += LOAD(TEMP, PITCH*(y-1) +x);
+lap += LOAD(TEMP, PITCH*(y+1) +x);
 lap -= 4.0*T ;
 
 return lap/(H*H);
@@ -30,14 +67,14 @@ return lap/(H*H);
 @param y The spatial y coordinate. The global ID 1 of the work item.
 @return The laplacian calculated using the five point stencil within the finite difference approximation.
 */
-float get_phase_laplacian(__global float* PH, int x, int y){
-float lap = 0.0f ;
-float p = PH[SIZE*y+x] ;
-
-lap += PH[SIZE*y +x -1];
-lap += PH[SIZE*y +x +1];
-lap += PH[SIZE*(y-1) +x];
-lap += PH[SIZE*(y+1) +x];
+real get_phase_laplacian(__global store* PH, int x, int y){
+real lap = 0.0f ;
+real p = LOAD(PH, PITCH*y+x) ;
+
+lap += LOAD(PH, PITCH*y +x -1);
+lap += LOAD(PH, PITCH*y +x +1);
+lap += LOAD(PH, PITCH*(y-1) +x);
+lap += LOAD(PH, PITCH*(y+1) +x);
 lap -= 4.0*p ;
 
 return lap/(H*H);
@@ -50,15 +87,15 @@ return lap/(H*H);
 @param y The spatial y coordinate. The global ID 1 of the work item.
 @return The partial derivative calculated within the finite difference approximation.
 */
- float get_dPdY(
-               __global float* PH,
+ real get_dPdY(
+               __global store* PH,
                int x,
                int y){
-float Top, Bottom ;
-Top = PH[SIZE*(y-1) +x];
-Bottom = PH[SIZE*(y+1)+x];
+real Top, Bottom ;
+Top = LOAD(PH, PITCH*(y-1) +x);
+Bottom = LOAD(PH, PITCH*(y+1)+x);
 
-return (Bottom-Top)/(2.0*(float)H) ;
+return (Bottom-Top)/(2.0*(real)H) ;
 }
 
 /**
@@ -68,15 +105,30 @@ return (Bottom-Top)/(2.0*(float)H) ;
 @param y The spatial y coordinate. The global ID 1 of the work item.
 @return The partial derivative calculated within the finite difference approximation.
 */
- float get_dPdX(
-               __global float* PH,
+ real get_dPdX(
+               __global store* PH,
                int x,
                int y){
-float Right, Left ;
-Left = PH[SIZE*y +x -1];
-Right = PH[SIZE*y +x + 1];
+real Right, Left ;
+Left = LOAD(PH, PITCH*y +x -1);
+Right = LOAD(PH, PITCH*y +x + 1);
+
+return (Right - Left)/(2.0*(real)H) ;
+}
 
-return (Right - Left)/(2.0*(float)H) ;
+/**
+@brief A function to calculate the value of theta from the gradient of the phase field.
+@param dPdX The partial derivative along the X axis.
+@param dPdY The partial derivative along the Y axis.
+@return The decimal value of theta, 0 if either derivative is 0.
+*/
+real get_theta_from_grad(real dPdX, real dPdY){
+    if ((dPdX==0)||(dPdY==0)){
+        return 0 ;
+    }
+    else{
+        return atan(dPdY/dPdX) ;
+    }
 }
 
 /**
@@ -91,20 +143,15 @@ Theta is calculated using the following equation :
 \theta = \arctan{ \left(\frac{\partial \phi / \partial y}{\partial \phi/ \partial x} \right)}
 \f]
 */
-float get_theta(
-                __global float* PH,
+real get_theta(
+                __global store* PH,
                 int x,
                 int y){
 
-float dPdY = get_dPdY(PH,x,y) ;
-float dPdX = get_dPdX(PH,x,y) ;
+real dPdY = get_dPdY(PH,x,y) ;
+real dPdX = get_dPdX(PH,x,y) ;
 
-if ((dPdX==0)||(dPdY==0)){
-    return 0 ;
-} 
-else{
-    return atan(dPdY/dPdX) ;
-}
+return get_theta_from_grad(dPdX, dPdY) ;
 }
 
 /**
@@ -117,8 +164,8 @@ Epsilon is calculated using the following equation :
 \epsilon = \bar{\epsilon}(1 + \delta \cos{j(\theta - \theta_0)})
 \f]
 */
-float get_epsilon(float theta){
-    return (float)EPS_BAR*(1 +DELTA*cos(J*(theta -THETA0))) ;
+real get_epsilon(real theta){
+    return (real)EPS_BAR*(1 +DELTA*cos(J*(theta -THETA0))) ;
 }
 
 /**
@@ -130,8 +177,8 @@ The derivative is calculated using the following equation :
 \frac{\partial \epsilon}{\partial \theta}= -\bar{\epsilon}*\delta *j* \sin{j(\theta - \theta_0)}
 \f]
 */
-float get_DepsDtheta(float theta){
-    return -(float)EPS_BAR*DELTA*J*sin(J*(theta -THETA0));
+real get_DepsDtheta(real theta){
+    return -(real)EPS_BAR*DELTA*J*sin(J*(theta -THETA0));
 }
 
 
@@ -148,8 +195,8 @@ Calculated using the following equation :
 \f]
 Here both epsilon and the partial derivative is calculated using the declared get_DepsDtheta() and get_epsilon() functions.
 */
-float get_epsDepsDtheta(__global float* PH, int x, int y){
-    float theta  = get_theta(PH,x,y) ;
+real get_epsDepsDtheta(__global store* PH, int x, int y){
+    real theta  = get_theta(PH,x,y) ;
     return get_epsilon(theta)*get_DepsDtheta(theta) ;
 }
 
@@ -161,10 +208,10 @@ float get_epsDepsDtheta(__global float* PH, int x, int y){
 @return A true or false.
 The function checks the neighborhood values for similarity. If all the values of the five point stencil are equal we skip computing laplacian and derrivatives in the phase_field_evol_kern() function as those will be 0. 
 */
-bool check_neighbors(__global float* PH, int x, int y){
+bool check_neighbors(__global store* PH, int x, int y){
     bool nbh = true ;
-    float C = PH[SIZE*y+x] ;
-    nbh = nbh && (PH[SIZE*(y+1)+x]==C) && (PH[SIZE*(y-1)+x]==C) && (PH[SIZE*y+x+1]==C)  && (PH[SIZE*y+x-1]==C) ;
+    real C = LOAD(PH, PITCH*y+x) ;
+    nbh = nbh && (LOAD(PH, PITCH*(y+1)+x)==C) && (LOAD(PH, PITCH*(y-1)+x)==C) && (LOAD(PH, PITCH*y+x+1)==C)  && (LOAD(PH, PITCH*y+x-1)==C) ;
     return nbh ;
 }
 
@@ -177,63 +224,382 @@ bool check_neighbors(__global float* PH, int x, int y){
 @param PHASE_NOISE The noise amplitide for introducing randomness in the phase field. 
 */
 __kernel void phase_field_evol_kern(
-                                        __global float* PHASE_IN,
-                                        __global float* PHASE_OUT,
-                                        __global float* TEMP_IN,
-                                        __global float* TEMP_OUT,
-                                        float PHASE_NOISE){
+                                        __global store* PHASE_IN,
+                                        __global store* PHASE_OUT,
+                                        __global store* TEMP_IN,
+                                        __global store* TEMP_OUT,
+                                        float PHASE_NOISE DT_ARG){
     // Get global IDs
     int gx = get_global_id(0);
     int gy = get_global_id(1);
+    if(gx >= NX || gy >= NY){
+        return;
+    }
 
-    bool condition = (gx<2)||(gx>(SIZE-3))||(gy<2)||(gy>(SIZE-3)) || (check_neighbors(PHASE_IN,gx,gy));
+    bool condition = (gx<2)||(gx>(NX-3))||(gy<2)||(gy>(NY-3)) || (check_neighbors(PHASE_IN,gx,gy));
 
     // basic vars to be used in both situations
-    float Temp, mm, term3, p1, p2 ;
-    p1 = PHASE_IN[SIZE*gy +gx];
-    Temp = TEMP_IN[SIZE*gy +gx] ;
-    mm = ((float)ALPHA/3.14152557)*atan((float)GAMMA*(-T_MELT +Temp)) ;
+    real Temp, mm, term3, p1, p2 ;
+    p1 = LOAD(PHASE_IN, PITCH*gy +gx);
+    Temp = LOAD(TEMP_IN, PITCH*gy +gx) ;
+    mm = ((real)ALPHA/3.14152557)*atan((real)GAMMA*(-T_MELT +Temp)) ;
 
     if(condition){
 
         // because everything else is zero!
         term3 = p1*(1.0-p1)*(p1-0.5+mm) ;
-        p2 = p1+ ((float)DT/(float)TAU)*(term3 +p1*(1.0 -p1)*PHASE_NOISE*sin((float)gx)*cos((float)gy)); ;
+        p2 = p1+ ((real)DT/(real)TAU)*(term3 +p1*(1.0 -p1)*PHASE_NOISE*sin((real)gx)*cos((real)gy)); ;
 
-        PHASE_OUT[SIZE*gy +gx] = p2 ;
-        TEMP_OUT[SIZE*gy +gx] = Temp - LAT_H*(p2-p1) ;
+        STORE(PHASE_OUT, PITCH*gy +gx, p2);
+        STORE(TEMP_OUT, PITCH*gy +gx, Temp - LAT_H*(p2-p1));
 
     }else{
 
         // printf("[[%d,%d]]",gx,gy);
         // get the center point
-        float tmp1, tmp2, term2, term1, eps ; 
+        real tmp1, tmp2, term2, term1, eps ; 
 
         // get term1
         tmp1=get_dPdX(PHASE_IN,gx,gy+1)*get_epsDepsDtheta(PHASE_IN,gx,gy+1) ; 
         tmp2=get_dPdX(PHASE_IN,gx,gy-1)*get_epsDepsDtheta(PHASE_IN,gx,gy-1) ; 
-        term1 = (tmp1-tmp2)/(2.0*(float)H) ;
+        term1 = (tmp1-tmp2)/(2.0*(real)H) ;
 
         // get term2
         tmp1 = get_dPdY(PHASE_IN,gx+1,gy)*get_epsDepsDtheta(PHASE_IN,gx+1,gy) ;
         tmp2 = get_dPdY(PHASE_IN,gx-1,gy)*get_epsDepsDtheta(PHASE_IN,gx-1,gy) ;
-        term2 = (tmp1-tmp2)/(2.0*(float)H) ;
+        term2 = (tmp1-tmp2)/(2.0*(real)H) ;
 
         // get epsilon
         eps  = get_epsilon( get_theta(PHASE_IN, gx, gy)) ;
 
         term3 = eps*eps*get_phase_laplacian(PHASE_IN,gx,gy) + p1*(1.0-p1)*(p1-0.5+mm) ;
         // calculate the evolution
-        p2= p1+ ((float)DT/(float)TAU)*(term1-term2+term3 +p1*(1.0 -p1)*PHASE_NOISE*sin((float)gx)*cos((float)gy));
+        p2= p1+ ((real)DT/(real)TAU)*(term1-term2+term3 +p1*(1.0 -p1)*PHASE_NOISE*sin((real)gx)*cos((real)gy));
 
-        PHASE_OUT[SIZE*gy +gx] = p2;
+        STORE(PHASE_OUT, PITCH*gy +gx, p2);
 
         //////// Temp field evolution 
         term1 = THERM_DIFF*get_temp_laplacian(TEMP_IN,gx,gy);
         term2 = LAT_H*(p2-p1);
-        TEMP_OUT[SIZE*gy +gx] = Temp + DT*term1 -term2 ;
+        STORE(TEMP_OUT, PITCH*gy +gx, Temp + DT*term1 -term2);
+    }
+
+}
+
+/// The parameter i of the replica P of an ensemble in evolve_tile(), or the build option C if P is 0, with its own type, so
+/// the tiled and sparse kernels compute with the "-D" constants exactly like phase_field_evol_kern().
+#define TILE_PARAM(i, C) ((P != 0) ? (real)P[i] : (C))
+
+/**
+@brief The update of one tile of the grid in local memory, the body of phase_field_evol_tiled_kern(), phase_field_evol_sparse_kern() and phase_field_evol_ensemble_kern().
+@param PHASE_IN The input phase/concentration field, at time t =n .
+@param PHASE_OUT The output phase/concentration field, at time t =n+1 .
+@param TEMP_IN The input temperature field, at time t =n .
+@param TEMP_OUT The output temperature field, at time t =n+1 .
+@param offset The first cell of the fields in the four buffers, PITCH*NY*r for the replica r of an ensemble, else 0.
+@param P The parameters of the replica, in the order of phase_field_evol_ensemble_kern(), or 0 for the build options.
+@param PHASE_NOISE The noise amplitide for introducing randomness in the phase field. 
+@param PTILE Local memory for the phase tile with a 2-cell halo, (LX+4)*(LY+4) floats for a LX*LY work-group.
+@param TTILE Local memory for the temperature tile with a 1-cell halo, (LX+2)*(LY+2) floats.
+@param GTILE Local memory for dphi/dx, dphi/dy, epsilon and eps*deps/dtheta of the tile with a 1-cell halo, 4*(LX+2)*(LY+2) floats.
+@param gx0 The x coordinate of the first cell of the tile.
+@param gy0 The y coordinate of the first cell of the tile.
+@return The new phase of the cell of the work item, 0 for the work items outside the grid.
+
+Each work-group loads its tiles once, then computes theta, epsilon and eps*deps/dtheta once per cell of the tile and its
+1-cell halo: one atan, one cos and one sin per cell instead of five atan and about ten cos/sin. term1, term2 and term3
+are then evaluated from local memory. Halo cells outside the grid are clamped to the edge; they only feed the cells
+within 2 of the edge, which take the simple branch. The work items outside the grid, when NX or NY is not a multiple
+of the work-group size, load their share of the tiles and return before the update.
+*/
+real evolve_tile(
+                __global store* PHASE_IN,
+                __global store* PHASE_OUT,
+                __global store* TEMP_IN,
+                __global store* TEMP_OUT,
+                size_t offset,
+                __constant float* P,
+                float PHASE_NOISE,
+                __local real* PTILE,
+                __local real* TTILE,
+                __local real* GTILE,
+                int gx0,
+                int gy0 DT_ARG){
+    PHASE_IN += offset;
+    PHASE_OUT += offset;
+    TEMP_IN += offset;
+    TEMP_OUT += offset;
+
+    // Get the cell of the work item
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int gx = gx0 + lx;
+    int gy = gy0 + ly;
+    int lid = ly*LX +lx;
+    int NL = LX*LY;
+
+    // Load the phase tile with a 2-cell halo and the temperature tile with a 1-cell halo
+    int PW = LX+4;
+    for(int i = lid; i < PW*(LY+4); i += NL){
+        int x = clamp(gx0 + i%PW - 2, 0, NX-1);
+        int y = clamp(gy0 + i/PW - 2, 0, NY-1);
+        PTILE[i] = LOAD(PHASE_IN, PITCH*y +x);
+    }
+    int GW = LX+2;
+    int GN = GW*(LY+2);
+    for(int i = lid; i < GN; i += NL){
+        int x = clamp(gx0 + i%GW - 1, 0, NX-1);
+        int y = clamp(gy0 + i/GW - 1, 0, NY-1);
+        TTILE[i] = LOAD(TEMP_IN, PITCH*y +x);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Gradient, epsilon and eps*deps/dtheta once per cell of the tile and its 1-cell halo
+    for(int i = lid; i < GN; i += NL){
+        int p = (i/GW +1)*PW + i%GW +1;
+        real dPdX = (PTILE[p+1] - PTILE[p-1])/(2.0*(real)H) ;
+        real dPdY = (PTILE[p+PW] - PTILE[p-PW])/(2.0*(real)H) ;
+        real theta = get_theta_from_grad(dPdX, dPdY) ;
+        real eps = TILE_PARAM(0, (real)EPS_BAR)*(1 +TILE_PARAM(3, DELTA)*cos(TILE_PARAM(6, J)*(theta -TILE_PARAM(5, THETA0)))) ;
+        GTILE[i] = dPdX ;
+        GTILE[GN+i] = dPdY ;
+        GTILE[2*GN+i] = eps ;
+        GTILE[3*GN+i] = eps*(real)(-TILE_PARAM(0, (real)EPS_BAR)*TILE_PARAM(3, DELTA)*TILE_PARAM(6, J)*sin(TILE_PARAM(6, J)*(theta -TILE_PARAM(5, THETA0)))) ;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // The work items outside the grid only helped to fill the tiles
+    if(gx >= NX || gy >= NY){
+        return 0;
     }
 
+    int p = (ly+2)*PW + lx+2 ;
+    int g = (ly+1)*GW + lx+1 ;
+    __local real* DPDX = GTILE ;
+    __local real* DPDY = GTILE + GN ;
+    __local real* EPS = GTILE + 2*GN ;
+    __local real* EPSD = GTILE + 3*GN ;
+
+    // basic vars to be used in both situations
+    real Temp, mm, term3, p1, p2 ;
+    p1 = PTILE[p];
+    Temp = TTILE[g] ;
+    mm = (TILE_PARAM(1, (real)ALPHA)/3.14152557)*atan(TILE_PARAM(2, (real)GAMMA)*(-TILE_PARAM(9, T_MELT) +Temp)) ;
+
+    bool condition = (gx<2)||(gx>(NX-3))||(gy<2)||(gy>(NY-3)) || ((PTILE[p+PW]==p1) && (PTILE[p-PW]==p1) && (PTILE[p+1]==p1) && (PTILE[p-1]==p1));
+
+    if(condition){
+
+        // because everything else is zero!
+        term3 = p1*(1.0-p1)*(p1-0.5+mm) ;
+        p2 = p1+ ((real)DT/TILE_PARAM(4, (real)TAU))*(term3 +p1*(1.0 -p1)*PHASE_NOISE*sin((real)gx)*cos((real)gy));
+
+        STORE(PHASE_OUT, PITCH*gy +gx, p2);
+        STORE(TEMP_OUT, PITCH*gy +gx, Temp - TILE_PARAM(8, LAT_H)*(p2-p1));
+
+    }else{
+
+        real tmp1, tmp2, term2, term1, eps, lap ;
+
+        // get term1
+        tmp1 = DPDX[g+GW]*EPSD[g+GW] ;
+        tmp2 = DPDX[g-GW]*EPSD[g-GW] ;
+        term1 = (tmp1-tmp2)/(2.0*(real)H) ;
+
+        // get term2
+        tmp1 = DPDY[g+1]*EPSD[g+1] ;
+        tmp2 = DPDY[g-1]*EPSD[g-1] ;
+        term2 = (tmp1-tmp2)/(2.0*(real)H) ;
+
+        // get epsilon
+        eps = EPS[g] ;
+
+        lap = 0.0f ;
+        lap += PTILE[p-1];
+        lap += PTILE[p+1];
+        lap += PTILE[p-PW];
+        lap += PTILE[p+PW];
+        lap -= 4.0*p1 ;
+        lap = lap/(H*H) ;
+
+        term3 = eps*eps*lap + p1*(1.0-p1)*(p1-0.5+mm) ;
+        // calculate the evolution
+        p2= p1+ ((real)DT/TILE_PARAM(4, (real)TAU))*(term1-term2+term3 +p1*(1.0 -p1)*PHASE_NOISE*sin((real)gx)*cos((real)gy));
+
+        STORE(PHASE_OUT, PITCH*gy +gx, p2);
+
+        //////// Temp field evolution 
+        lap = 0.0f ;
+        lap += TTILE[g-1];
+        lap += TTILE[g+1];
+        lap += TTILE[g-GW];
+        lap += TTILE[g+GW];
+        lap -= 4.0*Temp ;
+        lap = lap/(H*H) ;
+        term1 = TILE_PARAM(7, THERM_DIFF)*lap;
+        term2 = TILE_PARAM(8, LAT_H)*(p2-p1);
+        STORE(TEMP_OUT, PITCH*gy +gx, Temp + DT*term1 -term2);
+    }
+    return p2 ;
+}
+
+/**
+@brief The Kobayashi Anisotropic dendrite growth evolution kernel, tiled in local memory.
+@param PHASE_IN The input phase/concentration field, at time t =n .
+@param PHASE_OUT The output phase/concentration field, at time t =n+1 .
+@param TEMP_IN The input temperature field, at time t =n .
+@param TEMP_OUT The output temperature field, at time t =n+1 .
+@param PHASE_NOISE The noise amplitide for introducing randomness in the phase field. 
+@param PTILE Local memory for the phase tile with a 2-cell halo, (LX+4)*(LY+4) floats for a LX*LY work-group.
+@param TTILE Local memory for the temperature tile with a 1-cell halo, (LX+2)*(LY+2) floats.
+@param GTILE Local memory for dphi/dx, dphi/dy, epsilon and eps*deps/dtheta of the tile with a 1-cell halo, 4*(LX+2)*(LY+2) floats.
+
+The result is the same as phase_field_evol_kern(). Every work-group updates its tile with evolve_tile().
+*/
+__kernel void phase_field_evol_tiled_kern(
+                                        __global store* PHASE_IN,
+                                        __global store* PHASE_OUT,
+                                        __global store* TEMP_IN,
+                                        __global store* TEMP_OUT,
+                                        float PHASE_NOISE,
+                                        __local real* PTILE,
+                                        __local real* TTILE,
+                                        __local real* GTILE DT_ARG){
+    evolve_tile(PHASE_IN, PHASE_OUT, TEMP_IN, TEMP_OUT, 0, 0, PHASE_NOISE, PTILE, TTILE, GTILE,
+                get_group_id(0)*get_local_size(0), get_group_id(1)*get_local_size(1) DT_PASS);
+}
+
+// The states of a tile in TILE_STATE: all its cells at 0, all at 1, or anything else. See active_tiles_funcs.h .
+#define TILE_ZERO 0
+#define TILE_ONE 1
+#define TILE_MIXED 2
+
+/**
+@brief The Kobayashi Anisotropic dendrite growth evolution kernel over the active tiles only.
+@param PHASE_IN The input phase/concentration field, at time t =n .
+@param PHASE_OUT The output phase/concentration field, at time t =n+1 .
+@param TEMP_IN The input temperature field, at time t =n .
+@param TEMP_OUT The output temperature field, at time t =n+1 .
+@param PHASE_NOISE The noise amplitide for introducing randomness in the phase field. 
+@param TILES The number of active tiles followed by the list of their indices, made by active_tiles_kern().
+@param TILE_STATE The state of every tile, TILE_ZERO, TILE_ONE or TILE_MIXED. The kernel writes it for the tiles it updates.
+@param PTILE Local memory for the phase tile with a 2-cell halo, (LX+4)*(LY+4) floats for a LX*LY work-group.
+@param TTILE Local memory for the temperature tile with a 1-cell halo, (LX+2)*(LY+2) floats.
+@param GTILE Local memory for dphi/dx, dphi/dy, epsilon and eps*deps/dtheta of the tile with a 1-cell halo, 4*(LX+2)*(LY+2) floats.
+
+The NDRange is the one of phase_field_evol_tiled_kern(), the tiles are its work-groups. Work-group g updates the tile
+TILES[1+g] with evolve_tile() and writes its new state, the work-groups past the number of active tiles return at once.
+*/
+__kernel void phase_field_evol_sparse_kern(
+                                        __global store* PHASE_IN,
+                                        __global store* PHASE_OUT,
+                                        __global store* TEMP_IN,
+                                        __global store* TEMP_OUT,
+                                        float PHASE_NOISE,
+                                        __global const int* TILES,
+                                        __global int* TILE_STATE,
+                                        __local real* PTILE,
+                                        __local real* TTILE,
+                                        __local real* GTILE DT_ARG){
+    __local int uniform[2] ;
+    int g = get_group_id(1)*get_num_groups(0) + get_group_id(0);
+    if(g >= TILES[0]){
+        return;
+    }
+    int tile = TILES[1+g];
+    int gx0 = (tile%get_num_groups(0))*get_local_size(0);
+    int gy0 = (tile/get_num_groups(0))*get_local_size(1);
+    int lid = get_local_id(1)*get_local_size(0) + get_local_id(0);
+    if(lid == 0){
+        uniform[0] = 1 ;
+        uniform[1] = 1 ;
+    }
+    real p2 = evolve_tile(PHASE_IN, PHASE_OUT, TEMP_IN, TEMP_OUT, 0, 0, PHASE_NOISE, PTILE, TTILE, GTILE, gx0, gy0 DT_PASS);
+
+    // The new state of the tile
+    bool inside = (gx0 + (int)get_local_id(0) < NX) && (gy0 + (int)get_local_id(1) < NY);
+    if(inside && p2 != 0){
+        atomic_and(&uniform[0], 0);
+    }
+    if(inside && p2 != 1){
+        atomic_and(&uniform[1], 0);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if(lid == 0){
+        TILE_STATE[tile] = uniform[0] ? TILE_ZERO : (uniform[1] ? TILE_ONE : TILE_MIXED);
+    }
+}
+
+/**
+@brief Lists the tiles phase_field_evol_sparse_kern() updates in the next step.
+@param TILE_STATE The state of every tile.
+@param TILE_BUSY 1 for the tiles that may change in the next step, 0 for the others. Holds the flags of the last step on entry.
+@param TILES The list of the active tiles, its count TILES[0] must be 0 on entry.
+@param TX The number of tiles along x.
+@param TY The number of tiles along y.
+
+A cell at 0 or 1 whose four neighbours have the same value keeps it, and so does its temperature. So a tile whose
+state is TILE_ZERO or TILE_ONE, like the state of its eight neighbours, cannot change in the next step: it is not busy.
+The two fields are swapped every step, so a tile skipped in a step must have kept its values in the step before too:
+a tile is active if it is busy now or was busy in the last step.
+*/
+__kernel void active_tiles_kern(
+                            __global const int* TILE_STATE,
+                            __global int* TILE_BUSY,
+                            __global int* TILES,
+                            int TX,
+                            int TY){
+    int t = get_global_id(0);
+    if(t >= TX*TY){
+        return;
+    }
+    int tx = t%TX;
+    int ty = t/TX;
+    int state = TILE_STATE[t];
+    int busy = (state == TILE_MIXED);
+    for(int y = max(ty-1, 0); y <= min(ty+1, TY-1); y++){
+        for(int x = max(tx-1, 0); x <= min(tx+1, TX-1); x++){
+            busy = busy || (TILE_STATE[TX*y +x] != state);
+        }
+    }
+    int wasBusy = TILE_BUSY[t];
+    TILE_BUSY[t] = busy;
+    if(busy || wasBusy){
+        TILES[1 + atomic_inc(&TILES[0])] = t;
+    }
+}
+
+/**
+@brief The Kobayashi Anisotropic dendrite growth evolution kernel of an ensemble, tiled in local memory.
+@param PHASE_IN The input phase fields of all the replicas, PITCH*NY floats each, one after the other.
+@param PHASE_OUT The output phase fields.
+@param TEMP_IN The input temperature fields.
+@param TEMP_OUT The output temperature fields.
+@param NOISE The random number of the step, in [-0.5,0.5). Each replica scales it by its NOISE_AMP.
+@param PARAMS The parameters of the replicas, 11 floats each : EPS_BAR, ALPHA, GAMMA, DELTA, TAU, THETA0, J, THERM_DIFF, LAT_H, T_MELT, NOISE_AMP.
+@param PTILE Local memory for the phase tile with a 2-cell halo, (LX+4)*(LY+4) floats for a LX*LY*1 work-group.
+@param TTILE Local memory for the temperature tile with a 1-cell halo, (LX+2)*(LY+2) floats.
+@param GTILE Local memory for dphi/dx, dphi/dy, epsilon and eps*deps/dtheta of the tile with a 1-cell halo, 4*(LX+2)*(LY+2) floats.
+
+The replica is the third dimension of the NDRange. Each replica evolves with evolve_tile() like in phase_field_evol_tiled_kern(), with its own parameters instead of the build options.
+*/
+__kernel void phase_field_evol_ensemble_kern(
+                                        __global store* PHASE_IN,
+                                        __global store* PHASE_OUT,
+                                        __global store* TEMP_IN,
+                                        __global store* TEMP_OUT,
+                                        float NOISE,
+                                        __constant float* PARAMS,
+                                        __local real* PTILE,
+                                        __local real* TTILE,
+                                        __local real* GTILE DT_ARG){
+    // The fields and parameters of the replica
+    int r = get_global_id(2);
+    __constant float* P = PARAMS + 11*r;
+    evolve_tile(PHASE_IN, PHASE_OUT, TEMP_IN, TEMP_OUT, (size_t)PITCH*NY*r, P, NOISE*P[10], PTILE, TTILE, GTILE,
+                get_group_id(0)*get_local_size(0), get_group_id(1)*get_local_size(1) DT_PASS);
 }
 
 // END OF FILE
\ No newline at end of file
@@ -1,8 +1,41 @@
 /**
 @file KobayashiIsoKern.cl
 @brief The OpenCL kernel code for the Kobayashi Isotropic dendrite growth.
+
+phase_field_evol_kern() advances one time step per launch. phase_field_evol_tblock_kern() advances several time steps per launch inside local memory (temporal blocking).
+
+The grid is NX*NY cells, the rows are PITCH floats apart. The global work size is rounded up to the work-group size, the work items outside the grid write nothing.
 */
 
+// Precision of the fields, -DPRECISION=n from getKernelFromFile(): 0 float, 1 half storage with float compute, 2 double.
+// The fields are read with LOAD() and written with STORE(), the arithmetic and the local memory tiles are in real.
+#if PRECISION == 2
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#elif PRECISION == 1
+typedef float real;
+typedef half store;
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
+#else
+typedef float real;
+typedef float store;
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#endif
+
+// The time step: the DT build option, or with -DADAPTIVE_DT the last argument dt of the kernels that step in time, see adaptive_dt_funcs.h .
+#ifdef ADAPTIVE_DT
+#undef DT
+#define DT dt
+#define DT_ARG , real dt
+#else
+#define DT_ARG
+#endif
+
 /**
 @brief A function to get the laplacian of the temperature field.
 @param TEMP The pointer to the global temperature buffer.
@@ -10,30 +43,30 @@
 @param y The spatial y coordinate. The global ID 1 of the work item.
 @return The laplacian calculated using the five point stencil within the finite difference approximation.
 */
-float get_temp_laplacian(__global float* TEMP, int x, int y){
-    float lap = 0.0f ;
-    float T = TEMP[SIZE*y+x] ;
+real get_temp_laplacian(__global store* TEMP, int x, int y){
+    real lap = 0.0f ;
+    real T = LOAD(TEMP, PITCH*y+x) ;
     if(x==0){
         lap += T_L;
     }else{
-        lap += TEMP[SIZE*y +x -1];
+        lap += LOAD(TEMP, PITCH*y +x -1);
     }
-    if(x==(SIZE-1)){
+    if(x==(NX-1)){
         lap += T_R;
     }else{
-        lap += TEMP[SIZE*y +x +1];
+        lap += LOAD(TEMP, PITCH*y +x +1);
     }
     if(y==0){
         lap += T_T;
     }else{
-        lap += TEMP[SIZE*(y-1) +x];
+        lap += LOAD(TEMP, PITCH*(y-1) +x);
     }
-    if(y==(SIZE-1)){
+    if(y==(NY-1)){
         lap += T_B ;
     }else{
-        lap += TEMP[SIZE*(y+1) +x];
+        lap += LOAD(TEMP, PITCH*(y+1) +x);
     }
-    lap -= 4.0*TEMP[SIZE*y +x] ;
+    lap -= 4.0*LOAD(TEMP, PITCH*y +x) ;
     return lap/(H*H);
 }
 
@@ -44,30 +77,30 @@ float get_temp_laplacian(__global float* TEMP, int x, int y){
 @param y The spatial y coordinate. The global ID 1 of the work item.
 @return The laplacian calculated using the five point stencil within the finite difference approximation.
 */
-float get_phase_laplacian(__global float* PH, int x, int y){
-    float lap = 0.0f ;
-    float p = PH[SIZE*y+x] ;
+real get_phase_laplacian(__global store* PH, int x, int y){
+    real lap = 0.0f ;
+    real p = LOAD(PH, PITCH*y+x) ;
     if(x==0){
         lap += PH_L;
     }else{
-        lap += PH[SIZE*y +x -1];
+        lap += LOAD(PH, PITCH*y +x -1);
     }
-    if(x==(SIZE-1)){
+    if(x==(NX-1)){
         lap += PH_R;
     }else{
-        lap += PH[SIZE*y +x +1];
+        lap += LOAD(PH, PITCH*y +x +1);
     }
     if(y==0){
         lap += PH_T;
     }else{
-        lap += PH[SIZE*(y-1) +x];
+        lap += LOAD(PH, PITCH*(y-1) +x);
     }
-    if(y==(SIZE-1)){
+    if(y==(NY-1)){
         lap += PH_B;
     }else{
-        lap += PH[SIZE*(y+1) +x];
+        lap += LOAD(PH, PITCH*(y+1) +x);
     }
-    lap -= 4.0*PH[SIZE*y +x] ;
+    lap -= 4.0*LOAD(PH, PITCH*y +x) ;
     return lap/(H*H);
 }
 
@@ -80,10 +113,10 @@ float get_phase_laplacian(__global float* PH, int x, int y){
 @return A true or false.
 The function checks the neighborhood values for similarity. If all the values of the five point stencil are equal we skip computing laplacian and derrivatives in the phase_field_evol_kern() function as those will be 0. 
 */
-bool check_neighbors(__global float* PH, int x, int y){
+bool check_neighbors(__global store* PH, int x, int y){
     bool nbh = true ;
-    float C = PH[SIZE*y+x] ;
-    nbh = nbh && (PH[SIZE*(y+1)+x]==C) && (PH[SIZE*(y-1)+x]==C) && (PH[SIZE*y+x+1]==C)  && (PH[SIZE*y+x-1]==C) ;
+    real C = LOAD(PH, PITCH*y+x) ;
+    nbh = nbh && (LOAD(PH, PITCH*(y+1)+x)==C) && (LOAD(PH, PITCH*(y-1)+x)==C) && (LOAD(PH, PITCH*y+x+1)==C)  && (LOAD(PH, PITCH*y+x-1)==C) ;
     return nbh ;
 }
 
@@ -97,36 +130,171 @@ bool check_neighbors(__global float* PH, int x, int y){
 @param PHASE_NOISE The noise amplitide for introducing randomness in the phase field. 
 */
 __kernel void phase_field_evol_kern(
-                                        __global float* PHASE_IN,
-                                        __global float* PHASE_OUT,
-                                        __global float* TEMP_IN,
-                                        __global float* TEMP_OUT,
-                                        float PHASE_NOISE){
+                                        __global store* PHASE_IN,
+                                        __global store* PHASE_OUT,
+                                        __global store* TEMP_IN,
+                                        __global store* TEMP_OUT,
+                                        float PHASE_NOISE DT_ARG){
     // Get global IDs
     int gx = get_global_id(0);
     int gy = get_global_id(1);
+    if(gx >= NX || gy >= NY){
+        return;
+    }
 
     ///////// Phase field evolution
     // get the center point
-    float p1 = PHASE_IN[SIZE*gy +gx];
+    real p1 = LOAD(PHASE_IN, PITCH*gy +gx);
 
     // get current temperature
-    float Temp = TEMP_IN[SIZE*gy +gx] ;
+    real Temp = LOAD(TEMP_IN, PITCH*gy +gx) ;
 
     // calculate m
-    float m = (ALPHA/M_PI_F)*atan(GAMMA*(-T_MELT +Temp)) ;
+    real m = (ALPHA/M_PI_F)*atan(GAMMA*(-T_MELT +Temp)) ;
 
     // calculate ther terms
-    float terms =(EPS_BAR*EPS_BAR*get_phase_laplacian(PHASE_IN,gx,gy)) +(p1*(1.0-p1)*(p1-0.5+m));
+    real terms =(EPS_BAR*EPS_BAR*get_phase_laplacian(PHASE_IN,gx,gy)) +(p1*(1.0-p1)*(p1-0.5+m));
 
     // calculate the evolution
-    float noise = PHASE_NOISE*( (((float)gx/SIZE)-0.5)*(((float)gy/SIZE)-0.5) ) ;
-    float p2 = p1 + (DT/TAU)*(terms +p1*(1.0-p1)*noise);
+    real noise = PHASE_NOISE*( (((real)gx/NX)-0.5)*(((real)gy/NY)-0.5) ) ;
+    real p2 = p1 + (DT/TAU)*(terms +p1*(1.0-p1)*noise);
 
-    PHASE_OUT[SIZE*gy +gx] = p2 ;
+    STORE(PHASE_OUT, PITCH*gy +gx, p2);
 
     //////// Temp field evolition 
     terms = THERM_DIFF*get_temp_laplacian(TEMP_IN,gx,gy) - LAT_H*(p2-p1)/DT;
 
-    TEMP_OUT[SIZE*gy +gx] = Temp + DT*(terms) ;
+    STORE(TEMP_OUT, PITCH*gy +gx, Temp + DT*(terms));
+}
+
+/**
+@brief A function to get the laplacian of a field stored in a local memory tile.
+@param TILE The pointer to the local tile.
+@param i The index of the cell in the tile.
+@param W The width of the tile.
+@param x The spatial x coordinate of the cell.
+@param y The spatial y coordinate of the cell.
+@return The laplacian of the phase field, with the same boundary values as get_phase_laplacian().
+*/
+real get_phase_tile_laplacian(__local real* TILE, int i, int W, int x, int y){
+    real lap = 0.0f ;
+    lap += (x==0) ? PH_L : TILE[i-1];
+    lap += (x==(NX-1)) ? PH_R : TILE[i+1];
+    lap += (y==0) ? PH_T : TILE[i-W];
+    lap += (y==(NY-1)) ? PH_B : TILE[i+W];
+    lap -= 4.0*TILE[i] ;
+    return lap/(H*H);
+}
+
+/**
+@brief A function to get the laplacian of a field stored in a local memory tile.
+@param TILE The pointer to the local tile.
+@param i The index of the cell in the tile.
+@param W The width of the tile.
+@param x The spatial x coordinate of the cell.
+@param y The spatial y coordinate of the cell.
+@return The laplacian of the temperature field, with the same boundary values as get_temp_laplacian().
+*/
+real get_temp_tile_laplacian(__local real* TILE, int i, int W, int x, int y){
+    real lap = 0.0f ;
+    lap += (x==0) ? T_L : TILE[i-1];
+    lap += (x==(NX-1)) ? T_R : TILE[i+1];
+    lap += (y==0) ? T_T : TILE[i-W];
+    lap += (y==(NY-1)) ? T_B : TILE[i+W];
+    lap -= 4.0*TILE[i] ;
+    return lap/(H*H);
+}
+
+/**
+@brief The Kobayashi Isosotropic dendrite growth evolution kernel, advancing NSTEPS time steps in one launch.
+@param PHASE_IN The input phase/concentration field, at time t =n .
+@param PHASE_OUT The output phase/concentration field, at time t =n+NSTEPS .
+@param TEMP_IN The input temperature field, at time t =n .
+@param TEMP_OUT The output temperature field, at time t =n+NSTEPS .
+@param PHASE_NOISE The noise amplitide for introducing randomness in the phase field.
+@param NOISE_MASK Bit s is set if the noise is added in step s of the block.
+@param NSTEPS The number of time steps to advance, at most 32.
+@param PA Local memory for the phase tile with an NSTEPS-cell halo, (LX+2*NSTEPS)*(LY+2*NSTEPS) floats for a LX*LY work-group.
+@param PB Local memory of the same size as PA.
+@param TA Local memory of the same size as PA, for the temperature tile.
+@param TB Local memory of the same size as PA.
+
+Overlapped tiling: every work-group loads its tile with a halo NSTEPS cells wide and ping-pongs the tiles NSTEPS times.
+Step s updates the cells that are at least s+1 cells away from the edge of the loaded region, so after NSTEPS steps the cells of the tile itself are exact.
+Halo cells outside the domain are never updated, the laplacians use the boundary values there like phase_field_evol_kern() does.
+The same holds for the cells of the tiles that stick out of the grid when NX or NY is not a multiple of the work-group size.
+*/
+__kernel void phase_field_evol_tblock_kern(
+                                        __global store* PHASE_IN,
+                                        __global store* PHASE_OUT,
+                                        __global store* TEMP_IN,
+                                        __global store* TEMP_OUT,
+                                        float PHASE_NOISE,
+                                        int NOISE_MASK,
+                                        int NSTEPS,
+                                        __local real* PA,
+                                        __local real* PB,
+                                        __local real* TA,
+                                        __local real* TB DT_ARG){
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+    int LX = get_local_size(0);
+    int LY = get_local_size(1);
+    int gx0 = get_group_id(0)*LX;
+    int gy0 = get_group_id(1)*LY;
+    int lid = ly*LX +lx;
+    int NL = LX*LY;
+    int R = NSTEPS;
+    int W = LX + 2*R;
+    int N = W*(LY + 2*R);
+
+    // Load the tiles, the halo outside the domain is clamped and never used
+    for(int i = lid; i < N; i += NL){
+        int x = clamp(gx0 + i%W - R, 0, NX-1);
+        int y = clamp(gy0 + i/W - R, 0, NY-1);
+        PA[i] = LOAD(PHASE_IN, PITCH*y +x);
+        TA[i] = LOAD(TEMP_IN, PITCH*y +x);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    __local real* PIN = PA;
+    __local real* POUT = PB;
+    __local real* TIN = TA;
+    __local real* TOUT = TB;
+    for(int s = 0; s < R; s++){
+        real stepNoise = ((NOISE_MASK >> s) & 1) ? PHASE_NOISE : 0.0f ;
+        for(int i = lid; i < N; i += NL){
+            int tx = i%W;
+            int ty = i/W;
+            int gx = gx0 + tx - R;
+            int gy = gy0 + ty - R;
+            if((tx > s) && (tx < W-1-s) && (ty > s) && (ty < LY+2*R-1-s) && (gx >= 0) && (gx < NX) && (gy >= 0) && (gy < NY)){
+                real p1 = PIN[i];
+                real Temp = TIN[i];
+                real m = (ALPHA/M_PI_F)*atan(GAMMA*(-T_MELT +Temp)) ;
+                real lapP = get_phase_tile_laplacian(PIN, i, W, gx, gy);
+                real terms =(EPS_BAR*EPS_BAR*lapP) +(p1*(1.0-p1)*(p1-0.5+m));
+                real noise = stepNoise*( (((real)gx/NX)-0.5)*(((real)gy/NY)-0.5) ) ;
+                real p2 = p1 + (DT/TAU)*(terms +p1*(1.0-p1)*noise);
+                POUT[i] = p2 ;
+
+                real lapT = get_temp_tile_laplacian(TIN, i, W, gx, gy);
+                terms = THERM_DIFF*lapT - LAT_H*(p2-p1)/DT;
+                TOUT[i] = Temp + DT*(terms) ;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        __local real* tmp = PIN;
+        PIN = POUT;
+        POUT = tmp;
+        tmp = TIN;
+        TIN = TOUT;
+        TOUT = tmp;
+    }
+
+    int c = (ly+R)*W + lx+R;
+    if(gx0+lx < NX && gy0+ly < NY){
+        STORE(PHASE_OUT, PITCH*(gy0+ly) + gx0+lx, PIN[c]);
+        STORE(TEMP_OUT, PITCH*(gy0+ly) + gx0+lx, TIN[c]);
+    }
 }
@@ -0,0 +1,162 @@
+/**
+@file ReduceKern.cl
+@brief The OpenCL reductions of the fields, see reduce_funcs.h .
+
+getKernelFromFile() builds this file after the kernel file of the system, in the same program, so the real and store
+types, LOAD() and the grid constants are the ones of the system. Every work group reduces a part of the grid with a
+grid-stride loop and a tree in local memory, and writes one partial result; the host reduces the partial results.
+The work groups are 1D and their size is a power of two. A kernel with several results per work group writes them one after
+the other, PARTIAL[VALUES*group + k] for its k-th result. output_spec_kern() reduces a field to a smaller field instead,
+with one work item per value.
+*/
+
+// The Kobayashi systems are 2D and are built without NZ
+#ifndef NZ
+#define NZ 1
+#endif
+
+/**
+@brief The largest absolute difference of two fields, one partial result per work group.
+@param A The first field.
+@param B The second field.
+@param PARTIAL The partial results, one per work group.
+@param SCRATCH The local memory of the tree, one real per work item.
+
+The padding of the rows is skipped, the cell c of the grid is the cell PITCH*(c/NX) + c%NX of the fields.
+*/
+__kernel void max_change_kern(
+                        __global const store* A,
+                        __global const store* B,
+                        __global real* PARTIAL,
+                        __local real* SCRATCH){
+    int lid = get_local_id(0);
+    real m = 0 ;
+    for(size_t c = get_global_id(0); c < (size_t)NX*NY*NZ; c += get_global_size(0)){
+        size_t i = (size_t)PITCH*(c/NX) + c%NX ;
+        m = fmax(m, fabs(LOAD(A, i) - LOAD(B, i)));
+    }
+    SCRATCH[lid] = m ;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for(int s = get_local_size(0)/2; s > 0; s >>= 1){
+        if(lid < s){
+            SCRATCH[lid] = fmax(SCRATCH[lid], SCRATCH[lid+s]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if(lid == 0){
+        PARTIAL[get_group_id(0)] = SCRATCH[0] ;
+    }
+}
+
+/// The number of results per work group of diagnostics_kern().
+#define DIAGNOSTIC_VALUES 5
+
+/**
+@brief The sum, the minimum, the maximum, the number of cells above 0.5 and the number of cell faces where the field crosses 0.5.
+@param F The field.
+@param PARTIAL The partial results, DIAGNOSTIC_VALUES per work group in this order.
+@param SCRATCH The local memory of the tree, DIAGNOSTIC_VALUES reals per work item.
+
+The faces are counted between a cell and its neighbour at +1 along x, y and, on a 3D grid, z; the diagnostics of
+diagnostics_funcs.h turn the counts into the length or the area of the 0.5 contour.
+*/
+__kernel void diagnostics_kern(
+                        __global const store* F,
+                        __global real* PARTIAL,
+                        __local real* SCRATCH){
+    int lid = get_local_id(0);
+    int L = get_local_size(0);
+    real sum = 0, lo = INFINITY, hi = -INFINITY, above = 0, faces = 0 ;
+    for(size_t c = get_global_id(0); c < (size_t)NX*NY*NZ; c += get_global_size(0)){
+        int x = c%NX ;
+        size_t row = c/NX ;
+        int y = row%NY ;
+        int z = row/NY ;
+        size_t i = (size_t)PITCH*row + x ;
+        real v = LOAD(F, i);
+        bool in = v > 0.5 ;
+        sum += v ;
+        lo = fmin(lo, v);
+        hi = fmax(hi, v);
+        above += in ;
+        if(x+1 < NX){
+            faces += (in != (LOAD(F, i+1) > 0.5));
+        }
+        if(y+1 < NY){
+            faces += (in != (LOAD(F, i+PITCH) > 0.5));
+        }
+        if(z+1 < NZ){
+            faces += (in != (LOAD(F, i+(size_t)PITCH*NY) > 0.5));
+        }
+    }
+    SCRATCH[lid] = sum ;
+    SCRATCH[L+lid] = lo ;
+    SCRATCH[2*L+lid] = hi ;
+    SCRATCH[3*L+lid] = above ;
+    SCRATCH[4*L+lid] = faces ;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for(int s = L/2; s > 0; s >>= 1){
+        if(lid < s){
+            SCRATCH[lid] += SCRATCH[lid+s];
+            SCRATCH[L+lid] = fmin(SCRATCH[L+lid], SCRATCH[L+lid+s]);
+            SCRATCH[2*L+lid] = fmax(SCRATCH[2*L+lid], SCRATCH[2*L+lid+s]);
+            SCRATCH[3*L+lid] += SCRATCH[3*L+lid+s];
+            SCRATCH[4*L+lid] += SCRATCH[4*L+lid+s];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if(lid == 0){
+        for(int k = 0; k < DIAGNOSTIC_VALUES; k++){
+            PARTIAL[DIAGNOSTIC_VALUES*get_group_id(0) + k] = SCRATCH[k*L];
+        }
+    }
+}
+
+/**
+@brief A reduced output of a field, a window of the grid decimated by a factor, see output_spec_funcs.h .
+@param F The field, from the cell BASE of the buffer.
+@param OUT The reduced output, packed float rows of ceil(SX/FACTOR) values.
+@param BASE The first cell of the field in F, not 0 for the replicas of an ensemble.
+@param X0 The first cell of the window along x, Y0 and Z0 along y and z.
+@param SX The size of the window along x, SY and SZ along y and z.
+@param FACTOR The decimation factor, 1 copies the window.
+@param BOX 1 writes the mean of the cells of each block of FACTOR cells per side, 0 its first cell.
+
+One work item per value of the output; the blocks at the far edges of the window hold fewer cells.
+*/
+__kernel void output_spec_kern(
+                        __global const store* F,
+                        __global float* OUT,
+                        ulong BASE,
+                        int X0, int Y0, int Z0,
+                        int SX, int SY, int SZ,
+                        int FACTOR, int BOX){
+    int ox = get_global_id(0);
+    int oy = get_global_id(1);
+    int oz = get_global_id(2);
+    int onx = (SX + FACTOR - 1)/FACTOR ;
+    int ony = (SY + FACTOR - 1)/FACTOR ;
+    int onz = (SZ + FACTOR - 1)/FACTOR ;
+    if(ox >= onx || oy >= ony || oz >= onz){
+        return ;
+    }
+    int x = ox*FACTOR, y = oy*FACTOR, z = oz*FACTOR ;
+    real v ;
+    if(BOX){
+        int bx = min(FACTOR, SX - x), by = min(FACTOR, SY - y), bz = min(FACTOR, SZ - z) ;
+        real sum = 0 ;
+        for(int k = 0; k < bz; k++){
+            for(int j = 0; j < by; j++){
+                size_t row = BASE + (size_t)PITCH*((size_t)NY*(Z0+z+k) + Y0+y+j) + X0+x ;
+                for(int i = 0; i < bx; i++){
+                    sum += LOAD(F, row+i);
+                }
+            }
+        }
+        v = sum/(bx*by*bz) ;
+    }else{
+        v = LOAD(F, BASE + (size_t)PITCH*((size_t)NY*(Z0+z) + Y0+y) + X0+x);
+    }
+    OUT[((size_t)ony*oz + oy)*onx + ox] = (float)v ;
+}
+//END OF FILE
@@ -16,6 +16,8 @@
 
 #include "global_vars.h"
 #include "error_handle.h"
+#include "trace_funcs.h"
+#include "precision_funcs.h"
 
 /** The function initialises all the necessary OpenCL data structures. 
 @return It does not return anything but initialises the globally declared OpenCL structures.
@@ -36,9 +38,10 @@ static inline void initCLDataStructures(){
     free(platforms);
     
     // get the number of devices availabe on that platform
-    cl_uint numDevices;
-    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices);
+    cl_uint deviceCount;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, NULL, &deviceCount);
     ErrorHandle(err, "clGetDeviceIDs numDevices");
+    numDevices = deviceCount ;
     
     // get the devices into an array
     devices = (cl_device_id*)malloc(sizeof(cl_device_id)*numDevices);
@@ -62,7 +65,7 @@ static inline void initCLDataStructures(){
 @param device The cl_device_id device on which the optimum WG size is to be found.
 @return It returns the optimum WG size in size_t type.
 
-This value is used when the work group size is set to 0 in the input file.
+This value is used when the work group size is set to 0 in the input file and the kernel is not autotuned, see autotune_funcs.h .
 It uses clGetKernelWorkGroupInfo() function and CL_KERNEL_WORK_GROUP_SIZE flag.
 */
 size_t GetOptimumWGSize(cl_kernel kernel, cl_device_id device){
@@ -76,6 +79,18 @@ size_t GetOptimumWGSize(cl_kernel kernel, cl_device_id device){
 }
 
 
+/**
+@brief Sets the global work size of the grid, NX and NY rounded up to multiples of the local work size.
+@param globalWS The global work size, its first two dimensions are set.
+@param localWS The local work size.
+
+The kernels skip the work items outside the grid, so any work group size runs any NX and NY.
+*/
+void PadGlobalWorkSize(size_t globalWS[], const size_t localWS[]){
+    globalWS[0] = ((NX + localWS[0] - 1)/localWS[0])*localWS[0] ;
+    globalWS[1] = ((NY + localWS[1] - 1)/localWS[1])*localWS[1] ;
+}
+
 /**
 @brief The functions calculates the total execution time of an event.
 @param event A cl_event whose execution time is to be calculated. 
@@ -92,5 +107,78 @@ cl_float GetEventExecTime(cl_event event){
     return (end-start)/1.0e9 ; 
 }
 
+/**
+@brief Enqueues a marker on the command queue to profile a run of commands.
+@return The marker event. It is released by GetMarkerIntervalTime().
+*/
+cl_event EnqueueProfilingMarker(){
+    cl_int err ;
+    cl_event marker ;
+    err = clEnqueueMarkerWithWaitList(queue, 0, NULL, &marker);
+    KernErrorHandle(err, "clEnqueueMarkerWithWaitList");
+    return marker ;
+}
+
+/**
+@brief The device time between two profiling markers.
+@param startMarker The marker enqueued before the commands.
+@param endMarker The marker enqueued after the commands.
+@return The time in decimal seconds between the completion of the two markers.
+
+The function waits for endMarker and releases both markers. With an in-order queue the interval covers all the commands enqueued between the markers.
+*/
+cl_float GetMarkerIntervalTime(cl_event startMarker, cl_event endMarker){
+    cl_int err ;
+    cl_ulong start, end;
+    TRACE_SPAN_BEGIN(wait);
+    err = clWaitForEvents(1, &endMarker);
+    KernErrorHandle(err, "clWaitForEvents");
+    TRACE_SPAN_END(wait, "wait for device", "sync");
+    err = clGetEventProfilingInfo(startMarker, CL_PROFILING_COMMAND_END, sizeof(start), &start, NULL);
+    err |= clGetEventProfilingInfo(endMarker, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    KernErrorHandle(err, "clGetEventProfilingInfo");
+    clReleaseEvent(startMarker);
+    clReleaseEvent(endMarker);
+    return (end-start)/1.0e9 ;
+}
+
+/**
+@brief The function limits the number of time steps per launch of a temporally blocked kernel.
+@param device The cl_device_id device on which the kernel runs.
+@param localWS The local work size.
+@param numTiles The number of local memory tiles the kernel uses.
+@param steps The requested number of time steps per launch.
+@return The largest number of steps, not more than steps and 32, whose tiles fit in the local memory of the device.
+
+Each tile holds a work group with a halo as wide as the number of steps, (localWS[0]+2*steps)*(localWS[1]+2*steps) floats.
+*/
+cl_int GetMaxTimeBlock(cl_device_id device, const size_t localWS[2], cl_int numTiles, cl_int steps){
+    cl_int err;
+    cl_ulong localMem;
+    err = clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMem), &localMem, NULL);
+    ErrorHandle(err,"clGetDeviceInfo CL_DEVICE_LOCAL_MEM_SIZE");
+    if(steps > 32){
+        steps = 32 ;
+    }
+    while(steps > 1 && numTiles*RealBytes()*(localWS[0]+2*steps)*(localWS[1]+2*steps) > localMem){
+        steps-- ;
+    }
+    return steps ;
+}
+
+/**
+@brief The throughput of a stencil run in million lattice-site updates per second.
+@param sites The number of lattice sites (cells) updated in one step.
+@param steps The number of time steps.
+@param seconds The execution time of all the steps.
+@return The throughput in MLUPS.
+*/
+double MLUPS(double sites, double steps, double seconds){
+    if(seconds <= 0.0){
+        return 0.0 ;
+    }
+    return sites*steps/seconds/1.0e6 ;
+}
+
 #endif
 // END OF FILE
\ No newline at end of file
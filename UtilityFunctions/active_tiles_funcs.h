@@ -0,0 +1,281 @@
+/**
+@file active_tiles_funcs.h
+@brief Declares the sparse run of the Kobayashi anisotropic system, which only updates the tiles near the front. Run with SparseTiles = 1 in the input file.
+
+The grid is cut into tiles, one work-group of the tiled kernel each. A cell at 0 or 1 whose four neighbours have the same
+value does not change in a step, and neither does its temperature, so most of the grid is left as it is while the dendrite
+is small. The device keeps the state of every tile (all 0, all 1 or mixed) and the list of the active tiles, the tiles
+that may change: phase_field_evol_sparse_kern() updates the listed tiles and writes their new state, then
+active_tiles_kern() makes the list of the next step from the states. The host never reads the list back, the
+NDRange keeps the size of the whole grid and the work-groups past the end of the list return at once.
+
+The result is the same as the one of the tiled kernel, and goes to the same output directory. The sparse run is the
+single device OpenCL run with the fixed time step; the other runs update the whole grid.
+*/
+
+#ifndef ACTIVE_TILES_FUNCS
+#define ACTIVE_TILES_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "precision_funcs.h"
+#include "file_to_program.h"
+#include "autotune_funcs.h"
+#include "iterate_kernels.h"
+#include "output_writer.h"
+#include "checkpoint_funcs.h"
+#include "diagnostics_funcs.h"
+#include "trace_funcs.h"
+
+/// The state of a tile whose cells are not all 0 or all 1, as TILE_MIXED of KobayashiAnisoKern.cl .
+#define TILE_STATE_MIXED 2
+
+/// The tiles of the grid and the device list of the active ones.
+struct TileList{
+    /// phase_field_evol_sparse_kern and active_tiles_kern.
+    cl_kernel sparseKern, listKern ;
+    /// The number of tiles along x and y, the work-groups of the tiled NDRange.
+    cl_int TX, TY ;
+    /// The number of active tiles followed by their indices, 1+TX*TY ints.
+    cl_mem tiles ;
+    /// The state of every tile, TILE_ZERO, TILE_ONE or TILE_MIXED.
+    cl_mem state ;
+    /// 1 for the tiles that may change in the next step.
+    cl_mem busy ;
+};
+
+/**
+@brief Creates the tiles of a tiled NDRange, all of them active.
+@param globalWS The 2D global work size, padded to the local work size.
+@param localWS The 2D local work size, the size of a tile.
+@return The tiles, release them with ReleaseTileList().
+
+The states start as TILE_MIXED and every tile as busy, so the first two steps update the whole grid whatever the fields.
+*/
+struct TileList CreateTileList(const size_t globalWS[2], const size_t localWS[2]){
+    cl_int err ;
+    struct TileList tl ;
+    tl.sparseKern = getKernelFromProgram("phase_field_evol_sparse_kern");
+    tl.listKern = getKernelFromProgram("active_tiles_kern");
+    tl.TX = globalWS[0]/localWS[0] ;
+    tl.TY = globalWS[1]/localWS[1] ;
+    size_t numTiles = (size_t)tl.TX*tl.TY ;
+
+    cl_int *init = (cl_int*)malloc(sizeof(cl_int)*(numTiles+1));
+    for(size_t t = 0 ; t <= numTiles ; t++){
+        init[t] = TILE_STATE_MIXED ;
+    }
+    tl.state = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_int)*numTiles, init, &err);
+    ErrorHandle(err, "clCreateBuffer tile states");
+    for(size_t t = 0 ; t <= numTiles ; t++){
+        init[t] = 1 ;
+    }
+    tl.busy = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_int)*numTiles, init, &err);
+    ErrorHandle(err, "clCreateBuffer busy tiles");
+    init[0] = 0 ;
+    tl.tiles = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_int)*(numTiles+1), init, &err);
+    ErrorHandle(err, "clCreateBuffer active tiles");
+    free(init);
+    return tl ;
+}
+
+/**
+@brief Enqueues the list of the tiles to update in the next step.
+@param tl The tiles.
+
+The count of the list is reset with a 4 byte write before active_tiles_kern() appends the active tiles.
+*/
+static inline void UpdateTileList(struct TileList *tl){
+    static const cl_int zero = 0 ;
+    cl_int err ;
+    err = clEnqueueWriteBuffer(queue, tl->tiles, CL_FALSE, 0, sizeof(cl_int), &zero, 0, NULL, NULL);
+    KernErrorHandle(err, "clEnqueueWriteBuffer active tiles");
+    err = clSetKernelArg(tl->listKern, 0, sizeof(cl_mem), &tl->state);
+    err |= clSetKernelArg(tl->listKern, 1, sizeof(cl_mem), &tl->busy);
+    err |= clSetKernelArg(tl->listKern, 2, sizeof(cl_mem), &tl->tiles);
+    err |= clSetKernelArg(tl->listKern, 3, sizeof(cl_int), &tl->TX);
+    err |= clSetKernelArg(tl->listKern, 4, sizeof(cl_int), &tl->TY);
+    KernErrorHandle(err, "SetKernelArg active tiles");
+    size_t numTiles = (size_t)tl->TX*tl->TY ;
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, tl->listKern, 1, NULL, &numTiles, NULL, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel active tiles");
+    TRACE_CL_KERNEL(event, tl->listKern);
+}
+
+/**
+@brief One step of evolution in the kobayashi anisotropic system over the active tiles, followed by the list of the next step.
+@param tl The tiles.
+@param globalWS An array with the 2D global work size.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param TEMP1buff The input temperature buffer.
+@param TEMP2buff The output temperature buffer.
+@param noise The noise amplitide needed to generate randomness in the phase field.
+
+Same as KobayashiTiledEvolutionStep() with the list and the states of the tiles.
+*/
+static inline void KobayashiSparseEvolutionStep(struct TileList *tl, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem TEMP1buff, cl_mem TEMP2buff, cl_float noise){
+    // Error variable
+    cl_int err;
+    size_t haloCells = (localWS[0]+2)*(localWS[1]+2);
+    // Set inner kernel arguments;
+    err = clSetKernelArg(tl->sparseKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(tl->sparseKern, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(tl->sparseKern, 2, sizeof(cl_mem), &TEMP1buff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(tl->sparseKern, 3, sizeof(cl_mem), &TEMP2buff);
+    KernErrorHandle(err,"SetKernelArg 3");
+    err = clSetKernelArg(tl->sparseKern, 4, sizeof(cl_float), &noise);
+    KernErrorHandle(err,"SetKernelArg 4");
+    err = clSetKernelArg(tl->sparseKern, 5, sizeof(cl_mem), &tl->tiles);
+    KernErrorHandle(err,"SetKernelArg 5");
+    err = clSetKernelArg(tl->sparseKern, 6, sizeof(cl_mem), &tl->state);
+    KernErrorHandle(err,"SetKernelArg 6");
+    err = clSetKernelArg(tl->sparseKern, 7, RealBytes()*(localWS[0]+4)*(localWS[1]+4), NULL);
+    KernErrorHandle(err,"SetKernelArg 7");
+    err = clSetKernelArg(tl->sparseKern, 8, RealBytes()*haloCells, NULL);
+    KernErrorHandle(err,"SetKernelArg 8");
+    err = clSetKernelArg(tl->sparseKern, 9, RealBytes()*4*haloCells, NULL);
+    KernErrorHandle(err,"SetKernelArg 9");
+
+    // Enqueue the kernel
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, tl->sparseKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel SparseKern");
+    TRACE_CL_KERNEL(event, tl->sparseKern);
+
+    UpdateTileList(tl);
+}
+
+/**
+@brief Reads the number of tiles listed for the next step.
+@param tl The tiles.
+@return The number of active tiles.
+
+A blocking read of 4 bytes, done at the save points only.
+*/
+cl_int ReadActiveTileCount(struct TileList *tl){
+    cl_int count ;
+    cl_int err = clEnqueueReadBuffer(queue, tl->tiles, CL_TRUE, 0, sizeof(cl_int), &count, 0, NULL, NULL);
+    KernErrorHandle(err, "clEnqueueReadBuffer active tiles");
+    return count ;
+}
+
+/**
+@brief Frees the tiles.
+@param tl The tiles made by CreateTileList().
+*/
+void ReleaseTileList(struct TileList *tl){
+    clReleaseMemObject(tl->tiles);
+    clReleaseMemObject(tl->state);
+    clReleaseMemObject(tl->busy);
+    clReleaseKernel(tl->sparseKern);
+    clReleaseKernel(tl->listKern);
+}
+
+/**
+@brief A function to fully iterate the kobayashi anisotropic system over the active tiles.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure.
+Runs like iterateKobayashiAnisoKernel() with the tiled kernel, and prints the number of active tiles at the save points.
+*/
+static inline void iterateKobayashiAnisoSparseKernel(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
+    // WG parameters, the tiles are the work-groups of the tiled kernel
+    size_t globalWS[2] ;
+    cl_kernel tiledKern = getKernelFromProgram("phase_field_evol_tiled_kern");
+    struct TuneTarget tune = {"phase_field_evol_tiled_kern", {tiledKern, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff}, 4,
+                              TuneKobayashiTiled, KobayashiTiledBytes} ;
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    clReleaseKernel(tiledKern);
+    struct TileList tl = CreateTileList(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : Sparse anisotropic kernel over %d x %d tiles\n", tl.TX, tl.TY);
+
+    cl_float tot_exec_time = 0.0f;
+
+    // random noise, the generator is seeded in main() or restored from a checkpoint
+    cl_float noise;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+    cl_float noiseAMP = inpparams.NOISE_AMP ;
+
+    // The list of the first step
+    UpdateTileList(&tl);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const cl_mem DiagFields[2] = {databuffers.PHASE1buff, databuffers.TEMP1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        if((iter%50)==0){
+            noise=noiseAMP*(RandomUniform()-0.5);
+        }else{
+            noise=0.0;
+        }
+
+        KobayashiSparseEvolutionStep(&tl, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise);
+        KobayashiSparseEvolutionStep(&tl, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise);
+
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            SaveBufferAsync(databuffers.TEMP1buff, OutFileDir, "TEMP", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f seconds, %d of %d tiles active\n",100*iter/ITERS,"%", tot_exec_time, ReadActiveTileCount(&tl), tl.TX*tl.TY);
+        }
+
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getKobayashiAnisoCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "KOBANISO", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
+    }
+
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    SaveBufferAsync(databuffers.TEMP1buff, OutFileDir, "TEMP", ITERS);
+    StopDiagnostics(&diag);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    ReleaseTileList(&tl);
+}
+
+#endif
+// END OF FILE
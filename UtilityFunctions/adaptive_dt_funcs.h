@@ -0,0 +1,803 @@
+/**
+@file adaptive_dt_funcs.h
+@brief Declares the adaptive time stepping, run with AdaptiveDT = 1 in the input file.
+
+A fixed run steps with DT, which has to suit the fastest moment of the whole run. An adaptive run covers the same
+simulated time, 2*ITERS*DT, with a time step that follows the evolution of the fields:
+- after every iteration the largest change of the phase field in its second step is reduced, on the device with
+  max_change_kern of ReduceKern.cl or on the host with CPUMaxChange() (see reduce_funcs.h),
+- the next time step is the last one scaled by ADAPTIVE_DT_SAFETY*DTTolerance/change, by at most ADAPTIVE_DT_GROWTH
+  and at least ADAPTIVE_DT_SHRINK,
+- and it never exceeds the stability bound of the explicit step of the system, ADAPTIVE_DT_SAFETY times:
+|System|Bound|
+|------|-----|
+|DIFFUSION|\f$ h^2/(4D) \f$|
+|CAHNHILLIARD|\f$ h^2/(64\kappa M) \f$|
+|KOBISO|\f$ \min\left(\tau h^2/(4\bar\epsilon^2),\ h^2/(4D_T),\ \tau\right) \f$|
+|KOBANISO|\f$ \min\left(\tau h^2/(4\bar\epsilon^2(1+\delta)^2(1+\delta J)),\ h^2/(4D_T),\ \tau\right) \f$|
+
+The first time step is the smaller of DT and the bound. A step is never rejected: the change is measured after the
+step, so a sudden change is corrected by the next step. On the device the change is read back one iteration late,
+so the next iteration is already queued while the host waits for the read.
+
+The outfile of iteration L holds the fields at the simulated time 2*L*DT, the time a fixed run reaches after L
+iterations, so the outfiles of the two runs compare one to one. Iteration 0 is the initial field. The time step is
+shortened to land on the save times. The noise of the Kobayashi systems is drawn at the same simulated times as in a
+fixed run, every 100*DT, and scaled by DT/dt so that a noise kick has the same effect at any time step.
+
+The kernels get the time step as their last argument, they are built with -DADAPTIVE_DT (see file_to_program.h).
+The adaptive runs step 2D grids on one OpenCL device or on the CPU backend, without --ensemble, --multi-device,
+--restart, --bench, MPI or the SPECTRAL Cahn-Hilliard solver. They write no checkpoints, and run one time step per launch whatever TimeBlock is.
+The diagnostics of DiagnosticsEvery are sampled every DiagnosticsEvery adaptive iterations, at the simulated time of the clock.
+*/
+
+#ifndef ADAPTIVE_DT_FUNCS
+#define ADAPTIVE_DT_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "precision_funcs.h"
+#include "file_to_program.h"
+#include "autotune_funcs.h"
+#include "cpu_kernels.h"
+#include "data_manip_funcs.h"
+#include "data_writing_funcs.h"
+#include "output_writer.h"
+#include "reduce_funcs.h"
+#include "diagnostics_funcs.h"
+#include "iterate_kernels.h"
+#include "trace_funcs.h"
+
+/// The fraction of the stability bound, and of the change DTTolerance asks for, the time step aims at.
+#define ADAPTIVE_DT_SAFETY 0.9
+/// The largest growth of the time step from one iteration to the next.
+#define ADAPTIVE_DT_GROWTH 2.0
+/// The largest shrink of the time step from one iteration to the next.
+#define ADAPTIVE_DT_SHRINK 0.5
+/// The smallest time step, as a fraction of the stability bound.
+#define ADAPTIVE_DT_FLOOR 1.0e-4
+/// The DTTolerance used when the input file does not set it.
+#define ADAPTIVE_DT_TOLERANCE 0.05
+/// The simulated time between two noise kicks of the Kobayashi systems, in units of DT. The fixed runs kick every 50 iterations.
+#define ADAPTIVE_NOISE_PERIOD 100
+
+/// The simulated time of an adaptive run and its time step.
+struct AdaptiveClock{
+    /// The simulated time.
+    double t ;
+    /// The time step the controller proposes for the next iteration.
+    double dt ;
+    /// The stability bound of the time step, safety included.
+    double bound ;
+    /// The largest change of the phase field aimed at in one step.
+    double tol ;
+    /// The label of the next outfile, beyond ITERS when the run is over.
+    int nextLabel ;
+    /// The next step lands on the save time of nextLabel.
+    int landing ;
+    /// The index of the next noise kick.
+    long nextNoise ;
+    /// The number of iterations and the smallest and largest time steps, for the summary.
+    long iters ;
+    double minDT, maxDT ;
+};
+
+/**
+@brief The stability bound of the explicit diffusion step.
+@param InpParams The input parameters.
+*/
+double DiffusionStableDT(const struct DiffusionInputParams *InpParams){
+    return DX*DX/(4.0*InpParams->DIFF_COEFF) ;
+}
+
+/**
+@brief The stability bound of the explicit Cahn-Hilliard step, from its biharmonic term.
+@param InpParams The input parameters.
+*/
+double CahnHilliardStableDT(const struct CahnHilliardInputParams *InpParams){
+    return DX*DX/(64.0*InpParams->KAPPA*InpParams->MOBILITY) ;
+}
+
+/**
+@brief The stability bound of the explicit Kobayashi isotropic step: the phase and temperature diffusions and the reaction.
+@param InpParams The input parameters.
+*/
+double KobayashiIsoStableDT(const struct KobIsoInputParams *InpParams){
+    double phase = InpParams->TAU*DX*DX/(4.0*InpParams->EPS_BAR*InpParams->EPS_BAR) ;
+    double temp = DX*DX/(4.0*InpParams->TH_DIFF) ;
+    return fmin(fmin(phase, temp), InpParams->TAU) ;
+}
+
+/**
+@brief The stability bound of the explicit Kobayashi anisotropic step, with a margin of 1+DELTA*J for the anisotropic terms.
+@param InpParams The input parameters.
+*/
+double KobayashiAnisoStableDT(const struct KobAnisoInputParams *InpParams){
+    double eps = InpParams->EPS_BAR*(1.0 + InpParams->DELTA) ;
+    double phase = InpParams->TAU*DX*DX/(4.0*eps*eps*(1.0 + InpParams->DELTA*InpParams->J)) ;
+    double temp = DX*DX/(4.0*InpParams->TH_DIFF) ;
+    return fmin(fmin(phase, temp), InpParams->TAU) ;
+}
+
+/**
+@brief The label of the outfile after an outfile.
+@param label The label of an outfile.
+@return The next multiple of ITERS/NSAVE below ITERS, ITERS, or ITERS+1 after ITERS. The same labels as a fixed run.
+*/
+static int AdaptiveNextLabel(int label){
+    int every = (int)(ITERS/NSAVE) ;
+    if(label >= ITERS){
+        return ITERS+1 ;
+    }
+    return (label + every < ITERS) ? label + every : ITERS ;
+}
+
+/**
+@brief Starts the clock of an adaptive run at the simulated time 0.
+@param bound The stability bound of the system, from e.g. DiffusionStableDT().
+@return The clock, its next outfile is the one after iteration 0.
+*/
+struct AdaptiveClock StartAdaptiveClock(double bound){
+    struct AdaptiveClock c ;
+    c.t = 0.0 ;
+    c.bound = ADAPTIVE_DT_SAFETY*bound ;
+    c.dt = fmin(DT, c.bound) ;
+    c.tol = (DTTolerance > 0) ? DTTolerance : ADAPTIVE_DT_TOLERANCE ;
+    c.nextLabel = AdaptiveNextLabel(0) ;
+    c.landing = 0 ;
+    c.nextNoise = 0 ;
+    c.iters = 0 ;
+    c.minDT = c.maxDT = c.dt ;
+    printf("   : Adaptive time step: stability bound %g, first step %g, tolerance %g\n", c.bound, c.dt, c.tol);
+    return c ;
+}
+
+/**
+@brief The time step of the next iteration.
+@param c The clock.
+@return The proposed time step, shortened so that the iteration ends on the next save time or leaves at least one full step before it.
+*/
+double AdaptiveStepDT(struct AdaptiveClock *c){
+    double left = 2.0*c->nextLabel*DT - c->t ;
+    double dt = c->dt ;
+    c->landing = 0 ;
+    if(2.0*dt >= left){
+        dt = 0.5*left ;
+        c->landing = 1 ;
+    }else if(4.0*dt > left){
+        // Two equal iterations instead of a long and a short one
+        dt = 0.25*left ;
+    }
+    return dt ;
+}
+
+/**
+@brief The noise amplitude of the next iteration of a Kobayashi system.
+@param c The clock.
+@param stepDT The time step of the iteration.
+@param noiseAMP The NOISE_AMP input parameter.
+@return A random kick scaled by DT/stepDT if the iteration crosses a noise time, 0 otherwise.
+*/
+cl_float AdaptiveNoise(struct AdaptiveClock *c, double stepDT, cl_float noiseAMP){
+    if(c->t + 2.0*stepDT <= (double)c->nextNoise*ADAPTIVE_NOISE_PERIOD*DT){
+        return 0.0f ;
+    }
+    while((double)c->nextNoise*ADAPTIVE_NOISE_PERIOD*DT < c->t + 2.0*stepDT){
+        c->nextNoise++ ;
+    }
+    return (cl_float)(noiseAMP*(RandomUniform()-0.5)*DT/stepDT) ;
+}
+
+/**
+@brief Adapts the time step to the change of the phase field in a step.
+@param c The clock.
+@param stepDT The time step of the measured step.
+@param change The largest change of the phase field in that step.
+*/
+void AdaptiveControl(struct AdaptiveClock *c, double stepDT, double change){
+    double factor = (change > 0) ? ADAPTIVE_DT_SAFETY*c->tol/change : ADAPTIVE_DT_GROWTH ;
+    factor = fmin(fmax(factor, ADAPTIVE_DT_SHRINK), ADAPTIVE_DT_GROWTH) ;
+    // A step shortened for a save time says little about the proposed one, unless it changed too much already
+    double next = (stepDT < c->dt && factor >= 1.0) ? c->dt : stepDT*factor ;
+    c->dt = fmax(fmin(next, c->bound), ADAPTIVE_DT_FLOOR*c->bound) ;
+}
+
+/**
+@brief Moves the clock over an iteration.
+@param c The clock.
+@param stepDT The time step of the iteration.
+@return The label of the outfile to write if the iteration landed on a save time, -1 otherwise.
+*/
+int AdaptiveAdvance(struct AdaptiveClock *c, double stepDT){
+    c->iters++ ;
+    c->minDT = fmin(c->minDT, stepDT) ;
+    c->maxDT = fmax(c->maxDT, stepDT) ;
+    if(!c->landing){
+        c->t += 2.0*stepDT ;
+        return -1 ;
+    }
+    int label = c->nextLabel ;
+    c->t = 2.0*label*DT ;
+    c->nextLabel = AdaptiveNextLabel(label) ;
+    return label ;
+}
+
+/**
+@brief Checks if the run is over.
+@param c The clock.
+@return 1 once the outfile of ITERS is written.
+*/
+static inline int AdaptiveDone(const struct AdaptiveClock *c){
+    return c->nextLabel > ITERS ;
+}
+
+/**
+@brief Prints the progress at an outfile.
+@param c The clock.
+@param label The label of the outfile.
+@param seconds The time spent so far.
+*/
+static void AdaptiveProgress(const struct AdaptiveClock *c, int label, double seconds){
+    printf("%2d%s: complete in time %5.2f seconds, t = %g, dt = %g\n", 100*label/ITERS, "%", seconds, c->t, c->dt);
+}
+
+/**
+@brief Prints the summary of a run.
+@param c The clock.
+@param seconds The total time.
+*/
+static void AdaptiveSummary(const struct AdaptiveClock *c, double seconds){
+    printf("   : %ld adaptive iterations instead of %d, time step %g to %g\n", c->iters, ITERS, c->minDT, c->maxDT);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*c->iters, seconds));
+}
+
+/**
+@brief Checks the grid of an adaptive run.
+*/
+static void CheckAdaptiveGrid(){
+    if(NZ > 1){
+        printf("Error: AdaptiveDT = 1 runs 2D grids, the grid is %s\n", GridLabel());
+        exit(1);
+    }
+    if(TimeBlock > 1){
+        printf("   : TimeBlock is ignored, the adaptive time step runs one step per launch\n");
+    }
+}
+
+/**
+@brief Samples the diagnostics of device fields after an iteration, every DiagnosticsEvery adaptive iterations.
+@param d The time series.
+@param c The clock, moved over the iteration.
+@param fields The device fields.
+*/
+static void AdaptiveDiagnostics(struct Diagnostics *d, const struct AdaptiveClock *c, const cl_mem fields[]){
+    if(DiagnosticsDue((int)c->iters - 1)){
+        SampleDiagnosticsAt(d, fields, (int)c->iters, c->t);
+    }
+}
+
+/**
+@brief Samples the diagnostics of host fields after an iteration, every DiagnosticsEvery adaptive iterations.
+@param d The time series.
+@param c The clock, moved over the iteration.
+@param fields The host fields.
+*/
+static void AdaptiveDiagnosticsCPU(struct Diagnostics *d, const struct AdaptiveClock *c, const float *fields[]){
+    if(DiagnosticsDue((int)c->iters - 1)){
+        SampleDiagnosticsCPUAt(d, fields, (int)c->iters, c->t);
+    }
+}
+
+/**
+@brief Sets the time step argument of a kernel built with -DADAPTIVE_DT, its last argument.
+@param kern The kernel.
+@param dt The time step, passed in the precision of the kernels.
+*/
+void SetKernelDT(cl_kernel kern, double dt){
+    cl_uint numArgs ;
+    cl_int err = clGetKernelInfo(kern, CL_KERNEL_NUM_ARGS, sizeof(numArgs), &numArgs, NULL);
+    ErrorHandle(err, "clGetKernelInfo CL_KERNEL_NUM_ARGS");
+    cl_double d = dt ;
+    cl_float f = (cl_float)dt ;
+    err = clSetKernelArg(kern, numArgs-1, RealBytes(), (Precision == PRECISION_DOUBLE) ? (const void*)&d : (const void*)&f);
+    KernErrorHandle(err, "SetKernelArg dt");
+}
+
+/**
+@brief The device side of an adaptive run: the reduction of the change and the profiling.
+*/
+struct AdaptiveDevice{
+    struct DeviceReduction change ;
+    /// The slot of the next reduction, and the time step of the step measured in the other slot, 0 if none.
+    int slot ;
+    double pendingDT ;
+    cl_event startMarker ;
+    double seconds ;
+};
+
+static struct AdaptiveDevice StartAdaptiveDevice(){
+    struct AdaptiveDevice d ;
+    d.change = CreateDeviceReduction("max_change_kern", 1);
+    d.slot = 0 ;
+    d.pendingDT = 0.0 ;
+    d.startMarker = EnqueueProfilingMarker();
+    d.seconds = 0.0 ;
+    return d ;
+}
+
+/**
+@brief Measures the change of an iteration on the device, and adapts the time step with the change of the iteration before.
+@param d The device side.
+@param c The clock.
+@param stepDT The time step of the iteration.
+@param PHASE1buff The phase after the iteration.
+@param PHASE2buff The phase after its first step.
+*/
+static void AdaptiveDeviceControl(struct AdaptiveDevice *d, struct AdaptiveClock *c, double stepDT, cl_mem PHASE1buff, cl_mem PHASE2buff){
+    const cl_mem fields[2] = {PHASE1buff, PHASE2buff} ;
+    EnqueueDeviceReduction(&d->change, d->slot, fields, 2);
+    clFlush(queue);
+    if(d->pendingDT > 0.0){
+        AdaptiveControl(c, d->pendingDT, WaitDeviceReductionMax(&d->change, 1 - d->slot));
+    }
+    d->pendingDT = stepDT ;
+    d->slot = 1 - d->slot ;
+}
+
+/**
+@brief Saves the device buffers of an outfile and accounts the time of the iterations before it.
+@param d The device side.
+@param c The clock.
+@param label The label of the outfile.
+@param OutFileDir The outputfile directory.
+@param PHASEbuff The phase buffer.
+@param TEMPbuff The temperature buffer, NULL if the system has none.
+*/
+static void AdaptiveDeviceSave(struct AdaptiveDevice *d, const struct AdaptiveClock *c, int label, const char OutFileDir[], cl_mem PHASEbuff, cl_mem TEMPbuff){
+    cl_event endMarker = EnqueueProfilingMarker();
+    SaveBufferAsync(PHASEbuff, OutFileDir, "PHASE", label);
+    if(TEMPbuff != NULL){
+        SaveBufferAsync(TEMPbuff, OutFileDir, "TEMP", label);
+    }
+    cl_event nextMarker = EnqueueProfilingMarker();
+    d->seconds += GetMarkerIntervalTime(d->startMarker, endMarker);
+    d->startMarker = nextMarker ;
+    AdaptiveProgress(c, label, d->seconds);
+}
+
+static void StopAdaptiveDevice(struct AdaptiveDevice *d, const struct AdaptiveClock *c){
+    clFinish(queue);
+    ReleaseDeviceReduction(&d->change);
+    AdaptiveSummary(c, d->seconds);
+}
+
+/**
+@brief A function to iterate the diffusion system with the adaptive time step on the device.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure.
+*/
+static inline void iterateDiffusionAdaptiveKernel(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    struct AdaptiveClock clock = StartAdaptiveClock(DiffusionStableDT(&inpparams));
+    size_t globalWS[2], localWS[2] ;
+    SetKernelDT(kernel, clock.dt);
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL}, {databuffers.PHASE1buff, databuffers.PHASE2buff}, 2,
+                              TuneDiffusionStep, NULL} ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, 0);
+
+    struct AdaptiveDevice dev = StartAdaptiveDevice();
+    AdaptiveDeviceSave(&dev, &clock, 0, OutFileDir, databuffers.PHASE1buff, NULL);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        SetKernelDT(kernel, stepDT);
+        DiffusionEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, NULL,0);
+        DiffusionEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, NULL,1);
+        AdaptiveDeviceControl(&dev, &clock, stepDT, databuffers.PHASE1buff, databuffers.PHASE2buff);
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnostics(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveDeviceSave(&dev, &clock, label, OutFileDir, databuffers.PHASE1buff, NULL);
+        }
+    }
+    StopDiagnostics(&diag);
+    StopAdaptiveDevice(&dev, &clock);
+}
+
+/**
+@brief A function to iterate the cahn-hilliard system with the adaptive time step on the device.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+
+The tiled kernel runs if TiledKernels is set in the input file, the two-kernel step otherwise.
+*/
+static inline void iterateCahnHilliardAdaptiveKernel(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    struct AdaptiveClock clock = StartAdaptiveClock(CahnHilliardStableDT(&inpparams));
+    size_t globalWS[2], localWS[2] ;
+    cl_kernel innerKern = NULL, outerKern = NULL, dtKern = kernel ;
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff}, 3,
+                              TuneCahnHilliardTiled, CahnHilliardTiledBytes} ;
+    if(!TiledKernels){
+        innerKern = getKernelFromProgram("ch_inner_kern");
+        outerKern = getKernelFromProgram("ch_outer_kern");
+        dtKern = outerKern ;
+        tune.name = "ch_inner_kern+ch_outer_kern" ;
+        tune.kern[0] = innerKern ;
+        tune.kern[1] = outerKern ;
+        tune.launch = TuneCahnHilliardTwoKernel ;
+        tune.localBytes = NULL ;
+    }
+    SetKernelDT(dtKern, clock.dt);
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : %s Cahn-Hilliard step\n", TiledKernels ? "Tiled" : "Two-kernel");
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, 0);
+
+    struct AdaptiveDevice dev = StartAdaptiveDevice();
+    AdaptiveDeviceSave(&dev, &clock, 0, OutFileDir, databuffers.PHASE1buff, NULL);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        SetKernelDT(dtKern, stepDT);
+        if(TiledKernels){
+            CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, NULL,0);
+            CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, NULL,1);
+        }else{
+            CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff, NULL,0);
+            CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.InBracMbuff, NULL,1);
+        }
+        AdaptiveDeviceControl(&dev, &clock, stepDT, databuffers.PHASE1buff, databuffers.PHASE2buff);
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnostics(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveDeviceSave(&dev, &clock, label, OutFileDir, databuffers.PHASE1buff, NULL);
+        }
+    }
+    StopDiagnostics(&diag);
+    StopAdaptiveDevice(&dev, &clock);
+    if(!TiledKernels){
+        clReleaseKernel(innerKern);
+        clReleaseKernel(outerKern);
+    }
+}
+
+/**
+@brief A function to iterate the kobayashi isotropic system with the adaptive time step on the device.
+@param inpparams A KobIsoInputParams structure.
+@param databuffers A KobIsoDataBuffers structure.
+*/
+static inline void iterateKobayashiIsoAdaptiveKernel(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    struct AdaptiveClock clock = StartAdaptiveClock(KobayashiIsoStableDT(&inpparams));
+    size_t globalWS[2], localWS[2] ;
+    SetKernelDT(kernel, clock.dt);
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff}, 4,
+                              TuneKobayashiStep, NULL} ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const cl_mem DiagFields[2] = {databuffers.PHASE1buff, databuffers.TEMP1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnostics(&diag, DiagFields, 0);
+
+    struct AdaptiveDevice dev = StartAdaptiveDevice();
+    AdaptiveDeviceSave(&dev, &clock, 0, OutFileDir, databuffers.PHASE1buff, databuffers.TEMP1buff);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        cl_float noise = AdaptiveNoise(&clock, stepDT, inpparams.NOISE_AMP);
+        SetKernelDT(kernel, stepDT);
+        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, NULL,0);
+        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, NULL,1);
+        AdaptiveDeviceControl(&dev, &clock, stepDT, databuffers.PHASE1buff, databuffers.PHASE2buff);
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnostics(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveDeviceSave(&dev, &clock, label, OutFileDir, databuffers.PHASE1buff, databuffers.TEMP1buff);
+        }
+    }
+    StopDiagnostics(&diag);
+    StopAdaptiveDevice(&dev, &clock);
+}
+
+/**
+@brief A function to iterate the kobayashi anisotropic system with the adaptive time step on the device.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure.
+
+The tiled kernel runs if TiledKernels is set in the input file.
+*/
+static inline void iterateKobayashiAnisoAdaptiveKernel(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    struct AdaptiveClock clock = StartAdaptiveClock(KobayashiAnisoStableDT(&inpparams));
+    size_t globalWS[2], localWS[2] ;
+    cl_kernel stepKern = TiledKernels ? getKernelFromProgram("phase_field_evol_tiled_kern") : kernel ;
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff}, 4,
+                              TuneKobayashiStep, NULL} ;
+    if(TiledKernels){
+        tune.name = "phase_field_evol_tiled_kern" ;
+        tune.kern[0] = stepKern ;
+        tune.launch = TuneKobayashiTiled ;
+        tune.localBytes = KobayashiTiledBytes ;
+    }
+    SetKernelDT(stepKern, clock.dt);
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : %s anisotropic kernel\n", TiledKernels ? "Tiled" : "Untiled");
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const cl_mem DiagFields[2] = {databuffers.PHASE1buff, databuffers.TEMP1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnostics(&diag, DiagFields, 0);
+
+    struct AdaptiveDevice dev = StartAdaptiveDevice();
+    AdaptiveDeviceSave(&dev, &clock, 0, OutFileDir, databuffers.PHASE1buff, databuffers.TEMP1buff);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        cl_float noise = AdaptiveNoise(&clock, stepDT, inpparams.NOISE_AMP);
+        SetKernelDT(stepKern, stepDT);
+        if(TiledKernels){
+            KobayashiTiledEvolutionStep(stepKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, NULL,0);
+            KobayashiTiledEvolutionStep(stepKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, NULL,1);
+        }else{
+            KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, NULL,0);
+            KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, NULL,1);
+        }
+        AdaptiveDeviceControl(&dev, &clock, stepDT, databuffers.PHASE1buff, databuffers.PHASE2buff);
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnostics(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveDeviceSave(&dev, &clock, label, OutFileDir, databuffers.PHASE1buff, databuffers.TEMP1buff);
+        }
+    }
+    StopDiagnostics(&diag);
+    StopAdaptiveDevice(&dev, &clock);
+    if(TiledKernels){
+        clReleaseKernel(stepKern);
+    }
+}
+
+/**
+@brief A function to iterate the diffusion system with the adaptive time step on the CPU.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure.
+*/
+static inline void iterateDiffusionAdaptiveCPU(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    struct AdaptiveClock clock = StartAdaptiveClock(DiffusionStableDT(&inpparams));
+    double tot_exec_time = 0.0, start ;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const float *DiagFields[1] = {databuffers.PHASE1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnosticsCPU(&diag, DiagFields, 0);
+
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", 0);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        CPUStepDT = stepDT ;
+        cpuDiffusionStep(databuffers.PHASE1, databuffers.PHASE2, inpparams, CPUWholeGrid());
+        cpuDiffusionStep(databuffers.PHASE2, databuffers.PHASE1, inpparams, CPUWholeGrid());
+        AdaptiveControl(&clock, stepDT, CPUMaxChange(databuffers.PHASE1, databuffers.PHASE2));
+        TRACE_SPAN_END(steps, "cpuDiffusionStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnosticsCPU(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveProgress(&clock, label, tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", label);
+        }
+    }
+    StopDiagnostics(&diag);
+    CPUStepDT = 0.0 ;
+    AdaptiveSummary(&clock, tot_exec_time);
+}
+
+/**
+@brief A function to iterate the cahn-hilliard system with the adaptive time step on the CPU.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+*/
+static inline void iterateCahnHilliardAdaptiveCPU(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    struct AdaptiveClock clock = StartAdaptiveClock(CahnHilliardStableDT(&inpparams));
+    double tot_exec_time = 0.0, start ;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const float *DiagFields[1] = {databuffers.PHASE1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnosticsCPU(&diag, DiagFields, 0);
+
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", 0);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        CPUStepDT = stepDT ;
+        cpuCahnHilliardStep(databuffers.InBracM, databuffers.PHASE1, databuffers.PHASE2, inpparams, CPUWholeGrid());
+        cpuCahnHilliardStep(databuffers.InBracM, databuffers.PHASE2, databuffers.PHASE1, inpparams, CPUWholeGrid());
+        AdaptiveControl(&clock, stepDT, CPUMaxChange(databuffers.PHASE1, databuffers.PHASE2));
+        TRACE_SPAN_END(steps, "cpuCahnHilliardStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnosticsCPU(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveProgress(&clock, label, tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", label);
+        }
+    }
+    StopDiagnostics(&diag);
+    CPUStepDT = 0.0 ;
+    AdaptiveSummary(&clock, tot_exec_time);
+}
+
+/**
+@brief A function to iterate the kobayashi isotropic system with the adaptive time step on the CPU.
+@param inpparams A KobIsoInputParams structure.
+@param databuffers A KobIsoDataBuffers structure.
+*/
+static inline void iterateKobayashiIsoAdaptiveCPU(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    struct AdaptiveClock clock = StartAdaptiveClock(KobayashiIsoStableDT(&inpparams));
+    double tot_exec_time = 0.0, start ;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const float *DiagFields[2] = {databuffers.PHASE1, databuffers.TEMP1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnosticsCPU(&diag, DiagFields, 0);
+
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", 0);
+    SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", 0);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        cl_float noise = AdaptiveNoise(&clock, stepDT, inpparams.NOISE_AMP);
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        CPUStepDT = stepDT ;
+        cpuKobayashiIsoStep(databuffers.PHASE1, databuffers.PHASE2, databuffers.TEMP1, databuffers.TEMP2, noise, inpparams, CPUWholeGrid());
+        cpuKobayashiIsoStep(databuffers.PHASE2, databuffers.PHASE1, databuffers.TEMP2, databuffers.TEMP1, noise, inpparams, CPUWholeGrid());
+        AdaptiveControl(&clock, stepDT, CPUMaxChange(databuffers.PHASE1, databuffers.PHASE2));
+        TRACE_SPAN_END(steps, "cpuKobayashiIsoStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnosticsCPU(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveProgress(&clock, label, tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", label);
+            SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", label);
+        }
+    }
+    StopDiagnostics(&diag);
+    CPUStepDT = 0.0 ;
+    AdaptiveSummary(&clock, tot_exec_time);
+}
+
+/**
+@brief A function to iterate the kobayashi anisotropic system with the adaptive time step on the CPU.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure.
+*/
+static inline void iterateKobayashiAnisoAdaptiveCPU(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
+    CheckAdaptiveGrid();
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    struct AdaptiveClock clock = StartAdaptiveClock(KobayashiAnisoStableDT(&inpparams));
+    double tot_exec_time = 0.0, start ;
+
+    // Scratch arrays for the gradient and eps*deps/dtheta
+    float *DPDX = Init1DFloatMatrix(0.0);
+    float *DPDY = Init1DFloatMatrix(0.0);
+    float *EPSD = Init1DFloatMatrix(0.0);
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_ADAPTIVE_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const float *DiagFields[2] = {databuffers.PHASE1, databuffers.TEMP1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnosticsCPU(&diag, DiagFields, 0);
+
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", 0);
+    SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", 0);
+    while(!AdaptiveDone(&clock)){
+        double stepDT = AdaptiveStepDT(&clock);
+        cl_float noise = AdaptiveNoise(&clock, stepDT, inpparams.NOISE_AMP);
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        CPUStepDT = stepDT ;
+        cpuKobayashiAnisoStep(databuffers.PHASE1, databuffers.PHASE2, databuffers.TEMP1, databuffers.TEMP2, noise, inpparams, DPDX, DPDY, EPSD, CPUWholeGrid());
+        cpuKobayashiAnisoStep(databuffers.PHASE2, databuffers.PHASE1, databuffers.TEMP2, databuffers.TEMP1, noise, inpparams, DPDX, DPDY, EPSD, CPUWholeGrid());
+        AdaptiveControl(&clock, stepDT, CPUMaxChange(databuffers.PHASE1, databuffers.PHASE2));
+        TRACE_SPAN_END(steps, "cpuKobayashiAnisoStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        int label = AdaptiveAdvance(&clock, stepDT);
+        AdaptiveDiagnosticsCPU(&diag, &clock, DiagFields);
+        if(label >= 0){
+            AdaptiveProgress(&clock, label, tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", label);
+            SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", label);
+        }
+    }
+    StopDiagnostics(&diag);
+    CPUStepDT = 0.0 ;
+    AdaptiveSummary(&clock, tot_exec_time);
+    free(DPDX);
+    free(DPDY);
+    free(EPSD);
+}
+
+#endif
+// END OF FILE
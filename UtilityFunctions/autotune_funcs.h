@@ -0,0 +1,266 @@
+/**
+@file autotune_funcs.h
+@brief Declares the work group autotuner: it times candidate 2D local work sizes of a kernel and remembers the fastest.
+
+The drivers of iterate_kernels.h choose their local work size with ChooseWorkGroup(). The choice is, in order:
+|Case|Local work size|
+|----|---------------|
+|WGsize is at least 8 in the input file|WGsize x WGsize, as set|
+|The autotune cache has an entry of the kernel|The cached shape and temporal block|
+|Autotune is set|The fastest of the timed candidates, which is added to the cache|
+|Otherwise|The square of GetOptimumWGSize()|
+
+The candidates are the shapes LX x LY of powers of two with LX*LY between AUTOTUNE_MIN_ITEMS and the work group size limit of the
+kernel, e.g. 64x2 or 128x1 as well as the square 16x16, that fit the local memory of the device. For the temporally blocked
+kernels the number of steps per launch is tuned too. Every candidate runs a few steps of the real kernel on the fields of the
+run, which are saved before and restored after the tuning, so the tuning does not change the results.
+
+The cache is the text file AUTOTUNE_CACHE_FILE, one line per tuned kernel:
+\code
+<program key> <kernel name> <NX>x<NY>x<NZ> <LX> <LY> <steps per launch> <seconds per step>
+\endcode
+The program key is the hash of the device, driver, kernel source and build options of the program cache (see file_to_program.h),
+so an entry is only reused on the same device for the same kernel and grid. The last entry of a kernel wins.
+*/
+
+#ifndef AUTOTUNE_FUNCS
+#define AUTOTUNE_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "file_to_program.h"
+
+/// The autotune cache, next to the program binaries.
+#define AUTOTUNE_CACHE_FILE PROGRAM_CACHE_DIR "/autotune.txt"
+/// The smallest work group tried, smaller groups leave most SIMD lanes of a GPU idle.
+#define AUTOTUNE_MIN_ITEMS 32
+/// Number of timed launches per candidate, after one warm-up launch.
+#define AUTOTUNE_LAUNCHES 8
+
+/// A kernel to tune: the launch function of its driver with the kernels and buffers it needs.
+struct TuneTarget{
+    /// The name of the kernel in the cache.
+    const char *name ;
+    /// The kernels of a step, kern[1] is NULL for single kernel steps. The work group is limited by both.
+    cl_kernel kern[2] ;
+    /// The buffers the step writes, saved before and restored after the tuning.
+    cl_mem buff[5] ;
+    /// The number of buffers.
+    int numBuffs ;
+    /// Enqueues one launch of the step with the local work size and steps per launch, returns the number of time steps it advances.
+    cl_int (*launch)(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps) ;
+    /// The local memory of the step for a local work size and steps per launch, NULL for the kernels without local memory.
+    size_t (*localBytes)(const size_t localWS[2], cl_int steps) ;
+};
+
+/**
+@brief Finds the entry of a kernel in the autotune cache.
+@param name The kernel name.
+@param localWS The cached local work size, set on a hit.
+@param steps The cached steps per launch, set on a hit.
+@return 1 on a hit, 0 otherwise.
+*/
+static int LoadTunedWorkGroup(const char *name, size_t localWS[2], cl_int *steps){
+    FILE *File = fopen(AUTOTUNE_CACHE_FILE, "r");
+    if(File == NULL){
+        return 0 ;
+    }
+    char line[512], fileName[128], key[32], grid[64] ;
+    sprintf(key, "%016llx", (unsigned long long)ProgramKey);
+    sprintf(grid, "%dx%dx%d", NX, NY, NZ);
+    unsigned long long lx, ly ;
+    int s, hit = 0 ;
+    char lineKey[32], lineGrid[64] ;
+    while(fgets(line, sizeof(line), File)){
+        if(line[0] == '#'){
+            continue ;
+        }
+        if(sscanf(line, "%31s %127s %63s %llu %llu %d", lineKey, fileName, lineGrid, &lx, &ly, &s) == 6 &&
+           strcmp(lineKey, key) == 0 && strcmp(fileName, name) == 0 && strcmp(lineGrid, grid) == 0 && lx > 0 && ly > 0){
+            localWS[0] = (size_t)lx ;
+            localWS[1] = (size_t)ly ;
+            *steps = s ;
+            hit = 1 ;
+        }
+    }
+    fclose(File);
+    return hit ;
+}
+
+/**
+@brief Appends the tuned work group of a kernel to the autotune cache.
+@param name The kernel name.
+@param localWS The local work size.
+@param steps The steps per launch.
+@param seconds The time per step.
+*/
+static void StoreTunedWorkGroup(const char *name, const size_t localWS[2], cl_int steps, double seconds){
+    mkdir(PROGRAM_CACHE_DIR, 0777);
+    FILE *File = fopen(AUTOTUNE_CACHE_FILE, "a");
+    if(File == NULL){
+        printf("   : Could not write the autotune cache %s\n", AUTOTUNE_CACHE_FILE);
+        return ;
+    }
+    if(ftell(File) == 0){
+        fprintf(File, "# program-key kernel grid LX LY steps-per-launch seconds-per-step\n");
+    }
+    fprintf(File, "%016llx %s %dx%dx%d %lu %lu %d %e\n", (unsigned long long)ProgramKey, name, NX, NY, NZ,
+            (unsigned long)localWS[0], (unsigned long)localWS[1], steps, seconds);
+    fclose(File);
+}
+
+/**
+@brief Times one candidate.
+@param t The kernel.
+@param localWS The local work size.
+@param steps The steps per launch.
+@return The device time per time step in seconds.
+*/
+static double TimeWorkGroup(const struct TuneTarget *t, size_t localWS[2], cl_int steps){
+    size_t globalWS[2] ;
+    PadGlobalWorkSize(globalWS, localWS);
+    // The first launch pays for the first use of the shape
+    t->launch(t, globalWS, localWS, steps);
+    cl_event startMarker = EnqueueProfilingMarker();
+    cl_int done = 0 ;
+    for(int i = 0 ; i < AUTOTUNE_LAUNCHES ; i++){
+        done += t->launch(t, globalWS, localWS, steps);
+    }
+    return GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker())/done ;
+}
+
+/**
+@brief Times the candidate work groups of a kernel and returns the fastest.
+@param t The kernel.
+@param localWS The fastest local work size.
+@param steps The steps per launch, the requested number on entry. NULL if the kernel advances one step per launch.
+@return The time per step of the fastest candidate.
+*/
+static double TuneWorkGroup(const struct TuneTarget *t, size_t localWS[2], cl_int *steps){
+    cl_int err ;
+    size_t maxItems, kernItems, maxSizes[3] ;
+    cl_ulong localMem ;
+    err = clGetKernelWorkGroupInfo(t->kern[0], devices[devID], CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxItems), &maxItems, NULL);
+    if(t->kern[1] != NULL){
+        err |= clGetKernelWorkGroupInfo(t->kern[1], devices[devID], CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernItems), &kernItems, NULL);
+        maxItems = (kernItems < maxItems) ? kernItems : maxItems ;
+    }
+    err |= clGetDeviceInfo(devices[devID], CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxSizes), maxSizes, NULL);
+    err |= clGetDeviceInfo(devices[devID], CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMem), &localMem, NULL);
+    ErrorHandle(err, "autotune device limits");
+
+    // Save the fields, the candidates run on them
+    cl_mem saved[5] ;
+    for(int b = 0 ; b < t->numBuffs ; b++){
+        size_t bytes ;
+        clGetMemObjectInfo(t->buff[b], CL_MEM_SIZE, sizeof(bytes), &bytes, NULL);
+        saved[b] = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err);
+        ErrorHandle(err, "clCreateBuffer autotune");
+        clEnqueueCopyBuffer(queue, t->buff[b], saved[b], 0, 0, bytes, 0, NULL, NULL);
+    }
+
+    // Steps per launch: the requested number and the powers of two up to 32
+    cl_int stepList[8], numSteps = 0 ;
+    if(steps != NULL){
+        if(*steps > 32){
+            *steps = 32 ;
+        }
+        stepList[numSteps++] = (*steps > 1) ? *steps : 2 ;
+        for(cl_int s = 2 ; s <= 32 ; s *= 2){
+            if(s != stepList[0]){
+                stepList[numSteps++] = s ;
+            }
+        }
+    }else{
+        stepList[numSteps++] = 1 ;
+    }
+
+    printf("   : Autotuning %s\n", t->name);
+    double best = -1.0 ;
+    for(size_t ly = 1 ; ly <= maxSizes[1] && ly <= (size_t)NY ; ly *= 2){
+        for(size_t lx = 4 ; lx <= maxSizes[0] && lx <= (size_t)PITCH ; lx *= 2){
+            if(lx*ly < AUTOTUNE_MIN_ITEMS || lx*ly > maxItems){
+                continue ;
+            }
+            size_t shape[2] = {lx, ly} ;
+            for(cl_int k = 0 ; k < numSteps ; k++){
+                if(t->localBytes != NULL && t->localBytes(shape, stepList[k]) > localMem){
+                    continue ;
+                }
+                double seconds = TimeWorkGroup(t, shape, stepList[k]);
+                if(steps != NULL){
+                    printf("   :    %4lu x %-4lu %2d steps : %e s per step\n", (unsigned long)lx, (unsigned long)ly, stepList[k], seconds);
+                }else{
+                    printf("   :    %4lu x %-4lu : %e s per step\n", (unsigned long)lx, (unsigned long)ly, seconds);
+                }
+                if(seconds > 0.0 && (best < 0.0 || seconds < best)){
+                    best = seconds ;
+                    localWS[0] = lx ;
+                    localWS[1] = ly ;
+                    if(steps != NULL){
+                        *steps = stepList[k] ;
+                    }
+                }
+            }
+        }
+    }
+
+    // Restore the fields
+    for(int b = 0 ; b < t->numBuffs ; b++){
+        size_t bytes ;
+        clGetMemObjectInfo(t->buff[b], CL_MEM_SIZE, sizeof(bytes), &bytes, NULL);
+        clEnqueueCopyBuffer(queue, saved[b], t->buff[b], 0, 0, bytes, 0, NULL, NULL);
+    }
+    clFinish(queue);
+    for(int b = 0 ; b < t->numBuffs ; b++){
+        clReleaseMemObject(saved[b]);
+    }
+    return best ;
+}
+
+/**
+@brief Chooses the local work size of a kernel, see the table at the top of the file.
+@param t The kernel.
+@param localWS The local work size.
+@param steps The steps per launch of a temporally blocked kernel, TimeBlock on entry. NULL for the other kernels.
+*/
+void ChooseWorkGroup(const struct TuneTarget *t, size_t localWS[2], cl_int *steps){
+    if(WGsize >= 8){
+        localWS[0] = localWS[1] = WGsize ;
+        return ;
+    }
+    cl_int cachedSteps = 0 ;
+    if(Autotune < 2 && LoadTunedWorkGroup(t->name, localWS, &cachedSteps)){
+        printf("   : Work group of %s from the autotune cache\n", t->name);
+        if(steps != NULL && cachedSteps > 0){
+            *steps = cachedSteps ;
+        }
+        return ;
+    }
+    if(Autotune > 0){
+        double seconds = TuneWorkGroup(t, localWS, steps);
+        if(seconds > 0.0){
+            StoreTunedWorkGroup(t->name, localWS, (steps != NULL) ? *steps : 1, seconds);
+            printf("   : Fastest work group of %s stored in %s\n", t->name, AUTOTUNE_CACHE_FILE);
+            return ;
+        }
+        printf("   : No work group of %s could be timed\n", t->name);
+    }
+    localWS[0] = localWS[1] = GetOptimumWGSize(t->kern[0], devices[devID]) ;
+}
+
+#endif
+// END OF FILE
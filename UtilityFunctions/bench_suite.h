@@ -0,0 +1,284 @@
+/**
+@file bench_suite.h
+@brief Declares the benchmark suite: it times every registered system over a range of grid sizes and work group settings and writes the results to a JSON file.
+
+The suite runs with the --bench-suite flag instead of a simulation, on the backend chosen with --cpu or --opencl, so it also
+runs on a Linux box without any OpenCL platform. For every system the input file is read for the system parameters, then
+for every grid size (--bench-sizes, square grids) and every work group setting the main step of the system is run
+BENCH_WARMUP_STEPS times and then timed step by step (--bench-steps). The work group settings are:
+|Backend|Settings|
+|-------|--------|
+|OpenCL|The local work sizes of BenchShapes that the kernel and device allow|
+|CPU|The number of OpenMP threads, 1, 2, 4, ... up to the number of threads of the run|
+
+Each result has the percentiles of the step times, the throughput in MLUPS (million lattice-site updates per second) and the
+effective bandwidth: the bytesPerCell of the system times the cells per second. The JSON file is one object:
+\code
+{"suite": "phase-field-bench", "version": 1, "backend": "cpu", "device": "...", "host": "...", "timestamp": "2026-01-01T00:00:00Z",
+ "max_threads": 8, "warmup_steps": 5, "results": [
+  {"system": "DIFFUSION", "nx": 256, "ny": 256, "lx": 0, "ly": 0, "threads": 4, "steps": 50,
+   "min_us": ..., "p50_us": ..., "p90_us": ..., "p99_us": ..., "mean_us": ..., "mlups": ..., "gbps": ...}, ...]}
+\endcode
+lx and ly are 0 on the CPU backend and threads is 0 on the OpenCL backend. The step times of OpenCL are the device times of
+the profiling events, those of the CPU backend the wall time of the step. The noise of the Kobayashi systems is off and the
+initial fields are seeded with a fixed seed, so repeated runs time the same work.
+*/
+
+#ifndef BENCH_SUITE
+#define BENCH_SUITE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "read_inp_file.h"
+#include "file_to_program.h"
+#include "data_manip_funcs.h"
+#include "cpu_kernels.h"
+#include "system_registry.h"
+
+/// The grid sizes of the suite when --bench-sizes is not given.
+#define BENCH_DEFAULT_SIZES "128,256,512"
+/// The timed steps per setting when --bench-steps is not given.
+#define BENCH_DEFAULT_STEPS 50
+/// The untimed steps before the timed ones.
+#define BENCH_WARMUP_STEPS 5
+/// The most grid sizes of a suite.
+#define BENCH_MAX_SIZES 16
+
+/// The local work sizes tried on the OpenCL backend.
+static const size_t BenchShapes[][2] = {{8, 8}, {16, 16}, {32, 8}, {64, 4}, {128, 1}, {256, 1}} ;
+/// The number of entries of BenchShapes.
+#define NUM_BENCH_SHAPES ((int)(sizeof(BenchShapes)/sizeof(BenchShapes[0])))
+
+/// The statistics of the step times of one setting.
+struct BenchStats{
+    /// The step times in seconds.
+    double min, p50, p90, p99, mean ;
+};
+
+/**
+@brief Sorts doubles in ascending order, for qsort.
+*/
+static int CompareDoubles(const void *a, const void *b){
+    double x = *(const double*)a, y = *(const double*)b ;
+    return (x > y) - (x < y) ;
+}
+
+/**
+@brief Computes the statistics of the step times.
+@param latency The step times in seconds, sorted on return.
+@param steps The number of steps.
+@return The statistics, the percentiles by the nearest rank.
+*/
+static struct BenchStats GetBenchStats(double latency[], int steps){
+    struct BenchStats stats ;
+    qsort(latency, steps, sizeof(double), CompareDoubles);
+    double sum = 0.0 ;
+    for(int s = 0 ; s < steps ; s++){
+        sum += latency[s] ;
+    }
+    stats.min = latency[0] ;
+    stats.p50 = latency[(steps*50 + 99)/100 - 1] ;
+    stats.p90 = latency[(steps*90 + 99)/100 - 1] ;
+    stats.p99 = latency[(steps*99 + 99)/100 - 1] ;
+    stats.mean = sum/steps ;
+    return stats ;
+}
+
+/**
+@brief Writes a string as a JSON string, with the quotes and control characters escaped.
+@param File The JSON file.
+@param str The string.
+*/
+static void WriteJSONString(FILE *File, const char *str){
+    fputc('"', File);
+    for(const char *c = str ; *c != '\0' ; c++){
+        if(*c == '"' || *c == '\\'){
+            fprintf(File, "\\%c", *c);
+        }else if((unsigned char)*c < 0x20){
+            fprintf(File, "\\u%04x", (unsigned int)(unsigned char)*c);
+        }else{
+            fputc(*c, File);
+        }
+    }
+    fputc('"', File);
+}
+
+/**
+@brief Reads the comma separated grid sizes of --bench-sizes.
+@param list The list, e.g. "128,256,512".
+@param sizes The sizes.
+@return The number of sizes.
+*/
+static int ParseBenchSizes(const char *list, int sizes[BENCH_MAX_SIZES]){
+    int numSizes = 0 ;
+    const char *c = list ;
+    while(*c != '\0' && numSizes < BENCH_MAX_SIZES){
+        char *end ;
+        long size = strtol(c, &end, 10);
+        if(end == c || size < 3){
+            printf("Error: the grid sizes of --bench-sizes must be a comma separated list of numbers of at least 3, not %s\n", list);
+            exit(1);
+        }
+        sizes[numSizes++] = (int)size ;
+        c = (*end == ',') ? end + 1 : end ;
+    }
+    return numSizes ;
+}
+
+/**
+@brief Times one work group setting of a system and adds the result to the JSON file and the table.
+@param System The system.
+@param InpParams The input parameters struct of the system.
+@param dataBuffers The data buffers struct of the system.
+@param localWS The local work size, ignored by the CPU backend.
+@param threads The OpenMP threads, 0 on the OpenCL backend.
+@param steps The timed steps.
+@param File The JSON file.
+@param first 1 for the first result of the file.
+*/
+static void RunBenchSetting(const struct SystemDescriptor *System, const void *InpParams, const void *dataBuffers, const size_t localWS[2],
+                            int threads, int steps, FILE *File, int first){
+    double warmup[BENCH_WARMUP_STEPS] ;
+    double *latency = (double*)malloc(sizeof(double)*steps);
+    System->timeSteps(InpParams, dataBuffers, localWS, BENCH_WARMUP_STEPS, warmup);
+    System->timeSteps(InpParams, dataBuffers, localWS, steps, latency);
+    struct BenchStats stats = GetBenchStats(latency, steps);
+    free(latency);
+
+    double cells = (double)NX*NY ;
+    double mlups = cells/stats.mean/1.0e6 ;
+    double gbps = cells*System->bytesPerCell/stats.mean/1.0e9 ;
+    char setting[32] ;
+    if(threads > 0){
+        sprintf(setting, "%d threads", threads);
+    }else{
+        sprintf(setting, "%lu x %lu", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    }
+    printf("   : %-12s %5d x %-5d %-12s %10.1f %10.1f %10.1f %10.1f %10.2f %8.2f\n", System->name, NX, NY, setting,
+           stats.min*1.0e6, stats.p50*1.0e6, stats.p90*1.0e6, stats.p99*1.0e6, mlups, gbps);
+
+    fprintf(File, "%s\n  {\"system\": ", first ? "" : ",");
+    WriteJSONString(File, System->name);
+    fprintf(File, ", \"nx\": %d, \"ny\": %d, \"lx\": %lu, \"ly\": %lu, \"threads\": %d, \"steps\": %d, "
+                  "\"min_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"mean_us\": %.3f, \"mlups\": %.3f, \"gbps\": %.4f}",
+            NX, NY, (unsigned long)(threads > 0 ? 0 : localWS[0]), (unsigned long)(threads > 0 ? 0 : localWS[1]), threads, steps,
+            stats.min*1.0e6, stats.p50*1.0e6, stats.p90*1.0e6, stats.p99*1.0e6, stats.mean*1.0e6, mlups, gbps);
+}
+
+/**
+@brief Runs the benchmark suite over all registered systems and writes the results to a JSON file.
+@param JSONFileName The JSON file, overwritten.
+@param sizeList The comma separated grid sizes, NULL for BENCH_DEFAULT_SIZES.
+@param steps The timed steps per setting, 0 for BENCH_DEFAULT_STEPS.
+*/
+void RunBenchSuite(const char JSONFileName[], const char *sizeList, int steps){
+    int sizes[BENCH_MAX_SIZES] ;
+    int numSizes = ParseBenchSizes((sizeList != NULL) ? sizeList : BENCH_DEFAULT_SIZES, sizes);
+    if(steps <= 0){
+        steps = BENCH_DEFAULT_STEPS ;
+    }
+    FILE *File = fopen(JSONFileName, "w");
+    if(File == NULL){
+        printf("Error: could not write the benchmark results to %s\n", JSONFileName);
+        exit(1);
+    }
+
+    // The backend and the machine
+    char device[256] = "cpu", host[256] = "unknown", timestamp[32] ;
+    int maxThreads = CPUNumThreads();
+    if(Backend == BACKEND_OPENCL){
+        // The platform and device of the first system's input file
+        readCommonParams(Systems[0].inputFile);
+        initCLDataStructures();
+        cl_int err = clGetDeviceInfo(devices[devID], CL_DEVICE_NAME, sizeof(device), device, NULL);
+        ErrorHandle(err, "clGetDeviceInfo CL_DEVICE_NAME");
+    }
+    struct utsname machine ;
+    if(uname(&machine) == 0){
+        snprintf(host, sizeof(host), "%s", machine.nodename);
+    }
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(File, "{\"suite\": \"phase-field-bench\", \"version\": 1, \"backend\": \"%s\", \"device\": ", (Backend == BACKEND_CPU) ? "cpu" : "opencl");
+    WriteJSONString(File, device);
+    fprintf(File, ", \"host\": ");
+    WriteJSONString(File, host);
+    fprintf(File, ", \"timestamp\": \"%s\", \"max_threads\": %d, \"warmup_steps\": %d, \"results\": [", timestamp, maxThreads, BENCH_WARMUP_STEPS);
+
+    printf("Benchmark suite on %s (%s), %d timed steps per setting\n", (Backend == BACKEND_CPU) ? "the CPU backend" : "OpenCL", device, steps);
+    printf("   : %-12s %13s %-12s %10s %10s %10s %10s %10s %8s\n", "System", "Grid", "Work group", "min us", "p50 us", "p90 us", "p99 us", "MLUPS", "GB/s");
+    int first = 1 ;
+    for(int sys = 0 ; sys < NUM_SYSTEMS ; sys++){
+        const struct SystemDescriptor *System = &Systems[sys] ;
+        void *InpParams = calloc(1, System->paramsBytes);
+        void *dataBuffers = calloc(1, System->buffersBytes);
+        for(int n = 0 ; n < numSizes ; n++){
+            // The system parameters from its input file, the grid, the single precision and the fixed time step from the suite
+            readCommonParams(System->inputFile);
+            System->readParams(System->inputFile, InpParams);
+            NX = NY = GridNX = GridNY = sizes[n] ;
+            NZ = 1 ;
+            Precision = PRECISION_SINGLE ;
+            AdaptiveDT = 0 ;
+            PITCH = ((NX + PITCH_ALIGN - 1)/PITCH_ALIGN)*PITCH_ALIGN ;
+            SeedRandom(1);
+            if(Backend == BACKEND_OPENCL){
+                char BuildProgOptions[1024] ;
+                System->buildOptions(InpParams, BuildProgOptions, sizeof(BuildProgOptions));
+                kernel = getKernelFromFile(System->kernelFile, BuildProgOptions);
+            }
+            System->initBuffers(InpParams, dataBuffers);
+
+            if(Backend == BACKEND_CPU){
+                size_t noWS[2] = {0, 0} ;
+                // 1, 2, 4, ... threads and the threads of the run
+                for(int threads = 1 ; threads > 0 ; threads = (threads == maxThreads) ? 0 : (threads*2 < maxThreads) ? threads*2 : maxThreads){
+#ifdef _OPENMP
+                    omp_set_num_threads(threads);
+#endif
+                    RunBenchSetting(System, InpParams, dataBuffers, noWS, threads, steps, File, first);
+                    first = 0 ;
+                }
+#ifdef _OPENMP
+                omp_set_num_threads(maxThreads);
+#endif
+            }else{
+                size_t maxItems, maxSizes[3] ;
+                cl_int err = clGetKernelWorkGroupInfo(kernel, devices[devID], CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxItems), &maxItems, NULL);
+                err |= clGetDeviceInfo(devices[devID], CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxSizes), maxSizes, NULL);
+                ErrorHandle(err, "bench suite work group limits");
+                for(int w = 0 ; w < NUM_BENCH_SHAPES ; w++){
+                    if(BenchShapes[w][0]*BenchShapes[w][1] > maxItems || BenchShapes[w][0] > maxSizes[0] || BenchShapes[w][1] > maxSizes[1]){
+                        continue ;
+                    }
+                    RunBenchSetting(System, InpParams, dataBuffers, BenchShapes[w], 0, steps, File, first);
+                    first = 0 ;
+                }
+                clReleaseKernel(kernel);
+                clReleaseProgram(program);
+            }
+            System->releaseBuffers(dataBuffers);
+        }
+        free(dataBuffers);
+        free(InpParams);
+    }
+    fprintf(File, "\n]}\n");
+    fclose(File);
+    printf("Benchmark results written to %s\n", JSONFileName);
+}
+
+#endif
+// END OF FILE
@@ -0,0 +1,359 @@
+/**
+@file benchmark_funcs.h
+@brief Declares functions to benchmark the kernel variants of a system.
+
+The benchmarks are run with the --bench flag instead of a simulation. They report the kernel execution time measured
+with the profiling events and the throughput in MLUPS (million lattice-site updates per second).
+
+The time*Steps() functions time single steps of the main kernel of a system on either backend, for the benchmark suite of bench_suite.h .
+*/
+
+#ifndef BENCHMARK_FUNCS
+#define BENCHMARK_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else  
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "file_to_program.h"
+#include "iterate_kernels.h"
+#include "cpu_kernels.h"
+
+/**
+@brief Benchmark the Cahn-Hilliard kernels against each other.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+
+Every variant runs ITERS iterations (2*ITERS steps) from the same initial field:
+|Variant|Kernel(s)|
+|-------|---------|
+|legacy|ch_legacy_evol_kern, the original single launch with a global barrier (races between work-groups)|
+|two-kernel|ch_inner_kern + ch_outer_kern|
+|tiled|phase_field_evol_kern, the local-memory tiled kernel|
+
+The final field of each variant is compared with the two-kernel one, which is the exact explicit scheme.
+*/
+void benchCahnHilliardKernels(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    cl_int err ;
+    size_t globalWS[2] ;
+    if(WGsize < 8){
+        WGsize = GetOptimumWGSize(kernel, devices[devID]) ;
+    }
+    size_t localWS[2] = {WGsize,WGsize};
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Benchmark of the Cahn-Hilliard kernels, grid %d x %d, %d steps, work group size %d\n", NX, NY, 2*ITERS, WGsize);
+    
+    cl_kernel legacyKern = getKernelFromProgram("ch_legacy_evol_kern");
+    cl_kernel innerKern = getKernelFromProgram("ch_inner_kern");
+    cl_kernel outerKern = getKernelFromProgram("ch_outer_kern");
+    
+    // Keep the initial field and the two-kernel result to restart and compare every variant
+    // The buffers hold the device precision, the result is compared as floats
+    size_t bytes = StorageBytes()*FIELD_CELLS ;
+    void *initial = malloc(bytes);
+    float *reference = (float*)malloc(sizeof(float)*FIELD_CELLS);
+    float *result = (float*)malloc(StagingBytes(FIELD_CELLS));
+    FloatToStorage(databuffers.PHASE1, initial, FIELD_CELLS);
+    
+    const char *names[3] = {"two-kernel", "tiled", "legacy"};
+    cl_event events[4];
+    
+    for(int variant = 0; variant < 3; variant++){
+        err = clEnqueueWriteBuffer(queue, databuffers.PHASE1buff, CL_TRUE, 0, bytes, initial, 0, NULL, NULL);
+        KernErrorHandle(err, "clEnqueueWriteBuffer");
+        cl_int numEvents = (variant == 0) ? 4 : 2 ;
+        double exec_time = 0.0 ;
+        
+        for(int iter = 0 ; iter < ITERS ; iter++){
+            if(variant == 0){
+                CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff, events, 0);
+                CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.InBracMbuff, events, 1);
+            }else if(variant == 1){
+                CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, events, 0);
+                CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, events, 1);
+            }else{
+                cl_mem ping[2] = {databuffers.PHASE1buff, databuffers.PHASE2buff};
+                for(int half = 0; half < 2; half++){
+                    err = clSetKernelArg(legacyKern, 0, sizeof(cl_mem), &databuffers.InBracMbuff);
+                    err |= clSetKernelArg(legacyKern, 1, sizeof(cl_mem), &ping[half]);
+                    err |= clSetKernelArg(legacyKern, 2, sizeof(cl_mem), &ping[1-half]);
+                    KernErrorHandle(err, "SetKernelArg legacy");
+                    err = clEnqueueNDRangeKernel(queue, legacyKern, 2, NULL, globalWS, localWS, 0, NULL, &events[half]);
+                    KernErrorHandle(err, "clEnqueueNDRangeKernel legacy");
+                }
+            }
+            clFinish(queue);
+            for(int e = 0; e < numEvents; e++){
+                exec_time += GetEventExecTime(events[e]);
+                clReleaseEvent(events[e]);
+            }
+        }
+        
+        err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_TRUE, 0, bytes, result, 0, NULL, NULL);
+        KernErrorHandle(err, "clEnqueueReadBuffer");
+        StorageToFloat(result, FIELD_CELLS);
+        if(variant == 0){
+            memcpy(reference, result, sizeof(float)*FIELD_CELLS);
+        }
+        float maxdiff = 0.0f ;
+        for(size_t i = 0; i < FIELD_CELLS; i++){
+            maxdiff = fmaxf(maxdiff, fabsf(result[i]-reference[i]));
+        }
+        printf("   : %-10s : %8.4f s : %9.2f MLUPS : max |diff| to two-kernel %e\n", names[variant], exec_time, MLUPS((size_t)NX*NY, 2.0*ITERS, exec_time), maxdiff);
+    }
+    
+    clReleaseKernel(legacyKern);
+    clReleaseKernel(innerKern);
+    clReleaseKernel(outerKern);
+    free(initial);
+    free(reference);
+    free(result);
+}
+
+/**
+@brief Benchmark the untiled and the tiled Kobayashi anisotropic kernels against each other.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure.
+
+Both kernels run ITERS iterations (2*ITERS steps) without noise from the same initial fields, and the final
+fields of the tiled kernel are compared with the untiled ones.
+*/
+void benchKobayashiAnisoKernels(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
+    cl_int err ;
+    size_t globalWS[2] ;
+    cl_kernel tiledKern = getKernelFromProgram("phase_field_evol_tiled_kern");
+    if(WGsize < 8){
+        WGsize = GetOptimumWGSize(tiledKern, devices[devID]) ;
+    }
+    size_t localWS[2] = {WGsize,WGsize};
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Benchmark of the Kobayashi anisotropic kernels, grid %d x %d, %d steps, work group size %d\n", NX, NY, 2*ITERS, WGsize);
+    
+    // The buffers hold the device precision, the results are compared as floats
+    size_t bytes = StorageBytes()*FIELD_CELLS ;
+    void *phase0 = malloc(bytes), *temp0 = malloc(bytes);
+    float *phaseRef = (float*)malloc(sizeof(float)*FIELD_CELLS), *tempRef = (float*)malloc(sizeof(float)*FIELD_CELLS);
+    float *phase = (float*)malloc(StagingBytes(FIELD_CELLS)), *temp = (float*)malloc(StagingBytes(FIELD_CELLS));
+    FloatToStorage(databuffers.PHASE1, phase0, FIELD_CELLS);
+    FloatToStorage(databuffers.TEMP1, temp0, FIELD_CELLS);
+    
+    const char *names[2] = {"untiled", "tiled"};
+    cl_event events[2];
+    
+    for(int variant = 0; variant < 2; variant++){
+        err = clEnqueueWriteBuffer(queue, databuffers.PHASE1buff, CL_TRUE, 0, bytes, phase0, 0, NULL, NULL);
+        err |= clEnqueueWriteBuffer(queue, databuffers.TEMP1buff, CL_TRUE, 0, bytes, temp0, 0, NULL, NULL);
+        KernErrorHandle(err, "clEnqueueWriteBuffer");
+        double exec_time = 0.0 ;
+        
+        for(int iter = 0 ; iter < ITERS ; iter++){
+            if(variant == 0){
+                KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, 0.0f, events, 0);
+                KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, 0.0f, events, 1);
+            }else{
+                KobayashiTiledEvolutionStep(tiledKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, 0.0f, events, 0);
+                KobayashiTiledEvolutionStep(tiledKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, 0.0f, events, 1);
+            }
+            clFinish(queue);
+            for(int e = 0; e < 2; e++){
+                exec_time += GetEventExecTime(events[e]);
+                clReleaseEvent(events[e]);
+            }
+        }
+        
+        err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_TRUE, 0, bytes, phase, 0, NULL, NULL);
+        err |= clEnqueueReadBuffer(queue, databuffers.TEMP1buff, CL_TRUE, 0, bytes, temp, 0, NULL, NULL);
+        KernErrorHandle(err, "clEnqueueReadBuffer");
+        StorageToFloat(phase, FIELD_CELLS);
+        StorageToFloat(temp, FIELD_CELLS);
+        if(variant == 0){
+            memcpy(phaseRef, phase, sizeof(float)*FIELD_CELLS);
+            memcpy(tempRef, temp, sizeof(float)*FIELD_CELLS);
+        }
+        float maxdiff = 0.0f ;
+        for(size_t i = 0; i < FIELD_CELLS; i++){
+            maxdiff = fmaxf(maxdiff, fabsf(phase[i]-phaseRef[i]));
+            maxdiff = fmaxf(maxdiff, fabsf(temp[i]-tempRef[i]));
+        }
+        printf("   : %-10s : %8.4f s : %9.2f MLUPS : max |diff| to untiled %e\n", names[variant], exec_time, MLUPS((size_t)NX*NY, 2.0*ITERS, exec_time), maxdiff);
+    }
+    
+    clReleaseKernel(tiledKern);
+    free(phase0); free(temp0);
+    free(phaseRef); free(tempRef);
+    free(phase); free(temp);
+}
+
+/**
+@brief The time of one OpenCL step from its profiling events.
+@param events The events of the kernels of the step.
+@param count The number of events.
+@return The time in seconds from the start of the first kernel to the end of the last one, the latency of the step on the device.
+*/
+static double StepEventsTime(cl_event events[], int count){
+    cl_ulong start, end ;
+    clWaitForEvents(count, events);
+    cl_int err = clGetEventProfilingInfo(events[0], CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+    err |= clGetEventProfilingInfo(events[count-1], CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    KernErrorHandle(err, "clGetEventProfilingInfo");
+    for(int e = 0 ; e < count ; e++){
+        clReleaseEvent(events[e]);
+    }
+    return (end - start)/1.0e9 ;
+}
+
+/**
+@brief Times single steps of the diffusion system.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure.
+@param localWS The local work size of the OpenCL backend.
+@param steps The number of steps.
+@param latency The time of every step in seconds.
+*/
+void timeDiffusionSteps(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers, const size_t localWS[2], int steps, double latency[]){
+    size_t globalWS[2], l[2] = {localWS[0], localWS[1]} ;
+    if(Backend == BACKEND_OPENCL){
+        PadGlobalWorkSize(globalWS, l);
+    }
+    cl_event events[1] ;
+    for(int s = 0 ; s < steps ; s++){
+        int odd = s%2 ;
+        if(Backend == BACKEND_CPU){
+            double start = CPUWallTime();
+            cpuDiffusionStep(odd ? databuffers.PHASE2 : databuffers.PHASE1, odd ? databuffers.PHASE1 : databuffers.PHASE2, inpparams, CPUWholeGrid());
+            latency[s] = CPUWallTime() - start ;
+        }else{
+            DiffusionEvolutionStep(globalWS, l, odd ? databuffers.PHASE2buff : databuffers.PHASE1buff, odd ? databuffers.PHASE1buff : databuffers.PHASE2buff, events, 0);
+            latency[s] = StepEventsTime(events, 1);
+        }
+    }
+}
+
+/**
+@brief Times single steps of the Cahn-Hilliard system, the tiled kernel if TiledKernels is set, the two-kernel step otherwise.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+@param localWS The local work size of the OpenCL backend.
+@param steps The number of steps.
+@param latency The time of every step in seconds.
+*/
+void timeCahnHilliardSteps(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers, const size_t localWS[2], int steps, double latency[]){
+    size_t globalWS[2], l[2] = {localWS[0], localWS[1]} ;
+    if(Backend == BACKEND_OPENCL){
+        PadGlobalWorkSize(globalWS, l);
+    }
+    cl_event events[2] ;
+    cl_kernel innerKern = NULL, outerKern = NULL ;
+    if(Backend == BACKEND_OPENCL && !TiledKernels){
+        innerKern = getKernelFromProgram("ch_inner_kern");
+        outerKern = getKernelFromProgram("ch_outer_kern");
+    }
+    for(int s = 0 ; s < steps ; s++){
+        int odd = s%2 ;
+        if(Backend == BACKEND_CPU){
+            double start = CPUWallTime();
+            cpuCahnHilliardStep(databuffers.InBracM, odd ? databuffers.PHASE2 : databuffers.PHASE1, odd ? databuffers.PHASE1 : databuffers.PHASE2, inpparams, CPUWholeGrid());
+            latency[s] = CPUWallTime() - start ;
+        }else if(TiledKernels){
+            CahnHilliardEvolutinStep(globalWS, l, odd ? databuffers.PHASE2buff : databuffers.PHASE1buff, odd ? databuffers.PHASE1buff : databuffers.PHASE2buff, events, 0);
+            latency[s] = StepEventsTime(events, 1);
+        }else{
+            CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, l, odd ? databuffers.PHASE2buff : databuffers.PHASE1buff, odd ? databuffers.PHASE1buff : databuffers.PHASE2buff, databuffers.InBracMbuff, events, 0);
+            latency[s] = StepEventsTime(events, 2);
+        }
+    }
+    if(innerKern != NULL){
+        clReleaseKernel(innerKern);
+        clReleaseKernel(outerKern);
+    }
+}
+
+/**
+@brief Times single steps of the Kobayashi isotropic system, without noise.
+@param inpparams A KobIsoInputParams structure.
+@param databuffers A KobIsoDataBuffers structure.
+@param localWS The local work size of the OpenCL backend.
+@param steps The number of steps.
+@param latency The time of every step in seconds.
+*/
+void timeKobayashiIsoSteps(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers, const size_t localWS[2], int steps, double latency[]){
+    size_t globalWS[2], l[2] = {localWS[0], localWS[1]} ;
+    if(Backend == BACKEND_OPENCL){
+        PadGlobalWorkSize(globalWS, l);
+    }
+    cl_event events[1] ;
+    for(int s = 0 ; s < steps ; s++){
+        int odd = s%2 ;
+        if(Backend == BACKEND_CPU){
+            double start = CPUWallTime();
+            cpuKobayashiIsoStep(odd ? databuffers.PHASE2 : databuffers.PHASE1, odd ? databuffers.PHASE1 : databuffers.PHASE2,
+                                odd ? databuffers.TEMP2 : databuffers.TEMP1, odd ? databuffers.TEMP1 : databuffers.TEMP2, 0.0f, inpparams, CPUWholeGrid());
+            latency[s] = CPUWallTime() - start ;
+        }else{
+            KobayashiEvolutionStep(globalWS, l, odd ? databuffers.PHASE2buff : databuffers.PHASE1buff, odd ? databuffers.PHASE1buff : databuffers.PHASE2buff,
+                                   odd ? databuffers.TEMP2buff : databuffers.TEMP1buff, odd ? databuffers.TEMP1buff : databuffers.TEMP2buff, 0.0f, events, 0);
+            latency[s] = StepEventsTime(events, 1);
+        }
+    }
+}
+
+/**
+@brief Times single steps of the Kobayashi anisotropic system without noise, the tiled kernel if TiledKernels is set.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure.
+@param localWS The local work size of the OpenCL backend.
+@param steps The number of steps.
+@param latency The time of every step in seconds.
+*/
+void timeKobayashiAnisoSteps(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers, const size_t localWS[2], int steps, double latency[]){
+    size_t globalWS[2], l[2] = {localWS[0], localWS[1]} ;
+    if(Backend == BACKEND_OPENCL){
+        PadGlobalWorkSize(globalWS, l);
+    }
+    cl_event events[1] ;
+    cl_kernel tiledKern = NULL ;
+    float *DPDX = NULL, *DPDY = NULL, *EPSD = NULL ;
+    if(Backend == BACKEND_CPU){
+        DPDX = Init1DFloatMatrix(0.0);
+        DPDY = Init1DFloatMatrix(0.0);
+        EPSD = Init1DFloatMatrix(0.0);
+    }else if(TiledKernels){
+        tiledKern = getKernelFromProgram("phase_field_evol_tiled_kern");
+    }
+    for(int s = 0 ; s < steps ; s++){
+        int odd = s%2 ;
+        cl_mem p1 = odd ? databuffers.PHASE2buff : databuffers.PHASE1buff, p2 = odd ? databuffers.PHASE1buff : databuffers.PHASE2buff ;
+        cl_mem t1 = odd ? databuffers.TEMP2buff : databuffers.TEMP1buff, t2 = odd ? databuffers.TEMP1buff : databuffers.TEMP2buff ;
+        if(Backend == BACKEND_CPU){
+            double start = CPUWallTime();
+            cpuKobayashiAnisoStep(odd ? databuffers.PHASE2 : databuffers.PHASE1, odd ? databuffers.PHASE1 : databuffers.PHASE2,
+                                  odd ? databuffers.TEMP2 : databuffers.TEMP1, odd ? databuffers.TEMP1 : databuffers.TEMP2, 0.0f, inpparams, DPDX, DPDY, EPSD, CPUWholeGrid());
+            latency[s] = CPUWallTime() - start ;
+        }else if(TiledKernels){
+            KobayashiTiledEvolutionStep(tiledKern, globalWS, l, p1, p2, t1, t2, 0.0f, events, 0);
+            latency[s] = StepEventsTime(events, 1);
+        }else{
+            KobayashiEvolutionStep(globalWS, l, p1, p2, t1, t2, 0.0f, events, 0);
+            latency[s] = StepEventsTime(events, 1);
+        }
+    }
+    if(tiledKern != NULL){
+        clReleaseKernel(tiledKern);
+    }
+    free(DPDX);
+    free(DPDY);
+    free(EPSD);
+}
+
+#endif
+//END OF FILE
@@ -0,0 +1,362 @@
+/**
+@file checkpoint_funcs.h
+@brief Declares the functions to write checkpoints of the full simulation state and to restart from them.
+
+A checkpoint holds every data buffer of the SYSTEM, the next iteration to run, the state of the noise generator and
+the input parameters. The iterate functions write one every CheckpointEvery iterations to checkpoint.pfchk in their
+output directory. The file is written to checkpoint.pfchk.tmp, synced and renamed, so a crash while writing leaves
+the previous checkpoint intact. `mainfile --restart <file>` continues the run from a checkpoint.
+
+The file is in the byte order of the host and is made to be memory-mapped :
+|Byte offset|Type|Content|
+|-----------|----|-------|
+|0|char[8]|"PFCHK003"|
+|8|uint32|header size in bytes, 4096|
+|12|uint32|number of fields|
+|16|char[16]|SYSTEM name|
+|32|int32|NX|
+|36|int32|next iteration|
+|40|float32|DX|
+|44|float32|DT|
+|48|uint64|RNGState|
+|56|uint32|size of the input parameters struct|
+|60|uint32|0x01020304, checks the byte order|
+|64|int32|NY|
+|68|int32|PITCH, the fields are NY*NZ rows of PITCH cells|
+|72|int32|NZ|
+|128|field table|per field : char[16] name, uint64 offset, uint64 bytes|
+|1024|bytes|the input parameters struct|
+|4096|fields|each field starts at a multiple of 4096 bytes|
+
+The fields are saved in the precision of the device fields (see precision_funcs.h), so a run restarts in the precision it was written in.
+*/
+
+#ifndef CHECKPOINT_FUNCS
+#define CHECKPOINT_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "trace_funcs.h"
+#include "precision_funcs.h"
+#include "read_inp_file.h"
+
+/// Magic bytes at the start of a checkpoint file.
+#define CHECKPOINT_MAGIC "PFCHK003"
+/// Size of the header and alignment of the fields, a multiple of the page size.
+#define CHECKPOINT_ALIGN 4096
+/// Offset of the field table in the header.
+#define CHECKPOINT_TABLE_OFFSET 128
+/// Offset of the input parameters in the header.
+#define CHECKPOINT_PARAMS_OFFSET 1024
+/// Maximum number of fields, limited by the space of the field table.
+#define CHECKPOINT_MAX_FIELDS 28
+
+/// A field of a checkpoint. The device buffer is used with the OpenCL backend, the host array with the CPU backend.
+struct CheckpointField{
+    /// The field name, for example "PHASE1".
+    const char *name ;
+    cl_mem buff ;
+    float *host ;
+};
+
+/// An entry of the field table of a checkpoint file.
+struct CheckpointFieldEntry{
+    char name[16] ;
+    uint64_t offset ;
+    uint64_t bytes ;
+};
+
+/// The fixed part of the header of a checkpoint file.
+struct CheckpointHeader{
+    char magic[8] ;
+    uint32_t headerBytes ;
+    uint32_t numFields ;
+    char system[16] ;
+    int32_t nx ;
+    int32_t nextIter ;
+    float dx ;
+    float dt ;
+    uint64_t rngState ;
+    uint32_t paramBytes ;
+    uint32_t byteOrder ;
+    int32_t ny ;
+    int32_t pitch ;
+    int32_t nz ;
+};
+
+/// The memory-mapped checkpoint of a restart, between OpenCheckpoint() and LoadCheckpointFields().
+struct{
+    unsigned char *map ;
+    size_t bytes ;
+} Restart ;
+
+/**
+@brief Checks whether a checkpoint is due after an iteration.
+@param iter The iteration just completed.
+@return 1 if a checkpoint is to be written.
+*/
+static inline int CheckpointDue(int iter){
+    return (CheckpointEvery > 0) && ((iter+1)%CheckpointEvery == 0) ;
+}
+
+/**
+@brief Writes bytes of padding.
+@param File The checkpoint file.
+@param bytes The number of zero bytes.
+@return 1 on success.
+*/
+static inline int WritePadding(FILE *File, size_t bytes){
+    static const unsigned char zeros[CHECKPOINT_ALIGN] = {0} ;
+    return fwrite(zeros, 1, bytes, File) == bytes ;
+}
+
+/**
+@brief Writes a checkpoint atomically.
+@param OutFileDir The output directory, the checkpoint is OutFileDir/checkpoint.pfchk .
+@param system The SYSTEM name.
+@param params The input parameters struct.
+@param paramBytes The size of the input parameters struct.
+@param nextIter The next iteration to run after a restart.
+@param fields The fields to save.
+@param numFields The number of fields.
+
+With the OpenCL backend the buffers are mapped for reading, which waits for the commands enqueued before.
+*/
+void WriteCheckpoint(const char OutFileDir[], const char system[], const void *params, size_t paramBytes, int nextIter, struct CheckpointField fields[], int numFields){
+    TRACE_SPAN_BEGIN(checkpoint);
+    char FileName[160], TmpFileName[170] ;
+    sprintf(FileName, "%s/checkpoint.pfchk", OutFileDir);
+    sprintf(TmpFileName, "%s.tmp", FileName);
+    size_t fieldBytes = ((Backend == BACKEND_OPENCL) ? StorageBytes() : sizeof(float))*FIELD_CELLS ;
+    size_t stride = ((fieldBytes + CHECKPOINT_ALIGN - 1)/CHECKPOINT_ALIGN)*CHECKPOINT_ALIGN ;
+    if(numFields > CHECKPOINT_MAX_FIELDS || paramBytes > CHECKPOINT_ALIGN - CHECKPOINT_PARAMS_OFFSET){
+        printf("Error: the state does not fit in the checkpoint header\n");
+        exit(1);
+    }
+
+    unsigned char header[CHECKPOINT_ALIGN] ;
+    struct CheckpointHeader head ;
+    memset(header, 0, sizeof(header));
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, CHECKPOINT_MAGIC, 8);
+    head.headerBytes = CHECKPOINT_ALIGN ;
+    head.numFields = numFields ;
+    strncpy(head.system, system, 15);
+    head.nx = NX ;
+    head.ny = NY ;
+    head.pitch = PITCH ;
+    head.nz = NZ ;
+    head.nextIter = nextIter ;
+    head.dx = DX ;
+    head.dt = DT ;
+    head.rngState = RNGState ;
+    head.paramBytes = paramBytes ;
+    head.byteOrder = 0x01020304 ;
+    memcpy(header, &head, sizeof(head));
+    for(int f = 0 ; f < numFields ; f++){
+        struct CheckpointFieldEntry entry ;
+        memset(&entry, 0, sizeof(entry));
+        strncpy(entry.name, fields[f].name, 15);
+        entry.offset = CHECKPOINT_ALIGN + f*stride ;
+        entry.bytes = fieldBytes ;
+        memcpy(header + CHECKPOINT_TABLE_OFFSET + f*sizeof(entry), &entry, sizeof(entry));
+    }
+    memcpy(header + CHECKPOINT_PARAMS_OFFSET, params, paramBytes);
+
+    FILE *File = fopen(TmpFileName, "wb");
+    if(File == NULL){
+        perror("Error in writing the checkpoint\n");
+        exit(1);
+    }
+    int ok = fwrite(header, 1, sizeof(header), File) == sizeof(header) ;
+    for(int f = 0 ; f < numFields && ok ; f++){
+        if(Backend == BACKEND_OPENCL){
+            cl_int err ;
+            void *data = clEnqueueMapBuffer(queue, fields[f].buff, CL_TRUE, CL_MAP_READ, 0, fieldBytes, 0, NULL, NULL, &err);
+            KernErrorHandle(err, "clEnqueueMapBuffer checkpoint");
+            ok = fwrite(data, 1, fieldBytes, File) == fieldBytes ;
+            err = clEnqueueUnmapMemObject(queue, fields[f].buff, data, 0, NULL, NULL);
+            KernErrorHandle(err, "clEnqueueUnmapMemObject checkpoint");
+        }else{
+            ok = fwrite(fields[f].host, 1, fieldBytes, File) == fieldBytes ;
+        }
+        ok = ok && WritePadding(File, stride - fieldBytes);
+    }
+    ok = ok && fflush(File) == 0 && fsync(fileno(File)) == 0 ;
+    ok = (fclose(File) == 0) && ok ;
+    if(!ok || rename(TmpFileName, FileName) != 0){
+        printf("Error in writing the checkpoint %s\n", FileName);
+        exit(1);
+    }
+    TRACE_SPAN_END(checkpoint, "WriteCheckpoint", "io");
+    printf("   : Checkpoint at iteration %d written to %s\n", nextIter, FileName);
+}
+
+/**
+@brief Maps a checkpoint and restores the state that is needed before the kernels are built.
+@param FileName The checkpoint file.
+@param system The SYSTEM name, it must match the checkpoint.
+@param params The input parameters struct, overwritten with the saved one.
+@param paramBytes The size of the input parameters struct.
+
+NX, NY, NZ, PITCH, DX, DT, StartIter and RNGState are restored. ITERS and NSAVE still come from the input file, so a chained job
+can run on to a later iteration. The fields are uploaded by LoadCheckpointFields() once the buffers exist.
+*/
+void OpenCheckpoint(const char FileName[], const char system[], void *params, size_t paramBytes){
+    int fd = open(FileName, O_RDONLY);
+    struct stat info ;
+    if(fd < 0 || fstat(fd, &info) != 0){
+        printf("Error: cannot open the checkpoint %s\n", FileName);
+        exit(1);
+    }
+    Restart.bytes = info.st_size ;
+    Restart.map = (Restart.bytes >= CHECKPOINT_ALIGN) ? (unsigned char*)mmap(NULL, Restart.bytes, PROT_READ, MAP_PRIVATE, fd, 0) : (unsigned char*)MAP_FAILED ;
+    close(fd);
+    if(Restart.map == (unsigned char*)MAP_FAILED){
+        printf("Error: cannot map the checkpoint %s\n", FileName);
+        exit(1);
+    }
+
+    struct CheckpointHeader head ;
+    memcpy(&head, Restart.map, sizeof(head));
+    if(memcmp(head.magic, CHECKPOINT_MAGIC, 8) != 0 || head.byteOrder != 0x01020304 || head.headerBytes != CHECKPOINT_ALIGN){
+        printf("Error: %s is not a checkpoint of this program or was written on a host of another byte order\n", FileName);
+        exit(1);
+    }
+    if(strncmp(head.system, system, 16) != 0 || head.paramBytes != paramBytes){
+        printf("Error: %s is a checkpoint of the %s system, not %s\n", FileName, head.system, system);
+        exit(1);
+    }
+    if(head.nx != NX || head.ny != NY || head.nz != NZ || head.dx != DX || head.dt != DT || memcmp(Restart.map + CHECKPOINT_PARAMS_OFFSET, params, paramBytes) != 0){
+        printf("   : The parameters of the checkpoint replace the ones of the input file\n");
+    }
+    NX = head.nx ;
+    NY = head.ny ;
+    NZ = head.nz ;
+    PITCH = head.pitch ;
+    GridNX = NX ;
+    GridNY = NY ;
+    CheckOutputSpecs();
+    DX = head.dx ;
+    DT = head.dt ;
+    StartIter = head.nextIter ;
+    RNGState = head.rngState ;
+    memcpy(params, Restart.map + CHECKPOINT_PARAMS_OFFSET, paramBytes);
+    printf("   : Restarting from %s at iteration %d\n", FileName, StartIter);
+}
+
+/**
+@brief Uploads the fields of the mapped checkpoint and unmaps it.
+@param fields The fields of the SYSTEM, matched by name.
+@param numFields The number of fields.
+
+With the OpenCL backend the fields are written straight from the mapping into the device buffers.
+*/
+void LoadCheckpointFields(struct CheckpointField fields[], int numFields){
+    struct CheckpointHeader head ;
+    memcpy(&head, Restart.map, sizeof(head));
+    size_t fieldBytes = ((Backend == BACKEND_OPENCL) ? StorageBytes() : sizeof(float))*FIELD_CELLS ;
+    for(int f = 0 ; f < numFields ; f++){
+        int found = 0 ;
+        for(uint32_t e = 0 ; e < head.numFields ; e++){
+            struct CheckpointFieldEntry entry ;
+            memcpy(&entry, Restart.map + CHECKPOINT_TABLE_OFFSET + e*sizeof(entry), sizeof(entry));
+            if(strncmp(entry.name, fields[f].name, 16) != 0){
+                continue ;
+            }
+            if(entry.offset + entry.bytes > Restart.bytes){
+                printf("Error: the checkpoint field %s is truncated\n", fields[f].name);
+                exit(1);
+            }
+            if(entry.bytes != fieldBytes){
+                printf("Error: the checkpoint field %s has %llu bytes instead of %llu, it was written with another Precision\n", fields[f].name,
+                       (unsigned long long)entry.bytes, (unsigned long long)fieldBytes);
+                exit(1);
+            }
+            if(Backend == BACKEND_OPENCL){
+                cl_int err = clEnqueueWriteBuffer(queue, fields[f].buff, CL_TRUE, 0, fieldBytes, Restart.map + entry.offset, 0, NULL, NULL);
+                KernErrorHandle(err, "clEnqueueWriteBuffer checkpoint");
+            }else{
+                memcpy(fields[f].host, Restart.map + entry.offset, fieldBytes);
+            }
+            found = 1 ;
+        }
+        if(!found){
+            printf("Error: the checkpoint has no field %s\n", fields[f].name);
+            exit(1);
+        }
+    }
+    munmap(Restart.map, Restart.bytes);
+    Restart.map = NULL ;
+}
+
+/**
+@brief The checkpoint fields of the diffusion system.
+@param databuffers A pointer to a DiffusionDataBuffers structure.
+@param fields The array to fill, at least CHECKPOINT_MAX_FIELDS long.
+@return The number of fields.
+*/
+int getDiffusionCheckpointFields(struct DiffusionDataBuffers *databuffers, struct CheckpointField fields[]){
+    fields[0] = (struct CheckpointField){"PHASE1", databuffers->PHASE1buff, databuffers->PHASE1} ;
+    fields[1] = (struct CheckpointField){"PHASE2", databuffers->PHASE2buff, databuffers->PHASE2} ;
+    return 2 ;
+}
+
+/**
+@brief The checkpoint fields of the cahn-hilliard system.
+@param databuffers A pointer to a CahnHilliardDataBuffers structure.
+@param fields The array to fill, at least CHECKPOINT_MAX_FIELDS long.
+@return The number of fields.
+*/
+int getCahnHilliardCheckpointFields(struct CahnHilliardDataBuffers *databuffers, struct CheckpointField fields[]){
+    fields[0] = (struct CheckpointField){"PHASE1", databuffers->PHASE1buff, databuffers->PHASE1} ;
+    fields[1] = (struct CheckpointField){"PHASE2", databuffers->PHASE2buff, databuffers->PHASE2} ;
+    fields[2] = (struct CheckpointField){"InBracM", databuffers->InBracMbuff, databuffers->InBracM} ;
+    return 3 ;
+}
+
+/**
+@brief The checkpoint fields of the kobayashi anisotropic system.
+@param databuffers A pointer to a KobAnisoDataBuffers structure.
+@param fields The array to fill, at least CHECKPOINT_MAX_FIELDS long.
+@return The number of fields.
+*/
+int getKobayashiAnisoCheckpointFields(struct KobAnisoDataBuffers *databuffers, struct CheckpointField fields[]){
+    fields[0] = (struct CheckpointField){"PHASE1", databuffers->PHASE1buff, databuffers->PHASE1} ;
+    fields[1] = (struct CheckpointField){"PHASE2", databuffers->PHASE2buff, databuffers->PHASE2} ;
+    fields[2] = (struct CheckpointField){"TEMP1", databuffers->TEMP1buff, databuffers->TEMP1} ;
+    fields[3] = (struct CheckpointField){"TEMP2", databuffers->TEMP2buff, databuffers->TEMP2} ;
+    return 4 ;
+}
+
+/**
+@brief The checkpoint fields of the kobayashi isotropic system.
+@param databuffers A pointer to a KobIsoDataBuffers structure.
+@param fields The array to fill, at least CHECKPOINT_MAX_FIELDS long.
+@return The number of fields.
+*/
+int getKobayashiIsoCheckpointFields(struct KobIsoDataBuffers *databuffers, struct CheckpointField fields[]){
+    fields[0] = (struct CheckpointField){"PHASE1", databuffers->PHASE1buff, databuffers->PHASE1} ;
+    fields[1] = (struct CheckpointField){"PHASE2", databuffers->PHASE2buff, databuffers->PHASE2} ;
+    fields[2] = (struct CheckpointField){"TEMP1", databuffers->TEMP1buff, databuffers->TEMP1} ;
+    fields[3] = (struct CheckpointField){"TEMP2", databuffers->TEMP2buff, databuffers->TEMP2} ;
+    return 4 ;
+}
+
+#endif
+//END OF FILE
@@ -0,0 +1,395 @@
+/**
+@file cpu_kernels.h
+@brief Native C (OpenMP + SIMD) versions of the kernels in the Kernels directory.
+
+Every function here computes one time step of the corresponding phase_field_evol_kern on the host arrays.
+The arithmetic mirrors the .cl kernels term by term and the constants are rounded with CLConst() exactly as
+getKernelFromFile() rounds them into the "-D" build options, so both backends solve the same discrete problem.
+The results are not bit for bit those of the float kernels: the terms are evaluated in double and only the fields
+are stored as float, and the compilers may contract and vectorize differently. A step agrees with the kernel to
+a few float ulps of the fields, about 1e-6 relative, and the difference grows with the number of steps, faster
+where the Kobayashi fronts are unstable. Compare the two backends with a tolerance, not byte for byte.
+The host arrays have the layout of the device buffers, NY rows of PITCH floats.
+The time step is CPUDT(), the adaptive runs of adaptive_dt_funcs.h set it like the dt argument of the kernels.
+
+Every function updates the cells of a CPURect, CPUWholeGrid() for a full step. The periodic boundaries wrap around the
+arrays; the fixed boundaries of the Kobayashi systems and their noise are placed with the coordinates of the whole grid,
+so the functions also step a block of an MPI process, whose arrays have halo cells around the block (see mpi_funcs.h).
+*/
+
+#ifndef CPU_KERNELS
+#define CPU_KERNELS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+
+/// The float value of pi, as the M_PI_F constant of OpenCL C.
+#ifndef M_PI_F
+#define M_PI_F 3.14159274101257324219f
+#endif
+
+/**
+@brief Round a parameter the same way the "%f" build options of getKernelFromFile() do.
+@param val The parameter value.
+@return The value of the literal the OpenCL compiler sees, as a double.
+*/
+static inline double CLConst(cl_float val){
+    char buff[64];
+    sprintf(buff, "%f", val);
+    return atof(buff);
+}
+
+/// The time step of the steps of an adaptive run, see adaptive_dt_funcs.h . 0 steps with DT.
+double CPUStepDT ;
+
+/**
+@brief The time step of the CPU steps, the counterpart of the DT of the kernels.
+@return CPUStepDT if it is set, DT rounded like its build option otherwise.
+*/
+static inline double CPUDT(){
+    return (CPUStepDT > 0.0) ? CPUStepDT : CLConst(DT) ;
+}
+
+/// A rectangle of cells of the arrays, columns x0 to x1-1 of rows y0 to y1-1.
+struct CPURect{
+    int x0, x1, y0, y1 ;
+};
+
+/**
+@brief The rectangle of all the cells of the arrays.
+*/
+static inline struct CPURect CPUWholeGrid(){
+    struct CPURect R = {0, NX, 0, NY} ;
+    return R ;
+}
+
+/**
+@brief A rectangle grown by some cells on every side, clipped to the arrays.
+@param R The rectangle.
+@param by The number of cells.
+@param edge The number of cells at the edges of the arrays the result keeps clear of.
+*/
+static inline struct CPURect CPUGrowRect(struct CPURect R, int by, int edge){
+    R.x0 = (R.x0 - by < edge) ? edge : R.x0 - by ;
+    R.y0 = (R.y0 - by < edge) ? edge : R.y0 - by ;
+    R.x1 = (R.x1 + by > NX - edge) ? NX - edge : R.x1 + by ;
+    R.y1 = (R.y1 + by > NY - edge) ? NY - edge : R.y1 + by ;
+    return R ;
+}
+
+/**
+@brief Wall clock time in seconds, used to profile the CPU backend.
+*/
+static inline double CPUWallTime(){
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+@brief Number of threads used by the CPU backend.
+*/
+static inline int CPUNumThreads(){
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/**
+@brief One step of the diffusion equation on the host. Mirrors DiffusionKern.cl .
+@param IN The input field at time t=n .
+@param OUT The output field at time t=n+1 .
+@param InpParams The DiffusionInputParams struct.
+@param R The cells to update.
+
+Periodic boundary conditions. The rows are distributed over the OpenMP threads and the interior of each row is vectorized.
+*/
+void cpuDiffusionStep(const float *restrict IN, float *restrict OUT, struct DiffusionInputParams InpParams, struct CPURect R){
+    const double dt = CPUDT(), h = CLConst(DX), coeff = CLConst(InpParams.DIFF_COEFF);
+    const int P = PITCH;
+    #pragma omp parallel for schedule(static)
+    for(int gy=R.y0; gy<R.y1; gy++){
+        const float *up = IN + P*(gy==0 ? NY-1 : gy-1);
+        const float *mid = IN + P*gy;
+        const float *down = IN + P*(gy==NY-1 ? 0 : gy+1);
+        float *out = OUT + P*gy;
+        int x0 = R.x0, x1 = R.x1 ;
+        float p ;
+        if(x0 == 0){
+            p = up[0] + down[0] + mid[1] + mid[NX-1] - 4*mid[0];
+            out[0] = mid[0] + dt*coeff*p/(h*h);
+            x0 = 1 ;
+        }
+        if(x1 == NX){
+            p = up[NX-1] + down[NX-1] + mid[0] + mid[NX-2] - 4*mid[NX-1];
+            out[NX-1] = mid[NX-1] + dt*coeff*p/(h*h);
+            x1 = NX-1 ;
+        }
+        #pragma omp simd private(p)
+        for(int gx=x0; gx<x1; gx++){
+            p = up[gx] + down[gx] + mid[gx+1] + mid[gx-1] - 4*mid[gx];
+            out[gx] = mid[gx] + dt*coeff*p/(h*h);
+        }
+    }
+}
+
+/**
+@brief The Cahn-Hilliard inner evolution on the host. Mirrors CHInnerEvol() of CahnHilliardKern.cl .
+@param IN The input concentration field.
+@param OUT The inner bracket field.
+@param InpParams The CahnHilliardInputParams struct.
+@param R The cells to update.
+*/
+void cpuCHInnerEvol(const float *restrict IN, float *restrict OUT, struct CahnHilliardInputParams InpParams, struct CPURect R){
+    const double kappa = CLConst(InpParams.KAPPA);
+    const int P = PITCH;
+    #pragma omp parallel for schedule(static)
+    for(int gy=R.y0; gy<R.y1; gy++){
+        const float *up = IN + P*(gy==0 ? NY-1 : gy-1);
+        const float *mid = IN + P*gy;
+        const float *down = IN + P*(gy==NY-1 ? 0 : gy+1);
+        float *out = OUT + P*gy;
+        #pragma omp simd
+        for(int gx=R.x0; gx<R.x1; gx++){
+            float M = mid[gx];
+            float g = (float)2*M*(0.9-M)*(1-2*M);
+            float Left = (gx==0) ? mid[NX-1] : mid[gx-1];
+            float Right = (gx==NX-1) ? mid[0] : mid[gx+1];
+            float del2C = up[gx] + down[gx] + Right + Left - 4*M;
+            out[gx] = g - kappa*2.0*(float)del2C;
+        }
+    }
+}
+
+/**
+@brief The Cahn-Hilliard outer evolution on the host. Mirrors CHOuterEvol() of CahnHilliardKern.cl .
+@param InBracM The inner bracket field computed by cpuCHInnerEvol().
+@param CONC The concentration field at time t=n .
+@param OUT The concentration field at time t=n+1 .
+@param InpParams The CahnHilliardInputParams struct.
+@param R The cells to update.
+*/
+void cpuCHOuterEvol(const float *restrict InBracM, const float *restrict CONC, float *restrict OUT, struct CahnHilliardInputParams InpParams, struct CPURect R){
+    const double dt = CPUDT(), h = CLConst(DX), mobility = CLConst(InpParams.MOBILITY);
+    const int P = PITCH;
+    #pragma omp parallel for schedule(static)
+    for(int gy=R.y0; gy<R.y1; gy++){
+        const float *up = InBracM + P*(gy==0 ? NY-1 : gy-1);
+        const float *mid = InBracM + P*gy;
+        const float *down = InBracM + P*(gy==NY-1 ? 0 : gy+1);
+        const float *conc = CONC + P*gy;
+        float *out = OUT + P*gy;
+        #pragma omp simd
+        for(int gx=R.x0; gx<R.x1; gx++){
+            float Left = (gx==0) ? mid[NX-1] : mid[gx-1];
+            float Right = (gx==NX-1) ? mid[0] : mid[gx+1];
+            float del2M = up[gx] + down[gx] + Right + Left - 4*mid[gx];
+            del2M = (1.0f/(h*h))*del2M ;
+            float o = conc[gx] + dt*mobility*del2M;
+            o = (o > 1.0) ? 1.0 : o;
+            o = (o < 0.0) ? 0.0 : o;
+            out[gx] = o;
+        }
+    }
+}
+
+/**
+@brief One step of the Cahn-Hilliard evolution on the host.
+@param InBracM The scratch array for the inner bracket.
+@param PHASE1 The concentration field at time t=n .
+@param PHASE2 The concentration field at time t=n+1 .
+@param InpParams The CahnHilliardInputParams struct.
+@param R The cells to update.
+
+The inner bracket is completed over the rectangle and its neighbours before the outer evolution reads it.
+*/
+void cpuCahnHilliardStep(float *InBracM, const float *PHASE1, float *PHASE2, struct CahnHilliardInputParams InpParams, struct CPURect R){
+    cpuCHInnerEvol(PHASE1, InBracM, InpParams, CPUGrowRect(R, 1, 0));
+    cpuCHOuterEvol(InBracM, PHASE1, PHASE2, InpParams, R);
+}
+
+/**
+@brief One step of the Kobayashi isotropic evolution on the host. Mirrors KobayashiIsoKern.cl .
+@param PHASE_IN The phase field at time t=n .
+@param PHASE_OUT The phase field at time t=n+1 .
+@param TEMP_IN The temperature field at time t=n .
+@param TEMP_OUT The temperature field at time t=n+1 .
+@param PHASE_NOISE The noise amplitude.
+@param InpParams The KobIsoInputParams struct.
+@param R The cells to update.
+
+The boundary values are taken at the edges of the whole grid. A cell at the edge of the arrays that is not at the edge of the
+whole grid, a halo cell of an MPI block, reads a boundary value too; its result is never used.
+*/
+void cpuKobayashiIsoStep(const float *restrict PHASE_IN, float *restrict PHASE_OUT, const float *restrict TEMP_IN, float *restrict TEMP_OUT, cl_float PHASE_NOISE, struct KobIsoInputParams InpParams, struct CPURect R){
+    const double dt = CPUDT(), h = CLConst(DX);
+    const double eps_bar = CLConst(InpParams.EPS_BAR), alpha = CLConst(InpParams.ALPHA), gamma = CLConst(InpParams.GAMMA), tau = CLConst(InpParams.TAU);
+    const double ph_l = CLConst(InpParams.PHASE_L), ph_r = CLConst(InpParams.PHASE_R), ph_t = CLConst(InpParams.PHASE_T), ph_b = CLConst(InpParams.PHASE_B);
+    const double therm_diff = CLConst(InpParams.TH_DIFF), lat_h = CLConst(InpParams.L_HEAT), t_melt = CLConst(InpParams.T_MELT);
+    const double t_l = CLConst(InpParams.TEMP_L), t_r = CLConst(InpParams.TEMP_R), t_t = CLConst(InpParams.TEMP_T), t_b = CLConst(InpParams.TEMP_B);
+    const int P = PITCH;
+    #pragma omp parallel for schedule(static)
+    for(int gy=R.y0; gy<R.y1; gy++){
+        const int Y = gy + BlockY0 ;
+        const float *pmid = PHASE_IN + P*gy, *tmid = TEMP_IN + P*gy;
+        // The boundary rows take the boundary values, so their up/down pointers are never read.
+        const int yu = (gy==0) ? gy : gy-1, yd = (gy==NY-1) ? gy : gy+1;
+        const float *pup = PHASE_IN + P*yu, *tup = TEMP_IN + P*yu;
+        const float *pdown = PHASE_IN + P*yd, *tdown = TEMP_IN + P*yd;
+        #pragma omp simd
+        for(int gx=R.x0; gx<R.x1; gx++){
+            const int X = gx + BlockX0 ;
+            float p1 = pmid[gx];
+            float Temp = tmid[gx];
+            float m = (alpha/M_PI_F)*atan(gamma*(-t_melt +Temp));
+
+            float lap = 0.0f;
+            lap += (X==0 || gx==0) ? ph_l : pmid[gx-1];
+            lap += (X==GridNX-1 || gx==NX-1) ? ph_r : pmid[gx+1];
+            lap += (Y==0 || gy==0) ? ph_t : pup[gx];
+            lap += (Y==GridNY-1 || gy==NY-1) ? ph_b : pdown[gx];
+            lap -= 4.0*p1;
+            float lapP = lap/(h*h);
+
+            float terms = (eps_bar*eps_bar*lapP) + (p1*(1.0-p1)*(p1-0.5+m));
+            float noise = PHASE_NOISE*( (((float)X/GridNX)-0.5)*(((float)Y/GridNY)-0.5) );
+            float p2 = p1 + (dt/tau)*(terms +p1*(1.0-p1)*noise);
+            PHASE_OUT[P*gy+gx] = p2;
+
+            lap = 0.0f;
+            lap += (X==0 || gx==0) ? t_l : tmid[gx-1];
+            lap += (X==GridNX-1 || gx==NX-1) ? t_r : tmid[gx+1];
+            lap += (Y==0 || gy==0) ? t_t : tup[gx];
+            lap += (Y==GridNY-1 || gy==NY-1) ? t_b : tdown[gx];
+            lap -= 4.0*Temp;
+            float lapT = lap/(h*h);
+
+            terms = therm_diff*lapT - lat_h*(p2-p1)/dt;
+            TEMP_OUT[P*gy+gx] = Temp + dt*(terms);
+        }
+    }
+}
+
+/**
+@brief One step of the Kobayashi anisotropic evolution on the host. Mirrors KobayashiAnisoKern.cl .
+@param PHASE_IN The phase field at time t=n .
+@param PHASE_OUT The phase field at time t=n+1 .
+@param TEMP_IN The temperature field at time t=n .
+@param TEMP_OUT The temperature field at time t=n+1 .
+@param PHASE_NOISE The noise amplitude.
+@param InpParams The KobAnisoInputParams struct.
+@param DPDX Scratch array of FIELD_CELLS floats for dphi/dx.
+@param DPDY Scratch array of FIELD_CELLS floats for dphi/dy.
+@param EPSD Scratch array of FIELD_CELLS floats for eps*deps/dtheta.
+@param R The cells to update.
+
+The kernel evaluates get_epsDepsDtheta() on the four neighbours of every cell. Here the gradient, theta and
+eps*deps/dtheta are computed once per cell in a first pass and the second pass reads them back, which removes
+four of the five atan/cos/sin evaluations per cell without changing the result.
+The frame of 2 cells of the whole grid, and of the arrays, only takes the reaction term.
+*/
+void cpuKobayashiAnisoStep(const float *restrict PHASE_IN, float *restrict PHASE_OUT, const float *restrict TEMP_IN, float *restrict TEMP_OUT, cl_float PHASE_NOISE, struct KobAnisoInputParams InpParams, float *restrict DPDX, float *restrict DPDY, float *restrict EPSD, struct CPURect R){
+    const double dt = CPUDT(), h = CLConst(DX);
+    const double eps_bar = CLConst(InpParams.EPS_BAR), alpha = CLConst(InpParams.ALPHA), gamma = CLConst(InpParams.GAMMA);
+    const double delta = CLConst(InpParams.DELTA), tau = CLConst(InpParams.TAU), theta0 = CLConst(InpParams.THETA0), J = CLConst(InpParams.J);
+    const double therm_diff = CLConst(InpParams.TH_DIFF), lat_h = CLConst(InpParams.L_HEAT), t_melt = CLConst(InpParams.T_MELT);
+    const int P = PITCH;
+
+    // Pass 1: gradient and eps*deps/dtheta of every cell that is a neighbour of an interior cell
+    const struct CPURect R1 = CPUGrowRect(R, 1, 1) ;
+    #pragma omp parallel for schedule(static)
+    for(int y=R1.y0; y<R1.y1; y++){
+        const float *mid = PHASE_IN + P*y;
+        const float *up = PHASE_IN + P*(y-1);
+        const float *down = PHASE_IN + P*(y+1);
+        #pragma omp simd
+        for(int x=R1.x0; x<R1.x1; x++){
+            float dPdX = (mid[x+1] - mid[x-1])/(2.0*(float)h);
+            float dPdY = (down[x] - up[x])/(2.0*(float)h);
+            float theta = ((dPdX==0)||(dPdY==0)) ? 0 : atanf(dPdY/dPdX);
+            float eps = (float)eps_bar*(1 +delta*cos(J*(theta -theta0)));
+            float deps = -(float)eps_bar*delta*J*sin(J*(theta -theta0));
+            DPDX[P*y+x] = dPdX;
+            DPDY[P*y+x] = dPdY;
+            EPSD[P*y+x] = eps*deps;
+        }
+    }
+
+    // Pass 2: the evolution
+    #pragma omp parallel for schedule(static)
+    for(int gy=R.y0; gy<R.y1; gy++){
+        const int Y = gy + BlockY0 ;
+        const float nsy = cosf((float)Y);
+        for(int gx=R.x0; gx<R.x1; gx++){
+            const int X = gx + BlockX0 ;
+            const int c = P*gy +gx;
+            float p1 = PHASE_IN[c];
+            float Temp = TEMP_IN[c];
+            float mm = ((float)alpha/3.14152557)*atan((float)gamma*(-t_melt +Temp));
+            float term3, p2;
+            int condition = (X<2)||(X>(GridNX-3))||(Y<2)||(Y>(GridNY-3))||(gx<2)||(gx>(NX-3))||(gy<2)||(gy>(NY-3));
+            if(!condition){
+                condition = (PHASE_IN[c+P]==p1) && (PHASE_IN[c-P]==p1) && (PHASE_IN[c+1]==p1) && (PHASE_IN[c-1]==p1);
+            }
+            if(condition){
+                term3 = p1*(1.0-p1)*(p1-0.5+mm) ;
+                p2 = p1+ ((float)dt/(float)tau)*(term3 +p1*(1.0 -p1)*PHASE_NOISE*sinf((float)X)*nsy);
+                PHASE_OUT[c] = p2 ;
+                TEMP_OUT[c] = Temp - lat_h*(p2-p1) ;
+            }else{
+                float tmp1, tmp2, term1, term2, eps, lap, theta;
+                tmp1 = DPDX[c+P]*EPSD[c+P];
+                tmp2 = DPDX[c-P]*EPSD[c-P];
+                term1 = (tmp1-tmp2)/(2.0*(float)h) ;
+                tmp1 = DPDY[c+1]*EPSD[c+1];
+                tmp2 = DPDY[c-1]*EPSD[c-1];
+                term2 = (tmp1-tmp2)/(2.0*(float)h) ;
+
+                theta = ((DPDX[c]==0)||(DPDY[c]==0)) ? 0 : atanf(DPDY[c]/DPDX[c]);
+                eps = (float)eps_bar*(1 +delta*cos(J*(theta -theta0)));
+
+                lap = 0.0f;
+                lap += PHASE_IN[c-1];
+                lap += PHASE_IN[c+1];
+                lap += PHASE_IN[c-P];
+                lap += PHASE_IN[c+P];
+                lap -= 4.0*p1;
+                lap = lap/(h*h);
+
+                term3 = eps*eps*lap + p1*(1.0-p1)*(p1-0.5+mm) ;
+                p2 = p1+ ((float)dt/(float)tau)*(term1-term2+term3 +p1*(1.0 -p1)*PHASE_NOISE*sinf((float)X)*nsy);
+                PHASE_OUT[c] = p2;
+
+                lap = 0.0f;
+                lap += TEMP_IN[c-1];
+                lap += TEMP_IN[c+1];
+                lap += TEMP_IN[c-P];
+                lap += TEMP_IN[c+P];
+                lap -= 4.0*Temp;
+                lap = lap/(h*h);
+                term1 = therm_diff*lap;
+                term2 = lat_h*(p2-p1);
+                TEMP_OUT[c] = Temp + dt*term1 -term2 ;
+            }
+        }
+    }
+}
+
+#endif
+//END OF FILE
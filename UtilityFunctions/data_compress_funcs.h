@@ -0,0 +1,207 @@
+/**
+@file data_compress_funcs.h
+@brief Declares the functions to write compressed .pfz outputfiles, OutDataFileType 5 .
+
+The field is cut into chunks of PFZ_CHUNK values that are compressed in parallel with OpenMP.
+Each chunk is stored in one of two modes :
+|Mode|Chunk data|
+|----|----------|
+|0|lossless : the float32 values byte-shuffled (all first bytes, then all second bytes...) and deflated with zlib|
+|1|lossy : the values quantized to 16 bit little-endian codes q, value = min + q*step in float32 arithmetic, byte-shuffled and deflated|
+
+The lossy mode is used when CompressErrorBound is more than 0. The step is 2*CompressErrorBound, so every value
+is within CompressErrorBound of the stored one. Chunks whose range needs more than 16 bits, or that would break the bound
+through rounding, fall back to the lossless mode. Regions of constant phase shrink to a few bytes in both modes.
+
+The file layout, all words little-endian :
+|Byte offset|Type|Content|
+|-----------|----|-------|
+|0|char[8]|"PFZ00001"|
+|8|uint32|header size in bytes, 64|
+|12|uint32|NX, the fastest varying dimension, or the size of a reduced output|
+|16|uint32|NY|
+|20|uint32|NZ|
+|24|uint32|values per chunk|
+|28|uint32|number of chunks|
+|32|int32|iteration number|
+|36|float32|grid spacing DX, times the decimation factor of a reduced output|
+|40|float32|error bound, 0 if lossless|
+|44|char[16]|field name, NUL padded|
+|60|uint32|reserved, 0|
+|64|chunk table|per chunk 4 words : uint32 mode, uint32 compressed bytes, float32 min, float32 step|
+|64+16*chunks|chunk data|the compressed chunks one after the other|
+*/
+
+#ifndef DATA_COMPRESS
+#define DATA_COMPRESS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
+
+/// Magic bytes at the start of a .pfz outputfile.
+#define PFZ_FILE_MAGIC "PFZ00001"
+/// Number of values compressed together, the unit of parallel work.
+#define PFZ_CHUNK 65536
+/// Chunk stored as shuffled float32 values.
+#define PFZ_MODE_LOSSLESS 0
+/// Chunk stored as shuffled 16 bit quantization codes.
+#define PFZ_MODE_QUANT16 1
+
+/// One compressed chunk of a .pfz file.
+struct PFZChunk{
+    uint32_t mode ;
+    /// The deflated bytes.
+    unsigned char *data ;
+    uLongf bytes ;
+    float min ;
+    float step ;
+};
+
+/**
+@brief Byte-shuffles an array, byte b of value i goes to position b*n+i .
+@param dst The destination, n*width bytes.
+@param src The source values.
+@param n The number of values.
+@param width The bytes per value.
+*/
+static inline void ByteShuffle(unsigned char *dst, const unsigned char *src, size_t n, size_t width){
+    for(size_t b = 0 ; b < width ; b++){
+        for(size_t i = 0 ; i < n ; i++){
+            dst[b*n + i] = src[i*width + b] ;
+        }
+    }
+}
+
+/**
+@brief Tries to quantize a chunk to 16 bit codes within the error bound.
+@param codes The output codes, in little-endian byte order.
+@param MAT The values of the chunk.
+@param n The number of values.
+@param errorBound The absolute error bound, more than 0.
+@param chunk The chunk whose min and step are set.
+@return 1 if all the values are within the bound, 0 if the chunk has to be stored lossless.
+*/
+static inline int QuantizeChunk16(unsigned char *codes, const float *MAT, size_t n, float errorBound, struct PFZChunk *chunk){
+    float lo = MAT[0], hi = MAT[0] ;
+    for(size_t i = 1 ; i < n ; i++){
+        lo = (MAT[i] < lo) ? MAT[i] : lo ;
+        hi = (MAT[i] > hi) ? MAT[i] : hi ;
+    }
+    if(!isfinite(lo) || !isfinite(hi)){
+        return 0 ;
+    }
+    float step = 2.0f*errorBound ;
+    if(((double)hi - lo)/step > 65535.0){
+        return 0 ;
+    }
+    for(size_t i = 0 ; i < n ; i++){
+        uint16_t q = (uint16_t)lrint(((double)MAT[i] - lo)/step) ;
+        if(fabsf((lo + q*step) - MAT[i]) > errorBound){
+            return 0 ;
+        }
+        codes[2*i] = (unsigned char)(q & 0xff) ;
+        codes[2*i+1] = (unsigned char)(q >> 8) ;
+    }
+    chunk->min = lo ;
+    chunk->step = step ;
+    return 1 ;
+}
+
+/**
+@brief Compresses one chunk.
+@param MAT The values of the chunk.
+@param n The number of values.
+@param errorBound The absolute error bound, 0 for lossless.
+@param chunk The compressed chunk. Its data is allocated here and freed by the caller.
+@return 1 on success, 0 if zlib failed.
+*/
+static inline int CompressChunk(const float *MAT, size_t n, float errorBound, struct PFZChunk *chunk){
+    unsigned char *plain = (unsigned char*)malloc(4*n);
+    unsigned char *shuffled = (unsigned char*)malloc(4*n);
+    size_t width = 4 ;
+    chunk->mode = PFZ_MODE_LOSSLESS ;
+    chunk->min = 0.0f ;
+    chunk->step = 0.0f ;
+    if(errorBound > 0.0f && QuantizeChunk16(plain, MAT, n, errorBound, chunk)){
+        chunk->mode = PFZ_MODE_QUANT16 ;
+        width = 2 ;
+    }else if(HostIsLittleEndian()){
+        memcpy(plain, MAT, 4*n);
+    }else{
+        SwapBytes32(plain, MAT, n);
+    }
+    ByteShuffle(shuffled, plain, n, width);
+
+    chunk->bytes = compressBound(width*n);
+    chunk->data = (unsigned char*)malloc(chunk->bytes);
+    int ok = compress2(chunk->data, &chunk->bytes, shuffled, width*n, Z_BEST_SPEED) == Z_OK ;
+    free(plain);
+    free(shuffled);
+    return ok ;
+}
+
+/**
+@brief Writes a field to a compressed .pfz file.
+@param OutFileName The name of the file.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+@param MAT The float* data array.
+@param errorBound The absolute error bound, 0 for lossless.
+@param shape The shape of the field, GridShape() for a whole field.
+*/
+static inline void WriteCompressedFile(const char OutFileName[], const char type[], int iter, float* MAT, float errorBound, const struct FieldShape *shape){
+    size_t total = ShapeCells(shape) ;
+    int numChunks = (int)((total + PFZ_CHUNK - 1)/PFZ_CHUNK) ;
+    struct PFZChunk *chunks = (struct PFZChunk*)malloc(sizeof(struct PFZChunk)*numChunks);
+    int ok = 1 ;
+
+    #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+    for(int c = 0 ; c < numChunks ; c++){
+        size_t first = (size_t)c*PFZ_CHUNK ;
+        size_t n = (total - first < PFZ_CHUNK) ? (total - first) : PFZ_CHUNK ;
+        ok = CompressChunk(MAT + first, n, errorBound, &chunks[c]) && ok ;
+    }
+    if(!ok){
+        printf("Error in compressing %s\n", OutFileName);
+        exit(1);
+    }
+
+    unsigned char header[64] ;
+    uint32_t words[7] = {64, (uint32_t)shape->nx, (uint32_t)shape->ny, (uint32_t)shape->nz, PFZ_CHUNK, (uint32_t)numChunks, (uint32_t)iter} ;
+    float spacing[2] = {DX*shape->step, errorBound} ;
+    memset(header, 0, sizeof(header));
+    memcpy(header, PFZ_FILE_MAGIC, 8);
+    memcpy(header+8, words, sizeof(words));
+    memcpy(header+36, spacing, sizeof(spacing));
+    strncpy((char*)header+44, type, 15);
+
+    uint32_t *table = (uint32_t*)malloc(16*numChunks);
+    for(int c = 0 ; c < numChunks ; c++){
+        table[4*c] = chunks[c].mode ;
+        table[4*c+1] = (uint32_t)chunks[c].bytes ;
+        memcpy(&table[4*c+2], &chunks[c].min, 4);
+        memcpy(&table[4*c+3], &chunks[c].step, 4);
+    }
+    if(!HostIsLittleEndian()){
+        SwapBytes32(header+8, header+8, 9);
+        SwapBytes32(table, table, 4*numChunks);
+    }
+
+    FILE *OutFile = OpenOutFile(OutFileName, "wb");
+    ok = fwrite(header, 1, sizeof(header), OutFile) == sizeof(header) ;
+    ok = ok && fwrite(table, 16, numChunks, OutFile) == (size_t)numChunks ;
+    for(int c = 0 ; c < numChunks ; c++){
+        ok = ok && fwrite(chunks[c].data, 1, chunks[c].bytes, OutFile) == chunks[c].bytes ;
+        free(chunks[c].data);
+    }
+    CloseOutFile(OutFile, OutFileName, ok);
+    free(table);
+    free(chunks);
+}
+
+#endif
+//END OF FILE
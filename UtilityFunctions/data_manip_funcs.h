@@ -16,43 +16,68 @@
 #include <CL/cl.h>
 #endif
 
+#include "global_vars.h"
 
 /**
-@brief Initialize a 1D float matrix.
-@param SIZE The size of the matrix. The generated array will be of size SIZE*SIZE.
+@brief Seeds the random number generator of the noise.
+@param seed Any 64 bit value.
+*/
+void SeedRandom(cl_ulong seed){
+    RNGState = seed ;
+}
+
+/**
+@brief A uniform random float from the generator of the noise.
+@return A float in [0,1].
+
+The generator is splitmix64 on the global RNGState. Unlike rand() its whole state is one integer, so checkpoints can save and restore it.
+*/
+float RandomUniform(){
+    cl_ulong z = (RNGState += 0x9E3779B97F4A7C15ULL) ;
+    z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL ;
+    z = (z ^ (z >> 27))*0x94D049BB133111EBULL ;
+    z = z ^ (z >> 31) ;
+    return (float)(z >> 40)/(float)((1 << 24) - 1) ;
+}
+
+/**
+@brief Initialize a 1D float matrix holding a field of the grid.
 @param initVal The value to which the float array should be initialized.
-@return A pointer to the generated float array.
+@return A pointer to the generated float array of FIELD_CELLS floats, NY rows of PITCH floats.
 */
-float *Init1DFloatMatrix(cl_int SIZE, cl_float initVal){
+float *Init1DFloatMatrix(cl_float initVal){
     float *MAT;
-    MAT = (float *)malloc(sizeof(float)*SIZE*SIZE);
-    for(int i=0;i<SIZE*SIZE;i++){
+    MAT = (float *)malloc(sizeof(float)*FIELD_CELLS);
+    for(size_t i=0;i<FIELD_CELLS;i++){
         MAT[i] = initVal;
     }
     return MAT;
 }
 
 /**
-@brief Initialize a 1D float matrix.
-@param SIZE The size of the matrix. The generated array will be of size SIZE*SIZE.
+@brief Initialize a 1D float matrix holding a field of the grid, with other values on the edges.
 @param initVal The value to which the float array should be initialized.
-@return A pointer to the generated float array.
+@param left The value of the left column.
+@param right The value of the right column.
+@param top The value of the top row.
+@param bottom The value of the bottom row.
+@return A pointer to the generated float array of FIELD_CELLS floats. Every plane of a 3D grid gets the same values.
 */
-float *Init1DFloatMatrixWithBoundary(cl_int SIZE, cl_float initVal, cl_float left, cl_float right, cl_float top, cl_float bottom){
+float *Init1DFloatMatrixWithBoundary(cl_float initVal, cl_float left, cl_float right, cl_float top, cl_float bottom){
     float *MAT;
-    MAT = (float *)malloc(sizeof(float)*SIZE*SIZE);
-    for(int i=0;i<SIZE;i++){
-        for(int j=0; j<SIZE;j++){
+    MAT = (float *)malloc(sizeof(float)*FIELD_CELLS);
+    for(int i=0;i<PITCH;i++){
+        for(int j=0; j<NY*NZ;j++){
             if(i==0){
-                MAT[SIZE*j+i]=top;
-            }else if(i==(SIZE-1)){
-                MAT[SIZE*j+i]=bottom;
-            }else if(j==0){
-                MAT[SIZE*j+i]=left;
-            }else if(j==(SIZE-1)){
-                MAT[SIZE*j+i]=right;
+                MAT[PITCH*j+i]=top;
+            }else if(i==(NX-1)){
+                MAT[PITCH*j+i]=bottom;
+            }else if(j%NY==0){
+                MAT[PITCH*j+i]=left;
+            }else if(j%NY==(NY-1)){
+                MAT[PITCH*j+i]=right;
             }else{
-                MAT[SIZE*j+i]=initVal;
+                MAT[PITCH*j+i]=initVal;
             }
         }
     }
@@ -60,65 +85,74 @@ float *Init1DFloatMatrixWithBoundary(cl_int SIZE, cl_float initVal, cl_float lef
 }
 
 /**
-@brief Random initialization of a 1D float matrix.
-@param SIZE The size of the created matrix.
+@brief Random initialization of a 1D float matrix holding a field of the grid.
 @param mean The mean of the random distribution.
 @param noiseAmp The amplitude of the distribution. How much the maximum and the minimum value deviates from the mean.
-@return Pointer to a random flat array.
+@return Pointer to a random flat array of FIELD_CELLS floats.
 
-Random floats are generted using the srand() and rand() C functions.
+Random floats are generted using the srand() and rand() C functions, seeded with the seed of the noise generator. The padding at
+the end of the rows is set to the mean, so the random values of the grid do not depend on PITCH. The values are drawn for every
+cell of the whole grid in the same order, so a block of an MPI process gets the same values as the same cells of a single process run.
 */
-float *RandomInit1DFloatMatrix(cl_int SIZE, cl_float mean, cl_float noiseAmp){
-    srand((unsigned int)time(NULL));
-    float *MAT ; 
-    MAT = (float*)malloc(sizeof(float)*SIZE*SIZE);
-    for(int i=0; i<SIZE*SIZE; i++){
-        if (i==1){
-            printf("mean=%f\n noise=%f\n", mean, noiseAmp);
+float *RandomInit1DFloatMatrix(cl_float mean, cl_float noiseAmp){
+    srand((unsigned int)RNGState);
+    float *MAT = Init1DFloatMatrix(mean) ;
+    printf("mean=%f\n noise=%f\n", mean, noiseAmp);
+    for(int j=0; j<GridNY*NZ; j++){
+        for(int i=0; i<GridNX; i++){
+            float val = mean + 1.0*noiseAmp*( 0.5 - ((float)rand()/(float)RAND_MAX)) ;
+            int x = i - BlockX0, y = j - BlockY0 ;
+            if(x >= 0 && x < NX && y >= 0 && y < NY*NZ){
+                MAT[(size_t)PITCH*y+x] = val ;
+            }
         }
-        MAT[i] = mean + 1.0*noiseAmp*( 0.5 - ((float)rand()/(float)RAND_MAX));
     }
     return MAT ;
 }
 
 /**
-@brief Initialize a 2D array to a square in the center.
-@param MAT The pointer to the array on which a square is to be initialised.
-@param SIZE The size of the MAT array.
+@brief Initialize a 2D array to a square in the center of the grid, a cube on a 3D grid.
+@param MAT The pointer to the array on which a square is to be initialised, FIELD_CELLS floats.
 @param s The size of the square.
 @param val The value to which to initialize.
+
+The center is the center of the whole grid, also in a block of an MPI process.
 */
-void InitCenterSquare(cl_float* MAT, cl_int SIZE, cl_int s, cl_float val){
-    int S = SIZE/2 ;
-    for(int i=0; i<SIZE;i++){
-        for(int j=0; j<SIZE;j++){
-            cl_bool cond =((i-S)<s)&&((S-i)<s)&&((j-S)<s)&&((S-j)<s);
-            if(cond){
-                MAT[j*SIZE+i] = val ;
+void InitCenterSquare(cl_float* MAT, cl_int s, cl_float val){
+    int SX = GridNX/2 - BlockX0, SY = GridNY/2 - BlockY0, SZ = NZ/2 ;
+    for(int k=0; k<NZ;k++){
+        for(int i=0; i<NX;i++){
+            for(int j=0; j<NY;j++){
+                cl_bool cond =((i-SX)<s)&&((SX-i)<s)&&((j-SY)<s)&&((SY-j)<s)&&((k-SZ)<s)&&((SZ-k)<s);
+                if(cond){
+                    MAT[((size_t)k*NY+j)*PITCH+i] = val ;
+                }
             }
         }
     }
 }
 
 /**
-@brief Initialize a 2D array to a circle in the center.
-@param MAT The pointer to the array on which a square is to be initialised.
-@param SIZE The size of the MAT array.
+@brief Initialize a 2D array to a circle in the center of the grid, a sphere on a 3D grid.
+@param MAT The pointer to the array on which a circle is to be initialised, FIELD_CELLS floats.
 @param radius The radius of the circle.
 @param val The value to which to initialize.
+
+The center is the center of the whole grid, also in a block of an MPI process.
 */
-void InitCenterCircle(cl_float* MAT, cl_int SIZE, cl_int radius, cl_float val){
-    int S = SIZE/2 ;
-    for(int i=0; i<SIZE;i++){
-        for(int j=0; j<SIZE;j++){
-            cl_bool cond = ((i-S)*(i-S) + (j-S)*(j-S)) <= (radius*radius) ; 
-            if(cond){
-                MAT[j*SIZE+i] = val ;
+void InitCenterCircle(cl_float* MAT, cl_int radius, cl_float val){
+    int SX = GridNX/2 - BlockX0, SY = GridNY/2 - BlockY0, SZ = NZ/2 ;
+    for(int k=0; k<NZ;k++){
+        for(int i=0; i<NX;i++){
+            for(int j=0; j<NY;j++){
+                cl_bool cond = ((i-SX)*(i-SX) + (j-SY)*(j-SY) + (k-SZ)*(k-SZ)) <= (radius*radius) ; 
+                if(cond){
+                    MAT[((size_t)k*NY+j)*PITCH+i] = val ;
+                }
             }
         }
     }
 }
 
-
 #endif
 //END OF FILE
\ No newline at end of file
@@ -1,6 +1,19 @@
 /**
 @file data_writing_funcs.h
 @brief Declaring the functions needed to write the data buffers to outfiles of various formats. 
+
+The format is chosen by the OutDataFileType variable :
+|Value|Output file type|
+|-----|----------------|
+|0|.csv text, the rows of NX values of all the planes one after the other|
+|1|.vtk legacy ASCII|
+|2|.raw little-endian float32 with a 64 byte header, see WriteRawFile()|
+|3|.vtk legacy BINARY (big-endian float32)|
+|4|.vti XML image data with appended raw float32|
+|5|.pfz chunked zlib compressed float32, lossless or within CompressErrorBound, see data_compress_funcs.h|
+
+The binary formats write each field with a single fwrite. Write1DMatToFile() writes a whole field, WriteFieldToFile() also
+the reduced outputs of output_spec_funcs.h, whose size, origin and spacing are given by a FieldShape.
 */
 
 #ifndef DATA_WRITING
@@ -8,18 +21,270 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/// Magic bytes at the start of a .raw outputfile.
+#define RAW_FILE_MAGIC "PFRAW001"
 
 /**
-@brief Function to write a 1D array to a file.
-Two formats are supported: .csv and .vtk and the formet is chosen from
-the OutDataFileType variable in the inputfile.
-@param OutFileDir Name of the outputfile directory.
+@brief Checks the byte order of the host.
+@return 1 on a little-endian host, 0 on a big-endian host.
+*/
+static inline int HostIsLittleEndian(){
+    const uint32_t one = 1 ;
+    return *(const unsigned char*)&one == 1 ;
+}
+
+/**
+@brief Copies an array of 4 byte words reversing the bytes of each word.
+@param dst The destination array.
+@param src The source array.
+@param n The number of words.
+*/
+static inline void SwapBytes32(void *dst, const void *src, size_t n){
+    const unsigned char *s = (const unsigned char*)src ;
+    unsigned char *d = (unsigned char*)dst ;
+    for(size_t i = 0 ; i < n ; i++){
+        d[4*i] = s[4*i+3] ;
+        d[4*i+1] = s[4*i+2] ;
+        d[4*i+2] = s[4*i+1] ;
+        d[4*i+3] = s[4*i] ;
+    }
+}
+
+/**
+@brief Writes an array of 4 byte words in the requested byte order with a single fwrite.
+@param OutFile The outputfile.
+@param MAT The data array.
+@param n The number of words.
+@param littleEndian 1 to write little-endian, 0 for big-endian.
+@return 1 on success, 0 on a write error.
+*/
+static inline int WriteWords32(FILE *OutFile, const void *MAT, size_t n, int littleEndian){
+    if(littleEndian == HostIsLittleEndian()){
+        return fwrite(MAT, 4, n, OutFile) == n ;
+    }
+    void *swapped = malloc(4*n);
+    if(swapped == NULL){
+        return 0 ;
+    }
+    SwapBytes32(swapped, MAT, n);
+    int ok = fwrite(swapped, 4, n, OutFile) == n ;
+    free(swapped);
+    return ok ;
+}
+
+/**
+@brief Opens an outputfile for writing, exits on failure.
+@param OutFileName The name of the file.
+@param mode The fopen mode, "w" or "wb".
+@return The file handle.
+*/
+static inline FILE* OpenOutFile(const char OutFileName[], const char mode[]){
+    FILE *OutFile = fopen(OutFileName, mode);
+    if(OutFile==NULL){
+        perror("Error in writing to OutputFile\n");
+        exit(1);   
+    }
+    return OutFile ;
+}
+
+/**
+@brief Closes an outputfile, exits if any write to it failed.
+@param OutFile The file handle.
+@param OutFileName The name of the file.
+@param ok 0 if a write failed.
+*/
+static inline void CloseOutFile(FILE *OutFile, const char OutFileName[], int ok){
+    if(fclose(OutFile) != 0 || !ok){
+        printf("Error in writing to OutputFile %s\n", OutFileName);
+        exit(1);
+    }
+}
+
+/**
+@brief The grid part of the names of the output directories.
+@return "<NX>S" for a square grid, "<NX>x<NY>S" for a rectangular one and "<NX>x<NY>x<NZ>S" for a 3D grid, in a static buffer.
+
+The label is the size of the whole grid, also when it is split over MPI processes.
+*/
+static inline const char* GridLabel(){
+    static char label[32] ;
+    if(NZ > 1){
+        snprintf(label, sizeof(label), "%dx%dx%dS", GridNX, GridNY, NZ);
+    }else if(GridNX == GridNY){
+        snprintf(label, sizeof(label), "%dS", GridNX);
+    }else{
+        snprintf(label, sizeof(label), "%dx%dS", GridNX, GridNY);
+    }
+    return label ;
+}
+
+/// The size and the place in the grid of a field written to an outputfile.
+struct FieldShape{
+    /// The number of values along x, y and z.
+    int nx, ny, nz ;
+    /// The cell of the whole grid at the first value.
+    int x0, y0, z0 ;
+    /// The distance between two values in cells of the grid, the decimation factor.
+    int step ;
+};
+
+/**
+@brief The shape of a whole field.
+@return The size of the whole grid, also when it is split over MPI processes.
+*/
+static inline struct FieldShape GridShape(){
+    struct FieldShape shape = {GridNX, GridNY, NZ, 0, 0, 0, 1} ;
+    return shape ;
+}
+
+/**
+@brief The number of values of a field.
+@param shape The shape of the field.
+@return nx*ny*nz .
+*/
+static inline size_t ShapeCells(const struct FieldShape *shape){
+    return (size_t)shape->nx*shape->ny*shape->nz ;
+}
+
+/**
+@brief Fills the 64 byte header of a .raw file, see WriteRawFile().
+@param header The header.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+@param shape The shape of the field, GridShape() for a whole field.
+*/
+static inline void MakeRawHeader(unsigned char header[64], const char type[], int iter, const struct FieldShape *shape){
+    uint32_t words[6] = {64, (uint32_t)shape->nx, (uint32_t)shape->ny, (uint32_t)shape->nz, 4, (uint32_t)iter} ;
+    uint32_t origin[3] = {(uint32_t)shape->x0, (uint32_t)shape->y0, (uint32_t)shape->z0} ;
+    float spacing = DX*shape->step ;
+    memset(header, 0, 64);
+    memcpy(header, RAW_FILE_MAGIC, 8);
+    memcpy(header+8, words, sizeof(words));
+    memcpy(header+32, &spacing, 4);
+    strncpy((char*)header+36, type, 15);
+    memcpy(header+52, origin, sizeof(origin));
+    if(!HostIsLittleEndian()){
+        SwapBytes32(header+8, header+8, 7);
+        SwapBytes32(header+52, header+52, 3);
+    }
+}
+
+/**
+@brief Writes a field to a .raw file, a 64 byte header followed by the little-endian float32 data.
+@param OutFileName The name of the file.
 @param type "PHASE" or "TEMP"
 @param iter The current iteration number.
 @param MAT The float* data array.
+@param shape The shape of the field, GridShape() for a whole field.
+
+The header is made of little-endian 4 byte words :
+|Byte offset|Type|Content|
+|-----------|----|-------|
+|0|char[8]|"PFRAW001"|
+|8|uint32|header size in bytes, 64|
+|12|uint32|NX, the fastest varying dimension|
+|16|uint32|NY|
+|20|uint32|NZ|
+|24|uint32|bytes per value, 4|
+|28|int32|iteration number|
+|32|float32|grid spacing DX, times the decimation factor of a reduced output|
+|36|char[16]|field name, NUL padded|
+|52|uint32[3]|the cell x, y, z of the whole grid at the first value, 0 for a whole field|
+
+The value at (x,y,z) is at byte offset 64 + 4*(NX*(NY*z+y)+x).
 */
-void Write1DMatToFile(const char OutFileDir[], const char type[], int iter, float* MAT){
-    char OutFileName[80] ;
+static inline void WriteRawFile(const char OutFileName[], const char type[], int iter, float* MAT, const struct FieldShape *shape){
+    unsigned char header[64] ;
+    MakeRawHeader(header, type, iter, shape);
+    FILE *OutFile = OpenOutFile(OutFileName, "wb");
+    int ok = fwrite(header, 1, sizeof(header), OutFile) == sizeof(header) ;
+    ok = ok && WriteWords32(OutFile, MAT, ShapeCells(shape), 1);
+    CloseOutFile(OutFile, OutFileName, ok);
+}
+
+/**
+@brief Writes the header of a legacy .vtk file.
+@param OutFile The outputfile.
+@param type "PHASE" or "TEMP"
+@param encoding "ASCII" or "BINARY"
+@param shape The shape of the field, GridShape() for a whole field.
+*/
+static inline void WriteVTKHeader(FILE *OutFile, const char type[], const char encoding[], const struct FieldShape *shape){
+    float spacing = DX*shape->step ;
+    fprintf(OutFile, "# vtk DataFile Version 3.0\n");
+    fprintf(OutFile,"%s_fields\n", type);
+    fprintf(OutFile,"%s\n", encoding);
+    fprintf(OutFile,"DATASET STRUCTURED_POINTS\n");
+    fprintf(OutFile,"DIMENSIONS %d %d %d\n", shape->nx, shape->ny, shape->nz);
+    fprintf(OutFile,"ORIGIN %e %e %e\n", DX*shape->x0, DX*shape->y0, DX*shape->z0);
+    fprintf(OutFile,"SPACING %e %e %e\n", spacing, spacing, (NZ > 1) ? spacing : 1.0f);
+    fprintf(OutFile,"POINT_DATA %lu\n", (unsigned long)ShapeCells(shape));
+    fprintf(OutFile,"SCALARS %s float 1\nLOOKUP_TABLE default\n", type);
+}
+
+/**
+@brief Writes a field to a legacy .vtk file with BINARY data. Legacy VTK binary data is big-endian.
+@param OutFileName The name of the file.
+@param type "PHASE" or "TEMP"
+@param MAT The float* data array.
+@param shape The shape of the field, GridShape() for a whole field.
+*/
+static inline void WriteVTKBinaryFile(const char OutFileName[], const char type[], float* MAT, const struct FieldShape *shape){
+    FILE *OutFile = OpenOutFile(OutFileName, "wb");
+    WriteVTKHeader(OutFile, type, "BINARY", shape);
+    int ok = WriteWords32(OutFile, MAT, ShapeCells(shape), 0);
+    fprintf(OutFile, "\n");
+    CloseOutFile(OutFile, OutFileName, ok);
+}
+
+/**
+@brief Writes a field to an XML .vti image data file with the data appended in raw binary.
+@param OutFileName The name of the file.
+@param type "PHASE" or "TEMP"
+@param MAT The float* data array.
+@param shape The shape of the field, GridShape() for a whole field.
+
+The appended block is the byte count as a UInt64 followed by the float32 data, both in the byte order of the host.
+*/
+static inline void WriteVTIFile(const char OutFileName[], const char type[], float* MAT, const struct FieldShape *shape){
+    FILE *OutFile = OpenOutFile(OutFileName, "wb");
+    uint64_t nbytes = sizeof(float)*(uint64_t)ShapeCells(shape) ;
+    float spacing = DX*shape->step ;
+    fprintf(OutFile, "<?xml version=\"1.0\"?>\n");
+    fprintf(OutFile, "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n", HostIsLittleEndian() ? "LittleEndian" : "BigEndian");
+    fprintf(OutFile, "  <ImageData WholeExtent=\"0 %d 0 %d 0 %d\" Origin=\"%e %e %e\" Spacing=\"%e %e %e\">\n", shape->nx-1, shape->ny-1, shape->nz-1,
+            DX*shape->x0, DX*shape->y0, DX*shape->z0, spacing, spacing, (NZ > 1) ? spacing : 1.0f);
+    fprintf(OutFile, "    <Piece Extent=\"0 %d 0 %d 0 %d\">\n", shape->nx-1, shape->ny-1, shape->nz-1);
+    fprintf(OutFile, "      <PointData Scalars=\"%s\">\n", type);
+    fprintf(OutFile, "        <DataArray type=\"Float32\" Name=\"%s\" format=\"appended\" offset=\"0\"/>\n", type);
+    fprintf(OutFile, "      </PointData>\n");
+    fprintf(OutFile, "    </Piece>\n");
+    fprintf(OutFile, "  </ImageData>\n");
+    fprintf(OutFile, "  <AppendedData encoding=\"raw\">\n_");
+    int ok = fwrite(&nbytes, sizeof(nbytes), 1, OutFile) == 1 ;
+    ok = ok && fwrite(MAT, 1, nbytes, OutFile) == nbytes ;
+    fprintf(OutFile, "\n  </AppendedData>\n</VTKFile>\n");
+    CloseOutFile(OutFile, OutFileName, ok);
+}
+
+// The compressed format uses the byte order helpers above
+#include "data_compress_funcs.h"
+
+/**
+@brief Function to write a field of any shape to a file.
+The format is chosen from the OutDataFileType variable in the inputfile, see the table at the top of this file.
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP", or the name of a reduced output, e.g. "PHASE_ROI0"
+@param iter The current iteration number.
+@param MAT The float* data array of ShapeCells(shape) packed floats, rows of shape->nx values.
+@param shape The shape of the field. The .csv and .pfz files keep its size and spacing but not its origin.
+*/
+void WriteFieldToFile(const char OutFileDir[], const char type[], int iter, float* MAT, const struct FieldShape *shape){
+    char OutFileName[300] ;
+    const int nx = shape->nx ;
     
     // CSV file
     if(OutDataFileType==0){
@@ -30,18 +295,18 @@ void Write1DMatToFile(const char OutFileDir[], const char type[], int iter, floa
             perror("Error in writing to OutputFile\n");
             exit(1);   
         }
-        for(int i=1;i<=SIZE;i++){
+        for(int i=1;i<=nx;i++){
             fprintf(OutFile,"%2.6f",0.0f);
-            if((i%SIZE)!=0){
+            if((i%nx)!=0){
                 fprintf(OutFile,",");    
             }else{
                 fprintf(OutFile,"\n");
 
             }
         }
-        for(int i=1;i<(SIZE*SIZE+1);i++){
+        for(size_t i=1;i<(ShapeCells(shape)+1);i++){
             fprintf(OutFile,"%2.6f",MAT[i-1]);
-            if((i%SIZE)!=0){
+            if((i%nx)!=0){
                 fprintf(OutFile,",");    
             }else{
                 fprintf(OutFile,"\n");
@@ -62,26 +327,59 @@ void Write1DMatToFile(const char OutFileDir[], const char type[], int iter, floa
             perror("Error in writing to OutputFile\n");
             exit(1);   
         }
-        fprintf(OutFile, "# vtk DataFile Version 3.0\n");
-        fprintf(OutFile,"%s_fields\n", type);
-        fprintf(OutFile,"ASCII\n");
-        fprintf(OutFile,"DATASET STRUCTURED_POINTS\n");
-        fprintf(OutFile,"DIMENSIONS %d %d 1\n", SIZE, SIZE);
-        fprintf(OutFile,"ORIGIN 0 0 0\n");
-        fprintf(OutFile,"SPACING %e %e 1.000000e+00\n", DX, DX);
-        fprintf(OutFile,"POINT_DATA %d\n", SIZE*SIZE);
-        fprintf(OutFile,"SCALARS FCC double 1\nLOOKUP_TABLE default\n");
-        for(int i=0; i<SIZE*SIZE;i++){
+        WriteVTKHeader(OutFile, type, "ASCII", shape);
+        for(size_t i=0; i<ShapeCells(shape);i++){
             fprintf(OutFile,"%e\n",MAT[i]);
         }
+        fclose(OutFile) ;
         
     }
     
+    // Raw float32 file
+    else if (OutDataFileType==2){
+        sprintf(OutFileName,"%s/%s_%d.raw",OutFileDir,type, iter);
+        WriteRawFile(OutFileName, type, iter, MAT, shape);
+    }
+    
+    // Binary VTK file
+    else if (OutDataFileType==3){
+        sprintf(OutFileName,"%s/%s_%d.vtk",OutFileDir,type, iter);
+        WriteVTKBinaryFile(OutFileName, type, MAT, shape);
+    }
+    
+    // VTI file
+    else if (OutDataFileType==4){
+        sprintf(OutFileName,"%s/%s_%d.vti",OutFileDir,type, iter);
+        WriteVTIFile(OutFileName, type, MAT, shape);
+    }
+    
+    // Compressed file
+    else if (OutDataFileType==5){
+        sprintf(OutFileName,"%s/%s_%d.pfz",OutFileDir,type, iter);
+        WriteCompressedFile(OutFileName, type, iter, MAT, CompressErrorBound, shape);
+    }
+    
+    else{
+        printf("Unknown OutDataFileType %d\n", OutDataFileType);
+        exit(1);
+    }
     
     // End msg
     printf("   : Completed writing data to file %s\n",OutFileName);
     
 }
 
+/**
+@brief Function to write a whole field to a file, see WriteFieldToFile().
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+@param MAT The float* data array of GRID_CELLS packed floats, rows of NX values.
+*/
+void Write1DMatToFile(const char OutFileDir[], const char type[], int iter, float* MAT){
+    struct FieldShape grid = GridShape() ;
+    WriteFieldToFile(OutFileDir, type, iter, MAT, &grid);
+}
+
 #endif
-//END OF FILE
\ No newline at end of file
+//END OF FILE
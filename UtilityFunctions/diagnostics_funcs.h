@@ -0,0 +1,250 @@
+/**
+@file diagnostics_funcs.h
+@brief Declares the scalar diagnostics of the fields, sampled every DiagnosticsEvery iterations into a time series file of the run.
+
+A sample holds, for every field of the system, the diagnostics selected with Diagnostics in the input file:
+|Name|Diagnostic|Fields|
+|----|----------|------|
+|mean|The mean of the field, e.g. the mean concentration|all|
+|min|The smallest value, e.g. the lowest temperature|all|
+|max|The largest value|all|
+|frac|The fraction of the cells above 0.5, e.g. the solid fraction|the first (the phase)|
+|interface|The length, or on a 3D grid the area, of the 0.5 contour, counted on the cell faces|the first (the phase)|
+
+On the OpenCL backend every field is reduced on the device with diagnostics_kern of ReduceKern.cl and only its
+REDUCE_GROUPS partial results are read back, without blocking. A sample is written to the file when the next one is
+enqueued, so the host waits for the device one sample late at most. The CPU backend reduces the host arrays with OpenMP.
+The rows of <OutputDir>/diagnostics.csv are the number of iterations done, the simulated time 2*iteration*DT and the diagnostics.
+An adaptive run (see adaptive_dt_funcs.h) samples every DiagnosticsEvery of its own iterations and writes the simulated time of its clock.
+The first row is the initial field; a restarted run appends its rows to the file of the first run.
+*/
+
+#ifndef DIAGNOSTICS_FUNCS
+#define DIAGNOSTICS_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "reduce_funcs.h"
+#include "trace_funcs.h"
+
+/// The largest number of fields of a system.
+#define DIAGNOSTICS_MAX_FIELDS 2
+
+/// The time series of the diagnostics of a run.
+struct Diagnostics{
+    /// The output file, NULL if DiagnosticsEvery is 0.
+    FILE *File ;
+    /// The number of fields.
+    int numFields ;
+    /// The selected diagnostics, one bit per name of DIAGNOSTIC_NAMES.
+    cl_int mask ;
+    /// The device reductions of the fields, unused on the CPU backend.
+    struct DeviceReduction red[DIAGNOSTICS_MAX_FIELDS] ;
+    /// The iteration of the sample waiting in each slot of the reductions, -1 if none, and its simulated time.
+    int pending[2] ;
+    double pendingTime[2] ;
+    /// The slot of the next sample.
+    int slot ;
+};
+
+/**
+@brief Checks whether a sample of the diagnostics is due after an iteration.
+@param iter The iteration just completed.
+@return 1 if a sample is to be taken.
+*/
+static inline int DiagnosticsDue(int iter){
+    return (DiagnosticsEvery > 0) && ((iter+1)%DiagnosticsEvery == 0) ;
+}
+
+/**
+@brief Checks whether a diagnostic is written for a field.
+@param d The time series.
+@param k The diagnostic, its index in DIAGNOSTIC_NAMES.
+@param f The field.
+@return 1 if the diagnostic is selected and applies to the field: mean, min and max apply to every field, frac and interface to the phase.
+*/
+static inline int DiagnosticWritten(const struct Diagnostics *d, int k, int f){
+    return (d->mask & (1 << k)) && (f == 0 || k < 3) ;
+}
+
+/**
+@brief Opens the time series of a run and writes its header.
+@param OutFileDir The output directory of the run.
+@param Names The names of the fields, the first one is the phase.
+@param numFields The number of fields, at most DIAGNOSTICS_MAX_FIELDS.
+@return The time series, with no file if DiagnosticsEvery is 0. Close it with StopDiagnostics().
+*/
+struct Diagnostics StartDiagnostics(const char OutFileDir[], const char *Names[], int numFields){
+    struct Diagnostics d ;
+    d.File = NULL ;
+    d.numFields = numFields ;
+    d.mask = (DiagnosticsMask != 0) ? DiagnosticsMask : (1 << NUM_DIAGNOSTICS) - 1 ;
+    d.pending[0] = d.pending[1] = -1 ;
+    d.slot = 0 ;
+    if(DiagnosticsEvery <= 0){
+        return d ;
+    }
+
+    char FileName[256] ;
+    sprintf(FileName, "%s/diagnostics.csv", OutFileDir);
+    d.File = fopen(FileName, (StartIter > 0) ? "a" : "w");
+    if(d.File == NULL){
+        printf("Error: cannot open the diagnostics file %s\n", FileName);
+        exit(1);
+    }
+    if(StartIter == 0){
+        const char *Diag[NUM_DIAGNOSTICS] = DIAGNOSTIC_NAMES ;
+        fprintf(d.File, "iteration,time");
+        for(int f = 0 ; f < numFields ; f++){
+            for(int k = 0 ; k < NUM_DIAGNOSTICS ; k++){
+                if(DiagnosticWritten(&d, k, f)){
+                    fprintf(d.File, ",%s_%s", Names[f], Diag[k]);
+                }
+            }
+        }
+        fprintf(d.File, "\n");
+    }
+    if(Backend == BACKEND_OPENCL){
+        for(int f = 0 ; f < numFields ; f++){
+            d.red[f] = CreateDeviceReduction("diagnostics_kern", NUM_DIAGNOSTICS);
+        }
+    }
+    printf("   : Diagnostics every %d iterations in %s\n", DiagnosticsEvery, FileName);
+    return d ;
+}
+
+/**
+@brief Writes a row of the time series.
+@param d The time series.
+@param iter The number of iterations done.
+@param time The simulated time.
+@param values The results of diagnostics_kern for every field, NUM_DIAGNOSTICS doubles each.
+*/
+static void WriteDiagnosticsRow(struct Diagnostics *d, int iter, double time, const double values[]){
+    const double cells = (double)GRID_CELLS ;
+    const double face = (NZ > 1) ? (double)DX*DX : (double)DX ;
+    fprintf(d->File, "%d,%g", iter, time);
+    for(int f = 0 ; f < d->numFields ; f++){
+        const double *v = values + NUM_DIAGNOSTICS*f ;
+        const double diag[NUM_DIAGNOSTICS] = {v[0]/cells, v[1], v[2], v[3]/cells, v[4]*face} ;
+        for(int k = 0 ; k < NUM_DIAGNOSTICS ; k++){
+            if(DiagnosticWritten(d, k, f)){
+                fprintf(d->File, ",%.8g", diag[k]);
+            }
+        }
+    }
+    fprintf(d->File, "\n");
+}
+
+/**
+@brief Waits for the sample of a slot and writes it.
+@param d The time series.
+@param slot The slot.
+*/
+static void FlushDiagnosticsSlot(struct Diagnostics *d, int slot){
+    static const int ops[NUM_DIAGNOSTICS] = {REDUCE_SUM, REDUCE_MIN, REDUCE_MAX, REDUCE_SUM, REDUCE_SUM} ;
+    double values[NUM_DIAGNOSTICS*DIAGNOSTICS_MAX_FIELDS] ;
+    if(d->pending[slot] < 0){
+        return ;
+    }
+    for(int f = 0 ; f < d->numFields ; f++){
+        WaitDeviceReduction(&d->red[f], slot, ops, values + NUM_DIAGNOSTICS*f);
+    }
+    WriteDiagnosticsRow(d, d->pending[slot], d->pendingTime[slot], values);
+    d->pending[slot] = -1 ;
+}
+
+/**
+@brief Samples the diagnostics of device fields at a simulated time.
+@param d The time series.
+@param fields The device fields, in the order of the names given to StartDiagnostics().
+@param iter The number of iterations done.
+@param time The simulated time.
+
+The reductions are enqueued into the slot of the sample, then the sample before, in the other slot, is written.
+*/
+void SampleDiagnosticsAt(struct Diagnostics *d, const cl_mem fields[], int iter, double time){
+    if(d->File == NULL){
+        return ;
+    }
+    for(int f = 0 ; f < d->numFields ; f++){
+        EnqueueDeviceReduction(&d->red[f], d->slot, &fields[f], 1);
+    }
+    clFlush(queue);
+    d->pending[d->slot] = iter ;
+    d->pendingTime[d->slot] = time ;
+    d->slot = 1 - d->slot ;
+    FlushDiagnosticsSlot(d, d->slot);
+}
+
+/**
+@brief Samples the diagnostics of device fields.
+@param d The time series.
+@param fields The device fields, in the order of the names given to StartDiagnostics().
+@param iter The number of iterations done, at the simulated time 2*iter*DT.
+*/
+void SampleDiagnostics(struct Diagnostics *d, const cl_mem fields[], int iter){
+    SampleDiagnosticsAt(d, fields, iter, 2.0*iter*DT);
+}
+
+/**
+@brief Samples the diagnostics of host fields at a simulated time, on the CPU backend.
+@param d The time series.
+@param fields The host fields, in the order of the names given to StartDiagnostics().
+@param iter The number of iterations done.
+@param time The simulated time.
+*/
+void SampleDiagnosticsCPUAt(struct Diagnostics *d, const float *fields[], int iter, double time){
+    double values[NUM_DIAGNOSTICS*DIAGNOSTICS_MAX_FIELDS] ;
+    if(d->File == NULL){
+        return ;
+    }
+    TRACE_SPAN_BEGIN(diag);
+    for(int f = 0 ; f < d->numFields ; f++){
+        CPUDiagnostics(fields[f], values + NUM_DIAGNOSTICS*f);
+    }
+    TRACE_SPAN_END(diag, "CPUDiagnostics", "cpu");
+    WriteDiagnosticsRow(d, iter, time, values);
+}
+
+/**
+@brief Samples the diagnostics of host fields, on the CPU backend.
+@param d The time series.
+@param fields The host fields, in the order of the names given to StartDiagnostics().
+@param iter The number of iterations done, at the simulated time 2*iter*DT.
+*/
+void SampleDiagnosticsCPU(struct Diagnostics *d, const float *fields[], int iter){
+    SampleDiagnosticsCPUAt(d, fields, iter, 2.0*iter*DT);
+}
+
+/**
+@brief Writes the samples still waiting on the device and closes the time series.
+@param d The time series made by StartDiagnostics().
+*/
+void StopDiagnostics(struct Diagnostics *d){
+    if(d->File == NULL){
+        return ;
+    }
+    if(Backend == BACKEND_OPENCL){
+        FlushDiagnosticsSlot(d, d->slot);
+        FlushDiagnosticsSlot(d, 1 - d->slot);
+        for(int f = 0 ; f < d->numFields ; f++){
+            ReleaseDeviceReduction(&d->red[f]);
+        }
+    }
+    fclose(d->File);
+    d->File = NULL ;
+}
+
+#endif
+// END OF FILE
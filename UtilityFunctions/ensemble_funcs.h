@@ -0,0 +1,487 @@
+/**
+@file ensemble_funcs.h
+@brief Declares the ensemble mode: many replicas of a system, each with its own parameters, advanced by one kernel launch per step.
+
+`mainfile --system <name> --ensemble <file>` reads the input file as usual and then the ensemble file, one replica per line.
+A replica line lists KEY=value pairs with the keys of the input file, the parameters it does not list keep their input file values :
+\code
+## KAPPA and MOBILITY sweep
+KAPPA=0.2 MOBILITY=0.5
+KAPPA=0.4 MOBILITY=0.5
+KAPPA=0.4
+\endcode
+The replicas are stacked along the third dimension of the NDRange. Their fields lie one after the other in the data buffers
+and their kernel parameters in a __constant array, so one launch advances the whole sweep. NX, NY, DX, DT, ITERS and the
+output settings are common to all the replicas. Replica r writes its outputfiles to <output directory>/replica_<r>, with
+a params.in file that holds its parameters in the input file format.
+
+|System|Kernel|Parameters that vary per replica|
+|------|------|--------------------------------|
+|CAHNHILLIARD|ch_ensemble_kern|MOBILITY, KAPPA, and MEAN_CONCENTRATION, NOISE_AMP of the initial field|
+|KOBANISO|phase_field_evol_ensemble_kern|all the system parameters|
+
+The replicas share the random numbers of the initial field and of the noise, so they differ only by their parameters.
+Ensembles run on the OpenCL backend and do not write checkpoints.
+*/
+
+#ifndef ENSEMBLE_FUNCS
+#define ENSEMBLE_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "file_to_program.h"
+#include "data_manip_funcs.h"
+#include "iterate_kernels.h"
+#include "output_writer.h"
+#include "trace_funcs.h"
+
+/// A cl_float input parameter that may vary between the replicas of an ensemble.
+struct EnsembleParam{
+    /// The key of the input file.
+    const char *key ;
+    /// The offset of the member in the input parameters struct.
+    size_t offset ;
+};
+
+/// The replicas of an ensemble run.
+struct Ensemble{
+    /// Number of replicas.
+    int numReplicas ;
+    /// The input parameters structs of the replicas, one after the other.
+    void *params ;
+    /// The size of one input parameters struct.
+    size_t paramsBytes ;
+};
+
+/// Cahn-Hilliard parameters that vary per replica.
+static const struct EnsembleParam CahnHilliardEnsembleParams[] = {
+    {"MEAN_CONCENTRATION", offsetof(struct CahnHilliardInputParams, MEAN_C)},
+    {"NOISE_AMP", offsetof(struct CahnHilliardInputParams, NOISE_AMP)},
+    {"KAPPA", offsetof(struct CahnHilliardInputParams, KAPPA)},
+    {"MOBILITY", offsetof(struct CahnHilliardInputParams, MOBILITY)},
+};
+
+/// Kobayashi anisotropic parameters that vary per replica.
+static const struct EnsembleParam KobayashiAnisoEnsembleParams[] = {
+    {"EPS_BAR", offsetof(struct KobAnisoInputParams, EPS_BAR)},
+    {"ALPHA", offsetof(struct KobAnisoInputParams, ALPHA)},
+    {"GAMMA", offsetof(struct KobAnisoInputParams, GAMMA)},
+    {"DELTA", offsetof(struct KobAnisoInputParams, DELTA)},
+    {"J", offsetof(struct KobAnisoInputParams, J)},
+    {"TAU", offsetof(struct KobAnisoInputParams, TAU)},
+    {"THETA0", offsetof(struct KobAnisoInputParams, THETA0)},
+    {"NOISE_AMP", offsetof(struct KobAnisoInputParams, NOISE_AMP)},
+    {"THERMAL_DIFFUSIVITY", offsetof(struct KobAnisoInputParams, TH_DIFF)},
+    {"LATENT_HEAT_SLD", offsetof(struct KobAnisoInputParams, L_HEAT)},
+    {"TEMP_INIT", offsetof(struct KobAnisoInputParams, T_INIT)},
+    {"TEMP_MELT", offsetof(struct KobAnisoInputParams, T_MELT)},
+    {"TEMP_BOUND", offsetof(struct KobAnisoInputParams, T_BOUND)},
+};
+
+/// Number of entries of an EnsembleParam table.
+#define NUM_ENSEMBLE_PARAMS(table) ((int)(sizeof(table)/sizeof(table[0])))
+
+/**
+@brief Gives the input parameters struct of a replica.
+@param ens The ensemble.
+@param r The replica.
+@return A pointer to the struct.
+*/
+static inline void* ReplicaParams(const struct Ensemble *ens, int r){
+    return (char*)ens->params + ens->paramsBytes*r ;
+}
+
+/**
+@brief Reads an ensemble file.
+@param FileName The ensemble file, one replica per line.
+@param baseParams The input parameters read from the input file, the defaults of every replica.
+@param paramsBytes The size of the input parameters struct.
+@param table The parameters that may vary.
+@param numTable The number of entries of table.
+@return The ensemble. The program exits on an unknown key or an empty file.
+*/
+struct Ensemble ReadEnsembleFile(const char FileName[], const void *baseParams, size_t paramsBytes, const struct EnsembleParam table[], int numTable){
+    FILE *FileHandle = fopen(FileName, "rt");
+    if(FileHandle == NULL){
+        printf("Error: ensemble file %s not found\n", FileName);
+        exit(1);
+    }
+    struct Ensemble ens = {0, NULL, paramsBytes} ;
+    int capacity = 0 ;
+    char line[4096] ;
+    while(fgets(line, sizeof(line), FileHandle)){
+        char *comment = strchr(line, '#');
+        if(comment != NULL){
+            *comment = '\0' ;
+        }
+        char *token = strtok(line, " \t\r\n;");
+        if(token == NULL){
+            continue ;
+        }
+        if(ens.numReplicas == capacity){
+            capacity = (capacity == 0) ? 16 : 2*capacity ;
+            ens.params = realloc(ens.params, paramsBytes*capacity);
+        }
+        void *replica = ReplicaParams(&ens, ens.numReplicas) ;
+        memcpy(replica, baseParams, paramsBytes);
+        for( ; token != NULL ; token = strtok(NULL, " \t\r\n;")){
+            char *value = strchr(token, '=');
+            int k = 0 ;
+            if(value != NULL){
+                *value++ = '\0' ;
+                while(k < numTable && strcmp(table[k].key, token) != 0){
+                    k++ ;
+                }
+            }
+            if(value == NULL || k == numTable){
+                printf("Error: replica %d of %s sets %s, which is not an ensemble parameter of the system\n", ens.numReplicas, FileName, token);
+                exit(1);
+            }
+            *(cl_float*)((char*)replica + table[k].offset) = atof(value) ;
+        }
+        ens.numReplicas++ ;
+    }
+    fclose(FileHandle);
+    if(ens.numReplicas == 0){
+        printf("Error: no replicas in the ensemble file %s\n", FileName);
+        exit(1);
+    }
+    printf("   : Ensemble of %d replicas from %s\n", ens.numReplicas, FileName);
+    return ens ;
+}
+
+/**
+@brief Creates the outputfile directories of the replicas and writes their parameters.
+@param OutFileDirs The directory of each replica, 256 chars each.
+@param baseDir The output directory of the ensemble.
+@param ens The ensemble.
+@param table The parameters that may vary.
+@param numTable The number of entries of table.
+*/
+void MakeReplicaDirs(char OutFileDirs[][256], const char baseDir[], const struct Ensemble *ens, const struct EnsembleParam table[], int numTable){
+    mkdir(baseDir, 0777);
+    for(int r = 0 ; r < ens->numReplicas ; r++){
+        snprintf(OutFileDirs[r], 256, "%s/replica_%03d", baseDir, r);
+        mkdir(OutFileDirs[r], 0777);
+
+        char FileName[300] ;
+        snprintf(FileName, sizeof(FileName), "%s/params.in", OutFileDirs[r]);
+        FILE *File = fopen(FileName, "w");
+        if(File == NULL){
+            perror("Error in writing the replica parameters\n");
+            exit(1);
+        }
+        fprintf(File, "## Parameters of replica %d\n", r);
+        for(int k = 0 ; k < numTable ; k++){
+            fprintf(File, "%s = %f ;\n", table[k].key, *(const cl_float*)((const char*)ReplicaParams(ens, r) + table[k].offset));
+        }
+        fclose(File);
+    }
+}
+
+/**
+@brief Creates the __constant buffer of the kernel parameters of the replicas.
+@param values The parameters, perReplica floats for each replica.
+@param numReplicas The number of replicas.
+@param perReplica The number of parameters of a replica.
+@return The buffer.
+*/
+cl_mem CreateEnsembleParamsBuffer(cl_float *values, int numReplicas, int perReplica){
+    cl_int err ;
+    cl_ulong maxConstant = 0 ;
+    size_t bytes = sizeof(cl_float)*perReplica*numReplicas ;
+    clGetDeviceInfo(devices[devID], CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(maxConstant), &maxConstant, NULL);
+    if(bytes > maxConstant){
+        printf("Error: the parameters of %d replicas need %zu bytes of constant memory, the device has %lu\n", numReplicas, bytes, (unsigned long)maxConstant);
+        exit(1);
+    }
+    cl_mem buff = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, values, &err);
+    ErrorHandle(err, "clCreateBuffer ensemble parameters");
+    return buff ;
+}
+
+/**
+@brief Creates the device buffer of the fields of all the replicas, in the precision of the device fields.
+@param MAT The host array, numReplicas*FIELD_CELLS floats.
+@param numReplicas The number of replicas.
+@param name The name printed by ErrorHandle().
+@return The buffer.
+*/
+static cl_mem CreateEnsembleFieldBuffer(float *MAT, int numReplicas, char name[]){
+    return CreateFieldBuffer(MAT, FIELD_CELLS*numReplicas, name);
+}
+
+/**
+@brief Initialize the Cahn-Hilliard data buffers of an ensemble.
+@param ens The ensemble of CahnHilliardInputParams.
+@return A CahnHilliardDataBuffers struct whose fields hold all the replicas. InBracM is not used.
+*/
+struct CahnHilliardDataBuffers initCahnHilliardEnsembleBuffers(const struct Ensemble *ens){
+    struct CahnHilliardDataBuffers dataBuffers ;
+    size_t cells = FIELD_CELLS ;
+    dataBuffers.PHASE1 = (float*)malloc(sizeof(float)*cells*ens->numReplicas);
+    dataBuffers.PHASE2 = (float*)malloc(sizeof(float)*cells*ens->numReplicas);
+    for(int r = 0 ; r < ens->numReplicas ; r++){
+        const struct CahnHilliardInputParams *p = (const struct CahnHilliardInputParams*)ReplicaParams(ens, r) ;
+        float *init = RandomInit1DFloatMatrix(p->MEAN_C, p->NOISE_AMP);
+        memcpy(dataBuffers.PHASE1 + cells*r, init, sizeof(float)*cells);
+        free(init);
+    }
+    memset(dataBuffers.PHASE2, 0, sizeof(float)*cells*ens->numReplicas);
+    dataBuffers.InBracM = NULL ;
+    dataBuffers.InBracMbuff = NULL ;
+    dataBuffers.PHASE1buff = CreateEnsembleFieldBuffer(dataBuffers.PHASE1, ens->numReplicas, "clCreateBuffer PHASE1");
+    dataBuffers.PHASE2buff = CreateEnsembleFieldBuffer(dataBuffers.PHASE2, ens->numReplicas, "clCreateBuffer PHASE2");
+    return dataBuffers ;
+}
+
+/**
+@brief Initialize the Kobayashi anisotropic data buffers of an ensemble.
+@param ens The ensemble of KobAnisoInputParams.
+@return A KobAnisoDataBuffers struct whose fields hold all the replicas.
+*/
+struct KobAnisoDataBuffers initKobayashiAnisoEnsembleBuffers(const struct Ensemble *ens){
+    struct KobAnisoDataBuffers dataBuffers ;
+    size_t cells = FIELD_CELLS ;
+    dataBuffers.PHASE1 = (float*)malloc(sizeof(float)*cells*ens->numReplicas);
+    dataBuffers.PHASE2 = (float*)malloc(sizeof(float)*cells*ens->numReplicas);
+    dataBuffers.TEMP1 = (float*)malloc(sizeof(float)*cells*ens->numReplicas);
+    dataBuffers.TEMP2 = (float*)malloc(sizeof(float)*cells*ens->numReplicas);
+    for(int r = 0 ; r < ens->numReplicas ; r++){
+        const struct KobAnisoInputParams *p = (const struct KobAnisoInputParams*)ReplicaParams(ens, r) ;
+        float *phase = dataBuffers.PHASE1 + cells*r ;
+        float *temp = dataBuffers.TEMP1 + cells*r ;
+        for(size_t i = 0 ; i < cells ; i++){
+            phase[i] = 1.0f ;
+            temp[i] = p->T_INIT ;
+        }
+        InitCenterCircle(phase, GRID_MIN_SIDE/32, 0.0);
+        InitCenterCircle(temp, GRID_MIN_SIDE/32, p->T_BOUND);
+    }
+    memcpy(dataBuffers.PHASE2, dataBuffers.PHASE1, sizeof(float)*cells*ens->numReplicas);
+    memcpy(dataBuffers.TEMP2, dataBuffers.TEMP1, sizeof(float)*cells*ens->numReplicas);
+    dataBuffers.PHASE1buff = CreateEnsembleFieldBuffer(dataBuffers.PHASE1, ens->numReplicas, "clCreateBuffer PHASE1");
+    dataBuffers.PHASE2buff = CreateEnsembleFieldBuffer(dataBuffers.PHASE2, ens->numReplicas, "clCreateBuffer PHASE2");
+    dataBuffers.TEMP1buff = CreateEnsembleFieldBuffer(dataBuffers.TEMP1, ens->numReplicas, "clCreateBuffer TEMP1");
+    dataBuffers.TEMP2buff = CreateEnsembleFieldBuffer(dataBuffers.TEMP2, ens->numReplicas, "clCreateBuffer TEMP2");
+    return dataBuffers ;
+}
+
+/**
+@brief One step of evolution of a Cahn-Hilliard ensemble.
+@param ensKern The ch_ensemble_kern kernel.
+@param globalWS An array with the 3D global work size, the third dimension is the number of replicas.
+@param localWS An array with the 3D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param paramsBuff The parameters of the replicas.
+*/
+static inline void CahnHilliardEnsembleStep(cl_kernel ensKern, size_t globalWS[3], size_t localWS[3], cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem paramsBuff){
+    cl_int err ;
+    err = clSetKernelArg(ensKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(ensKern, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(ensKern, 2, sizeof(cl_mem), &paramsBuff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(ensKern, 3, RealBytes()*(localWS[0]+4)*(localWS[1]+4), NULL);
+    KernErrorHandle(err,"SetKernelArg 3");
+    err = clSetKernelArg(ensKern, 4, RealBytes()*(localWS[0]+2)*(localWS[1]+2), NULL);
+    KernErrorHandle(err,"SetKernelArg 4");
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, ensKern, 3, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel EnsembleKern");
+    TRACE_CL_KERNEL(event, ensKern);
+}
+
+/**
+@brief A function to fully iterate a Cahn-Hilliard ensemble.
+@param ens The ensemble of CahnHilliardInputParams.
+@param databuffers The data buffers from initCahnHilliardEnsembleBuffers().
+*/
+static inline void iterateCahnHilliardEnsembleKernel(const struct Ensemble *ens, struct CahnHilliardDataBuffers databuffers){
+    int N = ens->numReplicas ;
+    cl_kernel ensKern = getKernelFromProgram("ch_ensemble_kern");
+    if(WGsize < 8){
+        WGsize = GetOptimumWGSize(ensKern, devices[devID]) ;
+    }
+    size_t localWS[3] = {WGsize, WGsize, 1};
+    size_t globalWS[3] = {0, 0, N};
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %d\n", WGsize);
+
+    // MOBILITY, KAPPA of each replica, in the order of ch_ensemble_kern
+    cl_float *values = (cl_float*)malloc(sizeof(cl_float)*2*N);
+    for(int r = 0 ; r < N ; r++){
+        const struct CahnHilliardInputParams *p = (const struct CahnHilliardInputParams*)ReplicaParams(ens, r) ;
+        values[2*r] = p->MOBILITY ;
+        values[2*r+1] = p->KAPPA ;
+    }
+    cl_mem paramsBuff = CreateEnsembleParamsBuffer(values, N, 2);
+    free(values);
+
+    char OutFileDir[128] ;
+    snprintf(OutFileDir,sizeof(OutFileDir),"./OutDataFiles/CAHN_HILLIARD_ENS%d_%s_%dITERS",N,GridLabel(),ITERS);
+    char (*OutFileDirs)[256] = malloc(sizeof(*OutFileDirs)*N);
+    MakeReplicaDirs(OutFileDirs, OutFileDir, ens, CahnHilliardEnsembleParams, NUM_ENSEMBLE_PARAMS(CahnHilliardEnsembleParams));
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS*N);
+
+    cl_float tot_exec_time = 0.0f;
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = 0 ; iter < ITERS ; iter++){
+        CahnHilliardEnsembleStep(ensKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, paramsBuff);
+        CahnHilliardEnsembleStep(ensKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, paramsBuff);
+
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
+
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            for(int r = 0 ; r < N ; r++){
+                SaveBufferSliceAsync(databuffers.PHASE1buff, r, OutFileDirs[r], "PHASE", iter);
+            }
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
+        }
+    }
+
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    printf("   : %.2f MLUPS\n", MLUPS((size_t)NX*NY*N, 2.0*ITERS, tot_exec_time));
+    for(int r = 0 ; r < N ; r++){
+        SaveBufferSliceAsync(databuffers.PHASE1buff, r, OutFileDirs[r], "PHASE", ITERS);
+    }
+    clReleaseMemObject(paramsBuff);
+    free(OutFileDirs);
+}
+
+/**
+@brief One step of evolution of a Kobayashi anisotropic ensemble.
+@param ensKern The phase_field_evol_ensemble_kern kernel.
+@param globalWS An array with the 3D global work size, the third dimension is the number of replicas.
+@param localWS An array with the 3D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param TEMP1buff The input temperature buffer.
+@param TEMP2buff The output temperature buffer.
+@param noise The random number of the step, scaled by the NOISE_AMP of each replica.
+@param paramsBuff The parameters of the replicas.
+*/
+static inline void KobayashiEnsembleStep(cl_kernel ensKern, size_t globalWS[3], size_t localWS[3], cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem TEMP1buff, cl_mem TEMP2buff, cl_float noise, cl_mem paramsBuff){
+    cl_int err ;
+    size_t haloCells = (localWS[0]+2)*(localWS[1]+2);
+    err = clSetKernelArg(ensKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(ensKern, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(ensKern, 2, sizeof(cl_mem), &TEMP1buff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(ensKern, 3, sizeof(cl_mem), &TEMP2buff);
+    KernErrorHandle(err,"SetKernelArg 3");
+    err = clSetKernelArg(ensKern, 4, sizeof(cl_float), &noise);
+    KernErrorHandle(err,"SetKernelArg 4");
+    err = clSetKernelArg(ensKern, 5, sizeof(cl_mem), &paramsBuff);
+    KernErrorHandle(err,"SetKernelArg 5");
+    err = clSetKernelArg(ensKern, 6, RealBytes()*(localWS[0]+4)*(localWS[1]+4), NULL);
+    KernErrorHandle(err,"SetKernelArg 6");
+    err = clSetKernelArg(ensKern, 7, RealBytes()*haloCells, NULL);
+    KernErrorHandle(err,"SetKernelArg 7");
+    err = clSetKernelArg(ensKern, 8, RealBytes()*4*haloCells, NULL);
+    KernErrorHandle(err,"SetKernelArg 8");
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, ensKern, 3, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel EnsembleKern");
+    TRACE_CL_KERNEL(event, ensKern);
+}
+
+/**
+@brief A function to fully iterate a Kobayashi anisotropic ensemble.
+@param ens The ensemble of KobAnisoInputParams.
+@param databuffers The data buffers from initKobayashiAnisoEnsembleBuffers().
+*/
+static inline void iterateKobayashiAnisoEnsembleKernel(const struct Ensemble *ens, struct KobAnisoDataBuffers databuffers){
+    int N = ens->numReplicas ;
+    cl_kernel ensKern = getKernelFromProgram("phase_field_evol_ensemble_kern");
+    if(WGsize < 8){
+        WGsize = GetOptimumWGSize(ensKern, devices[devID]) ;
+    }
+    size_t localWS[3] = {WGsize, WGsize, 1};
+    size_t globalWS[3] = {0, 0, N};
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %d\n", WGsize);
+
+    // The parameters of each replica, in the order of phase_field_evol_ensemble_kern
+    cl_float *values = (cl_float*)malloc(sizeof(cl_float)*11*N);
+    for(int r = 0 ; r < N ; r++){
+        const struct KobAnisoInputParams *p = (const struct KobAnisoInputParams*)ReplicaParams(ens, r) ;
+        cl_float replica[11] = {p->EPS_BAR, p->ALPHA, p->GAMMA, p->DELTA, p->TAU, p->THETA0, p->J, p->TH_DIFF, p->L_HEAT, p->T_MELT, p->NOISE_AMP} ;
+        memcpy(values + 11*r, replica, sizeof(replica));
+    }
+    cl_mem paramsBuff = CreateEnsembleParamsBuffer(values, N, 11);
+    free(values);
+
+    char OutFileDir[128] ;
+    snprintf(OutFileDir,sizeof(OutFileDir),"./OutDataFiles/KOB_ANISO_ENS%d_%s_%dITERS",N,GridLabel(),ITERS);
+    char (*OutFileDirs)[256] = malloc(sizeof(*OutFileDirs)*N);
+    MakeReplicaDirs(OutFileDirs, OutFileDir, ens, KobayashiAnisoEnsembleParams, NUM_ENSEMBLE_PARAMS(KobayashiAnisoEnsembleParams));
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS*N);
+
+    // random noise, the same random number for every replica
+    cl_float noise ;
+    cl_float tot_exec_time = 0.0f;
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = 0 ; iter < ITERS ; iter++){
+        if((iter%50)==0){
+            noise = RandomUniform()-0.5 ;
+        }else{
+            noise = 0.0 ;
+        }
+        KobayashiEnsembleStep(ensKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, paramsBuff);
+        KobayashiEnsembleStep(ensKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, paramsBuff);
+
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
+
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            for(int r = 0 ; r < N ; r++){
+                SaveBufferSliceAsync(databuffers.PHASE1buff, r, OutFileDirs[r], "PHASE", iter);
+                SaveBufferSliceAsync(databuffers.TEMP1buff, r, OutFileDirs[r], "TEMP", iter);
+            }
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+        }
+    }
+
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    for(int r = 0 ; r < N ; r++){
+        SaveBufferSliceAsync(databuffers.PHASE1buff, r, OutFileDirs[r], "PHASE", ITERS);
+        SaveBufferSliceAsync(databuffers.TEMP1buff, r, OutFileDirs[r], "TEMP", ITERS);
+    }
+    printf("   : %.2f MLUPS\n", MLUPS((size_t)NX*NY*N, 2.0*ITERS, tot_exec_time));
+    clReleaseMemObject(paramsBuff);
+    free(OutFileDirs);
+}
+
+#endif
+// END OF FILE
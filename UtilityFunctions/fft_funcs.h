@@ -0,0 +1,189 @@
+/**
+@file fft_funcs.h
+@brief Declares the 2D fast Fourier transforms of the spectral solver, see spectral_funcs.h .
+
+The transforms are radix-2, so both sides of the grid have to be powers of two. A complex field is NX*NY interleaved
+(real, imaginary) pairs, row after row without the padding of the pitch.
+|Backend|Transform|
+|-------|---------|
+|BACKEND_CPU|FFT2D(): in-place iterative FFTs of the rows, then of the columns gathered into a scratch line, the lines run on OpenMP threads|
+|BACKEND_OPENCL|EnqueueFFT2D(): log2(NX) stages of fft_rows_kern and log2(NY) stages of fft_cols_kern, Stockham stages ping-ponging two buffers|
+
+Neither inverse transform is scaled, the 1/(NX*NY) is left to the caller.
+*/
+
+#ifndef FFT_FUNCS
+#define FFT_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "trace_funcs.h"
+
+/// The double value of pi, M_PI is not declared in strict C99.
+#define FFT_PI 3.14159265358979323846
+
+/**
+@brief Checks that a length can be transformed.
+@param N The length.
+@return 1 if N is a power of two of at least 2, 0 otherwise.
+*/
+int IsFFTLength(int N){
+    return N >= 2 && (N & (N-1)) == 0 ;
+}
+
+/**
+@brief Allocates the twiddle factors of a forward FFT of length N.
+@param N The length, a power of two.
+@return The N/2 interleaved factors exp(-2 pi i k/N), to be freed by the caller.
+
+The factors are computed in double and rounded once, so their error does not grow with N.
+*/
+float* FFTTwiddles(int N){
+    float *tw = (float*)malloc(sizeof(float)*N);
+    for(int k = 0 ; k < N/2 ; k++){
+        double angle = -2.0*FFT_PI*k/N ;
+        tw[2*k] = (float)cos(angle);
+        tw[2*k+1] = (float)sin(angle);
+    }
+    return tw ;
+}
+
+/**
+@brief The in-place FFT of one line of complex values.
+@param z The N interleaved complex values.
+@param N The length, a power of two.
+@param tw The twiddle factors from FFTTwiddles().
+@param sign -1 for the forward and 1 for the inverse transform.
+*/
+void FFTLine(float *z, int N, const float *tw, int sign){
+    // Bit reversed order
+    for(int i = 1, j = 0 ; i < N ; i++){
+        int bit = N >> 1 ;
+        for( ; j & bit ; bit >>= 1){
+            j ^= bit ;
+        }
+        j ^= bit ;
+        if(i < j){
+            float re = z[2*i], im = z[2*i+1] ;
+            z[2*i] = z[2*j] ;
+            z[2*i+1] = z[2*j+1] ;
+            z[2*j] = re ;
+            z[2*j+1] = im ;
+        }
+    }
+    // Butterflies of the spans 2, 4 ... N
+    for(int span = 2 ; span <= N ; span <<= 1){
+        int half = span >> 1, step = N/span ;
+        for(int start = 0 ; start < N ; start += span){
+            for(int k = 0 ; k < half ; k++){
+                // The inverse uses the conjugate factors
+                float wr = tw[2*k*step], wi = (sign < 0) ? tw[2*k*step+1] : -tw[2*k*step+1] ;
+                float *a = z + 2*(start+k), *b = z + 2*(start+k+half) ;
+                float tr = b[0]*wr - b[1]*wi ;
+                float ti = b[0]*wi + b[1]*wr ;
+                b[0] = a[0] - tr ;
+                b[1] = a[1] - ti ;
+                a[0] += tr ;
+                a[1] += ti ;
+            }
+        }
+    }
+}
+
+/**
+@brief The in-place 2D FFT of a complex field on the host.
+@param z The NX*NY interleaved complex values.
+@param twX The twiddle factors of the rows, FFTTwiddles(NX).
+@param twY The twiddle factors of the columns, FFTTwiddles(NY).
+@param sign -1 for the forward and 1 for the inverse transform.
+*/
+void FFT2D(float *z, const float *twX, const float *twY, int sign){
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static)
+        for(int y = 0 ; y < NY ; y++){
+            FFTLine(z + 2*(size_t)NX*y, NX, twX, sign);
+        }
+        // Every thread gathers its columns into its own line
+        float *col = (float*)malloc(sizeof(float)*2*NY);
+        #pragma omp for schedule(static)
+        for(int x = 0 ; x < NX ; x++){
+            for(int y = 0 ; y < NY ; y++){
+                col[2*y] = z[2*((size_t)NX*y +x)] ;
+                col[2*y+1] = z[2*((size_t)NX*y +x)+1] ;
+            }
+            FFTLine(col, NY, twY, sign);
+            for(int y = 0 ; y < NY ; y++){
+                z[2*((size_t)NX*y +x)] = col[2*y] ;
+                z[2*((size_t)NX*y +x)+1] = col[2*y+1] ;
+            }
+        }
+        free(col);
+    }
+}
+
+/**
+@brief Enqueues the stages of one direction of a 2D FFT.
+@param kern fft_rows_kern or fft_cols_kern.
+@param globalWS The global work size of the stages.
+@param localWS The local work size.
+@param N The length of the lines, NX or NY.
+@param cur The buffer holding the input, the output on return.
+@param other The other buffer, swapped with cur after every stage.
+@param sign -1 for the forward and 1 for the inverse transform.
+*/
+static void EnqueueFFTStages(cl_kernel kern, size_t globalWS[2], size_t localWS[2], cl_int N, cl_mem *cur, cl_mem *other, cl_int sign){
+    cl_int err ;
+    for(cl_int p = 1 ; p < N ; p <<= 1){
+        err = clSetKernelArg(kern, 0, sizeof(cl_mem), cur);
+        err |= clSetKernelArg(kern, 1, sizeof(cl_mem), other);
+        err |= clSetKernelArg(kern, 2, sizeof(cl_int), &p);
+        err |= clSetKernelArg(kern, 3, sizeof(cl_int), &sign);
+        KernErrorHandle(err, "SetKernelArg FFT");
+        cl_event *event = TRACE_CL_EVENT(NULL);
+        err = clEnqueueNDRangeKernel(queue, kern, 2, NULL, globalWS, localWS, 0, NULL, event);
+        KernErrorHandle(err, "clEnqueueNDRangeKernel FFT");
+        TRACE_CL_KERNEL(event, kern);
+        cl_mem tmp = *cur ;
+        *cur = *other ;
+        *other = tmp ;
+    }
+}
+
+/**
+@brief Enqueues a 2D FFT of a complex field on the device.
+@param rowsKern The fft_rows_kern kernel.
+@param colsKern The fft_cols_kern kernel.
+@param localWS The local work size of the stages.
+@param Z The buffer holding the input, NX*NY complex values of the kernel precision.
+@param Ztmp A second buffer of the same size.
+@param sign -1 for the forward and 1 for the inverse transform.
+@return Z or Ztmp, the buffer holding the transform. The other one is overwritten.
+*/
+cl_mem EnqueueFFT2D(cl_kernel rowsKern, cl_kernel colsKern, size_t localWS[2], cl_mem Z, cl_mem Ztmp, cl_int sign){
+    cl_mem cur = Z, other = Ztmp ;
+    size_t globalWS[2] ;
+    // The rows: one work item per butterfly of a row
+    globalWS[0] = ((NX/2 + localWS[0] - 1)/localWS[0])*localWS[0] ;
+    globalWS[1] = ((NY + localWS[1] - 1)/localWS[1])*localWS[1] ;
+    EnqueueFFTStages(rowsKern, globalWS, localWS, NX, &cur, &other, sign);
+    // The columns: one work item per butterfly of a column
+    globalWS[0] = ((NX + localWS[0] - 1)/localWS[0])*localWS[0] ;
+    globalWS[1] = ((NY/2 + localWS[1] - 1)/localWS[1])*localWS[1] ;
+    EnqueueFFTStages(colsKern, globalWS, localWS, NY, &cur, &other, sign);
+    return cur ;
+}
+
+#endif
+// END OF FILE
@@ -1,7 +1,11 @@
 /**
 @file file_to_program.h
 @brief Defines the function(s) that reads a .cl file and converts them into a cl_kernel.
-It is essential that a file contains only one kernel of one name. The .cl files are found in the Kernels directory.
+The main kernel of a file has to be named phase_field_evol_kern, further kernels of the same file are created with getKernelFromProgram(). The .cl files are found in the Kernels directory.
+
+Built programs are cached in PROGRAM_CACHE_DIR when ProgramCache is set. A cache file is named after a hash of the device name,
+the device and driver versions, the program source and the build options, so any change to them makes a new entry.
+On a hit the program is created with clCreateProgramWithBinary(); if the driver rejects the binary it is built from source as before.
 */
 
 
@@ -11,6 +15,9 @@ It is essential that a file contains only one kernel of one name. The .cl files
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #ifdef MAC
 #include <OpenCL/cl.h>
 #else  
@@ -19,85 +26,327 @@ It is essential that a file contains only one kernel of one name. The .cl files
 
 #include "global_vars.h"
 #include "error_handle.h"
+#include "trace_funcs.h"
+#include "precision_funcs.h"
+
+/// Directory of the program binary cache, relative to the run directory.
+#define PROGRAM_CACHE_DIR "./.clcache"
+/// Magic bytes at the start of a cached program binary.
+#define PROGRAM_CACHE_MAGIC "PFCLB001"
+/// The kernel file of the reductions, built into the program of every system (see reduce_funcs.h).
+#define REDUCE_KERNEL_FILE "Kernels/ReduceKern.cl"
+
+/// The cache key of the program built by getKernelFromFile(), also the key of its autotuned work groups.
+uint64_t ProgramKey ;
 
 /**
-@brief The function reads a program file, complies it and returns a kernel.
+@brief Folds bytes into a 64 bit FNV-1a hash.
+@param hash The hash so far, 14695981039346656037 to start.
+@param data The bytes.
+@param bytes The number of bytes.
+@return The new hash.
+*/
+static inline uint64_t HashBytes(uint64_t hash, const void *data, size_t bytes){
+    const unsigned char *p = (const unsigned char*)data ;
+    for(size_t i = 0 ; i < bytes ; i++){
+        hash ^= p[i] ;
+        hash *= 1099511628211ULL ;
+    }
+    return hash ;
+}
 
-@param ProgFileName defines the name of the program file with path. 
-@param InpParams is the input parameters struct. Here INP_PARAMS_STRUCT is a MACRO that takes a specific struct name as per the declared SYSTEM.
-@return A compiled cl_kernel.
+/**
+@brief Folds a device info string into a hash.
+@param hash The hash so far.
+@param param The cl_device_info to query, e.g. CL_DEVICE_NAME.
+@return The new hash.
+*/
+static inline uint64_t HashDeviceInfo(uint64_t hash, cl_device_info param){
+    char info[1024] = {0} ;
+    clGetDeviceInfo(devices[devID], param, sizeof(info)-1, info, NULL);
+    return HashBytes(hash, info, strlen(info)+1);
+}
 
-It reads the raw program file into a file handle of type FILE*, creates and char* buffer and reads the entire file into it. Then it compiles the program buffer with the inbuilt clCreateProgramWithSource() function. The clCreateProgramWithSource() functions takes an arugument called Build Program Options in which we pass the constants from the INP_PARAMS_STRUCT as MACROs. If there is any error in compiling, the function will print (in runtime log) the the program build log and exit. If successfull it will return the OpenCL kernel in the file named phase_field_evol_kern
+/**
+@brief Computes the cache key of a program.
+@param source The program source.
+@param sourceBytes The length of the source.
+@param options The build options.
+@return The key, a hash of the device name, the device and driver versions, the source and the build options.
+*/
+static uint64_t ProgramCacheKey(const char *source, size_t sourceBytes, const char *options){
+    uint64_t hash = 14695981039346656037ULL ;
+    hash = HashDeviceInfo(hash, CL_DEVICE_NAME);
+    hash = HashDeviceInfo(hash, CL_DEVICE_VERSION);
+    hash = HashDeviceInfo(hash, CL_DRIVER_VERSION);
+    hash = HashBytes(hash, source, sourceBytes);
+    hash = HashBytes(hash, options, strlen(options)+1);
+    return hash ;
+}
 
-NOTE AGAIN : The kernel has to be named phase_field_evol_kern .
+/**
+@brief Names the cache file of a key.
+@param FileName The file name, at least 64 chars.
+@param key The cache key.
+*/
+static inline void ProgramCacheFileName(char FileName[], uint64_t key){
+    sprintf(FileName, "%s/%016llx.bin", PROGRAM_CACHE_DIR, (unsigned long long)key);
+}
 
+/**
+@brief Loads a program from the binary cache and builds it for the device.
+@param key The cache key from ProgramCacheKey().
+@param options The build options.
+@return The built program, or NULL if it is not cached or the driver rejects the binary. The caller then builds from source.
 */
-cl_kernel getKernelFromFile(const char ProgFileName[], struct INP_PARAMS_STRUCT InpParams){
-    cl_int err;
-    FILE *program_handle ;
-    char *program_buffer ;
-    size_t program_size ;
-    program_handle = fopen(ProgFileName, "r");
+static cl_program LoadCachedProgram(uint64_t key, const char *options){
+    char FileName[64] ;
+    ProgramCacheFileName(FileName, key);
+    FILE *File = fopen(FileName, "rb");
+    if(File == NULL){
+        return NULL ;
+    }
+    char magic[8] ;
+    uint64_t fileKey = 0, bytes = 0 ;
+    unsigned char *binary = NULL ;
+    int ok = fread(magic, 1, 8, File) == 8 && memcmp(magic, PROGRAM_CACHE_MAGIC, 8) == 0 ;
+    ok = ok && fread(&fileKey, sizeof(fileKey), 1, File) == 1 && fileKey == key ;
+    ok = ok && fread(&bytes, sizeof(bytes), 1, File) == 1 && bytes > 0 ;
+    if(ok){
+        binary = (unsigned char*)malloc(bytes);
+        ok = binary != NULL && fread(binary, 1, bytes, File) == bytes ;
+    }
+    fclose(File);
+    if(!ok){
+        printf("   : Ignoring the broken cache file %s\n", FileName);
+        free(binary);
+        return NULL ;
+    }
+
+    cl_int err, binaryStatus ;
+    size_t binaryBytes = (size_t)bytes ;
+    cl_program cached = clCreateProgramWithBinary(context, 1, &devices[devID], &binaryBytes, (const unsigned char**)&binary, &binaryStatus, &err);
+    free(binary);
+    if(err != CL_SUCCESS || binaryStatus != CL_SUCCESS){
+        if(err == CL_SUCCESS){
+            clReleaseProgram(cached);
+        }
+        return NULL ;
+    }
+    err = clBuildProgram(cached, 1, &devices[devID], options, NULL, NULL);
+    if(err != CL_SUCCESS){
+        clReleaseProgram(cached);
+        return NULL ;
+    }
+    return cached ;
+}
+
+/**
+@brief Stores the binary of the built program for devices[devID] in the cache.
+@param key The cache key from ProgramCacheKey().
+
+The binary is written to a temporary file and renamed, so concurrent runs never read a partial file. Failures only print a message, the cache is an optimisation.
+*/
+static void StoreProgramBinary(uint64_t key){
+    cl_uint numProgDevices = 0 ;
+    clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(numProgDevices), &numProgDevices, NULL);
+    if(numProgDevices == 0){
+        return ;
+    }
+    cl_device_id *progDevices = (cl_device_id*)malloc(sizeof(cl_device_id)*numProgDevices);
+    size_t *sizes = (size_t*)malloc(sizeof(size_t)*numProgDevices);
+    unsigned char **binaries = (unsigned char**)calloc(numProgDevices, sizeof(unsigned char*));
+    clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(cl_device_id)*numProgDevices, progDevices, NULL);
+    cl_int err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t)*numProgDevices, sizes, NULL);
+
+    cl_uint dev = 0 ;
+    while(dev < numProgDevices && progDevices[dev] != devices[devID]){
+        dev++ ;
+    }
+    if(err == CL_SUCCESS && dev < numProgDevices && sizes[dev] > 0){
+        // Only the binary of devices[devID] is fetched, the other entries stay NULL
+        binaries[dev] = (unsigned char*)malloc(sizes[dev]);
+        err = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*)*numProgDevices, binaries, NULL);
+
+        char FileName[64], TmpFileName[80] ;
+        ProgramCacheFileName(FileName, key);
+        sprintf(TmpFileName, "%s.%d.tmp", FileName, (int)getpid());
+        mkdir(PROGRAM_CACHE_DIR, 0777);
+        FILE *File = (err == CL_SUCCESS) ? fopen(TmpFileName, "wb") : NULL ;
+        if(File != NULL){
+            uint64_t bytes = sizes[dev] ;
+            int ok = fwrite(PROGRAM_CACHE_MAGIC, 1, 8, File) == 8 ;
+            ok = ok && fwrite(&key, sizeof(key), 1, File) == 1 ;
+            ok = ok && fwrite(&bytes, sizeof(bytes), 1, File) == 1 ;
+            ok = ok && fwrite(binaries[dev], 1, sizes[dev], File) == sizes[dev] ;
+            ok = (fclose(File) == 0) && ok ;
+            if(ok && rename(TmpFileName, FileName) == 0){
+                printf("   : Program binary cached in %s\n", FileName);
+            }else{
+                remove(TmpFileName);
+                printf("   : Could not write the program cache %s\n", FileName);
+            }
+        }
+        free(binaries[dev]);
+    }
+    free(binaries);
+    free(sizes);
+    free(progDevices);
+}
+
+/**
+@brief Writes the build options of the Diffusion system, its constants as "-D" MACROs.
+@param InpParams The input parameters.
+@param BuildProgOptions The options string.
+@param bytes The size of BuildProgOptions.
+*/
+void getDiffusionBuildOptions(const struct DiffusionInputParams *InpParams, char BuildProgOptions[], size_t bytes){
+    snprintf(BuildProgOptions, bytes, "-DNX=%d -DNY=%d -DNZ=%d -DPITCH=%d -DH=%f -DDT=%f -DCOEFF=%f", NX, NY, NZ, PITCH, DX,DT, InpParams->DIFF_COEFF);
+}
+
+/**
+@brief Writes the build options of the Cahn-Hilliard system.
+@param InpParams The input parameters.
+@param BuildProgOptions The options string.
+@param bytes The size of BuildProgOptions.
+*/
+void getCahnHilliardBuildOptions(const struct CahnHilliardInputParams *InpParams, char BuildProgOptions[], size_t bytes){
+    snprintf(BuildProgOptions, bytes, "-DNX=%d -DNY=%d -DNZ=%d -DPITCH=%d -DH=%f -DDT=%f -DMOBILITY=%f -DKAPPA=%f", NX, NY, NZ, PITCH, DX,DT, InpParams->MOBILITY, InpParams->KAPPA);
+}
+
+/**
+@brief Writes the build options of the Kobayashi isotropic system.
+@param InpParams The input parameters.
+@param BuildProgOptions The options string.
+@param bytes The size of BuildProgOptions.
+*/
+void getKobayashiIsoBuildOptions(const struct KobIsoInputParams *InpParams, char BuildProgOptions[], size_t bytes){
+    snprintf(BuildProgOptions, bytes, "-DNX=%d -DNY=%d -DPITCH=%d -DH=%f -DDT=%f  -DEPS_BAR=%f -DALPHA=%f -DGAMMA=%f -DTAU=%f -DPH_L=%f -DPH_R=%f -DPH_T=%f -DPH_B=%f -DTHERM_DIFF=%f -DLAT_H=%f -DT_MELT=%f -DT_L=%f -DT_R=%f -DT_T=%f -DT_B=%f", NX, NY, PITCH, DX, DT, InpParams->EPS_BAR, InpParams->ALPHA, InpParams->GAMMA, InpParams->TAU, InpParams->PHASE_L,InpParams->PHASE_R, InpParams->PHASE_T, InpParams->PHASE_B ,InpParams->TH_DIFF, InpParams->L_HEAT, InpParams->T_MELT, InpParams->TEMP_L,InpParams->TEMP_R,InpParams->TEMP_T,InpParams->TEMP_B);
+}
+
+/**
+@brief Writes the build options of the Kobayashi anisotropic system.
+@param InpParams The input parameters.
+@param BuildProgOptions The options string.
+@param bytes The size of BuildProgOptions.
+*/
+void getKobayashiAnisoBuildOptions(const struct KobAnisoInputParams *InpParams, char BuildProgOptions[], size_t bytes){
+    snprintf(BuildProgOptions, bytes, "-DNX=%d -DNY=%d -DPITCH=%d -DH=%f -DEPS_BAR=%f -DALPHA=%f -DGAMMA=%f -DDELTA=%f -DTAU=%f -DTHETA0=%f -DJ=%f -DDT=%f -DTHERM_DIFF=%f -DLAT_H=%f -DT_MELT=%f ", NX, NY, PITCH, DX, InpParams->EPS_BAR, InpParams->ALPHA, InpParams->GAMMA, InpParams->DELTA,InpParams->TAU, InpParams->THETA0, InpParams->J, DT, InpParams->TH_DIFF, InpParams->L_HEAT, InpParams->T_MELT);
+}
+
+/**
+@brief Appends a source file to a program source.
+@param buffer The source, NULL to start one. It is reallocated and stays null terminated.
+@param size The length of the source, updated.
+@param FileName The file to append.
+
+A newline separates the files, so a comment on the last line of a file does not swallow the next one.
+*/
+static void AppendSourceFile(char **buffer, size_t *size, const char FileName[]){
+    FILE *program_handle = fopen(FileName, "r");
     if(program_handle == NULL){
         perror("Error in reading program file. \n");
         exit(1);
     }
     fseek(program_handle, 0, SEEK_END);
-    program_size = ftell(program_handle);
+    size_t file_size = ftell(program_handle);
     rewind(program_handle);
-    program_buffer = (char*)malloc(sizeof(char)*(program_size+1));
-    program_buffer[program_size] = '\0';
-    fread(program_buffer, sizeof(char), program_size, program_handle);
+    size_t start = (*buffer == NULL) ? 0 : *size + 1 ;
+    *buffer = (char*)realloc(*buffer, sizeof(char)*(start+file_size+1));
+    if(start > 0){
+        (*buffer)[start-1] = '\n';
+    }
+    fread(*buffer + start, sizeof(char), file_size, program_handle);
+    (*buffer)[start+file_size] = '\0';
     fclose(program_handle);
+    *size = start + file_size ;
+}
 
-    cl_program program ;
-    program = clCreateProgramWithSource(context, 1, (const char**)&program_buffer, &program_size, &err);
-    ErrorHandle(err, "clCreateProgramWithSource");
-    free(program_buffer);
-    
-#ifdef DIFFUSION
-    char BuildProgOptions[65];
-    err = sprintf(BuildProgOptions,"-DSIZE=%d -DH=%f -DDT=%f -DCOEFF=%f", SIZE, DX,DT, InpParams.DIFF_COEFF);
-#endif
-    
-#ifdef CAHNHILLIARD
-    char BuildProgOptions[80];
-    err = sprintf(BuildProgOptions,"-DSIZE=%d -DH=%f -DDT=%f -DMOBILITY=%f -DKAPPA=%f",SIZE, DX,DT, InpParams.MOBILITY, InpParams.KAPPA);
-#endif
+/**
+@brief The function reads a program file, complies it and returns a kernel.
 
+@param ProgFileName defines the name of the program file with path. 
+@param BuildProgOptions The build options, made by the build options function of the system, e.g. getDiffusionBuildOptions().
+@return A compiled cl_kernel.
 
-#ifdef KOBISO
-    char BuildProgOptions[900];
-    err = sprintf(BuildProgOptions,"-DSIZE=%d -DH=%f -DDT=%f  -DEPS_BAR=%f -DALPHA=%f -DGAMMA=%f -DTAU=%f -DPH_L=%f -DPH_R=%f -DPH_T=%f -DPH_B=%f -DTHERM_DIFF=%f -DLAT_H=%f -DT_MELT=%f -DT_L=%f -DT_R=%f -DT_T=%f -DT_B=%f", SIZE, DX, DT, InpParams.EPS_BAR, InpParams.ALPHA, InpParams.GAMMA, InpParams.TAU, InpParams.PHASE_L,InpParams.PHASE_R, InpParams.PHASE_T, InpParams.PHASE_B ,InpParams.TH_DIFF, InpParams.L_HEAT, InpParams.T_MELT, InpParams.TEMP_L,InpParams.TEMP_R,InpParams.TEMP_T,InpParams.TEMP_B);
-    
-#endif
+It reads the raw program file into a file handle of type FILE*, creates and char* buffer and reads the entire file into it. Then it compiles the program buffer with the inbuilt clCreateProgramWithSource() function. The clBuildProgram() function takes an arugument called Build Program Options in which we pass the constants from the input parameters struct as MACROs. If there is any error in compiling, the function will print (in runtime log) the the program build log and exit. If successfull it will return the OpenCL kernel in the file named phase_field_evol_kern
+With ProgramCache set, a cached binary of the same source and options is loaded instead of compiling, and a fresh build is stored in the cache.
+-DPRECISION is appended to the options, so the kernels store and compute in the precision of the Precision variable (see precision_funcs.h).
+With AdaptiveDT set -DADAPTIVE_DT is appended too, and the kernels that step in time take the time step as their last argument (see adaptive_dt_funcs.h).
+The reductions of REDUCE_KERNEL_FILE are built after the program file, in the same program.
 
-#ifdef KOBANISO
-    char BuildProgOptions[300];
-    err = sprintf(BuildProgOptions,"-DSIZE=%d -DH=%f -DEPS_BAR=%f -DALPHA=%f -DGAMMA=%f -DDELTA=%f -DTAU=%f -DTHETA0=%f -DJ=%f -DDT=%f -DTHERM_DIFF=%f -DLAT_H=%f -DT_MELT=%f ", SIZE, DX, InpParams.EPS_BAR, InpParams.ALPHA, InpParams.GAMMA, InpParams.DELTA,InpParams.TAU, InpParams.THETA0, InpParams.J, DT, InpParams.TH_DIFF, InpParams.L_HEAT, InpParams.T_MELT);
-#endif
-    
-
-    err = clBuildProgram(program, 0, NULL, BuildProgOptions, NULL, NULL);
-
-    if (err<0){        
-        size_t log_size ;
-        clGetProgramBuildInfo(program, devices[devID], CL_PROGRAM_BUILD_LOG, 0, NULL,&log_size);
-        char *program_log;
-        program_log = (char*)malloc(log_size+1);
-        program_log[log_size] = '\0';
-        clGetProgramBuildInfo(program, devices[devID], CL_PROGRAM_BUILD_LOG, log_size+1, program_log, NULL);
-        printf("%s\n", program_log);
-        exit(1);
-    }
-    else{
-        ErrorHandle(0, "clBuildProgram" );
+NOTE AGAIN : The kernel has to be named phase_field_evol_kern .
+
+*/
+cl_kernel getKernelFromFile(const char ProgFileName[], const char BuildProgOptions[]){
+    cl_int err;
+    char *program_buffer = NULL ;
+    size_t program_size = 0 ;
+    AppendSourceFile(&program_buffer, &program_size, ProgFileName);
+    // The reductions share the types and the constants of the system
+    AppendSourceFile(&program_buffer, &program_size, REDUCE_KERNEL_FILE);
+
+    // The precision of the fields, a different precision is a different cached binary
+    CheckPrecision(devices[devID]);
+    size_t optionsBytes = strlen(BuildProgOptions) + 48 ;
+    char *options = (char*)malloc(optionsBytes);
+    snprintf(options, optionsBytes, "%s -DPRECISION=%d%s", BuildProgOptions, Precision, AdaptiveDT ? " -DADAPTIVE_DT" : "");
+
+    // Try the binary cache first, build from source on a miss
+    uint64_t cacheKey = ProgramCacheKey(program_buffer, program_size, options);
+    ProgramKey = cacheKey ;
+    TRACE_SPAN_BEGIN(load);
+    program = (ProgramCache > 0) ? LoadCachedProgram(cacheKey, options) : NULL ;
+    if(program != NULL){
+        TRACE_SPAN_END(load, "program cache load", "build");
+        printf("   : Program loaded from the cache %s\n", PROGRAM_CACHE_DIR);
+        free(program_buffer);
+    }else{
+        TRACE_SPAN_BEGIN(build);
+        program = clCreateProgramWithSource(context, 1, (const char**)&program_buffer, &program_size, &err);
+        ErrorHandle(err, "clCreateProgramWithSource");
+        free(program_buffer);
+
+        err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+
+        if (err<0){        
+            size_t log_size ;
+            clGetProgramBuildInfo(program, devices[devID], CL_PROGRAM_BUILD_LOG, 0, NULL,&log_size);
+            char *program_log;
+            program_log = (char*)malloc(log_size+1);
+            program_log[log_size] = '\0';
+            clGetProgramBuildInfo(program, devices[devID], CL_PROGRAM_BUILD_LOG, log_size+1, program_log, NULL);
+            printf("%s\n", program_log);
+            exit(1);
+        }
+        else{
+            ErrorHandle(0, "clBuildProgram" );
+        }
+        TRACE_SPAN_END(build, "clBuildProgram", "build");
+        if(ProgramCache > 0){
+            StoreProgramBinary(cacheKey);
+        }
     }
+    free(options);
     kernel = clCreateKernel(program, "phase_field_evol_kern", &err);
     ErrorHandle(err, "clCreateKernel");
 
     return kernel ;
 }
 
+/**
+@brief The function creates another kernel from the program compiled by getKernelFromFile().
+@param KernelName The name of the __kernel function in the .cl file.
+@return A cl_kernel.
+
+Used by the systems whose .cl file has more than one kernel, e.g. the two-kernel Cahn-Hilliard step.
+*/
+cl_kernel getKernelFromProgram(const char KernelName[]){
+    cl_int err;
+    cl_kernel namedKernel = clCreateKernel(program, KernelName, &err);
+    ErrorHandle(err, "clCreateKernel");
+    return namedKernel ;
+}
+
 #endif
 // END OF FILE
\ No newline at end of file
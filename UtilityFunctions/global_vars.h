@@ -30,13 +30,40 @@ cl_device_id *devices;
 cl_context context;
 /// The command queue structure. It is the queue where kernels line up and wait for excution.
 cl_command_queue queue;
+/// The program structure. The compiled .cl file, from which getKernelFromProgram() creates further kernels.
+cl_program program ;
 /// The kernel structure. It represents a kernel, read from a .cl file using the getKernelFromFile() function.
 cl_kernel kernel ;
 // Work group size.
 cl_int WGsize ;
+/// Time the candidate work groups of the kernels, see autotune_funcs.h . Read from the INPUT_FILE or set by --autotune. The following table states the values:
+/// |Value|Autotuning|
+/// |-----|----------|
+/// |0|Use the cached work groups, never time (default)|
+/// |1|Time the kernels without a cached work group|
+/// |2|Time all the kernels again (--autotune)|
+cl_int Autotune ;
 
-/// Matrix/mesh/grid size of the system.
-cl_int SIZE ; 
+/// Number of cells of a grid row, the x size of the grid. Read from the INPUT_FILE as NX, or as SIZE for a square grid.
+cl_int NX ;
+/// Number of grid rows, the y size of the grid. Read from the INPUT_FILE as NY, or as SIZE for a square grid.
+cl_int NY ;
+/// Number of grid planes, the z size of the grid. Read from the INPUT_FILE as NZ, 1 (the default) is a 2D grid.
+cl_int NZ ;
+/// Row stride of the fields in floats, NX rounded up to PITCH_ALIGN so that every row starts on an aligned address.
+cl_int PITCH ;
+/// Alignment of the rows in floats. 32 floats are 128 bytes, one full memory transaction of most GPUs.
+#define PITCH_ALIGN 32
+/// Number of floats of a field, including the padding at the end of the rows. The planes of a 3D grid are PITCH*NY floats apart.
+#define FIELD_CELLS ((size_t)PITCH*NY*NZ)
+/// Number of cells of the grid, without the padding.
+#define GRID_CELLS ((size_t)NX*NY*NZ)
+/// The size of the whole grid in x and y. NX and NY, unless the grid is split over MPI processes: then NX and NY are the size of the block of the process, halo included (see mpi_funcs.h).
+cl_int GridNX, GridNY ;
+/// The cell of the whole grid at the first cell of the fields, 0 unless the grid is split over MPI processes.
+cl_int BlockX0, BlockY0 ;
+/// The shortest side of the whole grid, which sets the size of the initial seeds. NZ only counts for a 3D grid.
+#define GRID_MIN_SIDE ((NZ > 1 && NZ < GridNX && NZ < GridNY) ? NZ : ((GridNX < GridNY) ? GridNX : GridNY))
 /// The delta x variable. dx=dy=H
 cl_float DX ;
 /// Number of iterations to run.
@@ -50,7 +77,87 @@ cl_int NSAVE ;
 /// |-----|----------------|
 /// |0|.csv|
 /// |1|.vtk|
+/// |2|.raw float32 with a header|
+/// |3|.vtk BINARY|
+/// |4|.vti appended raw|
+/// |5|.pfz compressed|
 cl_int OutDataFileType ;
+/// Use the local-memory tiled kernels where a system has them. Read from the INPUT_FILE, 0 (the default) runs the untiled kernels.
+cl_int TiledKernels ;
+/// Update only the active tiles of the Kobayashi anisotropic system, see active_tiles_funcs.h . Read from the INPUT_FILE, 0 (the default) updates the whole grid.
+cl_int SparseTiles ;
+/// Number of time steps advanced per kernel launch by the temporally blocked kernels, at most 32. Read from the INPUT_FILE, 0 or 1 (the default) runs one step per launch.
+cl_int TimeBlock ;
+/// Number of host staging buffers of the output writer thread, one field each. Read from the INPUT_FILE, at least 2 (the default) .
+cl_int OutputBuffers ;
+/// Absolute error bound of the compressed output (OutDataFileType 5). Read from the INPUT_FILE, 0 (the default) compresses lossless.
+cl_float CompressErrorBound ;
+/// Cache the built OpenCL programs in PROGRAM_CACHE_DIR, see file_to_program.h . Read from the INPUT_FILE, 0 (the default) always builds from source.
+cl_int ProgramCache ;
+/// Write a checkpoint every CheckpointEvery iterations. Read from the INPUT_FILE, 0 (the default) writes none.
+cl_int CheckpointEvery ;
+/// The first iteration to run. 0 unless the run restarts from a checkpoint, see checkpoint_funcs.h .
+cl_int StartIter ;
+/// The state of the random number generator of the noise, see RandomUniform(). It is saved in the checkpoints.
+cl_ulong RNGState ;
+
+/// OpenCL backend. The kernels in the Kernels directory run on the device given by platID and devID.
+#define BACKEND_OPENCL 0
+/// Native CPU backend. The functions of cpu_kernels.h run on the host with OpenMP threads.
+#define BACKEND_CPU 1
+/// The compute backend. Set from the command line, see main(). The following table states the values:
+/// |Value|Backend|
+/// |-----|-------|
+/// |BACKEND_OPENCL|OpenCL kernels (default)|
+/// |BACKEND_CPU|Native OpenMP + SIMD C functions|
+cl_int Backend ;
+
+/// The fields are float on the device and the host.
+#define PRECISION_SINGLE 0
+/// The fields are half on the device, the kernels compute in float. The host arrays stay float, see precision_funcs.h .
+#define PRECISION_HALF 1
+/// The fields are double on the device and the kernels compute in double, which needs cl_khr_fp64. The host arrays stay float.
+#define PRECISION_DOUBLE 2
+/// The precision of the device fields. Read from the INPUT_FILE as Precision or set by --precision. The following table states the values:
+/// |Value|Storage|Compute|
+/// |-----|-------|-------|
+/// |PRECISION_SINGLE|float|float (default)|
+/// |PRECISION_HALF|half|float|
+/// |PRECISION_DOUBLE|double|double|
+cl_int Precision ;
+/// Adapt the time step to the evolution of the fields, see adaptive_dt_funcs.h . Read from the INPUT_FILE, 0 (the default) steps with the fixed DT.
+cl_int AdaptiveDT ;
+/// The largest change of the phase field in one iteration the adaptive time step aims at. Read from the INPUT_FILE, ADAPTIVE_DT_TOLERANCE if not set.
+cl_float DTTolerance ;
+/// Sample the diagnostics of the fields every DiagnosticsEvery iterations, see diagnostics_funcs.h . Read from the INPUT_FILE, 0 (the default) samples none.
+cl_int DiagnosticsEvery ;
+/// The number of diagnostics a field can have.
+#define NUM_DIAGNOSTICS 5
+/// The names of the diagnostics in the INPUT_FILE and the output file, bit k of DiagnosticsMask selects the k-th.
+#define DIAGNOSTIC_NAMES {"mean", "min", "max", "frac", "interface"}
+/// The diagnostics to sample, one bit per name of DIAGNOSTIC_NAMES. Read from the INPUT_FILE as a comma separated list of names, 0 (not set) samples them all.
+cl_int DiagnosticsMask ;
+/// The largest number of reduced outputs.
+#define MAX_OUTPUT_SPECS 8
+/// A reduced output of the saved fields, a window of the grid decimated by a factor, see output_spec_funcs.h .
+struct OutputSpec{
+    /// The first cell of the window.
+    cl_int x0, y0, z0 ;
+    /// The size of the window in cells, 0 spans the grid from the first cell of the window to its end.
+    cl_int nx, ny, nz ;
+    /// The decimation factor, 1 keeps every cell.
+    cl_int factor ;
+    /// 1 writes the mean of each block of factor cells per side (box filter), 0 its first cell (stride).
+    cl_int box ;
+    /// The name of the output, appended to the name of the field in the output files, e.g. "ROI0".
+    char name[16] ;
+};
+/// The reduced outputs written at every save. Read from the INPUT_FILE, one per OutputROI or OutputDecimate line.
+struct OutputSpec OutputSpecs[MAX_OUTPUT_SPECS] ;
+/// The number of reduced outputs in OutputSpecs.
+cl_int NumOutputSpecs ;
+/// Write the whole fields at the saves. Read from the INPUT_FILE, 1 (the default) writes them next to the reduced outputs, 0 only writes the reduced outputs.
+cl_int FullOutput ;
 
 /// Diffusion system input parameters.
 struct DiffusionInputParams{
@@ -76,6 +183,8 @@ struct CahnHilliardInputParams{
     cl_float KAPPA ;
     /// The mobility of the material.
     cl_float MOBILITY ;
+    /// Run the semi-implicit Fourier-spectral step of spectral_funcs.h instead of the explicit step. Read from the INPUT_FILE, 0 (the default) runs the explicit step.
+    cl_int SPECTRAL ;
 };
 
 /// Cahn-Hilliard system data buffers. 
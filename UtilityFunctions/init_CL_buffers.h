@@ -19,6 +19,7 @@
 #include "global_vars.h"
 #include "error_handle.h"
 #include "data_manip_funcs.h"
+#include "precision_funcs.h"
 
 /**
 @brief Initialize Kobayashi Anisotropic Data Buffers. 
@@ -27,28 +28,25 @@
 
 */
 struct KobAnisoDataBuffers initKobayashiAnisoBuffers(struct KobAnisoInputParams InpParams){
-    cl_int err ;
     struct KobAnisoDataBuffers dataBuffers ;
     // Initialize data
-    dataBuffers.PHASE1 = Init1DFloatMatrix(SIZE,1.0) ;
-    InitCenterCircle(dataBuffers.PHASE1, SIZE, SIZE/32, 0.0);
-    dataBuffers.PHASE2 = Init1DFloatMatrix(SIZE,1.0) ;
-    dataBuffers.TEMP1 = Init1DFloatMatrix(SIZE,InpParams.T_INIT) ;
-    InitCenterCircle(dataBuffers.TEMP1, SIZE, SIZE/32, InpParams.T_BOUND);
-    dataBuffers.TEMP2 = Init1DFloatMatrix(SIZE,InpParams.T_INIT) ;
-    
-    // Create buffers from matrix
-    dataBuffers.PHASE1buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE1, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE1");
-    
-    dataBuffers.PHASE2buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE2, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE2");
-    
-    dataBuffers.TEMP1buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.TEMP1, &err);
-    ErrorHandle(err, "clCreateBuffer TEMP1");
-    
-    dataBuffers.TEMP2buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.TEMP2, &err);
-    ErrorHandle(err, "clCreateBuffer TEMP2");
+    dataBuffers.PHASE1 = Init1DFloatMatrix(1.0) ;
+    InitCenterCircle(dataBuffers.PHASE1, GRID_MIN_SIDE/32, 0.0);
+    dataBuffers.PHASE2 = Init1DFloatMatrix(1.0) ;
+    dataBuffers.TEMP1 = Init1DFloatMatrix(InpParams.T_INIT) ;
+    InitCenterCircle(dataBuffers.TEMP1, GRID_MIN_SIDE/32, InpParams.T_BOUND);
+    dataBuffers.TEMP2 = Init1DFloatMatrix(InpParams.T_INIT) ;
+    
+    // Create buffers from matrix. The CPU backend works on the host arrays only.
+    if(Backend == BACKEND_OPENCL){
+        dataBuffers.PHASE1buff = CreateFieldBuffer(dataBuffers.PHASE1, FIELD_CELLS, "clCreateBuffer PHASE1");
+
+        dataBuffers.PHASE2buff = CreateFieldBuffer(dataBuffers.PHASE2, FIELD_CELLS, "clCreateBuffer PHASE2");
+
+        dataBuffers.TEMP1buff = CreateFieldBuffer(dataBuffers.TEMP1, FIELD_CELLS, "clCreateBuffer TEMP1");
+
+        dataBuffers.TEMP2buff = CreateFieldBuffer(dataBuffers.TEMP2, FIELD_CELLS, "clCreateBuffer TEMP2");
+    }
     
     return dataBuffers ;
 }
@@ -60,26 +58,23 @@ struct KobAnisoDataBuffers initKobayashiAnisoBuffers(struct KobAnisoInputParams
 
 */
 struct KobIsoDataBuffers initKobayashiIsoBuffers(struct KobIsoInputParams InpParams){
-    cl_int err ;
     struct KobIsoDataBuffers dataBuffers ;
     // Initialize data
-    dataBuffers.PHASE1 = Init1DFloatMatrix(SIZE,1.0 ) ;
-    dataBuffers.PHASE2 = Init1DFloatMatrix(SIZE,1.0 ) ;
-    dataBuffers.TEMP1 = Init1DFloatMatrix(SIZE,InpParams.T_INIT) ;
-    dataBuffers.TEMP2 = Init1DFloatMatrix(SIZE,InpParams.T_INIT) ;
-    
-    // Create buffers from matrix
-    dataBuffers.PHASE1buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE1, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE1");
-    
-    dataBuffers.PHASE2buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE2, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE2");
-    
-    dataBuffers.TEMP1buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.TEMP1, &err);
-    ErrorHandle(err, "clCreateBuffer TEMP1");
-    
-    dataBuffers.TEMP2buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.TEMP2, &err);
-    ErrorHandle(err, "clCreateBuffer TEMP2");
+    dataBuffers.PHASE1 = Init1DFloatMatrix(1.0 ) ;
+    dataBuffers.PHASE2 = Init1DFloatMatrix(1.0 ) ;
+    dataBuffers.TEMP1 = Init1DFloatMatrix(InpParams.T_INIT) ;
+    dataBuffers.TEMP2 = Init1DFloatMatrix(InpParams.T_INIT) ;
+    
+    // Create buffers from matrix. The CPU backend works on the host arrays only.
+    if(Backend == BACKEND_OPENCL){
+        dataBuffers.PHASE1buff = CreateFieldBuffer(dataBuffers.PHASE1, FIELD_CELLS, "clCreateBuffer PHASE1");
+
+        dataBuffers.PHASE2buff = CreateFieldBuffer(dataBuffers.PHASE2, FIELD_CELLS, "clCreateBuffer PHASE2");
+
+        dataBuffers.TEMP1buff = CreateFieldBuffer(dataBuffers.TEMP1, FIELD_CELLS, "clCreateBuffer TEMP1");
+
+        dataBuffers.TEMP2buff = CreateFieldBuffer(dataBuffers.TEMP2, FIELD_CELLS, "clCreateBuffer TEMP2");
+    }
     
     return dataBuffers ;
 }
@@ -90,19 +85,18 @@ struct KobIsoDataBuffers initKobayashiIsoBuffers(struct KobIsoInputParams InpPar
 @return A DiffusionDataBuffers struct.
 */
 struct DiffusionDataBuffers initDiffusionBuffers(struct DiffusionInputParams InpParams){
-    cl_int err ;
     struct DiffusionDataBuffers dataBuffers ;
     // Initialize data
-    dataBuffers.PHASE1 = Init1DFloatMatrix(SIZE,0) ;
-    InitCenterCircle(dataBuffers.PHASE1, SIZE, SIZE/8, 1);
-    dataBuffers.PHASE2 = Init1DFloatMatrix(SIZE,0) ;
-    
-    // Create buffers from matrix
-    dataBuffers.PHASE1buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE1, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE1");
+    dataBuffers.PHASE1 = Init1DFloatMatrix(0) ;
+    InitCenterCircle(dataBuffers.PHASE1, GRID_MIN_SIDE/8, 1);
+    dataBuffers.PHASE2 = Init1DFloatMatrix(0) ;
     
-    dataBuffers.PHASE2buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE2, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE2");
+    // Create buffers from matrix. The CPU backend works on the host arrays only.
+    if(Backend == BACKEND_OPENCL){
+        dataBuffers.PHASE1buff = CreateFieldBuffer(dataBuffers.PHASE1, FIELD_CELLS, "clCreateBuffer PHASE1");
+
+        dataBuffers.PHASE2buff = CreateFieldBuffer(dataBuffers.PHASE2, FIELD_CELLS, "clCreateBuffer PHASE2");
+    }
     
     return dataBuffers ;
 }
@@ -113,26 +107,79 @@ struct DiffusionDataBuffers initDiffusionBuffers(struct DiffusionInputParams Inp
 @return A CahnHilliardDataBuffers struct.
 */
 struct CahnHilliardDataBuffers initCahnHilliardBuffers(struct CahnHilliardInputParams InpParams){
-    cl_int err ;
     struct CahnHilliardDataBuffers dataBuffers;
     //Initialize data
-    dataBuffers.PHASE1 = RandomInit1DFloatMatrix( SIZE, InpParams.MEAN_C, InpParams.NOISE_AMP) ;
-    dataBuffers.PHASE2 = Init1DFloatMatrix(SIZE,0.0) ;
-    dataBuffers.InBracM = Init1DFloatMatrix(SIZE,0.0);
-    
-    // Create buffers from matrix
-    dataBuffers.PHASE1buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE1, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE1");
-    
-    dataBuffers.PHASE2buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.PHASE2, &err);
-    ErrorHandle(err, "clCreateBuffer PHASE2");
+    dataBuffers.PHASE1 = RandomInit1DFloatMatrix(InpParams.MEAN_C, InpParams.NOISE_AMP) ;
+    dataBuffers.PHASE2 = Init1DFloatMatrix(0.0) ;
+    dataBuffers.InBracM = Init1DFloatMatrix(0.0);
     
-    dataBuffers.InBracMbuff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*SIZE*SIZE, dataBuffers.InBracM, &err);
-    ErrorHandle(err, "clCreateBuffer InBracM");
+    // Create buffers from matrix. The CPU backend works on the host arrays only.
+    if(Backend == BACKEND_OPENCL){
+        dataBuffers.PHASE1buff = CreateFieldBuffer(dataBuffers.PHASE1, FIELD_CELLS, "clCreateBuffer PHASE1");
+
+        dataBuffers.PHASE2buff = CreateFieldBuffer(dataBuffers.PHASE2, FIELD_CELLS, "clCreateBuffer PHASE2");
+
+        dataBuffers.InBracMbuff = CreateFieldBuffer(dataBuffers.InBracM, FIELD_CELLS, "clCreateBuffer InBracM");
+    }
     
     return dataBuffers ;
     
 }
 
+/**
+@brief Frees the arrays and releases the OpenCL buffers of the data buffers of a system.
+@param fields The host arrays.
+@param buffs The OpenCL buffers, released with the OpenCL backend only.
+@param count The number of arrays.
+*/
+static void releaseFieldArrays(cl_float *fields[], cl_mem buffs[], int count){
+    for(int i = 0 ; i < count ; i++){
+        if(Backend == BACKEND_OPENCL){
+            clReleaseMemObject(buffs[i]);
+        }
+        free(fields[i]);
+    }
+}
+
+/**
+@brief Releases Kobayashi Anisotropic Data Buffers.
+@param dataBuffers The KobAnisoDataBuffers struct made by initKobayashiAnisoBuffers().
+*/
+void releaseKobayashiAnisoBuffers(struct KobAnisoDataBuffers dataBuffers){
+    cl_float *fields[4] = {dataBuffers.PHASE1, dataBuffers.PHASE2, dataBuffers.TEMP1, dataBuffers.TEMP2} ;
+    cl_mem buffs[4] = {dataBuffers.PHASE1buff, dataBuffers.PHASE2buff, dataBuffers.TEMP1buff, dataBuffers.TEMP2buff} ;
+    releaseFieldArrays(fields, buffs, 4);
+}
+
+/**
+@brief Releases Kobayashi Isotropic Data Buffers.
+@param dataBuffers The KobIsoDataBuffers struct made by initKobayashiIsoBuffers().
+*/
+void releaseKobayashiIsoBuffers(struct KobIsoDataBuffers dataBuffers){
+    cl_float *fields[4] = {dataBuffers.PHASE1, dataBuffers.PHASE2, dataBuffers.TEMP1, dataBuffers.TEMP2} ;
+    cl_mem buffs[4] = {dataBuffers.PHASE1buff, dataBuffers.PHASE2buff, dataBuffers.TEMP1buff, dataBuffers.TEMP2buff} ;
+    releaseFieldArrays(fields, buffs, 4);
+}
+
+/**
+@brief Releases Diffusion system Data Buffers.
+@param dataBuffers The DiffusionDataBuffers struct made by initDiffusionBuffers().
+*/
+void releaseDiffusionBuffers(struct DiffusionDataBuffers dataBuffers){
+    cl_float *fields[2] = {dataBuffers.PHASE1, dataBuffers.PHASE2} ;
+    cl_mem buffs[2] = {dataBuffers.PHASE1buff, dataBuffers.PHASE2buff} ;
+    releaseFieldArrays(fields, buffs, 2);
+}
+
+/**
+@brief Releases Cahn-hilliard system Data Buffers.
+@param dataBuffers The CahnHilliardDataBuffers struct made by initCahnHilliardBuffers().
+*/
+void releaseCahnHilliardBuffers(struct CahnHilliardDataBuffers dataBuffers){
+    cl_float *fields[3] = {dataBuffers.PHASE1, dataBuffers.PHASE2, dataBuffers.InBracM} ;
+    cl_mem buffs[3] = {dataBuffers.PHASE1buff, dataBuffers.PHASE2buff, dataBuffers.InBracMbuff} ;
+    releaseFieldArrays(fields, buffs, 3);
+}
+
 #endif
 //END OF FILE
\ No newline at end of file
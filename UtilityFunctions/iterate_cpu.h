@@ -0,0 +1,263 @@
+/**
+@file iterate_cpu.h
+@brief Declares the functions to iterate each SYSTEM with the native CPU backend.
+
+The functions have the same contract as the ones in iterate_kernels.h : they take the input parameters and the
+data buffers, run ITERS iterations (two time steps each, ping-ponging PHASE1/PHASE2), and write NSAVE output
+files into the same output directories. Only the host arrays of the data buffers are used.
+The fields are copied to the writer thread of output_writer.h, so the next steps start before the files are written.
+*/
+
+#ifndef ITERATE_CPU
+#define ITERATE_CPU
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "cpu_kernels.h"
+#include "data_manip_funcs.h"
+#include "output_writer.h"
+#include "checkpoint_funcs.h"
+#include "diagnostics_funcs.h"
+#include "trace_funcs.h"
+
+/**
+@brief A function to fully iterate the diffusion system on the CPU.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure.
+*/
+static inline void iterateDiffusionCPU(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    double tot_exec_time = 0.0, start ;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const float *DiagFields[1] = {databuffers.PHASE1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnosticsCPU(&diag, DiagFields, StartIter);
+    
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        cpuDiffusionStep(databuffers.PHASE1, databuffers.PHASE2, inpparams, CPUWholeGrid());
+        cpuDiffusionStep(databuffers.PHASE2, databuffers.PHASE1, inpparams, CPUWholeGrid());
+        TRACE_SPAN_END(steps, "cpuDiffusionStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnosticsCPU(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", iter);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getDiffusionCheckpointFields(&databuffers, fields);
+            WriteCheckpoint(OutFileDir, "DIFFUSION", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+        }
+    }
+
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+}
+
+/**
+@brief A function to fully iterate the cahn-Hilliard system on the CPU.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+*/
+static inline void iterateCahnHilliardCPU(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    double tot_exec_time = 0.0, start ;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const float *DiagFields[1] = {databuffers.PHASE1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnosticsCPU(&diag, DiagFields, StartIter);
+    
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        cpuCahnHilliardStep(databuffers.InBracM, databuffers.PHASE1, databuffers.PHASE2, inpparams, CPUWholeGrid());
+        cpuCahnHilliardStep(databuffers.InBracM, databuffers.PHASE2, databuffers.PHASE1, inpparams, CPUWholeGrid());
+        TRACE_SPAN_END(steps, "cpuCahnHilliardStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnosticsCPU(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", iter);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getCahnHilliardCheckpointFields(&databuffers, fields);
+            WriteCheckpoint(OutFileDir, "CAHNHILLIARD", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+        }
+    }
+
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+}
+
+/**
+@brief A function to fully iterate the kobayashi isotropic system on the CPU.
+@param inpparams A KobIsoInputParams structure.
+@param databuffers A KobIsoDataBuffers structure.
+*/
+static inline void iterateKobayashiIsoCPU(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers){
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    double tot_exec_time = 0.0, start ;
+
+    // random noise, the generator is seeded in main() or restored from a checkpoint
+    cl_float noise;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS);
+    cl_float noiseAMP = inpparams.NOISE_AMP ;
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const float *DiagFields[2] = {databuffers.PHASE1, databuffers.TEMP1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnosticsCPU(&diag, DiagFields, StartIter);
+    
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        if((iter%50)==0){
+            noise=noiseAMP*(RandomUniform()-0.5);
+        }else{
+            noise=0.0;
+        }
+
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        cpuKobayashiIsoStep(databuffers.PHASE1, databuffers.PHASE2, databuffers.TEMP1, databuffers.TEMP2, noise, inpparams, CPUWholeGrid());
+        cpuKobayashiIsoStep(databuffers.PHASE2, databuffers.PHASE1, databuffers.TEMP2, databuffers.TEMP1, noise, inpparams, CPUWholeGrid());
+        TRACE_SPAN_END(steps, "cpuKobayashiIsoStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnosticsCPU(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", iter);
+            SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", iter);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getKobayashiIsoCheckpointFields(&databuffers, fields);
+            WriteCheckpoint(OutFileDir, "KOBISO", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+        }
+    }
+
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", ITERS);
+    SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", ITERS);
+    StopDiagnostics(&diag);
+}
+
+/**
+@brief A function to fully iterate the kobayashi anisotropic system on the CPU.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure.
+*/
+static inline void iterateKobayashiAnisoCPU(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    double tot_exec_time = 0.0, start ;
+
+    // Scratch arrays for the gradient and eps*deps/dtheta
+    float *DPDX = Init1DFloatMatrix(0.0);
+    float *DPDY = Init1DFloatMatrix(0.0);
+    float *EPSD = Init1DFloatMatrix(0.0);
+
+    // random noise, the generator is seeded in main() or restored from a checkpoint
+    cl_float noise;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS);
+    cl_float noiseAMP = inpparams.NOISE_AMP ;
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const float *DiagFields[2] = {databuffers.PHASE1, databuffers.TEMP1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnosticsCPU(&diag, DiagFields, StartIter);
+    
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        if((iter%50)==0){
+            noise=noiseAMP*(RandomUniform()-0.5);
+        }else{
+            noise=0.0;
+        }
+
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        cpuKobayashiAnisoStep(databuffers.PHASE1, databuffers.PHASE2, databuffers.TEMP1, databuffers.TEMP2, noise, inpparams, DPDX, DPDY, EPSD, CPUWholeGrid());
+        cpuKobayashiAnisoStep(databuffers.PHASE2, databuffers.PHASE1, databuffers.TEMP2, databuffers.TEMP1, noise, inpparams, DPDX, DPDY, EPSD, CPUWholeGrid());
+        TRACE_SPAN_END(steps, "cpuKobayashiAnisoStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnosticsCPU(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", iter);
+            SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", iter);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getKobayashiAnisoCheckpointFields(&databuffers, fields);
+            WriteCheckpoint(OutFileDir, "KOBANISO", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+        }
+    }
+
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", ITERS);
+    SaveArrayAsync(databuffers.TEMP1, OutFileDir, "TEMP", ITERS);
+    StopDiagnostics(&diag);
+
+    free(DPDX);
+    free(DPDY);
+    free(EPSD);
+}
+
+#endif
+//END OF FILE
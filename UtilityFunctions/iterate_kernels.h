@@ -2,6 +2,10 @@
 @file iterate_kernels.h
 @brief Declares the functions to iterate one and multiple timesteps of evolution for each SYSTEM. 
 
+The drivers enqueue the steps without waiting for them and only synchronise with the device at the save points.
+The execution time is measured between profiling markers enqueued at the save points, so no per-step events are created.
+The fields are saved with SaveBufferAsync(), the device keeps computing while the writer thread of output_writer.h writes the files.
+
 */
 
 #ifndef ITERATE_KERN
@@ -20,7 +24,15 @@
 #include "global_vars.h"
 #include "error_handle.h"
 #include "CL_utility_funcs.h"
-#include "data_writing_funcs.h"
+#include "file_to_program.h"
+#include "output_writer.h"
+#include "checkpoint_funcs.h"
+#include "diagnostics_funcs.h"
+#include "autotune_funcs.h"
+#include "trace_funcs.h"
+
+/// Number of iterations the drivers enqueue between two clFlush() calls. The host does not wait for the device between the save points.
+#define FLUSH_ITERS 64
 
 /**
 @brief One step of evolution in the diffusion system.
@@ -28,7 +40,7 @@
 @param localWS An array with the 2D local work size.
 @param PHASE1buff The input phase buffer.
 @param PHASE2buff The output phase buffer.
-@param events The cl_event s associated with each iteration to profile kernel execution.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
 @param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
 
 Because the function is to be called as many times as the number of iterations, it is declared to be an inline function, which though increases the compiling time but reduces the running time for large number of iterations.
@@ -43,9 +55,284 @@ static inline void DiffusionEvolutionStep(size_t globalWS[2], size_t localWS[2],
     KernErrorHandle(err,"SetKernelArg 1");
     
     // Enqueue the kernel
-    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWS, localWS, 0, NULL, &events[iter]);
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWS, localWS, 0, NULL, event);
     KernErrorHandle(err, "clEnqueueNDRangeKernel EvolKern");
+    TRACE_CL_KERNEL(event, kernel);
+    
+}
+
+// The autotune launch of DiffusionEvolutionStep(), one step
+static cl_int TuneDiffusionStep(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    DiffusionEvolutionStep(globalWS, localWS, t->buff[0], t->buff[1], NULL, 0);
+    return 1 ;
+}
+
+/**
+@brief The number of time steps of the next launch of a temporally blocked kernel.
+@param step The number of time steps already done.
+@param blockSteps The maximum number of steps per launch.
+@return The number of steps, so that a launch neither straddles a save point, a checkpoint or a sample of the diagnostics nor runs past 2*ITERS steps.
+
+Iteration iter is made of the steps 2*iter and 2*iter+1. The outputs are saved after the iterations that are multiples of ITERS/NSAVE, as in the untiled drivers.
+*/
+static inline cl_int TimeBlockLaunchSteps(cl_int step, cl_int blockSteps){
+    cl_int saveEvery = ITERS/NSAVE ;
+    cl_int nextSave = ((step/2 + saveEvery - 1)/saveEvery)*saveEvery ;
+    cl_int stop = 2*nextSave + 2 ;
+    if(stop > 2*ITERS){
+        stop = 2*ITERS ;
+    }
+    if(CheckpointEvery > 0){
+        cl_int nextCheckpoint = (step/(2*CheckpointEvery) + 1)*2*CheckpointEvery ;
+        stop = (nextCheckpoint < stop) ? nextCheckpoint : stop ;
+    }
+    if(DiagnosticsEvery > 0){
+        cl_int nextSample = (step/(2*DiagnosticsEvery) + 1)*2*DiagnosticsEvery ;
+        stop = (nextSample < stop) ? nextSample : stop ;
+    }
+    return (stop - step < blockSteps) ? (stop - step) : blockSteps ;
+}
+
+/**
+@brief NSTEPS steps of evolution in the diffusion system with the temporally blocked kernel.
+@param tblockKern The phase_field_evol_tblock_kern kernel.
+@param globalWS An array with the 2D global work size.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param nsteps The number of time steps of this launch.
+@param maxSteps The number of time steps the local memory is sized for.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
+@param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
+*/
+static inline void DiffusionTimeBlockStep(cl_kernel tblockKern, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_int nsteps, cl_int maxSteps, cl_event *events, cl_int iter){
+    // Error variable
+    cl_int err;       
+    size_t tileBytes = RealBytes()*(localWS[0]+2*maxSteps)*(localWS[1]+2*maxSteps);
+    // Set inner kernel arguments;
+    err = clSetKernelArg(tblockKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(tblockKern, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(tblockKern, 2, sizeof(cl_int), &nsteps);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(tblockKern, 3, tileBytes, NULL);
+    KernErrorHandle(err,"SetKernelArg 3");
+    err = clSetKernelArg(tblockKern, 4, tileBytes, NULL);
+    KernErrorHandle(err,"SetKernelArg 4");
+    
+    // Enqueue the kernel
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, tblockKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel TBlockKern");
+    TRACE_CL_KERNEL(event, tblockKern);
+}
+
+// The autotune launch of DiffusionTimeBlockStep() and its two tiles
+static cl_int TuneDiffusionTimeBlock(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    DiffusionTimeBlockStep(t->kern[0], globalWS, localWS, t->buff[0], t->buff[1], steps, steps, NULL, 0);
+    return steps ;
+}
+static size_t DiffusionTimeBlockBytes(const size_t localWS[2], cl_int steps){
+    return 2*RealBytes()*(localWS[0]+2*steps)*(localWS[1]+2*steps) ;
+}
+
+/**
+@brief A function to fully iterate the diffusion system with the temporally blocked kernel.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure.
+Every launch advances up to TimeBlock steps. The result of a launch lands in either buffer, so the output is saved from whichever buffer is current.
+*/
+static inline void iterateDiffusionTBlockKernel(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    // WG parameters
+    size_t globalWS[2] ;
+    
+    cl_kernel tblockKern = getKernelFromProgram("phase_field_evol_tblock_kern");
+    struct TuneTarget tune = {"phase_field_evol_tblock_kern", {tblockKern, NULL}, {databuffers.PHASE1buff, databuffers.PHASE2buff}, 2,
+                              TuneDiffusionTimeBlock, DiffusionTimeBlockBytes} ;
+    size_t localWS[2] ;
+    cl_int blockSteps = TimeBlock ;
+    ChooseWorkGroup(&tune, localWS, &blockSteps);
+    PadGlobalWorkSize(globalWS, localWS);
+    blockSteps = GetMaxTimeBlock(devices[devID], localWS, 2, blockSteps);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : Temporal blocking: %d steps per launch\n", blockSteps);
+    
+    cl_float tot_exec_time = 0.0f;
+    
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+    
+    cl_mem curBuff = databuffers.PHASE1buff, nextBuff = databuffers.PHASE2buff, tmpBuff ;
+    
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {curBuff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(cl_int step = 2*StartIter ; step < 2*ITERS ; ){
+        cl_int nsteps = TimeBlockLaunchSteps(step, blockSteps);
+        DiffusionTimeBlockStep(tblockKern, globalWS, localWS, curBuff, nextBuff, nsteps, blockSteps, NULL,0);
+        
+        clFlush(queue);
+        
+        step += nsteps ;
+        tmpBuff = curBuff ; curBuff = nextBuff ; nextBuff = tmpBuff ;
+        
+        int iter = step/2 - 1 ;
+        if((step%2 == 0) && DiagnosticsDue(iter)){
+            const cl_mem CurFields[1] = {curBuff} ;
+            SampleDiagnostics(&diag, CurFields, iter+1);
+        }
+        
+        if((step%2 == 0) && (iter %((int)(ITERS/NSAVE)) == 0)){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(curBuff, OutFileDir, "PHASE", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+        }
+        
+        if((step%2 == 0) && CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            // The current field is saved as PHASE1
+            struct DiffusionDataBuffers current = databuffers ;
+            current.PHASE1buff = curBuff ;
+            current.PHASE2buff = nextBuff ;
+            int numFields = getDiffusionCheckpointFields(&current, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "DIFFUSION", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
+    }
+    
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveBufferAsync(curBuff, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    
+    clReleaseKernel(tblockKern);
+}
+
+/**
+@brief One step of evolution in the diffusion system on a 3D grid.
+@param kern3d The phase_field_evol_3d_kern kernel.
+@param globalWS An array with the 2D global work size, the kernel marches in z.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
+@param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
+*/
+static inline void Diffusion3DStep(cl_kernel kern3d, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_event *events, cl_int iter){
+    // Error variable
+    cl_int err;       
+    err = clSetKernelArg(kern3d, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(kern3d, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(kern3d, 2, RealBytes()*(localWS[0]+2)*(localWS[1]+2), NULL);
+    KernErrorHandle(err,"SetKernelArg 2");
+    
+    // Enqueue the kernel
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, kern3d, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel 3DKern");
+    TRACE_CL_KERNEL(event, kern3d);
+}
+
+// The autotune launch of Diffusion3DStep() and its plane tile
+static cl_int TuneDiffusion3D(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    Diffusion3DStep(t->kern[0], globalWS, localWS, t->buff[0], t->buff[1], NULL, 0);
+    return 1 ;
+}
+static size_t PlaneTileBytes(const size_t localWS[2], cl_int steps){
+    (void)steps ;
+    return RealBytes()*(localWS[0]+2)*(localWS[1]+2) ;
+}
+
+/**
+@brief A function to fully iterate the diffusion system on a 3D grid.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure.
+The NDRange covers one plane, every work item marches its column through the NZ planes, see phase_field_evol_3d_kern().
+*/
+static inline void iterateDiffusion3DKernel(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    // WG parameters
+    size_t globalWS[2] ;
+    
+    cl_kernel kern3d = getKernelFromProgram("phase_field_evol_3d_kern");
+    struct TuneTarget tune = {"phase_field_evol_3d_kern", {kern3d, NULL}, {databuffers.PHASE1buff, databuffers.PHASE2buff}, 2,
+                              TuneDiffusion3D, PlaneTileBytes} ;
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : 3D grid of %d planes, 2.5D blocked kernel\n", NZ);
+    
+    cl_float tot_exec_time = 0.0f;
+    
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+    
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
     
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        
+        Diffusion3DStep(kern3d, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, NULL,0);
+        Diffusion3DStep(kern3d, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, NULL,1);
+        
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
+        
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getDiffusionCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "DIFFUSION", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
+    }
+    
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    
+    clReleaseKernel(kern3d);
 }
 
 /**
@@ -53,61 +340,81 @@ static inline void DiffusionEvolutionStep(size_t globalWS[2], size_t localWS[2],
 @param inpparams A DiffusionInputParams structure.
 @param databuffers A DiffusionDataBuffers structure.
 Along with executing the kernel, the function also writes output to output files and profiles the kernel to compute the execution time.
+The temporally blocked kernel runs if TimeBlock is more than 1 in the input file, the 3D kernel if NZ is more than 1.
 */
 static inline void iterateDiffusionKernel(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
-    cl_int err ;
+    if(NZ > 1){
+        iterateDiffusion3DKernel(inpparams, databuffers);
+        return ;
+    }
+    if(TimeBlock > 1){
+        iterateDiffusionTBlockKernel(inpparams, databuffers);
+        return ;
+    }
     // Iterate kernel with a random float
     // WG parameters
-    size_t globalWS[2] = {SIZE, SIZE};
+    size_t globalWS[2] ;
     
-    if(WGsize < 8){
-        WGsize = GetOptimumWGSize(kernel, devices[devID]) ;
-    }
-    size_t localWS[2] = {WGsize,WGsize};
-    printf("   : Work group size: %d\n", WGsize);
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL}, {databuffers.PHASE1buff, databuffers.PHASE2buff}, 2,
+                              TuneDiffusionStep, NULL} ;
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
     
-    // Profiling events
-    cl_event* timing_events ; 
-    timing_events = (cl_event*)malloc(sizeof(cl_event)*2);
     cl_float tot_exec_time = 0.0f;
     
     // Read the buffers and profile the reading time.
-    char OutFileDir[50] ;
-    err = sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%dS_%dITERS", SIZE, ITERS);
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%s_%dITERS", GridLabel(), ITERS);
     mkdir(OutFileDir,0777);
-    printf("   : Enqueuing kernels:\n   : Compute size is %u\n", SIZE*SIZE*ITERS);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
     
-    for(int iter = 0 ; iter < ITERS ; iter++){
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
         
-        DiffusionEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, timing_events,0);
-        DiffusionEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, timing_events,1);
+        DiffusionEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, NULL,0);
+        DiffusionEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, NULL,1);
         
-        clFinish(queue);
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
         
-        tot_exec_time += GetEventExecTime(timing_events[0]) ;
-        tot_exec_time += GetEventExecTime(timing_events[1]) ;
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
         
         if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
             printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
-            
-            err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_TRUE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-            KernErrorHandle(err, "clEnqueueReadBuffer");
-            
-            // Write data to file
-            Write1DMatToFile(OutFileDir, "PHASE",iter,databuffers.PHASE1);
-            
         }
         
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getDiffusionCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "DIFFUSION", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
     }
     
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
     printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
-    err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_TRUE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-    KernErrorHandle(err, "clEnqueueReadBuffer");
-    
-    Write1DMatToFile(OutFileDir, "PHASE",ITERS,databuffers.PHASE1);
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
 
-    
-    
 }
 
 
@@ -120,7 +427,7 @@ static inline void iterateDiffusionKernel(struct DiffusionInputParams inpparams,
 @param TEMP1buff The input temperature buffer.
 @param TEMP2buff The output temperature buffer.
 @param noise The noise amplitide needed to generate randomness in the phase field.
-@param events The cl_event s associated with each iteration to profile kernel execution.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
 @param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
 
 Because the function is to be called as many times as the number of iterations, it is declared to be an inline function, which though increases the compiling time but reduces the running time for large number of iterations.
@@ -141,8 +448,72 @@ static inline void KobayashiEvolutionStep(size_t globalWS[2], size_t localWS[2],
     KernErrorHandle(err,"SetKernelArg 4");
     
     // Enqueue the kernel
-    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWS, localWS, 0, NULL, &events[iter]);
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWS, localWS, 0, NULL, event);
     KernErrorHandle(err, "clEnqueueNDRangeKernel EvolKern");
+    TRACE_CL_KERNEL(event, kernel);
+}
+
+// The autotune launch of KobayashiEvolutionStep(), one step without noise
+static cl_int TuneKobayashiStep(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    KobayashiEvolutionStep(globalWS, localWS, t->buff[0], t->buff[1], t->buff[2], t->buff[3], 0.0f, NULL, 0);
+    return 1 ;
+}
+
+/**
+@brief One step of evolution in the kobayashi anisotropic system with the tiled kernel.
+@param tiledKern The phase_field_evol_tiled_kern kernel.
+@param globalWS An array with the 2D global work size.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param TEMP1buff The input temperature buffer.
+@param TEMP2buff The output temperature buffer.
+@param noise The noise amplitide needed to generate randomness in the phase field.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
+@param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
+
+Same as KobayashiEvolutionStep() plus the three local memory arguments sized from the local work size.
+*/
+static inline void KobayashiTiledEvolutionStep(cl_kernel tiledKern, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem TEMP1buff, cl_mem TEMP2buff, cl_float noise, cl_event *events, cl_int iter){
+    // Error variable
+    cl_int err;       
+    size_t haloCells = (localWS[0]+2)*(localWS[1]+2);
+    // Set inner kernel arguments;
+    err = clSetKernelArg(tiledKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(tiledKern, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(tiledKern, 2, sizeof(cl_mem), &TEMP1buff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(tiledKern, 3, sizeof(cl_mem), &TEMP2buff);
+    KernErrorHandle(err,"SetKernelArg 3");
+    err = clSetKernelArg(tiledKern, 4, sizeof(cl_float), &noise);
+    KernErrorHandle(err,"SetKernelArg 4");
+    err = clSetKernelArg(tiledKern, 5, RealBytes()*(localWS[0]+4)*(localWS[1]+4), NULL);
+    KernErrorHandle(err,"SetKernelArg 5");
+    err = clSetKernelArg(tiledKern, 6, RealBytes()*haloCells, NULL);
+    KernErrorHandle(err,"SetKernelArg 6");
+    err = clSetKernelArg(tiledKern, 7, RealBytes()*4*haloCells, NULL);
+    KernErrorHandle(err,"SetKernelArg 7");
+    
+    // Enqueue the kernel
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, tiledKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel TiledKern");
+    TRACE_CL_KERNEL(event, tiledKern);
+}
+
+// The autotune launch of KobayashiTiledEvolutionStep() and its tiles
+static cl_int TuneKobayashiTiled(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    KobayashiTiledEvolutionStep(t->kern[0], globalWS, localWS, t->buff[0], t->buff[1], t->buff[2], t->buff[3], 0.0f, NULL, 0);
+    return 1 ;
+}
+static size_t KobayashiTiledBytes(const size_t localWS[2], cl_int steps){
+    (void)steps ;
+    return RealBytes()*((localWS[0]+4)*(localWS[1]+4) + 5*(localWS[0]+2)*(localWS[1]+2)) ;
 }
 
 /**
@@ -150,178 +521,575 @@ static inline void KobayashiEvolutionStep(size_t globalWS[2], size_t localWS[2],
 @param inpparams A KobAnisoInputParams structure.
 @param databuffers A KobAnisoDataBuffers structure.
 Along with executing the kernel, the function also writes output to output files and profiles the kernel to compute the execution time.
+The tiled kernel runs if TiledKernels is set in the input file.
 */
 static inline void iterateKobayashiAnisoKernel(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
-    cl_int err ;
     // Iterate kernel with a random float
     // WG parameters
-    size_t globalWS[2] = {SIZE, SIZE};
+    size_t globalWS[2] ;
     
-    if(WGsize < 8){
-        WGsize = GetOptimumWGSize(kernel, devices[devID]) ;
+    cl_kernel tiledKern = NULL ;
+    if(TiledKernels){
+        tiledKern = getKernelFromProgram("phase_field_evol_tiled_kern");
+    }
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff}, 4,
+                              TuneKobayashiStep, NULL} ;
+    if(TiledKernels){
+        tune.name = "phase_field_evol_tiled_kern" ;
+        tune.kern[0] = tiledKern ;
+        tune.launch = TuneKobayashiTiled ;
+        tune.localBytes = KobayashiTiledBytes ;
     }
-    size_t localWS[2] = {WGsize,WGsize};
-    printf("   : Work group size: %d\n", WGsize);
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : %s anisotropic kernel\n", TiledKernels ? "Tiled" : "Untiled");
     
-    // Profiling events
-    cl_event* timing_events ; 
-    timing_events = (cl_event*)malloc(sizeof(cl_event)*2);
     cl_float tot_exec_time = 0.0f;
     
-    // random number generation
-    srand((unsigned int)time(NULL));
+    // random noise, the generator is seeded in main() or restored from a checkpoint
     cl_float noise;
     
     // Read the buffers and profile the reading time.
-    char OutFileDir[50] ;
-    err = sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_%dS_%dITERS",SIZE,ITERS);
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_%s_%dITERS", GridLabel(), ITERS);
     mkdir(OutFileDir,0777);
-    printf("   : Enqueuing kernels:\n   : Compute size is %u\n", SIZE*SIZE*ITERS);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
     cl_float noiseAMP = inpparams.NOISE_AMP ;
     
-    for(int iter = 0 ; iter < ITERS ; iter++){
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const cl_mem DiagFields[2] = {databuffers.PHASE1buff, databuffers.TEMP1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
         if((iter%50)==0){
-            noise=noiseAMP*(((float)rand()/(float)RAND_MAX)-0.5);
+            noise=noiseAMP*(RandomUniform()-0.5);
         }else{
             noise=0.0;
         }
         
-        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, timing_events,0);
-        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, timing_events,1);
+        if(TiledKernels){
+            KobayashiTiledEvolutionStep(tiledKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, NULL,0);
+            KobayashiTiledEvolutionStep(tiledKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, NULL,1);
+        }else{
+            KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, NULL,0);
+            KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, NULL,1);
+        }
         
-        clFinish(queue);
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
         
-        tot_exec_time += GetEventExecTime(timing_events[0]) ;
-        tot_exec_time += GetEventExecTime(timing_events[1]) ;
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
         
         if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            SaveBufferAsync(databuffers.TEMP1buff, OutFileDir, "TEMP", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
             printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
-            
-            err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-            err = clEnqueueReadBuffer(queue, databuffers.TEMP1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.TEMP1, 0, NULL,NULL);
-            KernErrorHandle(err, "clEnqueueReadBuffer");
-            clFinish(queue);
-            
- 
-            Write1DMatToFile(OutFileDir, "PHASE",iter,databuffers.PHASE1);
-            Write1DMatToFile(OutFileDir,"TEMP", iter, databuffers.TEMP1);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getKobayashiAnisoCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "KOBANISO", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
         }
     }
     
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
     printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
-    err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-    err = clEnqueueReadBuffer(queue, databuffers.TEMP1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.TEMP1, 0, NULL,NULL);
-    KernErrorHandle(err, "clEnqueueReadBuffer");
-    clFinish(queue);
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    SaveBufferAsync(databuffers.TEMP1buff, OutFileDir, "TEMP", ITERS);
+    StopDiagnostics(&diag);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+
+}
+
+
+/**
+@brief NSTEPS steps of evolution in the kobayashi isotropic system with the temporally blocked kernel.
+@param tblockKern The phase_field_evol_tblock_kern kernel.
+@param globalWS An array with the 2D global work size.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param TEMP1buff The input temperature buffer.
+@param TEMP2buff The output temperature buffer.
+@param noise The noise amplitide needed to generate randomness in the phase field.
+@param noiseMask Bit s is set if the noise is added in step s of the launch.
+@param nsteps The number of time steps of this launch.
+@param maxSteps The number of time steps the local memory is sized for.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
+@param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
+*/
+static inline void KobayashiTimeBlockStep(cl_kernel tblockKern, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem TEMP1buff, cl_mem TEMP2buff, cl_float noise, cl_int noiseMask, cl_int nsteps, cl_int maxSteps, cl_event *events, cl_int iter){
+    // Error variable
+    cl_int err;       
+    size_t tileBytes = RealBytes()*(localWS[0]+2*maxSteps)*(localWS[1]+2*maxSteps);
+    // Set inner kernel arguments;
+    err = clSetKernelArg(tblockKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(tblockKern, 1, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(tblockKern, 2, sizeof(cl_mem), &TEMP1buff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(tblockKern, 3, sizeof(cl_mem), &TEMP2buff);
+    KernErrorHandle(err,"SetKernelArg 3");
+    err = clSetKernelArg(tblockKern, 4, sizeof(cl_float), &noise);
+    KernErrorHandle(err,"SetKernelArg 4");
+    err = clSetKernelArg(tblockKern, 5, sizeof(cl_int), &noiseMask);
+    KernErrorHandle(err,"SetKernelArg 5");
+    err = clSetKernelArg(tblockKern, 6, sizeof(cl_int), &nsteps);
+    KernErrorHandle(err,"SetKernelArg 6");
+    for(cl_uint arg = 7 ; arg < 11 ; arg++){
+        err = clSetKernelArg(tblockKern, arg, tileBytes, NULL);
+        KernErrorHandle(err,"SetKernelArg local tile");
+    }
     
-    Write1DMatToFile(OutFileDir, "PHASE",ITERS,databuffers.PHASE1);
-    Write1DMatToFile(OutFileDir,"TEMP",ITERS, databuffers.TEMP1);
+    // Enqueue the kernel
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, tblockKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel TBlockKern");
+    TRACE_CL_KERNEL(event, tblockKern);
+}
 
+// The autotune launch of KobayashiTimeBlockStep() and its four tiles
+static cl_int TuneKobayashiTimeBlock(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    KobayashiTimeBlockStep(t->kern[0], globalWS, localWS, t->buff[0], t->buff[1], t->buff[2], t->buff[3], 0.0f, 0, steps, steps, NULL, 0);
+    return steps ;
+}
+static size_t KobayashiTimeBlockBytes(const size_t localWS[2], cl_int steps){
+    return 4*RealBytes()*(localWS[0]+2*steps)*(localWS[1]+2*steps) ;
 }
 
+/**
+@brief A function to fully iterate the kobayashi isotropic system with the temporally blocked kernel.
+@param inpparams A KobIsoInputParams structure.
+@param databuffers A KobIsoDataBuffers structure.
+Every launch advances up to TimeBlock steps. The noise is drawn once per noisy iteration, as in iterateKobayashiIsoKernel(), and passed with a mask of the steps it applies to.
+*/
+static inline void iterateKobayashiIsoTBlockKernel(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers){
+    // WG parameters
+    size_t globalWS[2] ;
+    
+    cl_kernel tblockKern = getKernelFromProgram("phase_field_evol_tblock_kern");
+    struct TuneTarget tune = {"phase_field_evol_tblock_kern", {tblockKern, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff}, 4,
+                              TuneKobayashiTimeBlock, KobayashiTimeBlockBytes} ;
+    size_t localWS[2] ;
+    cl_int blockSteps = TimeBlock ;
+    ChooseWorkGroup(&tune, localWS, &blockSteps);
+    PadGlobalWorkSize(globalWS, localWS);
+    blockSteps = GetMaxTimeBlock(devices[devID], localWS, 4, blockSteps);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : Temporal blocking: %d steps per launch\n", blockSteps);
+    
+    cl_float tot_exec_time = 0.0f;
+    
+    // random noise, the generator is seeded in main() or restored from a checkpoint
+    cl_float noise = 0.0f;
+    cl_int noiseIter = -1 ;
+    
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+    cl_float noiseAMP = inpparams.NOISE_AMP ;
+    
+    cl_mem curPhase = databuffers.PHASE1buff, nextPhase = databuffers.PHASE2buff ;
+    cl_mem curTemp = databuffers.TEMP1buff, nextTemp = databuffers.TEMP2buff, tmpBuff ;
+    
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const cl_mem DiagFields[2] = {curPhase, curTemp} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(cl_int step = 2*StartIter ; step < 2*ITERS ; ){
+        cl_int nsteps = TimeBlockLaunchSteps(step, blockSteps);
+        
+        // Noisy iterations are 50 iterations apart, a launch covers at most one of them
+        cl_int noiseMask = 0 ;
+        for(cl_int s = 0 ; s < nsteps ; s++){
+            cl_int iter = (step + s)/2 ;
+            if((iter%50)==0){
+                if(iter != noiseIter){
+                    noise=noiseAMP*(RandomUniform()-0.5);
+                    noiseIter = iter ;
+                }
+                noiseMask |= 1 << s ;
+            }
+        }
+        
+        KobayashiTimeBlockStep(tblockKern, globalWS, localWS, curPhase, nextPhase, curTemp, nextTemp, noise, noiseMask, nsteps, blockSteps, NULL,0);
+        
+        clFlush(queue);
+        
+        step += nsteps ;
+        tmpBuff = curPhase ; curPhase = nextPhase ; nextPhase = tmpBuff ;
+        tmpBuff = curTemp ; curTemp = nextTemp ; nextTemp = tmpBuff ;
+        
+        int iter = step/2 - 1 ;
+        if((step%2 == 0) && DiagnosticsDue(iter)){
+            const cl_mem CurFields[2] = {curPhase, curTemp} ;
+            SampleDiagnostics(&diag, CurFields, iter+1);
+        }
+        
+        if((step%2 == 0) && (iter %((int)(ITERS/NSAVE)) == 0)){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(curPhase, OutFileDir, "PHASE", iter);
+            SaveBufferAsync(curTemp, OutFileDir, "TEMP", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+        }
+        
+        if((step%2 == 0) && CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            // The current fields are saved as PHASE1/TEMP1
+            struct KobIsoDataBuffers current = databuffers ;
+            current.PHASE1buff = curPhase ;
+            current.PHASE2buff = nextPhase ;
+            current.TEMP1buff = curTemp ;
+            current.TEMP2buff = nextTemp ;
+            int numFields = getKobayashiIsoCheckpointFields(&current, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "KOBISO", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
+    }
+    
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveBufferAsync(curPhase, OutFileDir, "PHASE", ITERS);
+    SaveBufferAsync(curTemp, OutFileDir, "TEMP", ITERS);
+    StopDiagnostics(&diag);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    
+    clReleaseKernel(tblockKern);
+}
 
 /**
 @brief A function to fully iterate the kobayashi kernels.
 @param inpparams A KobIsoInputParams structure.
 @param databuffers A KobIsoDataBuffers structure.
 Along with executing the kernel, the function also writes output to output files and profiles the kernel to compute the execution time.
+The temporally blocked kernel runs if TimeBlock is more than 1 in the input file.
 */
 static inline void iterateKobayashiIsoKernel(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers){
-    cl_int err ;
+    if(TimeBlock > 1){
+        iterateKobayashiIsoTBlockKernel(inpparams, databuffers);
+        return ;
+    }
     // Iterate kernel with a random float
     // WG parameters
-    size_t globalWS[2] = {SIZE, SIZE};
+    size_t globalWS[2] ;
     
-    if(WGsize < 8){
-        WGsize = GetOptimumWGSize(kernel, devices[devID]) ;
-    }
-    size_t localWS[2] = {WGsize,WGsize};
-    printf("   : Work group size: %d\n", WGsize);
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff}, 4,
+                              TuneKobayashiStep, NULL} ;
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
     
-    // Profiling events
-    cl_event* timing_events ; 
-    timing_events = (cl_event*)malloc(sizeof(cl_event)*2);
     cl_float tot_exec_time = 0.0f;
     
-    // random number generation
-    srand((unsigned int)time(NULL));
+    // random noise, the generator is seeded in main() or restored from a checkpoint
     cl_float noise;
     
     // Read the buffers and profile the reading time.
-    char OutFileDir[50] ;
-    err = sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_%dS_%dITERS",SIZE,ITERS);
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_%s_%dITERS", GridLabel(), ITERS);
     mkdir(OutFileDir,0777);
-    printf("   : Enqueuing kernels:\n   : Compute size is %u\n", SIZE*SIZE*ITERS);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
     cl_float noiseAMP = inpparams.NOISE_AMP ;
     
-    for(int iter = 0 ; iter < ITERS ; iter++){
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[2] = {"PHASE", "TEMP"} ;
+    const cl_mem DiagFields[2] = {databuffers.PHASE1buff, databuffers.TEMP1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 2);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
         if((iter%50)==0){
-            noise=noiseAMP*(((float)rand()/(float)RAND_MAX)-0.5);
+            noise=noiseAMP*(RandomUniform()-0.5);
         }else{
             noise=0.0;
         }
         
-        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, timing_events,0);
-        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, timing_events,1);
+        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.TEMP1buff, databuffers.TEMP2buff, noise, NULL,0);
+        KobayashiEvolutionStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.TEMP2buff, databuffers.TEMP1buff, noise, NULL,1);
         
-        clFinish(queue);
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
         
-        tot_exec_time += GetEventExecTime(timing_events[0]) ;
-        tot_exec_time += GetEventExecTime(timing_events[1]) ;
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
         
         if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            SaveBufferAsync(databuffers.TEMP1buff, OutFileDir, "TEMP", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
             printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
-            
-            err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-            err = clEnqueueReadBuffer(queue, databuffers.TEMP1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.TEMP1, 0, NULL,NULL);
-            KernErrorHandle(err, "clEnqueueReadBuffer");
-            clFinish(queue);
-            
-            Write1DMatToFile(OutFileDir, "PHASE",iter,databuffers.PHASE1);
-            Write1DMatToFile(OutFileDir,"TEMP",iter, databuffers.TEMP1);
-
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getKobayashiIsoCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "KOBISO", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
         }
     }
     
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
     printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
-    err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-    err = clEnqueueReadBuffer(queue, databuffers.TEMP1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.TEMP1, 0, NULL,NULL);
-    KernErrorHandle(err, "clEnqueueReadBuffer");
-    clFinish(queue);
-    
-    Write1DMatToFile(OutFileDir, "PHASE",ITERS,databuffers.PHASE1);
-    Write1DMatToFile(OutFileDir,"TEMP",ITERS, databuffers.TEMP1);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    SaveBufferAsync(databuffers.TEMP1buff, OutFileDir, "TEMP", ITERS);
+    StopDiagnostics(&diag);
 
 
 }
 
 
 /**
-@brief One step of evolution in the cahn-hilliard (spinodal decomposition) system.
+@brief One step of evolution in the cahn-hilliard (spinodal decomposition) system with the tiled kernel.
 @param globalWS An array with the 2D global work size.
 @param localWS An array with the 2D local work size.
 @param PHASE1buff The input phase buffer.
 @param PHASE2buff The output phase buffer.
-@param InBracMbuff The temporary value holder, inner brackets matrix buffer.
-@param events The cl_event s associated with each iteration to profile kernel execution.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled.
 @param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
 
+The tiled phase_field_evol_kern takes two local memory arguments sized from the local work size.
 Because the function is to be called as many times as the number of iterations, it is declared to be an inline function, which though increases the compiling time but reduces the running time for large number of iterations.
 */
-static inline void CahnHilliardEvolutinStep(size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem InBracMbuff, cl_event *events, cl_int iter){
+static inline void CahnHilliardEvolutinStep(size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_event *events, cl_int iter){
     // Error variable
     cl_int err;       
     // Set inner kernel arguments;
-    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &InBracMbuff);
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &PHASE1buff);
     KernErrorHandle(err,"SetKernelArg 0");
-    err = clSetKernelArg(kernel, 1, sizeof(cl_mem), &PHASE1buff);
+    err = clSetKernelArg(kernel, 1, sizeof(cl_mem), &PHASE2buff);
     KernErrorHandle(err,"SetKernelArg 1");
-    err = clSetKernelArg(kernel, 2, sizeof(cl_mem), &PHASE2buff);
+    err = clSetKernelArg(kernel, 2, RealBytes()*(localWS[0]+4)*(localWS[1]+4), NULL);
     KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(kernel, 3, RealBytes()*(localWS[0]+2)*(localWS[1]+2), NULL);
+    KernErrorHandle(err,"SetKernelArg 3");
     // Enqueue the kernel
-    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWS, localWS, 0, NULL, &events[iter]);
+    cl_event *event = TRACE_CL_EVENT(events ? &events[iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWS, localWS, 0, NULL, event);
     KernErrorHandle(err, "clEnqueueNDRangeKernel EvolKern");
+    TRACE_CL_KERNEL(event, kernel);
+    
+}
+
+// The autotune launch of CahnHilliardEvolutinStep() and its two tiles
+static cl_int TuneCahnHilliardTiled(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    CahnHilliardEvolutinStep(globalWS, localWS, t->buff[0], t->buff[1], NULL, 0);
+    return 1 ;
+}
+static size_t CahnHilliardTiledBytes(const size_t localWS[2], cl_int steps){
+    (void)steps ;
+    return RealBytes()*((localWS[0]+4)*(localWS[1]+4) + (localWS[0]+2)*(localWS[1]+2)) ;
+}
+
+/**
+@brief One step of evolution in the cahn-hilliard system with the two kernels ch_inner_kern and ch_outer_kern.
+@param innerKern The ch_inner_kern kernel.
+@param outerKern The ch_outer_kern kernel.
+@param globalWS An array with the 2D global work size.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param InBracMbuff The temporary value holder, inner brackets matrix buffer.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled. Two events per step.
+@param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
+
+The in-order queue completes the inner kernel on the whole grid before the outer kernel starts.
+*/
+static inline void CahnHilliardTwoKernelStep(cl_kernel innerKern, cl_kernel outerKern, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem InBracMbuff, cl_event *events, cl_int iter){
+    // Error variable
+    cl_int err;       
+    // Inner bracket
+    err = clSetKernelArg(innerKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(innerKern, 1, sizeof(cl_mem), &InBracMbuff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    cl_event *event = TRACE_CL_EVENT(events ? &events[2*iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, innerKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel InnerKern");
+    TRACE_CL_KERNEL(event, innerKern);
+    // Outer evolution
+    err = clSetKernelArg(outerKern, 0, sizeof(cl_mem), &InBracMbuff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(outerKern, 1, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(outerKern, 2, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    event = TRACE_CL_EVENT(events ? &events[2*iter+1] : NULL);
+    err = clEnqueueNDRangeKernel(queue, outerKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel OuterKern");
+    TRACE_CL_KERNEL(event, outerKern);
+}
+
+// The autotune launch of CahnHilliardTwoKernelStep()
+static cl_int TuneCahnHilliardTwoKernel(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    CahnHilliardTwoKernelStep(t->kern[0], t->kern[1], globalWS, localWS, t->buff[0], t->buff[1], t->buff[2], NULL, 0);
+    return 1 ;
+}
+
+/**
+@brief One step of evolution in the cahn-hilliard system on a 3D grid with the two kernels ch_inner_3d_kern and ch_outer_3d_kern.
+@param innerKern The ch_inner_3d_kern kernel.
+@param outerKern The ch_outer_3d_kern kernel.
+@param globalWS An array with the 2D global work size, the kernels march in z.
+@param localWS An array with the 2D local work size.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+@param InBracMbuff The temporary value holder, inner brackets matrix buffer.
+@param events The cl_event s associated with each iteration to profile kernel execution, or NULL when the step is not profiled. Two events per step.
+@param iter The iteration index. Whether its the 1st, 2nd or 56th iteration.
+*/
+static inline void CahnHilliard3DStep(cl_kernel innerKern, cl_kernel outerKern, size_t globalWS[2], size_t localWS[2],  cl_mem PHASE1buff, cl_mem PHASE2buff, cl_mem InBracMbuff, cl_event *events, cl_int iter){
+    // Error variable
+    cl_int err;       
+    size_t tileBytes = RealBytes()*(localWS[0]+2)*(localWS[1]+2);
+    // Inner bracket
+    err = clSetKernelArg(innerKern, 0, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(innerKern, 1, sizeof(cl_mem), &InBracMbuff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(innerKern, 2, tileBytes, NULL);
+    KernErrorHandle(err,"SetKernelArg 2");
+    cl_event *event = TRACE_CL_EVENT(events ? &events[2*iter] : NULL);
+    err = clEnqueueNDRangeKernel(queue, innerKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel Inner3DKern");
+    TRACE_CL_KERNEL(event, innerKern);
+    // Outer evolution
+    err = clSetKernelArg(outerKern, 0, sizeof(cl_mem), &InBracMbuff);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(outerKern, 1, sizeof(cl_mem), &PHASE1buff);
+    KernErrorHandle(err,"SetKernelArg 1");
+    err = clSetKernelArg(outerKern, 2, sizeof(cl_mem), &PHASE2buff);
+    KernErrorHandle(err,"SetKernelArg 2");
+    err = clSetKernelArg(outerKern, 3, tileBytes, NULL);
+    KernErrorHandle(err,"SetKernelArg 3");
+    event = TRACE_CL_EVENT(events ? &events[2*iter+1] : NULL);
+    err = clEnqueueNDRangeKernel(queue, outerKern, 2, NULL, globalWS, localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel Outer3DKern");
+    TRACE_CL_KERNEL(event, outerKern);
+}
+
+// The autotune launch of CahnHilliard3DStep(), both kernels use one plane tile
+static cl_int TuneCahnHilliard3D(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)steps ;
+    CahnHilliard3DStep(t->kern[0], t->kern[1], globalWS, localWS, t->buff[0], t->buff[1], t->buff[2], NULL, 0);
+    return 1 ;
+}
+
+/**
+@brief A function to fully iterate the cahn-Hilliard system on a 3D grid.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+The NDRange covers one plane, every work item marches its column through the NZ planes, see ch_inner_3d_kern().
+*/
+static inline void iterateCahnHilliard3DKernel(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    // WG parameters
+    size_t globalWS[2] ;
+    
+    cl_kernel innerKern = getKernelFromProgram("ch_inner_3d_kern");
+    cl_kernel outerKern = getKernelFromProgram("ch_outer_3d_kern");
+    struct TuneTarget tune = {"ch_inner_3d_kern+ch_outer_3d_kern", {innerKern, outerKern},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff}, 3,
+                              TuneCahnHilliard3D, PlaneTileBytes} ;
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : 3D grid of %d planes, 2.5D blocked two-kernel step\n", NZ);
+    
+    cl_float tot_exec_time = 0.0f;
+    
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+    
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+    
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        
+        CahnHilliard3DStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff, NULL,0);
+        CahnHilliard3DStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.InBracMbuff, NULL,1);
+        
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
+        
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
+        
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getCahnHilliardCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "CAHNHILLIARD", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
+    }
     
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+    
+    clReleaseKernel(innerKern);
+    clReleaseKernel(outerKern);
 }
 
 /**
@@ -329,58 +1097,102 @@ static inline void CahnHilliardEvolutinStep(size_t globalWS[2], size_t localWS[2
 @param inpparams A CahnHilliardInputParams structure.
 @param databuffers A CahnHilliardDataBuffers structure.
 Along with executing the kernel, the function also writes output to output files and profiles the kernel to compute the execution time.
+The tiled kernel runs if TiledKernels is set in the input file, the two-kernel step otherwise. A 3D grid runs iterateCahnHilliard3DKernel().
 */
 static inline void iterateCahnHilliardKernel(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    if(NZ > 1){
+        iterateCahnHilliard3DKernel(inpparams, databuffers);
+        return ;
+    }
     
-    cl_int err ;
     // Iterate kernel with a random float
     // WG parameters
-    size_t globalWS[2] = {SIZE, SIZE};
+    size_t globalWS[2] ;
     
-    if(WGsize < 8){
-        WGsize = GetOptimumWGSize(kernel, devices[devID]) ;
+    // The two-kernel step
+    cl_kernel innerKern = NULL, outerKern = NULL ;
+    if(!TiledKernels){
+        innerKern = getKernelFromProgram("ch_inner_kern");
+        outerKern = getKernelFromProgram("ch_outer_kern");
     }
-    size_t localWS[2] = {WGsize,WGsize};
-    printf("   : Work group size: %d\n", WGsize);
+    struct TuneTarget tune = {"phase_field_evol_kern", {kernel, NULL},
+                              {databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff}, 3,
+                              TuneCahnHilliardTiled, CahnHilliardTiledBytes} ;
+    if(!TiledKernels){
+        tune.name = "ch_inner_kern+ch_outer_kern" ;
+        tune.kern[0] = innerKern ;
+        tune.kern[1] = outerKern ;
+        tune.launch = TuneCahnHilliardTwoKernel ;
+        tune.localBytes = NULL ;
+    }
+    size_t localWS[2] ;
+    ChooseWorkGroup(&tune, localWS, NULL);
+    PadGlobalWorkSize(globalWS, localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)localWS[0], (unsigned long)localWS[1]);
+    printf("   : %s Cahn-Hilliard step\n", TiledKernels ? "Tiled" : "Two-kernel");
     
-    // Profiling events
-    cl_event* timing_events ; 
-    timing_events = (cl_event*)malloc(sizeof(cl_event)*2);
     cl_float tot_exec_time = 0.0f;
        
     // Read the buffers and profile the reading time.
-    char OutFileDir[50] ;
-    err = sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_%dS_%dITERS",SIZE,ITERS);
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_%s_%dITERS", GridLabel(), ITERS);
     mkdir(OutFileDir,0777);
-    printf("   : Enqueuing kernels:\n   : Compute size is %u\n", SIZE*SIZE*ITERS);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+    
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
     
-    for(int iter = 0 ; iter < ITERS ; iter++){
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
         
-        CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff, timing_events,0);
-        CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.InBracMbuff, timing_events,1);
+        if(TiledKernels){
+            CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, NULL,0);
+            CahnHilliardEvolutinStep(globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, NULL,1);
+        }else{
+            CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE1buff, databuffers.PHASE2buff, databuffers.InBracMbuff, NULL,0);
+            CahnHilliardTwoKernelStep(innerKern, outerKern, globalWS, localWS, databuffers.PHASE2buff, databuffers.PHASE1buff, databuffers.InBracMbuff, NULL,1);
+        }
         
-        clFinish(queue);
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
         
-        tot_exec_time += GetEventExecTime(timing_events[0]) ;
-        tot_exec_time += GetEventExecTime(timing_events[1]) ;
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
         
         if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
             printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
-            
-            err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-            KernErrorHandle(err, "clEnqueueReadBuffer");
-            clFinish(queue);
-            
-            Write1DMatToFile(OutFileDir, "PHASE",iter,databuffers.PHASE1);
+        }
+        
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getCahnHilliardCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "CAHNHILLIARD", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
         }
     }
     
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
     printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
-    err = clEnqueueReadBuffer(queue, databuffers.PHASE1buff, CL_FALSE, 0, sizeof(float)*SIZE*SIZE, databuffers.PHASE1, 0, NULL,NULL);
-    KernErrorHandle(err, "clEnqueueReadBuffer");
-    clFinish(queue);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
     
-    Write1DMatToFile(OutFileDir, "PHASE",ITERS,databuffers.PHASE1);
+    if(!TiledKernels){
+        clReleaseKernel(innerKern);
+        clReleaseKernel(outerKern);
+    }
 }
 
 
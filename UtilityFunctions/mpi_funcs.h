@@ -0,0 +1,464 @@
+/**
+@file mpi_funcs.h
+@brief Declares the distributed mode: the grid is split into blocks over MPI processes.
+
+Built with `make build MPI=1` (the mpicc compiler and -DUSE_MPI) the program runs under mpirun, e.g.
+\code
+mpirun -np 4 ./mainfile --system KOBANISO --cpu
+\endcode
+With more than one process the whole grid, GridNX x GridNY cells, is split into a 2D grid of blocks, one per process, as equal
+as possible and with more blocks along the longer side. Every process holds its block with HALO cells on every side, where
+HALO is the reach of one step of the stencil of the system, and NX, NY, PITCH and FIELD_CELLS become the size of these arrays:
+\code
+columns [0, HALO)                 halo, cells of the blocks to the left
+columns [HALO, HALO+nx)           the block, cells BlockX0+HALO ... BlockX0+HALO+nx-1 of the whole grid
+columns [HALO+nx, 2*HALO+nx)      halo, cells of the blocks to the right
+\endcode
+and likewise for the rows. The CPU kernels of cpu_kernels.h step the blocks: the periodic systems wrap around the arrays,
+which only changes halo cells, and the Kobayashi systems place their boundaries and noise with the coordinates of the whole grid.
+
+Every step the halos of the input fields are exchanged with the 8 neighbouring blocks by non-blocking sends and receives.
+While the messages are in flight the cells of the block that only read cells of the block are updated, the rim of HALO
+cells along the edges of the block is updated when the halos have arrived.
+
+The output files are written collectively with MPI-IO, every process writes its block into the one file of the whole grid.
+Distributed runs write .raw (OutDataFileType 2) or binary .vtk (3) files, the other types are written as .raw.
+They use the CPU backend, without --restart, --ensemble, --bench or --multi-device, on 2D grids, and write no checkpoints.
+*/
+
+#ifndef MPI_FUNCS
+#define MPI_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include "global_vars.h"
+#include "CL_utility_funcs.h"
+#include "cpu_kernels.h"
+#include "data_manip_funcs.h"
+#include "data_writing_funcs.h"
+
+/// Number of MPI processes, 1 without MPI.
+int NumProcs = 1 ;
+/// The rank of this process, 0 without MPI.
+int ProcRank = 0 ;
+
+/**
+@brief Starts MPI. The output of all but the first process is discarded.
+@param argc The argc of main().
+@param argv The argv of main().
+*/
+void StartMPI(int *argc, char ***argv){
+#ifdef USE_MPI
+    MPI_Init(argc, argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &NumProcs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+    if(ProcRank > 0){
+        if(freopen("/dev/null", "w", stdout) == NULL){
+            printf("Error: cannot silence process %d\n", ProcRank);
+        }
+    }
+#endif
+}
+
+/**
+@brief Stops MPI.
+*/
+void StopMPI(){
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
+}
+
+/**
+@brief Ends MPI on an error exit of main(), so that every process of a distributed run stops cleanly after printing the error.
+@return 1, the exit status of main().
+*/
+int FailMPI(){
+    StopMPI();
+    return 1 ;
+}
+
+#ifdef USE_MPI
+
+/// The block of the grid held by this process.
+struct MPIBlock{
+    /// The cartesian communicator of the blocks, dimension 0 is y.
+    MPI_Comm comm ;
+    /// Number of blocks in y and x.
+    int dims[2] ;
+    /// Coordinates of this block in y and x.
+    int coords[2] ;
+    /// Number of cells of the block in x and y, without the halo.
+    int nx, ny ;
+    /// Width of the halo.
+    int halo ;
+    /// The ranks of the 8 neighbouring blocks, direction d = 3*(dy+1)+(dx+1), MPI_PROC_NULL past a fixed boundary.
+    int nbr[9] ;
+    /// The cells of the block sent to the neighbour in each direction.
+    MPI_Datatype send[9] ;
+    /// The halo cells received from the neighbour in each direction.
+    MPI_Datatype recv[9] ;
+    /// The cells of the block in the whole grid, the view of the output files.
+    MPI_Datatype fileType ;
+};
+
+/// The block of this process, set by SplitGridMPI().
+struct MPIBlock Block ;
+
+/**
+@brief The cells of the arrays next to the edge of the block in one direction.
+@param d The direction, 3*(dy+1)+(dx+1).
+@param halo 1 for the halo cells, 0 for the cells of the block along that edge.
+@return The MPI datatype of the cells, committed.
+*/
+static MPI_Datatype HaloType(int d, int halo){
+    int R = Block.halo ;
+    int dir[2] = {d/3 - 1, d%3 - 1} ;
+    int n[2] = {Block.ny, Block.nx} ;
+    int sizes[2] = {NY, PITCH}, subsizes[2], starts[2] ;
+    for(int k = 0 ; k < 2 ; k++){
+        subsizes[k] = (dir[k] == 0) ? n[k] : R ;
+        if(dir[k] < 0){
+            starts[k] = halo ? 0 : R ;
+        }else if(dir[k] == 0){
+            starts[k] = R ;
+        }else{
+            starts[k] = halo ? R + n[k] : n[k] ;
+        }
+    }
+    MPI_Datatype type ;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &type);
+    MPI_Type_commit(&type);
+    return type ;
+}
+
+/**
+@brief Splits the whole grid into blocks, one per process, and makes NX, NY and PITCH the size of the arrays of the block.
+@param halo The reach of one step of the stencil, the width of the halo.
+@param periodic 1 if the boundaries of the grid are periodic.
+
+Also gives every process the seed of the first process, so the random initial fields and the noise are the same as in a single process run.
+@return 0, or 1 if the blocks are too small for the halo. Every process finds the same result.
+*/
+int SplitGridMPI(int halo, int periodic){
+    Block.halo = halo ;
+    Block.dims[0] = Block.dims[1] = 0 ;
+    MPI_Dims_create(NumProcs, 2, Block.dims);
+    // MPI_Dims_create() puts the larger count first, give it to the longer side
+    if((GridNX > GridNY) != (Block.dims[1] > Block.dims[0])){
+        int tmp = Block.dims[0] ;
+        Block.dims[0] = Block.dims[1] ;
+        Block.dims[1] = tmp ;
+    }
+    int periods[2] = {periodic, periodic} ;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, Block.dims, periods, 0, &Block.comm);
+    MPI_Cart_coords(Block.comm, ProcRank, 2, Block.coords);
+
+    int cy = Block.coords[0], cx = Block.coords[1] ;
+    int py = Block.dims[0], px = Block.dims[1] ;
+    Block.ny = GridNY/py + ((cy < GridNY%py) ? 1 : 0) ;
+    Block.nx = GridNX/px + ((cx < GridNX%px) ? 1 : 0) ;
+    int y0 = cy*(GridNY/py) + ((cy < GridNY%py) ? cy : GridNY%py) ;
+    int x0 = cx*(GridNX/px) + ((cx < GridNX%px) ? cx : GridNX%px) ;
+    if(GridNX/px < 2*halo || GridNY/py < 2*halo){
+        printf("Error: the %d x %d blocks of the %d processes are smaller than %d cells\n", GridNX/px, GridNY/py, NumProcs, 2*halo);
+        return 1 ;
+    }
+    printf("   : %d processes, %d x %d blocks of about %d x %d cells, halo %d\n", NumProcs, px, py, Block.nx, Block.ny, halo);
+
+    // The arrays of the block
+    NX = Block.nx + 2*halo ;
+    NY = Block.ny + 2*halo ;
+    PITCH = ((NX + PITCH_ALIGN - 1)/PITCH_ALIGN)*PITCH_ALIGN ;
+    BlockX0 = x0 - halo ;
+    BlockY0 = y0 - halo ;
+
+    for(int d = 0 ; d < 9 ; d++){
+        int c[2] = {cy + d/3 - 1, cx + d%3 - 1} ;
+        if(d == 4){
+            Block.nbr[d] = MPI_PROC_NULL ;
+            continue ;
+        }
+        if(!periodic && (c[0] < 0 || c[0] >= py || c[1] < 0 || c[1] >= px)){
+            Block.nbr[d] = MPI_PROC_NULL ;
+        }else{
+            c[0] = (c[0] + py)%py ;
+            c[1] = (c[1] + px)%px ;
+            MPI_Cart_rank(Block.comm, c, &Block.nbr[d]);
+        }
+        Block.send[d] = HaloType(d, 0);
+        Block.recv[d] = HaloType(d, 1);
+    }
+    int sizes[2] = {GridNY, GridNX}, subsizes[2] = {Block.ny, Block.nx}, starts[2] = {y0, x0} ;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &Block.fileType);
+    MPI_Type_commit(&Block.fileType);
+
+    MPI_Bcast(&RNGState, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if(OutDataFileType != 2 && OutDataFileType != 3){
+        printf("   : Distributed runs write .raw or binary .vtk files, OutDataFileType %d is written as .raw\n", OutDataFileType);
+        OutDataFileType = 2 ;
+    }
+    if(NumOutputSpecs > 0 || !FullOutput){
+        printf("   : Distributed runs write the whole fields, the OutputROI and OutputDecimate outputs are not written\n");
+        NumOutputSpecs = 0 ;
+        FullOutput = 1 ;
+    }    return 0 ;
+}
+
+/// The fields and parameters of one step of a block.
+struct MPIStepArgs{
+    /// The input parameters struct of the system.
+    const void *params ;
+    /// The input fields, phase and temperature.
+    const float *in[2] ;
+    /// The output fields.
+    float *out[2] ;
+    /// The scratch arrays of the system.
+    float *scratch[3] ;
+    /// The noise of the step.
+    cl_float noise ;
+};
+
+/**
+@brief One step of all the blocks, the halo exchange overlapped with the update of the inside of the block.
+@param args The fields of the step, the halos of args->in are exchanged.
+@param numFields The number of input fields.
+@param step Updates a rectangle of cells of the arrays.
+*/
+static void MPIStep(const struct MPIStepArgs *args, int numFields, void (*step)(const struct MPIStepArgs *args, struct CPURect R)){
+    MPI_Request req[36] ;
+    int n = 0 ;
+    for(int f = 0 ; f < numFields ; f++){
+        float *field = (float*)args->in[f] ;
+        for(int d = 0 ; d < 9 ; d++){
+            if(d == 4){
+                continue ;
+            }
+            // A message sent in direction d arrives from direction 8-d
+            MPI_Irecv(field, 1, Block.recv[d], Block.nbr[d], 9*f + 8-d, Block.comm, &req[n++]);
+            MPI_Isend(field, 1, Block.send[d], Block.nbr[d], 9*f + d, Block.comm, &req[n++]);
+        }
+    }
+    int R = Block.halo ;
+    struct CPURect inside = {2*R, NX-2*R, 2*R, NY-2*R} ;
+    step(args, inside);
+    MPI_Waitall(n, req, MPI_STATUSES_IGNORE);
+    struct CPURect top = {R, NX-R, R, 2*R}, bottom = {R, NX-R, NY-2*R, NY-R} ;
+    struct CPURect left = {R, 2*R, 2*R, NY-2*R}, right = {NX-2*R, NX-R, 2*R, NY-2*R} ;
+    step(args, top);
+    step(args, bottom);
+    step(args, left);
+    step(args, right);
+}
+
+/**
+@brief Writes the block of every process into one output file, collectively.
+@param MAT The field of the block, halo included.
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+
+The first process writes the header of the file, then every process writes its cells with MPI_File_write_all().
+*/
+void WriteFieldMPI(const float *MAT, const char OutFileDir[], const char type[], int iter){
+    char OutFileName[300] ;
+    int vtk = (OutDataFileType == 3) ;
+    sprintf(OutFileName, "%s/%s_%d.%s", OutFileDir, type, iter, vtk ? "vtk" : "raw");
+    long headerBytes = 0 ;
+    if(ProcRank == 0){
+        FILE *OutFile = OpenOutFile(OutFileName, "wb");
+        int ok = 1 ;
+        struct FieldShape grid = GridShape() ;
+        if(vtk){
+            WriteVTKHeader(OutFile, type, "BINARY", &grid);
+        }else{
+            unsigned char header[64] ;
+            MakeRawHeader(header, type, iter, &grid);
+            ok = fwrite(header, 1, sizeof(header), OutFile) == sizeof(header) ;
+        }
+        headerBytes = ftell(OutFile);
+        CloseOutFile(OutFile, OutFileName, ok);
+    }
+    MPI_Bcast(&headerBytes, 1, MPI_LONG, 0, Block.comm);
+
+    // The cells of the block, packed in the byte order of the file
+    int R = Block.halo ;
+    size_t cells = (size_t)Block.nx*Block.ny ;
+    int swap = (vtk == HostIsLittleEndian()) ;
+    float *data = (float*)malloc(sizeof(float)*cells);
+    for(int y = 0 ; y < Block.ny ; y++){
+        const float *row = MAT + (size_t)PITCH*(y+R) + R ;
+        if(swap){
+            SwapBytes32(data + (size_t)Block.nx*y, row, Block.nx);
+        }else{
+            memcpy(data + (size_t)Block.nx*y, row, sizeof(float)*Block.nx);
+        }
+    }
+
+    MPI_File fh ;
+    int err = MPI_File_open(Block.comm, OutFileName, MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    if(err == MPI_SUCCESS){
+        MPI_File_set_view(fh, headerBytes, MPI_FLOAT, Block.fileType, "native", MPI_INFO_NULL);
+        err = MPI_File_write_all(fh, data, (int)cells, MPI_FLOAT, MPI_STATUS_IGNORE);
+        MPI_File_close(&fh);
+    }
+    free(data);
+    if(err != MPI_SUCCESS){
+        printf("Error in writing to OutputFile %s\n", OutFileName);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if(vtk && ProcRank == 0){
+        FILE *OutFile = OpenOutFile(OutFileName, "ab");
+        CloseOutFile(OutFile, OutFileName, fprintf(OutFile, "\n") == 1);
+    }
+    printf("   : Completed writing data to file %s\n",OutFileName);
+}
+
+/**
+@brief Iterates the blocks and saves the fields.
+@param OutFileDir Name of the outputfile directory, made by the first process.
+@param args The step arguments, params and scratch set.
+@param F1 The fields at the save points, phase and temperature.
+@param F2 The other fields of the ping-pong.
+@param types The names of the fields in the output files.
+@param numFields The number of fields, 1 or 2.
+@param step Updates a rectangle of cells of the arrays.
+@param noiseAMP The amplitude of the noise drawn every 50 iterations, 0 for the systems without noise.
+*/
+static void iterateBlocksMPI(const char OutFileDir[], struct MPIStepArgs *args, float *F1[], float *F2[], const char *types[], int numFields,
+        void (*step)(const struct MPIStepArgs *args, struct CPURect R), cl_float noiseAMP){
+    if(ProcRank == 0){
+        mkdir(OutFileDir,0777);
+    }
+    MPI_Barrier(Block.comm);
+    printf("   : CPU backend with %d processes of %d threads\n", NumProcs, CPUNumThreads());
+    printf("   : Compute size is %lu\n", (unsigned long)GridNX*GridNY*ITERS);
+    double tot_exec_time = 0.0, start ;
+
+    for(int iter = 0 ; iter < ITERS ; iter++){
+        if(noiseAMP != 0.0f){
+            // The same random numbers on every process
+            args->noise = ((iter%50)==0) ? noiseAMP*(RandomUniform()-0.5) : 0.0 ;
+        }
+        start = MPI_Wtime();
+        for(int f = 0 ; f < numFields ; f++){
+            args->in[f] = F1[f] ;
+            args->out[f] = F2[f] ;
+        }
+        MPIStep(args, numFields, step);
+        for(int f = 0 ; f < numFields ; f++){
+            args->in[f] = F2[f] ;
+            args->out[f] = F1[f] ;
+        }
+        MPIStep(args, numFields, step);
+        tot_exec_time += MPI_Wtime() - start;
+
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            printf("%2d%s: complete in time %5.2f seconds\n",100*iter/ITERS,"%", tot_exec_time);
+            for(int f = 0 ; f < numFields ; f++){
+                WriteFieldMPI(F1[f], OutFileDir, types[f], iter);
+            }
+        }
+    }
+
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    printf("   : %.2f MLUPS\n", MLUPS((double)GridNX*GridNY, 2.0*ITERS, tot_exec_time));
+    for(int f = 0 ; f < numFields ; f++){
+        WriteFieldMPI(F1[f], OutFileDir, types[f], ITERS);
+    }
+}
+
+// The steps of the systems on a rectangle of a block
+static void DiffusionRectMPI(const struct MPIStepArgs *a, struct CPURect R){
+    cpuDiffusionStep(a->in[0], a->out[0], *(const struct DiffusionInputParams*)a->params, R);
+}
+static void CahnHilliardRectMPI(const struct MPIStepArgs *a, struct CPURect R){
+    cpuCahnHilliardStep(a->scratch[0], a->in[0], a->out[0], *(const struct CahnHilliardInputParams*)a->params, R);
+}
+static void KobayashiIsoRectMPI(const struct MPIStepArgs *a, struct CPURect R){
+    cpuKobayashiIsoStep(a->in[0], a->out[0], a->in[1], a->out[1], a->noise, *(const struct KobIsoInputParams*)a->params, R);
+}
+static void KobayashiAnisoRectMPI(const struct MPIStepArgs *a, struct CPURect R){
+    cpuKobayashiAnisoStep(a->in[0], a->out[0], a->in[1], a->out[1], a->noise, *(const struct KobAnisoInputParams*)a->params,
+                          a->scratch[0], a->scratch[1], a->scratch[2], R);
+}
+
+/**
+@brief A function to fully iterate the block of this process of the diffusion system.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure of the block.
+*/
+static inline void iterateDiffusionMPI(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%s_%dITERS", GridLabel(), ITERS);
+    struct MPIStepArgs args = {&inpparams} ;
+    float *F1[1] = {databuffers.PHASE1}, *F2[1] = {databuffers.PHASE2} ;
+    const char *types[1] = {"PHASE"} ;
+    iterateBlocksMPI(OutFileDir, &args, F1, F2, types, 1, DiffusionRectMPI, 0.0f);
+}
+
+/**
+@brief A function to fully iterate the block of this process of the cahn-Hilliard system.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure of the block.
+*/
+static inline void iterateCahnHilliardMPI(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_%s_%dITERS", GridLabel(), ITERS);
+    struct MPIStepArgs args = {&inpparams} ;
+    args.scratch[0] = databuffers.InBracM ;
+    float *F1[1] = {databuffers.PHASE1}, *F2[1] = {databuffers.PHASE2} ;
+    const char *types[1] = {"PHASE"} ;
+    iterateBlocksMPI(OutFileDir, &args, F1, F2, types, 1, CahnHilliardRectMPI, 0.0f);
+}
+
+/**
+@brief A function to fully iterate the block of this process of the kobayashi isotropic system.
+@param inpparams A KobIsoInputParams structure.
+@param databuffers A KobIsoDataBuffers structure of the block.
+*/
+static inline void iterateKobayashiIsoMPI(struct KobIsoInputParams inpparams, struct KobIsoDataBuffers databuffers){
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ISO_%s_%dITERS", GridLabel(), ITERS);
+    struct MPIStepArgs args = {&inpparams} ;
+    float *F1[2] = {databuffers.PHASE1, databuffers.TEMP1}, *F2[2] = {databuffers.PHASE2, databuffers.TEMP2} ;
+    const char *types[2] = {"PHASE", "TEMP"} ;
+    iterateBlocksMPI(OutFileDir, &args, F1, F2, types, 2, KobayashiIsoRectMPI, inpparams.NOISE_AMP);
+}
+
+/**
+@brief A function to fully iterate the block of this process of the kobayashi anisotropic system.
+@param inpparams A KobAnisoInputParams structure.
+@param databuffers A KobAnisoDataBuffers structure of the block.
+*/
+static inline void iterateKobayashiAnisoMPI(struct KobAnisoInputParams inpparams, struct KobAnisoDataBuffers databuffers){
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/KOB_ANISO_%s_%dITERS", GridLabel(), ITERS);
+    struct MPIStepArgs args = {&inpparams} ;
+    for(int k = 0 ; k < 3 ; k++){
+        args.scratch[k] = Init1DFloatMatrix(0.0);
+    }
+    float *F1[2] = {databuffers.PHASE1, databuffers.TEMP1}, *F2[2] = {databuffers.PHASE2, databuffers.TEMP2} ;
+    const char *types[2] = {"PHASE", "TEMP"} ;
+    iterateBlocksMPI(OutFileDir, &args, F1, F2, types, 2, KobayashiAnisoRectMPI, inpparams.NOISE_AMP);
+    for(int k = 0 ; k < 3 ; k++){
+        free(args.scratch[k]);
+    }
+}
+
+#endif
+#endif
+// END OF FILE
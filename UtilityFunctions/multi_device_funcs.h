@@ -0,0 +1,392 @@
+/**
+@file multi_device_funcs.h
+@brief Declares the multi-device mode: the grid is split into horizontal strips, one per device of the context.
+
+`mainfile --system <name> --multi-device` runs one strip of rows on every device of the platform, each device with its own
+command queues, kernels and buffers in the single context of initCLDataStructures(). A strip buffer holds the rows of the
+strip and HALO rows above and below them, where HALO is the reach of the stencil of one step:
+\code
+rows [0, HALO)                    top halo, a copy of the last rows of the strip above
+rows [HALO, HALO+rows)            the rows of the strip, global rows y0 ... y0+rows-1
+rows [HALO+rows, 2*HALO+rows)     bottom halo, a copy of the first rows of the strip below
+\endcode
+The strips wrap around, so the grid stays periodic in y. Every step of a strip is enqueued in two parts:
+the boundary part updates the first and last HALO rows of the strip, it waits for the halo copies of the previous step;
+the interior part updates the other rows and needs no halo. As soon as the boundary part is done its rows are copied
+into the halos of the neighbours, on a second queue of the device, while the interior part is still running.
+
+|System|Kernels|HALO|
+|------|-------|----|
+|DIFFUSION|phase_field_evol_strip_kern|1|
+|CAHNHILLIARD|ch_inner_strip_kern, ch_outer_strip_kern|2|
+
+The strips are as equal as possible. A strip needs at least 4*HALO rows, so small grids use fewer devices.
+The multi-device mode runs the 2D grids of the OpenCL backend, it does not use the program cache and does not write checkpoints.
+*/
+
+#ifndef MULTI_DEVICE_FUNCS
+#define MULTI_DEVICE_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "file_to_program.h"
+#include "cpu_kernels.h"
+#include "output_writer.h"
+
+/// The strip of rows of one device.
+struct DeviceStrip{
+    /// The device.
+    cl_device_id device ;
+    /// The queue of the kernels.
+    cl_command_queue queue ;
+    /// The queue of the halo copies out of this strip.
+    cl_command_queue xferQueue ;
+    /// The first global row of the strip.
+    int y0 ;
+    /// The number of rows of the strip.
+    int rows ;
+    /// The two field buffers, swapped every step, and a scratch buffer (the inner bracket of the Cahn-Hilliard step).
+    cl_mem buff[3] ;
+    /// The kernels of the step, created for this strip.
+    cl_kernel kern[2] ;
+    /// The boundary part of the current step.
+    cl_event edge ;
+    /// The boundary part of the previous step, the last reader of the halos written in this step.
+    cl_event prevEdge ;
+    /// The copies into the top [0] and bottom [1] halos.
+    cl_event haloIn[2] ;
+};
+
+/// The strips of a multi-device run.
+struct MultiDevice{
+    /// Number of strips, at most numDevices.
+    int numStrips ;
+    /// Number of halo rows on each side of a strip.
+    int halo ;
+    /// The strips, top to bottom.
+    struct DeviceStrip *strips ;
+};
+
+/**
+@brief Splits the grid into strips and creates the queues, kernels and buffers of every device.
+@param MAT The initial field, NY rows of PITCH floats.
+@param halo The number of halo rows the step needs.
+@param kernelNames The names of the kernels of the step.
+@param numKernels The number of kernels, 1 or 2.
+@return The strips. Both field buffers start from MAT, halos included.
+*/
+struct MultiDevice CreateDeviceStrips(const float *MAT, int halo, const char *kernelNames[], int numKernels){
+    cl_int err ;
+    struct MultiDevice md ;
+    md.halo = halo ;
+    md.numStrips = numDevices ;
+    if(md.numStrips > NY/(4*halo)){
+        md.numStrips = NY/(4*halo) ;
+    }
+    if(md.numStrips < 1){
+        printf("Error: the grid has %d rows, the multi-device mode needs at least %d\n", NY, 4*halo);
+        exit(1);
+    }
+    md.strips = (struct DeviceStrip*)calloc(md.numStrips, sizeof(struct DeviceStrip));
+
+    int y0 = 0 ;
+    for(int d = 0 ; d < md.numStrips ; d++){
+        struct DeviceStrip *s = &md.strips[d] ;
+        s->device = devices[d] ;
+        s->y0 = y0 ;
+        s->rows = NY/md.numStrips + ((d < NY%md.numStrips) ? 1 : 0) ;
+        y0 += s->rows ;
+
+        char name[128] = "" ;
+        clGetDeviceInfo(s->device, CL_DEVICE_NAME, sizeof(name)-1, name, NULL);
+        printf("   : Device %d %s: rows %d to %d\n", d, name, s->y0, s->y0+s->rows-1);
+
+        s->queue = clCreateCommandQueue(context, s->device, 0, &err);
+        ErrorHandle(err, "clCreateCommandQueue strip");
+        s->xferQueue = clCreateCommandQueue(context, s->device, 0, &err);
+        ErrorHandle(err, "clCreateCommandQueue strip halo copies");
+        for(int k = 0 ; k < numKernels ; k++){
+            s->kern[k] = getKernelFromProgram(kernelNames[k]);
+        }
+
+        // The rows of the strip with periodic halos
+        size_t rowBytes = sizeof(float)*PITCH ;
+        size_t bytes = rowBytes*(s->rows + 2*halo) ;
+        float *init = (float*)malloc(bytes);
+        for(int r = 0 ; r < s->rows + 2*halo ; r++){
+            int y = (s->y0 - halo + r + NY)%NY ;
+            memcpy(init + (size_t)PITCH*r, MAT + (size_t)PITCH*y, rowBytes);
+        }
+        s->buff[0] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes, init, &err);
+        ErrorHandle(err, "clCreateBuffer strip 0");
+        s->buff[1] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes, init, &err);
+        ErrorHandle(err, "clCreateBuffer strip 1");
+        s->buff[2] = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err);
+        ErrorHandle(err, "clCreateBuffer strip scratch");
+        free(init);
+    }
+    return md ;
+}
+
+/**
+@brief Enqueues a kernel on some rows of a strip.
+@param s The strip.
+@param kern The kernel, its arguments set.
+@param row0 The first row, counted from the top of the strip buffer (the top halo is row 0).
+@param nrows The number of rows.
+@param numWait The number of events in waitList.
+@param waitList The events to wait for, or NULL.
+@param event The event of the launch, or NULL.
+
+The work groups are one row of PITCH_ALIGN work items, the NDRange covers the PITCH floats of the rows.
+*/
+static inline void EnqueueStripRows(struct DeviceStrip *s, cl_kernel kern, int row0, int nrows, cl_uint numWait, const cl_event *waitList, cl_event *event){
+    cl_int err ;
+    size_t offset[2] = {0, row0} ;
+    size_t globalWS[2] = {PITCH, nrows} ;
+    size_t localWS[2] = {PITCH_ALIGN, 1} ;
+    err = clEnqueueNDRangeKernel(s->queue, kern, 2, offset, globalWS, localWS, numWait, waitList, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel strip");
+}
+
+/**
+@brief Advances all the strips one step and exchanges the halos.
+@param md The strips.
+@param in The index of the input field buffer, the output is the other one.
+@param boundary Enqueues the boundary part of the step of a strip, waiting for the events of the list, the last launch sets the event.
+@param interior Enqueues the interior part of the step of a strip.
+
+The copies out of a strip run on its xferQueue after its boundary part, the copies into a strip wait for its previous boundary part,
+the last reader of the halos they overwrite. The boundary part of the next step waits for the copies into and out of the strip.
+*/
+static inline void MultiDeviceStep(struct MultiDevice *md, int in,
+        void (*boundary)(struct DeviceStrip *s, int in, cl_uint numWait, const cl_event *waitList, cl_event *event),
+        void (*interior)(struct DeviceStrip *s, int in)){
+    cl_int err ;
+    int n = md->numStrips ;
+    int R = md->halo ;
+    int out = 1 - in ;
+    struct DeviceStrip *S = md->strips ;
+
+    for(int d = 0 ; d < n ; d++){
+        struct DeviceStrip *up = &S[(d+n-1)%n], *down = &S[(d+1)%n] ;
+        cl_event waitList[4] ;
+        cl_uint numWait = 0 ;
+        if(S[d].haloIn[0] != NULL){
+            waitList[numWait++] = S[d].haloIn[0] ;
+            waitList[numWait++] = S[d].haloIn[1] ;
+            waitList[numWait++] = up->haloIn[1] ;
+            waitList[numWait++] = down->haloIn[0] ;
+        }
+        boundary(&S[d], in, numWait, (numWait > 0) ? waitList : NULL, &S[d].edge);
+    }
+    for(int d = 0 ; d < n ; d++){
+        for(int h = 0 ; h < 2 ; h++){
+            if(S[d].haloIn[h] != NULL){
+                clReleaseEvent(S[d].haloIn[h]);
+                S[d].haloIn[h] = NULL ;
+            }
+        }
+        interior(&S[d], in);
+    }
+
+    size_t haloBytes = sizeof(float)*PITCH*R ;
+    for(int d = 0 ; d < n ; d++){
+        struct DeviceStrip *up = &S[(d+n-1)%n], *down = &S[(d+1)%n] ;
+        // The first rows of the strip into the bottom halo of the strip above
+        cl_event waitList[2] = {S[d].edge, up->prevEdge} ;
+        err = clEnqueueCopyBuffer(S[d].xferQueue, S[d].buff[out], up->buff[out], haloBytes, sizeof(float)*PITCH*(up->rows+R), haloBytes,
+                                  (up->prevEdge != NULL) ? 2 : 1, waitList, &up->haloIn[1]);
+        KernErrorHandle(err, "clEnqueueCopyBuffer halo up");
+        // The last rows of the strip into the top halo of the strip below
+        waitList[1] = down->prevEdge ;
+        err = clEnqueueCopyBuffer(S[d].xferQueue, S[d].buff[out], down->buff[out], sizeof(float)*PITCH*S[d].rows, 0, haloBytes,
+                                  (down->prevEdge != NULL) ? 2 : 1, waitList, &down->haloIn[0]);
+        KernErrorHandle(err, "clEnqueueCopyBuffer halo down");
+    }
+    for(int d = 0 ; d < n ; d++){
+        if(S[d].prevEdge != NULL){
+            clReleaseEvent(S[d].prevEdge);
+        }
+        S[d].prevEdge = S[d].edge ;
+        S[d].edge = NULL ;
+        // The other queues wait for events of these queues
+        clFlush(S[d].queue);
+        clFlush(S[d].xferQueue);
+    }
+}
+
+/**
+@brief Waits for all the queues of the strips.
+@param md The strips.
+*/
+void FinishDeviceStrips(struct MultiDevice *md){
+    for(int d = 0 ; d < md->numStrips ; d++){
+        clFinish(md->strips[d].queue);
+        clFinish(md->strips[d].xferQueue);
+    }
+}
+
+/**
+@brief Reads the rows of all the strips into one host array.
+@param md The strips.
+@param b The index of the field buffer.
+@param MAT The host array of NY rows of PITCH floats.
+*/
+void GatherDeviceStrips(struct MultiDevice *md, int b, float *MAT){
+    cl_int err ;
+    for(int d = 0 ; d < md->numStrips ; d++){
+        struct DeviceStrip *s = &md->strips[d] ;
+        err = clEnqueueReadBuffer(s->queue, s->buff[b], CL_FALSE, sizeof(float)*PITCH*md->halo, sizeof(float)*PITCH*s->rows,
+                                  MAT + (size_t)PITCH*s->y0, 0, NULL, NULL);
+        KernErrorHandle(err, "clEnqueueReadBuffer strip");
+    }
+    FinishDeviceStrips(md);
+}
+
+/**
+@brief Releases the queues, kernels, buffers and events of the strips.
+@param md The strips.
+*/
+void ReleaseDeviceStrips(struct MultiDevice *md){
+    FinishDeviceStrips(md);
+    for(int d = 0 ; d < md->numStrips ; d++){
+        struct DeviceStrip *s = &md->strips[d] ;
+        for(int h = 0 ; h < 2 ; h++){
+            if(s->haloIn[h] != NULL){
+                clReleaseEvent(s->haloIn[h]);
+            }
+        }
+        if(s->prevEdge != NULL){
+            clReleaseEvent(s->prevEdge);
+        }
+        for(int b = 0 ; b < 3 ; b++){
+            clReleaseMemObject(s->buff[b]);
+        }
+        for(int k = 0 ; k < 2 ; k++){
+            if(s->kern[k] != NULL){
+                clReleaseKernel(s->kern[k]);
+            }
+        }
+        clReleaseCommandQueue(s->queue);
+        clReleaseCommandQueue(s->xferQueue);
+    }
+    free(md->strips);
+    md->strips = NULL ;
+}
+
+/**
+@brief Iterates the strips and saves the field.
+@param md The strips.
+@param OutFileDir Name of the outputfile directory.
+@param MAT A host array of NY rows of PITCH floats for the saved field.
+@param boundary The boundary part of the step, see MultiDeviceStep().
+@param interior The interior part of the step.
+
+The time is the wall clock time of the steps, the host waits for all the devices at the save points.
+*/
+static void iterateDeviceStrips(struct MultiDevice *md, const char OutFileDir[], float *MAT,
+        void (*boundary)(struct DeviceStrip *s, int in, cl_uint numWait, const cl_event *waitList, cl_event *event),
+        void (*interior)(struct DeviceStrip *s, int in)){
+    printf("   : Enqueuing kernels on %d devices:\n   : Compute size is %lu\n", md->numStrips, (unsigned long)GRID_CELLS*ITERS);
+    double tot_exec_time = 0.0 ;
+    double start = CPUWallTime();
+    for(int iter = 0 ; iter < ITERS ; iter++){
+        MultiDeviceStep(md, 0, boundary, interior);
+        MultiDeviceStep(md, 1, boundary, interior);
+
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            FinishDeviceStrips(md);
+            tot_exec_time += CPUWallTime() - start ;
+            GatherDeviceStrips(md, 0, MAT);
+            SaveArrayAsync(MAT, OutFileDir, "PHASE", iter);
+            printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
+            start = CPUWallTime();
+        }
+    }
+    FinishDeviceStrips(md);
+    tot_exec_time += CPUWallTime() - start ;
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*ITERS, tot_exec_time));
+    GatherDeviceStrips(md, 0, MAT);
+    SaveArrayAsync(MAT, OutFileDir, "PHASE", ITERS);
+}
+
+// Diffusion step, one kernel with a halo of 1 row
+static void DiffusionStripBoundary(struct DeviceStrip *s, int in, cl_uint numWait, const cl_event *waitList, cl_event *event){
+    cl_int err ;
+    err = clSetKernelArg(s->kern[0], 0, sizeof(cl_mem), &s->buff[in]);
+    err |= clSetKernelArg(s->kern[0], 1, sizeof(cl_mem), &s->buff[1-in]);
+    KernErrorHandle(err, "SetKernelArg phase_field_evol_strip_kern");
+    EnqueueStripRows(s, s->kern[0], 1, 1, numWait, waitList, NULL);
+    EnqueueStripRows(s, s->kern[0], s->rows, 1, 0, NULL, event);
+}
+static void DiffusionStripInterior(struct DeviceStrip *s, int in){
+    EnqueueStripRows(s, s->kern[0], 2, s->rows-2, 0, NULL, NULL);
+}
+
+/**
+@brief A function to fully iterate the diffusion system on all the devices of the platform.
+@param inpparams A DiffusionInputParams structure.
+@param databuffers A DiffusionDataBuffers structure, PHASE1 holds the initial field and the saved fields.
+*/
+static inline void iterateDiffusionMultiDevice(struct DiffusionInputParams inpparams, struct DiffusionDataBuffers databuffers){
+    const char *names[1] = {"phase_field_evol_strip_kern"} ;
+    struct MultiDevice md = CreateDeviceStrips(databuffers.PHASE1, 1, names, 1);
+    char OutFileDir[128] ;
+    sprintf(OutFileDir, "./OutDataFiles/DIFUSION_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    iterateDeviceStrips(&md, OutFileDir, databuffers.PHASE1, DiffusionStripBoundary, DiffusionStripInterior);
+    ReleaseDeviceStrips(&md);
+}
+
+// Cahn-Hilliard step, the inner bracket and the concentration kernels with a halo of 2 rows
+static inline void CahnHilliardStripRows(struct DeviceStrip *s, int in, int innerRow0, int innerRows, int outerRow0, int outerRows, cl_uint numWait, const cl_event *waitList, cl_event *event){
+    cl_int err ;
+    err = clSetKernelArg(s->kern[0], 0, sizeof(cl_mem), &s->buff[in]);
+    err |= clSetKernelArg(s->kern[0], 1, sizeof(cl_mem), &s->buff[2]);
+    err |= clSetKernelArg(s->kern[1], 0, sizeof(cl_mem), &s->buff[2]);
+    err |= clSetKernelArg(s->kern[1], 1, sizeof(cl_mem), &s->buff[in]);
+    err |= clSetKernelArg(s->kern[1], 2, sizeof(cl_mem), &s->buff[1-in]);
+    KernErrorHandle(err, "SetKernelArg ch_strip_kern");
+    EnqueueStripRows(s, s->kern[0], innerRow0, innerRows, numWait, waitList, NULL);
+    EnqueueStripRows(s, s->kern[1], outerRow0, outerRows, 0, NULL, event);
+}
+static void CahnHilliardStripBoundary(struct DeviceStrip *s, int in, cl_uint numWait, const cl_event *waitList, cl_event *event){
+    // The inner bracket reaches 1 row beyond the updated rows
+    CahnHilliardStripRows(s, in, 1, 4, 2, 2, numWait, waitList, NULL);
+    CahnHilliardStripRows(s, in, s->rows-1, 4, s->rows, 2, 0, NULL, event);
+}
+static void CahnHilliardStripInterior(struct DeviceStrip *s, int in){
+    CahnHilliardStripRows(s, in, 5, s->rows-6, 4, s->rows-4, 0, NULL, NULL);
+}
+
+/**
+@brief A function to fully iterate the Cahn-Hilliard system on all the devices of the platform.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure, PHASE1 holds the initial field and the saved fields.
+*/
+static inline void iterateCahnHilliardMultiDevice(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    const char *names[2] = {"ch_inner_strip_kern", "ch_outer_strip_kern"} ;
+    struct MultiDevice md = CreateDeviceStrips(databuffers.PHASE1, 2, names, 2);
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    iterateDeviceStrips(&md, OutFileDir, databuffers.PHASE1, CahnHilliardStripBoundary, CahnHilliardStripInterior);
+    ReleaseDeviceStrips(&md);
+}
+
+#endif
+// END OF FILE
@@ -0,0 +1,160 @@
+/**
+@file output_spec_funcs.h
+@brief Declares the reduced outputs of the saved fields: windows of the grid at full resolution and decimated copies of the whole grid.
+
+A reduced output is a window of the grid decimated by a factor, keeping the first cell of every block of factor cells per side (stride)
+or writing the mean of the block (box filter). They are set in the input file, one per line, at most MAX_OUTPUT_SPECS :
+|Input line|Reduced output|
+|----------|--------------|
+|OutputROI = x0,y0,width,height ;|The window at full resolution, on all the planes of a 3D grid|
+|OutputROI = x0,y0,z0,width,height,depth ;|A 3D window at full resolution|
+|OutputDecimate = factor,box ;|The whole grid, each value the mean of a block of factor cells per side|
+|OutputDecimate = factor,stride ;|The whole grid, every factor-th cell along each axis|
+
+At every save each field is written with every reduced output, e.g. PHASE_ROI0_<iter> and PHASE_DEC0_<iter> next to PHASE_<iter>
+in the format of OutDataFileType; FullOutput = 0 writes the reduced outputs only. The files hold the size of the reduced output,
+and the .raw, .vtk and .vti files its origin and spacing in the whole grid, see FieldShape.
+On the OpenCL backend output_spec_kern of ReduceKern.cl makes the reduced output on the device, so only its values are read back
+and written; the CPU backend reduces the host array.
+*/
+
+#ifndef OUTPUT_SPEC_FUNCS
+#define OUTPUT_SPEC_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "file_to_program.h"
+#include "data_writing_funcs.h"
+#include "trace_funcs.h"
+
+/**
+@brief The size of the window of a reduced output in cells of the grid.
+@param s The reduced output.
+@param size The size along x, y and z.
+*/
+static inline void OutputSpecWindow(const struct OutputSpec *s, int size[3]){
+    size[0] = (s->nx > 0) ? s->nx : NX - s->x0 ;
+    size[1] = (s->ny > 0) ? s->ny : NY - s->y0 ;
+    size[2] = (s->nz > 0) ? s->nz : NZ - s->z0 ;
+}
+
+/**
+@brief The shape of a reduced output in the output files.
+@param s The reduced output.
+@return The window divided by the factor, rounded up, with its origin in the grid.
+*/
+struct FieldShape OutputSpecShape(const struct OutputSpec *s){
+    int size[3] ;
+    OutputSpecWindow(s, size);
+    int f = s->factor ;
+    struct FieldShape shape = {(size[0]+f-1)/f, (size[1]+f-1)/f, (size[2]+f-1)/f, s->x0, s->y0, s->z0, f} ;
+    return shape ;
+}
+
+/**
+@brief Enqueues a reduced output of a device field and the non-blocking read of its values.
+@param s The reduced output.
+@param buff The device buffer of the field.
+@param slice The index of the field of FIELD_CELLS cells in the buffer, 0 unless the buffer holds the replicas of an ensemble.
+@param data The host array of the values, ShapeCells() floats of OutputSpecShape().
+@return The event of the read, to be released by the caller.
+
+The reduced output is made on the in-order queue after the steps enqueued before it. Its device buffer and kernel are released
+here; OpenCL keeps them until the read is done.
+*/
+cl_event EnqueueOutputSpec(const struct OutputSpec *s, cl_mem buff, size_t slice, float *data){
+    cl_int err ;
+    int size[3] ;
+    OutputSpecWindow(s, size);
+    struct FieldShape shape = OutputSpecShape(s);
+    size_t bytes = sizeof(float)*ShapeCells(&shape) ;
+    cl_mem out = clCreateBuffer(context, CL_MEM_WRITE_ONLY, bytes, NULL, &err);
+    ErrorHandle(err, "clCreateBuffer output spec");
+    cl_kernel kern = getKernelFromProgram("output_spec_kern");
+    cl_ulong base = (cl_ulong)slice*FIELD_CELLS ;
+    err = clSetKernelArg(kern, 0, sizeof(cl_mem), &buff);
+    err |= clSetKernelArg(kern, 1, sizeof(cl_mem), &out);
+    err |= clSetKernelArg(kern, 2, sizeof(cl_ulong), &base);
+    err |= clSetKernelArg(kern, 3, sizeof(cl_int), &s->x0);
+    err |= clSetKernelArg(kern, 4, sizeof(cl_int), &s->y0);
+    err |= clSetKernelArg(kern, 5, sizeof(cl_int), &s->z0);
+    for(int d = 0 ; d < 3 ; d++){
+        err |= clSetKernelArg(kern, 6+d, sizeof(cl_int), &size[d]);
+    }
+    err |= clSetKernelArg(kern, 9, sizeof(cl_int), &s->factor);
+    err |= clSetKernelArg(kern, 10, sizeof(cl_int), &s->box);
+    KernErrorHandle(err, "SetKernelArg output spec");
+
+    size_t globalWS[3] = {(size_t)shape.nx, (size_t)shape.ny, (size_t)shape.nz} ;
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, kern, 3, NULL, globalWS, NULL, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel output spec");
+    TRACE_CL_KERNEL(event, kern);
+    cl_event ready ;
+    err = clEnqueueReadBuffer(queue, out, CL_FALSE, 0, bytes, data, 0, NULL, &ready);
+    KernErrorHandle(err, "clEnqueueReadBuffer output spec");
+    TRACE_CL_RECORD(&ready, "clEnqueueReadBuffer output spec", "transfer");
+    clReleaseMemObject(out);
+    clReleaseKernel(kern);
+    return ready ;
+}
+
+/**
+@brief Makes a reduced output of a host field. Mirrors output_spec_kern of ReduceKern.cl .
+@param s The reduced output.
+@param MAT The field, NY*NZ rows of PITCH floats.
+@param data The values, ShapeCells() floats of OutputSpecShape().
+*/
+void OutputSpecCPU(const struct OutputSpec *s, const float *MAT, float *data){
+    int size[3] ;
+    OutputSpecWindow(s, size);
+    const struct FieldShape shape = OutputSpecShape(s);
+    const int f = s->factor ;
+    #pragma omp parallel for schedule(static)
+    for(int orow = 0 ; orow < shape.ny*shape.nz ; orow++){
+        const int y = (orow%shape.ny)*f, z = (orow/shape.ny)*f ;
+        float *out = data + (size_t)shape.nx*orow ;
+        for(int ox = 0 ; ox < shape.nx ; ox++){
+            const int x = ox*f ;
+            if(s->box){
+                const int bx = (f < size[0]-x) ? f : size[0]-x ;
+                const int by = (f < size[1]-y) ? f : size[1]-y ;
+                const int bz = (f < size[2]-z) ? f : size[2]-z ;
+                float sum = 0.0f ;
+                for(int k = 0 ; k < bz ; k++){
+                    for(int j = 0 ; j < by ; j++){
+                        const float *row = MAT + (size_t)PITCH*((size_t)NY*(s->z0+z+k) + s->y0+y+j) + s->x0+x ;
+                        for(int i = 0 ; i < bx ; i++){
+                            sum += row[i] ;
+                        }
+                    }
+                }
+                out[ox] = sum/(bx*by*bz) ;
+            }else{
+                out[ox] = MAT[(size_t)PITCH*((size_t)NY*(s->z0+z) + s->y0+y) + s->x0+x] ;
+            }
+        }
+    }
+}
+
+/**
+@brief The name of a field with a reduced output in the output files.
+@param Name The name, at least 16 chars.
+@param type "PHASE" or "TEMP"
+@param s The reduced output.
+*/
+static inline void OutputSpecName(char Name[16], const char type[], const struct OutputSpec *s){
+    snprintf(Name, 16, "%.5s_%.9s", type, s->name);
+}
+
+#endif
+// END OF FILE
@@ -0,0 +1,286 @@
+/**
+@file output_writer.h
+@brief Declares the background output writer, a thread that writes the saved fields to the outfiles while the simulation goes on.
+
+At a save point the iterate functions copy a field into a host staging buffer, SaveBufferAsync() with a non-blocking
+read from a device buffer and SaveArrayAsync() with a copy of a host array, and hand it to the writer thread.
+The writer waits for the read to complete, turns the half or double device cells into floats (see precision_funcs.h),
+calls WriteFieldToFile() and returns the staging buffer to the pool.
+The pool has OutputBuffers staging buffers, so the simulation only blocks when all of them are waiting to be written.
+Every save also queues the reduced outputs of output_spec_funcs.h, one staging buffer each, and skips the whole field when FullOutput is 0.
+*/
+
+#ifndef OUTPUT_WRITER
+#define OUTPUT_WRITER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "data_writing_funcs.h"
+#include "trace_funcs.h"
+#include "precision_funcs.h"
+#include "output_spec_funcs.h"
+
+/// A field waiting in the queue of the writer thread.
+struct OutputJob{
+    /// The outputfile directory.
+    char OutFileDir[256] ;
+    /// "PHASE" or "TEMP", or the name of a reduced output, e.g. "PHASE_ROI0"
+    char type[16] ;
+    /// The iteration number of the field.
+    int iter ;
+    /// The staging buffer holding the field.
+    float *data ;
+    /// The read filling the staging buffer, or NULL if the buffer is already filled.
+    cl_event ready ;
+    /// The buffer holds device cells that StorageToFloat() turns into floats, 0 if it holds floats.
+    int convert ;
+    /// The shape of the field, GridShape() for a whole field.
+    struct FieldShape shape ;
+};
+
+/// The state of the writer thread. The queue and the free staging buffers are guarded by lock.
+struct OutputWriter{
+    pthread_t thread ;
+    pthread_mutex_t lock ;
+    /// Signalled when a job is queued, a staging buffer is freed or the writer is stopped.
+    pthread_cond_t changed ;
+    /// Number of staging buffers, also the capacity of the job queue.
+    int numBuffers ;
+    /// The staging buffers.
+    float **buffers ;
+    /// The staging buffers not holding a field.
+    float **freeBuffers ;
+    int numFree ;
+    /// Ring buffer of jobs.
+    struct OutputJob *jobs ;
+    int head ;
+    int count ;
+    int stop ;
+} Writer ;
+
+/**
+@brief The writer thread. It writes the queued fields in order until the writer is stopped and the queue is empty.
+@param arg Not used.
+*/
+static void* OutputWriterThread(void *arg){
+    (void)arg ;
+    pthread_mutex_lock(&Writer.lock);
+    while(1){
+        while(Writer.count == 0 && !Writer.stop){
+            pthread_cond_wait(&Writer.changed, &Writer.lock);
+        }
+        if(Writer.count == 0){
+            break ;
+        }
+        struct OutputJob job = Writer.jobs[Writer.head] ;
+        Writer.head = (Writer.head + 1)%Writer.numBuffers ;
+        Writer.count-- ;
+        pthread_mutex_unlock(&Writer.lock);
+
+        if(job.ready != NULL){
+            TRACE_SPAN_BEGIN(wait);
+            cl_int err = clWaitForEvents(1, &job.ready);
+            KernErrorHandle(err, "clWaitForEvents output read");
+            clReleaseEvent(job.ready);
+            TRACE_SPAN_END(wait, "wait for output read", "io");
+        }
+        if(job.convert){
+            StorageToFloat(job.data, ShapeCells(&job.shape));
+        }
+        TRACE_SPAN_BEGIN(write);
+        WriteFieldToFile(job.OutFileDir, job.type, job.iter, job.data, &job.shape);
+        TRACE_SPAN_END(write, "WriteFieldToFile", "io");
+
+        pthread_mutex_lock(&Writer.lock);
+        Writer.freeBuffers[Writer.numFree++] = job.data ;
+        pthread_cond_broadcast(&Writer.changed);
+    }
+    pthread_mutex_unlock(&Writer.lock);
+    return NULL ;
+}
+
+/**
+@brief Allocates the staging buffers and starts the writer thread.
+@param numFloats The number of floats of one field.
+
+The number of staging buffers is read from the OutputBuffers variable, at least 2. A buffer also holds numFloats cells of the device precision.
+*/
+void StartOutputWriter(size_t numFloats){
+    Writer.numBuffers = (OutputBuffers < 2) ? 2 : OutputBuffers ;
+    Writer.buffers = (float**)malloc(sizeof(float*)*Writer.numBuffers);
+    Writer.freeBuffers = (float**)malloc(sizeof(float*)*Writer.numBuffers);
+    Writer.jobs = (struct OutputJob*)malloc(sizeof(struct OutputJob)*Writer.numBuffers);
+    for(int i = 0 ; i < Writer.numBuffers ; i++){
+        Writer.buffers[i] = (float*)malloc(StagingBytes(numFloats));
+        if(Writer.buffers[i] == NULL){
+            printf("Error: cannot allocate %d output staging buffers\n", Writer.numBuffers);
+            exit(1);
+        }
+        Writer.freeBuffers[i] = Writer.buffers[i] ;
+    }
+    Writer.numFree = Writer.numBuffers ;
+    Writer.head = 0 ;
+    Writer.count = 0 ;
+    Writer.stop = 0 ;
+    pthread_mutex_init(&Writer.lock, NULL);
+    pthread_cond_init(&Writer.changed, NULL);
+    if(pthread_create(&Writer.thread, NULL, OutputWriterThread, NULL) != 0){
+        printf("Error: cannot start the output writer thread\n");
+        exit(1);
+    }
+}
+
+/**
+@brief Waits until all the queued fields are written, then stops the writer thread and frees the staging buffers.
+*/
+void StopOutputWriter(){
+    pthread_mutex_lock(&Writer.lock);
+    Writer.stop = 1 ;
+    pthread_cond_broadcast(&Writer.changed);
+    pthread_mutex_unlock(&Writer.lock);
+    pthread_join(Writer.thread, NULL);
+
+    pthread_cond_destroy(&Writer.changed);
+    pthread_mutex_destroy(&Writer.lock);
+    for(int i = 0 ; i < Writer.numBuffers ; i++){
+        free(Writer.buffers[i]);
+    }
+    free(Writer.buffers);
+    free(Writer.freeBuffers);
+    free(Writer.jobs);
+}
+
+/**
+@brief Takes a free staging buffer from the pool, waiting for the writer if there is none.
+@return The staging buffer.
+*/
+static float* AcquireOutputBuffer(){
+    pthread_mutex_lock(&Writer.lock);
+    if(Writer.numFree == 0){
+        // The simulation stalls on the output
+        TRACE_SPAN_BEGIN(stall);
+        while(Writer.numFree == 0){
+            pthread_cond_wait(&Writer.changed, &Writer.lock);
+        }
+        TRACE_SPAN_END(stall, "wait for staging buffer", "io");
+    }
+    float *buffer = Writer.freeBuffers[--Writer.numFree] ;
+    pthread_mutex_unlock(&Writer.lock);
+    return buffer ;
+}
+
+/**
+@brief Queues a staging buffer for the writer thread.
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+@param data The staging buffer from AcquireOutputBuffer().
+@param ready The event of the read filling data, or NULL. The writer releases it.
+@param convert 1 if data holds device cells to turn into floats, 0 if it holds floats.
+@param shape The shape of the field.
+*/
+static void SubmitOutput(const char OutFileDir[], const char type[], int iter, float *data, cl_event ready, int convert, const struct FieldShape *shape){
+    struct OutputJob job ;
+    snprintf(job.OutFileDir, sizeof(job.OutFileDir), "%s", OutFileDir);
+    snprintf(job.type, sizeof(job.type), "%s", type);
+    job.iter = iter ;
+    job.data = data ;
+    job.ready = ready ;
+    job.convert = convert ;
+    job.shape = *shape ;
+
+    pthread_mutex_lock(&Writer.lock);
+    Writer.jobs[(Writer.head + Writer.count)%Writer.numBuffers] = job ;
+    Writer.count++ ;
+    pthread_cond_broadcast(&Writer.changed);
+    pthread_mutex_unlock(&Writer.lock);
+}
+
+/**
+@brief Saves one field of a device buffer that holds several fields one after the other, e.g. the replicas of an ensemble.
+@param buff The device buffer.
+@param slice The index of the field of FIELD_CELLS floats in the buffer.
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+
+The rows are read without the padding of the pitch, so the writers get GRID_CELLS packed floats once the writer thread has converted them.
+The reduced outputs are made on the device and read as floats.
+*/
+void SaveBufferSliceAsync(cl_mem buff, size_t slice, const char OutFileDir[], const char type[], int iter){
+    cl_int err ;
+    cl_event ready ;
+    if(FullOutput){
+        float *data = AcquireOutputBuffer();
+        size_t bufferOrigin[3] = {0, 0, slice*NZ} ;
+        size_t hostOrigin[3] = {0, 0, 0} ;
+        size_t cell = StorageBytes() ;
+        size_t region[3] = {cell*NX, NY, NZ} ;
+        err = clEnqueueReadBufferRect(queue, buff, CL_FALSE, bufferOrigin, hostOrigin, region, cell*PITCH, cell*PITCH*NY, cell*NX, cell*NX*NY, data, 0, NULL, &ready);
+        KernErrorHandle(err, "clEnqueueReadBufferRect");
+        TRACE_CL_RECORD(&ready, "clEnqueueReadBufferRect", "transfer");
+        struct FieldShape grid = GridShape() ;
+        SubmitOutput(OutFileDir, type, iter, data, ready, Precision != PRECISION_SINGLE, &grid);
+    }
+    for(int k = 0 ; k < NumOutputSpecs ; k++){
+        char Name[16] ;
+        float *data = AcquireOutputBuffer();
+        struct FieldShape shape = OutputSpecShape(&OutputSpecs[k]) ;
+        ready = EnqueueOutputSpec(&OutputSpecs[k], buff, slice, data);
+        OutputSpecName(Name, type, &OutputSpecs[k]);
+        SubmitOutput(OutFileDir, Name, iter, data, ready, 0, &shape);
+    }
+}
+
+/**
+@brief Saves a device buffer to a file without waiting for the read or the write.
+@param buff The device buffer of FIELD_CELLS floats.
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+
+The read is enqueued on the in-order queue, so it sees all the steps enqueued before it and completes before the steps enqueued after it.
+*/
+void SaveBufferAsync(cl_mem buff, const char OutFileDir[], const char type[], int iter){
+    SaveBufferSliceAsync(buff, 0, OutFileDir, type, iter);
+}
+
+/**
+@brief Saves a host array to a file without waiting for the write.
+@param MAT The float* data array of NY*NZ rows of PITCH floats. It is copied packed, so it can be overwritten right away.
+@param OutFileDir Name of the outputfile directory.
+@param type "PHASE" or "TEMP"
+@param iter The current iteration number.
+*/
+void SaveArrayAsync(float *MAT, const char OutFileDir[], const char type[], int iter){
+    if(FullOutput){
+        float *data = AcquireOutputBuffer();
+        for(int y=0; y<NY*NZ; y++){
+            memcpy(data + (size_t)NX*y, MAT + (size_t)PITCH*y, sizeof(float)*NX);
+        }
+        struct FieldShape grid = GridShape() ;
+        SubmitOutput(OutFileDir, type, iter, data, NULL, 0, &grid);
+    }
+    for(int k = 0 ; k < NumOutputSpecs ; k++){
+        char Name[16] ;
+        float *data = AcquireOutputBuffer();
+        struct FieldShape shape = OutputSpecShape(&OutputSpecs[k]) ;
+        OutputSpecCPU(&OutputSpecs[k], MAT, data);
+        OutputSpecName(Name, type, &OutputSpecs[k]);
+        SubmitOutput(OutFileDir, Name, iter, data, NULL, 0, &shape);
+    }
+}
+
+#endif
+//END OF FILE
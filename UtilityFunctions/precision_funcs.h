@@ -0,0 +1,227 @@
+/**
+@file precision_funcs.h
+@brief Declares the helpers of the precision modes: the size of the device fields and the conversion between the float host arrays and the device fields.
+
+The host arrays are float in every mode, the initialisation, the CPU backend and the writers are unchanged. The Precision
+variable only sets how the fields are stored on the device:
+|Precision|Device field|Kernel arithmetic and local memory|
+|---------|------------|----------------------------------|
+|PRECISION_SINGLE|float|float|
+|PRECISION_HALF|half, read with vload_half() and written with vstore_half()|float|
+|PRECISION_DOUBLE|double|double, the device needs cl_khr_fp64|
+
+getKernelFromFile() passes -DPRECISION to the kernels, which define their real and store types from it. The device buffers are
+created from the float arrays with CreateFieldBuffer(), and the fields read back for the outfiles are turned into floats with StorageToFloat().
+The half conversion rounds to the nearest even like vstore_half() with the default rounding mode.
+*/
+
+#ifndef PRECISION_FUNCS
+#define PRECISION_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+
+/**
+@brief The bytes of one cell of a device field.
+@return 2, 4 or 8 for half, float or double.
+*/
+size_t StorageBytes(){
+    return (Precision == PRECISION_HALF) ? sizeof(cl_half) : (Precision == PRECISION_DOUBLE) ? sizeof(cl_double) : sizeof(cl_float) ;
+}
+
+/**
+@brief The bytes of one cell of the local memory tiles, the type the kernels compute in.
+@return 4 or 8 for float or double.
+*/
+size_t RealBytes(){
+    return (Precision == PRECISION_DOUBLE) ? sizeof(cl_double) : sizeof(cl_float) ;
+}
+
+/**
+@brief The bytes of a host array that receives device cells and is turned into floats in place by StorageToFloat().
+@param cells The number of cells.
+@return The larger of the device and the float size of the cells.
+*/
+size_t StagingBytes(size_t cells){
+    return ((StorageBytes() > sizeof(float)) ? StorageBytes() : sizeof(float))*cells ;
+}
+
+/**
+@brief Rounds a float to the nearest half.
+@param f The float.
+@return The bits of the half. Values beyond the half range become infinities, NaNs stay NaNs.
+*/
+cl_half FloatToHalf(float f){
+    uint32_t x ;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000 ;
+    uint32_t absx = x & 0x7fffffff ;
+    if(absx >= 0x7f800000){
+        // Infinity or NaN
+        return (cl_half)(sign | 0x7c00 | ((absx > 0x7f800000) ? 0x200 : 0)) ;
+    }
+    if(absx >= 0x477ff000){
+        // Rounds beyond 65504
+        return (cl_half)(sign | 0x7c00) ;
+    }
+    if(absx < 0x38800000){
+        // Subnormal half: the mantissa with the implicit bit, shifted right and rounded to even
+        if(absx < 0x33000000){
+            return (cl_half)sign ;
+        }
+        uint32_t mant = (absx & 0x7fffff) | 0x800000 ;
+        int shift = 126 - (int)(absx >> 23) ;
+        uint32_t h = mant >> shift ;
+        uint32_t rest = mant & ((1u << shift) - 1) ;
+        uint32_t halfway = 1u << (shift - 1) ;
+        if(rest > halfway || (rest == halfway && (h & 1))){
+            h++ ;
+        }
+        return (cl_half)(sign | h) ;
+    }
+    // Normal half: rebias the exponent and round the mantissa to 10 bits, a carry moves into the exponent
+    uint32_t h = ((absx - 0x38000000) >> 13) ;
+    uint32_t rest = absx & 0x1fff ;
+    if(rest > 0x1000 || (rest == 0x1000 && (h & 1))){
+        h++ ;
+    }
+    return (cl_half)(sign | h) ;
+}
+
+/**
+@brief Expands a half to a float, exactly.
+@param h The bits of the half.
+@return The float.
+*/
+float HalfToFloat(cl_half h){
+    uint32_t sign = ((uint32_t)h & 0x8000) << 16 ;
+    uint32_t exp = ((uint32_t)h >> 10) & 0x1f ;
+    uint32_t mant = (uint32_t)h & 0x3ff ;
+    uint32_t x ;
+    if(exp == 0x1f){
+        x = sign | 0x7f800000 | (mant << 13) ;
+    }else if(exp != 0){
+        x = sign | ((exp + 112) << 23) | (mant << 13) ;
+    }else if(mant == 0){
+        x = sign ;
+    }else{
+        // Subnormal half, normalise the mantissa
+        exp = 113 ;
+        while(!(mant & 0x400)){
+            mant <<= 1 ;
+            exp-- ;
+        }
+        x = sign | (exp << 23) | ((mant & 0x3ff) << 13) ;
+    }
+    float f ;
+    memcpy(&f, &x, sizeof(f));
+    return f ;
+}
+
+/**
+@brief Converts a float array to the device storage type.
+@param in The float array.
+@param out The array of cells*StorageBytes() bytes.
+@param cells The number of cells.
+*/
+void FloatToStorage(const float *in, void *out, size_t cells){
+    if(Precision == PRECISION_HALF){
+        cl_half *h = (cl_half*)out ;
+        for(size_t i = 0 ; i < cells ; i++){
+            h[i] = FloatToHalf(in[i]);
+        }
+    }else if(Precision == PRECISION_DOUBLE){
+        cl_double *d = (cl_double*)out ;
+        for(size_t i = 0 ; i < cells ; i++){
+            d[i] = in[i] ;
+        }
+    }else{
+        memcpy(out, in, sizeof(float)*cells);
+    }
+}
+
+/**
+@brief Converts cells of the device storage type to floats in place.
+@param data The array, holding cells values of StorageBytes() on entry and cells floats on return. It has room for both.
+
+The halves are expanded from the end and the doubles are narrowed from the start, so no value is overwritten before it is read.
+*/
+void StorageToFloat(void *data, size_t cells){
+    float *f = (float*)data ;
+    if(Precision == PRECISION_HALF){
+        const cl_half *h = (const cl_half*)data ;
+        for(size_t i = cells ; i-- > 0 ; ){
+            f[i] = HalfToFloat(h[i]);
+        }
+    }else if(Precision == PRECISION_DOUBLE){
+        const cl_double *d = (const cl_double*)data ;
+        for(size_t i = 0 ; i < cells ; i++){
+            f[i] = (float)d[i] ;
+        }
+    }
+}
+
+/**
+@brief Creates the device buffer of a field from its float host array.
+@param MAT The float host array.
+@param cells The number of cells of the buffer.
+@param name The name of the buffer in the error message.
+@return The buffer of cells*StorageBytes() bytes.
+
+In single precision the buffer uses the host array like before. The other modes copy a converted array and the host array
+keeps the initial field.
+*/
+cl_mem CreateFieldBuffer(float *MAT, size_t cells, char name[]){
+    cl_int err ;
+    cl_mem buff ;
+    if(Precision == PRECISION_SINGLE){
+        buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(float)*cells, MAT, &err);
+    }else{
+        void *data = malloc(StorageBytes()*cells);
+        FloatToStorage(MAT, data, cells);
+        buff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, StorageBytes()*cells, data, &err);
+        free(data);
+    }
+    ErrorHandle(err, name);
+    return buff ;
+}
+
+/**
+@brief Checks that the device supports the precision, and exits if it does not.
+@param device The device.
+*/
+void CheckPrecision(cl_device_id device){
+    if(Precision < PRECISION_SINGLE || Precision > PRECISION_DOUBLE){
+        printf("Error: Precision %d, set it to 0 (single), 1 (half) or 2 (double)\n", Precision);
+        exit(1);
+    }
+    if(Precision != PRECISION_DOUBLE){
+        return ;
+    }
+    size_t size ;
+    cl_int err = clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+    ErrorHandle(err, "clGetDeviceInfo extensions");
+    char *extensions = (char*)malloc(size+1);
+    err = clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    ErrorHandle(err, "clGetDeviceInfo extensions");
+    extensions[size] = '\0' ;
+    if(strstr(extensions, "cl_khr_fp64") == NULL){
+        printf("Error: the double precision needs cl_khr_fp64, which the device does not support\n");
+        exit(1);
+    }
+    free(extensions);
+}
+
+#endif
+// END OF FILE
@@ -18,9 +18,94 @@
 #include "global_vars.h"
 #include "error_handle.h"
 
+/**
+@brief Reads the list of the diagnostics to sample.
+@param List The names of DIAGNOSTIC_NAMES separated by commas, e.g. "mean,min,max".
+@return The bits of the names in the list.
+*/
+cl_int readDiagnosticsList(char List[]){
+    const char *Names[NUM_DIAGNOSTICS] = DIAGNOSTIC_NAMES ;
+    cl_int mask = 0 ;
+    for(char *name = strtok(List, ", \t"); name != NULL; name = strtok(NULL, ", \t")){
+        int k = 0 ;
+        while(k < NUM_DIAGNOSTICS && strcmp(name, Names[k]) != 0){
+            k++ ;
+        }
+        if(k == NUM_DIAGNOSTICS){
+            printf("Error: unknown diagnostic %s, the diagnostics are mean, min, max, frac and interface\n", name);
+            exit(1);
+        }
+        mask |= 1 << k ;
+    }
+    return mask ;
+}
+
+/**
+@brief Adds a reduced output to OutputSpecs.
+@param Value The OutputROI or OutputDecimate value of the input file.
+@param decimate 0 for an OutputROI window, x0,y0,width,height or x0,y0,z0,width,height,depth .
+1 for an OutputDecimate copy of the whole grid, factor,box or factor,stride .
+
+A size of 0 spans the grid from the first cell of the window to its end, so a decimated copy is a window of size 0 and a 2D window spans all the planes.
+*/
+void readOutputSpec(char Value[], int decimate){
+    if(NumOutputSpecs == MAX_OUTPUT_SPECS){
+        printf("Error: more than %d OutputROI and OutputDecimate lines\n", MAX_OUTPUT_SPECS);
+        exit(1);
+    }
+    struct OutputSpec *s = &OutputSpecs[NumOutputSpecs] ;
+    int index = 0 ;
+    for(int k = 0 ; k < NumOutputSpecs ; k++){
+        index += ((OutputSpecs[k].factor > 1) == decimate) ;
+    }
+    memset(s, 0, sizeof(*s));
+    if(decimate){
+        char filter[16] = "box" ;
+        if(sscanf(Value, " %d , %15[a-z]", &s->factor, filter) < 1 || s->factor < 2 || (strcmp(filter, "box") != 0 && strcmp(filter, "stride") != 0)){
+            printf("Error: OutputDecimate is %s, set it to factor,box or factor,stride with a factor of at least 2\n", Value);
+            exit(1);
+        }
+        s->box = (strcmp(filter, "box") == 0) ;
+        snprintf(s->name, sizeof(s->name), "DEC%d", index);
+    }else{
+        int v[6] ;
+        int n = sscanf(Value, " %d , %d , %d , %d , %d , %d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        if(n == 4){
+            s->x0 = v[0] ; s->y0 = v[1] ; s->nx = v[2] ; s->ny = v[3] ;
+        }else if(n == 6){
+            s->x0 = v[0] ; s->y0 = v[1] ; s->z0 = v[2] ; s->nx = v[3] ; s->ny = v[4] ; s->nz = v[5] ;
+        }
+        if((n != 4 && n != 6) || s->nx < 1 || s->ny < 1 || (n == 6 && s->nz < 1)){
+            printf("Error: OutputROI is %s, set it to x0,y0,width,height or x0,y0,z0,width,height,depth\n", Value);
+            exit(1);
+        }
+        s->factor = 1 ;
+        snprintf(s->name, sizeof(s->name), "ROI%d", index);
+    }
+    NumOutputSpecs++ ;
+}
+
+/**
+@brief Checks that the windows of the reduced outputs are inside the grid, exits if one is not.
+
+Called once the grid is known, after the input file is read and after a checkpoint is restored.
+*/
+void CheckOutputSpecs(){
+    for(int k = 0 ; k < NumOutputSpecs ; k++){
+        const struct OutputSpec *s = &OutputSpecs[k] ;
+        int nx = (s->nx > 0) ? s->nx : NX - s->x0 ;
+        int ny = (s->ny > 0) ? s->ny : NY - s->y0 ;
+        int nz = (s->nz > 0) ? s->nz : NZ - s->z0 ;
+        if(s->x0 < 0 || s->y0 < 0 || s->z0 < 0 || nx < 1 || ny < 1 || nz < 1 || s->x0 + nx > NX || s->y0 + ny > NY || s->z0 + nz > NZ){
+            printf("Error: the output %s, %d x %d x %d cells at (%d,%d,%d), is not inside the %d x %d x %d grid\n", s->name, nx, ny, nz, s->x0, s->y0, s->z0, NX, NY, NZ);
+            exit(1);
+        }
+    }
+}
+
 /**
 @brief A function to read the parameters common in all input files to global variables.
-@param InputFileName The Input File name as defined by the INPUT_FILE macro in the mainfile.c .
+@param InputFileName The Input File name, given with --input or the default of the system in system_registry.h .
 */
 void readCommonParams(const char InputFileName[]){
     FILE *FileHandle = fopen(InputFileName, "rt");
@@ -32,8 +117,15 @@ void readCommonParams(const char InputFileName[]){
     char tmpbuff[1500];
     char tmpstr1[100];
     char tmpstr2[100];
+    // A 2D grid unless NZ is set
+    NZ = 1 ;
+    // The whole fields and no reduced outputs unless set
+    FullOutput = 1 ;
+    NumOutputSpecs = 0 ;
     
     while(fgets(tmpbuff,1000,FileHandle)){
+        // An empty line must not repeat the key before it, OutputROI and OutputDecimate add an output per line
+        tmpstr1[0] = '\0' ;
         sscanf(tmpbuff,"%100s = %100[^;];",tmpstr1,tmpstr2);
         if(tmpstr1[0] != '#'){
             // Simulation matrix size parameters
@@ -43,8 +135,17 @@ void readCommonParams(const char InputFileName[]){
                 devID = atoi(tmpstr2);
             }else if(strcmp(tmpstr1,"WGsize")==0){
                 WGsize = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"Autotune")==0){
+                Autotune = atoi(tmpstr2);
             }else if(strcmp(tmpstr1,"SIZE")==0){
-                SIZE = atoi(tmpstr2);
+                NX = atoi(tmpstr2);
+                NY = NX ;
+            }else if(strcmp(tmpstr1,"NX")==0){
+                NX = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"NY")==0){
+                NY = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"NZ")==0){
+                NZ = atoi(tmpstr2);
             }else if(strcmp(tmpstr1,"DX")==0){
                 DX = atof(tmpstr2);
             }else if(strcmp(tmpstr1,"ITERS")==0){
@@ -55,15 +156,56 @@ void readCommonParams(const char InputFileName[]){
                 NSAVE = atoi(tmpstr2);
             }else if(strcmp(tmpstr1,"OutDataFileType")==0){
                 OutDataFileType = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"TiledKernels")==0){
+                TiledKernels = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"SparseTiles")==0){
+                SparseTiles = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"TimeBlock")==0){
+                TimeBlock = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"OutputBuffers")==0){
+                OutputBuffers = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"CompressErrorBound")==0){
+                CompressErrorBound = atof(tmpstr2);
+            }else if(strcmp(tmpstr1,"ProgramCache")==0){
+                ProgramCache = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"CheckpointEvery")==0){
+                CheckpointEvery = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"Precision")==0){
+                Precision = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"AdaptiveDT")==0){
+                AdaptiveDT = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"DTTolerance")==0){
+                DTTolerance = atof(tmpstr2);
+            }else if(strcmp(tmpstr1,"DiagnosticsEvery")==0){
+                DiagnosticsEvery = atoi(tmpstr2);
+            }else if(strcmp(tmpstr1,"Diagnostics")==0){
+                DiagnosticsMask = readDiagnosticsList(tmpstr2);
+            }else if(strcmp(tmpstr1,"OutputROI")==0){
+                readOutputSpec(tmpstr2, 0);
+            }else if(strcmp(tmpstr1,"OutputDecimate")==0){
+                readOutputSpec(tmpstr2, 1);
+            }else if(strcmp(tmpstr1,"FullOutput")==0){
+                FullOutput = atoi(tmpstr2);
             }
         }
     }
-    
+    if(NX < 3 || NY < 3){
+        printf("Error: the grid of %s is %d x %d, set SIZE or NX and NY to at least 3\n", InputFileName, NX, NY);
+        exit(1);
+    }
+    if(NZ < 1 || NZ == 2){
+        printf("Error: NZ of %s is %d, set it to 1 for a 2D grid or to at least 3\n", InputFileName, NZ);
+        exit(1);
+    }
+    PITCH = ((NX + PITCH_ALIGN - 1)/PITCH_ALIGN)*PITCH_ALIGN ;
+    GridNX = NX ;
+    GridNY = NY ;
+    CheckOutputSpecs();
 }
 
 /**
 @brief A function to read the parameters specific to the diffusion system input file.
-@param InputFileName The Input File name as defined by the INPUT_FILE macro in the mainfile.c .
+@param InputFileName The Input File name, given with --input or the default of the system in system_registry.h .
 @return A DiffusionInputParams struct.
 */
 struct DiffusionInputParams readDiffusionInParams(const char InputFileName[]){
@@ -93,7 +235,7 @@ struct DiffusionInputParams readDiffusionInParams(const char InputFileName[]){
 
 /**
 @brief A function to read the parameters specific to the cahn-hilliard (spinodal decomposition) system input file.
-@param InputFileName The Input File name as defined by the INPUT_FILE macro in the mainfile.c .
+@param InputFileName The Input File name, given with --input or the default of the system in system_registry.h .
 @return A CahnHilliardInputParams struct.
 */
 struct CahnHilliardInputParams readCahnHilliardInParams(const char InputFileName[]){
@@ -103,6 +245,7 @@ struct CahnHilliardInputParams readCahnHilliardInParams(const char InputFileName
         perror("ERROR!");
     }
     struct CahnHilliardInputParams Params;
+    Params.SPECTRAL = 0 ;
     char tmpbuff[1000];
     char tmpstr1[100];
     char tmpstr2[100];
@@ -121,6 +264,8 @@ struct CahnHilliardInputParams readCahnHilliardInParams(const char InputFileName
                 Params.KAPPA = atof(tmpstr2);
             }else if(strcmp(tmpstr1,"MOBILITY")==0){
                 Params.MOBILITY = atof(tmpstr2);
+            }else if(strcmp(tmpstr1,"SPECTRAL")==0){
+                Params.SPECTRAL = atoi(tmpstr2);
             }
         }
     }
@@ -129,7 +274,7 @@ struct CahnHilliardInputParams readCahnHilliardInParams(const char InputFileName
 
 /**
 @brief A function to read the parameters specific to the Kobayashi isotropic dendritic growth system input file.
-@param InputFileName The Input File name as defined by the INPUT_FILE macro in the mainfile.c .
+@param InputFileName The Input File name, given with --input or the default of the system in system_registry.h .
 @return A KobIsoInputParams struct.
 */
 struct KobIsoInputParams readKobIsoInParams(const char InputFileName[]){
@@ -193,7 +338,7 @@ struct KobIsoInputParams readKobIsoInParams(const char InputFileName[]){
 
 /**
 @brief A function to read the parameters specific to the Kobayashi anisotropic dendritic growth system input file.
-@param InputFileName The Input File name as defined by the INPUT_FILE macro in the mainfile.c .
+@param InputFileName The Input File name, given with --input or the default of the system in system_registry.h .
 @return A KobAnisoInputParams struct.
 */
 struct KobAnisoInputParams readKobAnisoInParams(const char InputFileName[]){
@@ -0,0 +1,226 @@
+/**
+@file reduce_funcs.h
+@brief Declares the reductions of the fields to scalars, on the device with the kernels of ReduceKern.cl and on the host with OpenMP.
+
+A device reduction runs REDUCE_GROUPS work groups, each writes one partial result and the host reduces the partial results,
+so only a few hundred bytes are read back. A reduction may have several results, each work group then writes one partial
+result of each. Every reduction has two slots of partial results: the host can read the result
+of one slot while the next reduction is enqueued into the other, and the device does not wait for the host.
+*/
+
+#ifndef REDUCE_FUNCS
+#define REDUCE_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "precision_funcs.h"
+#include "file_to_program.h"
+#include "trace_funcs.h"
+
+/// The number of work groups, and of partial results, of a device reduction.
+#define REDUCE_GROUPS 64
+/// The largest work group of a device reduction.
+#define REDUCE_MAX_LOCAL 256
+/// The largest number of results of a device reduction.
+#define REDUCE_MAX_VALUES 8
+
+/// The partial results of a result are added.
+#define REDUCE_SUM 0
+/// The smallest partial result is kept.
+#define REDUCE_MIN 1
+/// The largest partial result is kept.
+#define REDUCE_MAX 2
+
+/// A reduction kernel with its two slots of partial results.
+struct DeviceReduction{
+    cl_kernel kern ;
+    /// The number of results, each work group writes one partial result of each.
+    int values ;
+    /// The 1D local and global work sizes.
+    size_t localWS, globalWS ;
+    /// The device partial results of the slots, values*REDUCE_GROUPS reals each.
+    cl_mem partialbuff[2] ;
+    /// The host copies of the partial results.
+    void *partial[2] ;
+    /// The reads of the partial results, NULL if the slot has none pending.
+    cl_event ready[2] ;
+};
+
+/**
+@brief Creates a reduction from a kernel of ReduceKern.cl .
+@param KernelName The name of the kernel, e.g. "max_change_kern".
+@param values The number of results of the kernel, at most REDUCE_MAX_VALUES.
+@return The reduction, release it with ReleaseDeviceReduction().
+
+The work group is the largest power of two the kernel allows, at most REDUCE_MAX_LOCAL.
+*/
+struct DeviceReduction CreateDeviceReduction(const char KernelName[], int values){
+    cl_int err ;
+    struct DeviceReduction r ;
+    r.kern = getKernelFromProgram(KernelName);
+    r.values = values ;
+    size_t maxLocal ;
+    err = clGetKernelWorkGroupInfo(r.kern, devices[devID], CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxLocal), &maxLocal, NULL);
+    ErrorHandle(err, "clGetKernelWorkGroupInfo reduction");
+    r.localWS = 1 ;
+    while(2*r.localWS <= maxLocal && 2*r.localWS <= REDUCE_MAX_LOCAL){
+        r.localWS *= 2 ;
+    }
+    r.globalWS = r.localWS*REDUCE_GROUPS ;
+    for(int s = 0 ; s < 2 ; s++){
+        r.partialbuff[s] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, RealBytes()*values*REDUCE_GROUPS, NULL, &err);
+        ErrorHandle(err, "clCreateBuffer reduction");
+        r.partial[s] = malloc(RealBytes()*values*REDUCE_GROUPS);
+        r.ready[s] = NULL ;
+    }
+    return r ;
+}
+
+/**
+@brief Enqueues the reduction of some fields and the non-blocking read of its partial results.
+@param r The reduction.
+@param slot The slot of the partial results, 0 or 1. Its previous result must have been taken with WaitDeviceReduction().
+@param fields The fields, the first arguments of the kernel.
+@param numFields The number of fields.
+*/
+void EnqueueDeviceReduction(struct DeviceReduction *r, int slot, const cl_mem fields[], int numFields){
+    cl_int err = CL_SUCCESS ;
+    for(int f = 0 ; f < numFields ; f++){
+        err |= clSetKernelArg(r->kern, f, sizeof(cl_mem), &fields[f]);
+    }
+    err |= clSetKernelArg(r->kern, numFields, sizeof(cl_mem), &r->partialbuff[slot]);
+    err |= clSetKernelArg(r->kern, numFields+1, RealBytes()*r->values*r->localWS, NULL);
+    KernErrorHandle(err, "SetKernelArg reduction");
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, r->kern, 1, NULL, &r->globalWS, &r->localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel reduction");
+    TRACE_CL_KERNEL(event, r->kern);
+    err = clEnqueueReadBuffer(queue, r->partialbuff[slot], CL_FALSE, 0, RealBytes()*r->values*REDUCE_GROUPS, r->partial[slot], 0, NULL, &r->ready[slot]);
+    KernErrorHandle(err, "clEnqueueReadBuffer reduction");
+    TRACE_CL_RECORD(&r->ready[slot], "clEnqueueReadBuffer reduction", "transfer");
+}
+
+/**
+@brief Waits for the partial results of a slot and reduces them on the host.
+@param r The reduction.
+@param slot The slot filled by EnqueueDeviceReduction().
+@param ops How each result is reduced, REDUCE_SUM, REDUCE_MIN or REDUCE_MAX.
+@param results The results, r->values doubles.
+*/
+void WaitDeviceReduction(struct DeviceReduction *r, int slot, const int ops[], double results[]){
+    cl_int err = clWaitForEvents(1, &r->ready[slot]);
+    KernErrorHandle(err, "clWaitForEvents reduction");
+    clReleaseEvent(r->ready[slot]);
+    r->ready[slot] = NULL ;
+    for(int k = 0 ; k < r->values ; k++){
+        for(int g = 0 ; g < REDUCE_GROUPS ; g++){
+            size_t i = (size_t)r->values*g + k ;
+            double v = (Precision == PRECISION_DOUBLE) ? ((cl_double*)r->partial[slot])[i] : ((cl_float*)r->partial[slot])[i] ;
+            if(g == 0){
+                results[k] = v ;
+            }else if(ops[k] == REDUCE_SUM){
+                results[k] += v ;
+            }else if(ops[k] == REDUCE_MIN){
+                results[k] = (v < results[k]) ? v : results[k] ;
+            }else{
+                results[k] = (v > results[k]) ? v : results[k] ;
+            }
+        }
+    }
+}
+
+/**
+@brief Waits for the partial results of a slot and takes their largest value.
+@param r The reduction, with one result.
+@param slot The slot filled by EnqueueDeviceReduction().
+@return The largest partial result.
+*/
+double WaitDeviceReductionMax(struct DeviceReduction *r, int slot){
+    const int ops[1] = {REDUCE_MAX} ;
+    double m ;
+    WaitDeviceReduction(r, slot, ops, &m);
+    return m ;
+}
+
+/**
+@brief Waits for the pending reads and frees a reduction.
+@param r The reduction.
+*/
+void ReleaseDeviceReduction(struct DeviceReduction *r){
+    for(int s = 0 ; s < 2 ; s++){
+        if(r->ready[s] != NULL){
+            clWaitForEvents(1, &r->ready[s]);
+            clReleaseEvent(r->ready[s]);
+        }
+        clReleaseMemObject(r->partialbuff[s]);
+        free(r->partial[s]);
+    }
+    clReleaseKernel(r->kern);
+}
+
+/**
+@brief The largest absolute difference of two host fields. Mirrors max_change_kern of ReduceKern.cl .
+@param A The first field, NY*NZ rows of PITCH floats.
+@param B The second field.
+@return The largest difference over the cells of the grid.
+*/
+double CPUMaxChange(const float *A, const float *B){
+    float m = 0.0f ;
+    #pragma omp parallel for schedule(static) reduction(max:m)
+    for(int y = 0 ; y < NY*NZ ; y++){
+        for(int x = 0 ; x < NX ; x++){
+            float d = fabsf(A[(size_t)PITCH*y +x] - B[(size_t)PITCH*y +x]);
+            m = (d > m) ? d : m ;
+        }
+    }
+    return m ;
+}
+
+/**
+@brief The sums, extremes and 0.5 crossings of a host field. Mirrors diagnostics_kern of ReduceKern.cl .
+@param F The field, NY*NZ rows of PITCH floats.
+@param results The sum, the minimum, the maximum, the number of cells above 0.5 and the number of cell faces where the field crosses 0.5.
+*/
+void CPUDiagnostics(const float *F, double results[5]){
+    double sum = 0.0, above = 0.0, faces = 0.0 ;
+    float lo = F[0], hi = F[0] ;
+    #pragma omp parallel for schedule(static) reduction(+:sum,above,faces) reduction(min:lo) reduction(max:hi)
+    for(int row = 0 ; row < NY*NZ ; row++){
+        const int y = row%NY, z = row/NY ;
+        const float *f = F + (size_t)PITCH*row ;
+        for(int x = 0 ; x < NX ; x++){
+            const int in = f[x] > 0.5f ;
+            sum += f[x] ;
+            lo = (f[x] < lo) ? f[x] : lo ;
+            hi = (f[x] > hi) ? f[x] : hi ;
+            above += in ;
+            if(x+1 < NX){
+                faces += (in != (f[x+1] > 0.5f));
+            }
+            if(y+1 < NY){
+                faces += (in != (f[x+PITCH] > 0.5f));
+            }
+            if(z+1 < NZ){
+                faces += (in != (f[x+(size_t)PITCH*NY] > 0.5f));
+            }
+        }
+    }
+    results[0] = sum ;
+    results[1] = lo ;
+    results[2] = hi ;
+    results[3] = above ;
+    results[4] = faces ;
+}
+
+#endif
+// END OF FILE
@@ -0,0 +1,361 @@
+/**
+@file spectral_funcs.h
+@brief Declares the semi-implicit Fourier-spectral solver of the Cahn-Hilliard system, run with SPECTRAL = 1 in the input file.
+
+The explicit step of CahnHilliardKern.cl is stable only for a DT of the order of h^4/(MOBILITY*KAPPA). The spectral step treats
+the stiff KAPPA term implicitly and the bulk term g(C) explicitly. With the 5-point Laplacian of the explicit step,
+\f$ L(k) = -\frac{4}{h^2}\left(\sin^2\frac{\pi k_x}{NX} + \sin^2\frac{\pi k_y}{NY}\right) \f$ in Fourier space, a step is
+\f[ \hat{C}^{n+1} = \frac{\hat{C}^n + DT\,M\,L\,\hat{g}^n}{1 + 2\,DT\,M\,\kappa\,h^2 L^2} \f]
+so both solvers discretise the same equation in space, and the spectral one takes much larger time steps. C and g(C) are
+packed into one complex field, which takes one forward and one inverse 2D FFT per step (see fft_funcs.h).
+
+Unlike the explicit step the concentration is not clamped to [0,1], which keeps the mean concentration exact.
+The solver runs 2D grids whose NX and NY are powers of two, on one OpenCL device or on the CPU backend,
+in any precision of the device fields. The ensemble, multi-device and distributed runs use the explicit step only.
+*/
+
+#ifndef SPECTRAL_FUNCS
+#define SPECTRAL_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+#include "error_handle.h"
+#include "CL_utility_funcs.h"
+#include "precision_funcs.h"
+#include "file_to_program.h"
+#include "autotune_funcs.h"
+#include "cpu_kernels.h"
+#include "fft_funcs.h"
+#include "data_writing_funcs.h"
+#include "output_writer.h"
+#include "checkpoint_funcs.h"
+#include "diagnostics_funcs.h"
+#include "trace_funcs.h"
+
+/**
+@brief Exits unless the grid can be transformed by the spectral solver.
+*/
+void CheckSpectralGrid(){
+    if(NZ > 1 || !IsFFTLength(NX) || !IsFFTLength(NY)){
+        printf("Error: SPECTRAL = 1 runs 2D grids whose NX and NY are powers of two, the grid is %s\n", GridLabel());
+        exit(1);
+    }
+}
+
+/**
+@brief Reports the runs the spectral solver does not support.
+@param InpParams The input parameters.
+@param mode The kind of run, e.g. "--multi-device".
+@return 1 and prints an error if SPECTRAL is set, 0 otherwise.
+*/
+int CahnHilliardSpectralUnsupported(const struct CahnHilliardInputParams *InpParams, const char mode[]){
+    if(InpParams->SPECTRAL){
+        printf("Error: SPECTRAL = 1 runs on one OpenCL device or the CPU backend, not with %s\n", mode);
+        return 1 ;
+    }
+    return 0 ;
+}
+
+/**
+@brief Computes the multipliers of the spectral step.
+@param InpParams The input parameters.
+@return NX*NY interleaved pairs (a, b), to be freed by the caller. The new concentration is a C + b g in Fourier space.
+
+The constants are rounded like the build options of the kernels, so the CPU and the device solve the same problem.
+Both multipliers include the 1/(NX*NY) of the inverse FFT.
+*/
+double* CHSpectralMultipliers(const struct CahnHilliardInputParams *InpParams){
+    const double dt = CLConst(DT), h = CLConst(DX), mobility = CLConst(InpParams->MOBILITY), kappa = CLConst(InpParams->KAPPA);
+    const double scale = 1.0/((double)NX*NY);
+    double *mult = (double*)malloc(sizeof(double)*2*NX*NY);
+    for(int ky = 0 ; ky < NY ; ky++){
+        double sy = sin(FFT_PI*ky/NY);
+        for(int kx = 0 ; kx < NX ; kx++){
+            double sx = sin(FFT_PI*kx/NX);
+            double L = -4.0/(h*h)*(sx*sx + sy*sy);
+            double denom = 1.0 + 2.0*dt*mobility*kappa*h*h*L*L ;
+            mult[2*((size_t)NX*ky +kx)] = scale/denom ;
+            mult[2*((size_t)NX*ky +kx)+1] = scale*dt*mobility*L/denom ;
+        }
+    }
+    return mult ;
+}
+
+/// The work arrays of the spectral step on the host.
+struct CHSpectralCPU{
+    /// The complex field, NX*NY interleaved pairs.
+    float *Z ;
+    /// The multipliers from CHSpectralMultipliers().
+    float *MULT ;
+    /// The twiddle factors of the rows and the columns.
+    float *twX, *twY ;
+};
+
+/**
+@brief One semi-implicit spectral step of the Cahn-Hilliard evolution on the host.
+@param s The work arrays.
+@param PHASE1 The concentration field at time t=n .
+@param PHASE2 The concentration field at time t=n+1 .
+*/
+void cpuCahnHilliardSpectralStep(struct CHSpectralCPU *s, const float *PHASE1, float *PHASE2){
+    float *Z = s->Z ;
+    const float *MULT = s->MULT ;
+    #pragma omp parallel for schedule(static)
+    for(int gy=0; gy<NY; gy++){
+        for(int gx=0; gx<NX; gx++){
+            float M = PHASE1[PITCH*gy +gx];
+            Z[2*((size_t)NX*gy +gx)] = M ;
+            Z[2*((size_t)NX*gy +gx)+1] = (float)2*M*(0.9-M)*(1-2*M);
+        }
+    }
+    FFT2D(Z, s->twX, s->twY, -1);
+    #pragma omp parallel for schedule(static)
+    for(size_t c=0; c<(size_t)NX*NY; c++){
+        float zr = Z[2*c], zi = Z[2*c+1] ;
+        float a = MULT[2*c], b = MULT[2*c+1] ;
+        Z[2*c] = a*zr + b*zi ;
+        Z[2*c+1] = a*zi - b*zr ;
+    }
+    FFT2D(Z, s->twX, s->twY, 1);
+    #pragma omp parallel for schedule(static)
+    for(int gy=0; gy<NY; gy++){
+        for(int gx=0; gx<NX; gx++){
+            PHASE2[PITCH*gy +gx] = Z[2*((size_t)NX*gy +gx)];
+        }
+    }
+}
+
+/**
+@brief A function to fully iterate the cahn-Hilliard system with the spectral step on the CPU.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+*/
+static inline void iterateCahnHilliardSpectralCPU(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    CheckSpectralGrid();
+    printf("   : CPU backend with %d threads\n", CPUNumThreads());
+    printf("   : Semi-implicit spectral Cahn-Hilliard step\n");
+    double tot_exec_time = 0.0, start ;
+
+    struct CHSpectralCPU s ;
+    s.Z = (float*)malloc(sizeof(float)*2*NX*NY);
+    s.MULT = (float*)malloc(sizeof(float)*2*NX*NY);
+    double *mult = CHSpectralMultipliers(&inpparams);
+    for(size_t c = 0 ; c < (size_t)2*NX*NY ; c++){
+        s.MULT[c] = (float)mult[c] ;
+    }
+    free(mult);
+    s.twX = FFTTwiddles(NX);
+    s.twY = FFTTwiddles(NY);
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_SPECTRAL_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Compute size is %lu\n", (unsigned long)NX*NY*ITERS);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const float *DiagFields[1] = {databuffers.PHASE1} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnosticsCPU(&diag, DiagFields, StartIter);
+
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+        start = CPUWallTime();
+        TRACE_SPAN_BEGIN(steps);
+        cpuCahnHilliardSpectralStep(&s, databuffers.PHASE1, databuffers.PHASE2);
+        cpuCahnHilliardSpectralStep(&s, databuffers.PHASE2, databuffers.PHASE1);
+        TRACE_SPAN_END(steps, "cpuCahnHilliardSpectralStep x2", "cpu");
+        tot_exec_time += CPUWallTime() - start;
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnosticsCPU(&diag, DiagFields, iter+1);
+        }
+
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
+            SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", iter);
+        }
+
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getCahnHilliardCheckpointFields(&databuffers, fields);
+            WriteCheckpoint(OutFileDir, "CAHNHILLIARD", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+        }
+    }
+
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    SaveArrayAsync(databuffers.PHASE1, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+    free(s.Z);
+    free(s.MULT);
+    free(s.twX);
+    free(s.twY);
+}
+
+/// The kernels and the buffers of the spectral step on the device.
+struct CHSpectralCL{
+    cl_kernel packKern, rowsKern, colsKern, updateKern, unpackKern ;
+    /// The complex field and the second buffer of the FFT stages, NX*NY pairs of the kernel precision.
+    cl_mem Zbuff, Ztmpbuff ;
+    /// The multipliers from CHSpectralMultipliers().
+    cl_mem MULTbuff ;
+    /// The work sizes of the pack, update and unpack kernels, and the local work size of the FFT stages.
+    size_t globalWS[2], localWS[2] ;
+};
+
+/**
+@brief Enqueues one of the pointwise kernels of the spectral step.
+@param s The kernels and the buffers.
+@param kern The kernel.
+@param IN The first argument.
+@param OUT The second argument.
+*/
+static inline void EnqueueSpectralPointwise(struct CHSpectralCL *s, cl_kernel kern, cl_mem IN, cl_mem OUT){
+    cl_int err ;
+    err = clSetKernelArg(kern, 0, sizeof(cl_mem), &IN);
+    KernErrorHandle(err,"SetKernelArg 0");
+    err = clSetKernelArg(kern, 1, sizeof(cl_mem), &OUT);
+    KernErrorHandle(err,"SetKernelArg 1");
+    cl_event *event = TRACE_CL_EVENT(NULL);
+    err = clEnqueueNDRangeKernel(queue, kern, 2, NULL, s->globalWS, s->localWS, 0, NULL, event);
+    KernErrorHandle(err, "clEnqueueNDRangeKernel spectral");
+    TRACE_CL_KERNEL(event, kern);
+}
+
+/**
+@brief One semi-implicit spectral step of the Cahn-Hilliard evolution on the device.
+@param s The kernels and the buffers.
+@param PHASE1buff The input phase buffer.
+@param PHASE2buff The output phase buffer.
+*/
+static inline void CahnHilliardSpectralStep(struct CHSpectralCL *s, cl_mem PHASE1buff, cl_mem PHASE2buff){
+    EnqueueSpectralPointwise(s, s->packKern, PHASE1buff, s->Zbuff);
+    cl_mem hat = EnqueueFFT2D(s->rowsKern, s->colsKern, s->localWS, s->Zbuff, s->Ztmpbuff, -1);
+    EnqueueSpectralPointwise(s, s->updateKern, hat, s->MULTbuff);
+    cl_mem other = (hat == s->Zbuff) ? s->Ztmpbuff : s->Zbuff ;
+    cl_mem out = EnqueueFFT2D(s->rowsKern, s->colsKern, s->localWS, hat, other, 1);
+    EnqueueSpectralPointwise(s, s->unpackKern, out, PHASE2buff);
+}
+
+// The autotune launch of the forward FFT, the stages set the work group of the whole step
+static cl_int TuneSpectralFFT(const struct TuneTarget *t, size_t globalWS[2], size_t localWS[2], cl_int steps){
+    (void)globalWS ;
+    (void)steps ;
+    EnqueueFFT2D(t->kern[0], t->kern[1], localWS, t->buff[0], t->buff[1], -1);
+    return 1 ;
+}
+
+/**
+@brief A function to fully iterate the cahn-hilliard system with the spectral step on one device.
+@param inpparams A CahnHilliardInputParams structure.
+@param databuffers A CahnHilliardDataBuffers structure.
+*/
+static inline void iterateCahnHilliardSpectralKernel(struct CahnHilliardInputParams inpparams, struct CahnHilliardDataBuffers databuffers){
+    CheckSpectralGrid();
+    cl_int err ;
+    struct CHSpectralCL s ;
+    s.packKern = getKernelFromProgram("ch_spectral_pack_kern");
+    s.rowsKern = getKernelFromProgram("fft_rows_kern");
+    s.colsKern = getKernelFromProgram("fft_cols_kern");
+    s.updateKern = getKernelFromProgram("ch_spectral_update_kern");
+    s.unpackKern = getKernelFromProgram("ch_spectral_unpack_kern");
+
+    // The complex fields and the multipliers in the kernel precision
+    size_t pairs = (size_t)NX*NY ;
+    s.Zbuff = clCreateBuffer(context, CL_MEM_READ_WRITE, 2*RealBytes()*pairs, NULL, &err);
+    ErrorHandle(err, "clCreateBuffer Z");
+    s.Ztmpbuff = clCreateBuffer(context, CL_MEM_READ_WRITE, 2*RealBytes()*pairs, NULL, &err);
+    ErrorHandle(err, "clCreateBuffer Ztmp");
+    double *mult = CHSpectralMultipliers(&inpparams);
+    if(Precision != PRECISION_DOUBLE){
+        // Narrowed in place, the floats never overtake the doubles
+        float *f = (float*)mult ;
+        for(size_t c = 0 ; c < 2*pairs ; c++){
+            f[c] = (float)mult[c] ;
+        }
+    }
+    s.MULTbuff = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 2*RealBytes()*pairs, mult, &err);
+    ErrorHandle(err, "clCreateBuffer MULT");
+    free(mult);
+
+    struct TuneTarget tune = {"fft_rows_kern+fft_cols_kern", {s.rowsKern, s.colsKern},
+                              {s.Zbuff, s.Ztmpbuff}, 2, TuneSpectralFFT, NULL} ;
+    ChooseWorkGroup(&tune, s.localWS, NULL);
+    PadGlobalWorkSize(s.globalWS, s.localWS);
+    printf("   : Work group size: %lu x %lu\n", (unsigned long)s.localWS[0], (unsigned long)s.localWS[1]);
+    printf("   : Semi-implicit spectral Cahn-Hilliard step\n");
+
+    cl_float tot_exec_time = 0.0f;
+
+    char OutFileDir[128] ;
+    sprintf(OutFileDir,"./OutDataFiles/CAHN_HILLIARD_SPECTRAL_%s_%dITERS", GridLabel(), ITERS);
+    mkdir(OutFileDir,0777);
+    printf("   : Enqueuing kernels:\n   : Compute size is %lu\n", (unsigned long)GRID_CELLS*ITERS);
+
+    // The diagnostics of the fields, see diagnostics_funcs.h
+    const char *DiagNames[1] = {"PHASE"} ;
+    const cl_mem DiagFields[1] = {databuffers.PHASE1buff} ;
+    struct Diagnostics diag = StartDiagnostics(OutFileDir, DiagNames, 1);
+    SampleDiagnostics(&diag, DiagFields, StartIter);
+
+    // Profiling markers, the host only waits for the device at the save points
+    cl_event startMarker = EnqueueProfilingMarker();
+    for(int iter = StartIter ; iter < ITERS ; iter++){
+
+        CahnHilliardSpectralStep(&s, databuffers.PHASE1buff, databuffers.PHASE2buff);
+        CahnHilliardSpectralStep(&s, databuffers.PHASE2buff, databuffers.PHASE1buff);
+
+        if(DiagnosticsDue(iter)){
+            SampleDiagnostics(&diag, DiagFields, iter+1);
+        }
+
+        if((iter+1)%FLUSH_ITERS == 0){
+            clFlush(queue);
+        }
+
+        if(iter %((int)(ITERS/NSAVE)) == 0){
+            cl_event endMarker = EnqueueProfilingMarker();
+            SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", iter);
+            cl_event nextMarker = EnqueueProfilingMarker();
+            tot_exec_time += GetMarkerIntervalTime(startMarker, endMarker);
+            startMarker = nextMarker ;
+            printf("%2d%s: complete in time %5.2f mins\n",100*iter/ITERS,"%", tot_exec_time/60.0);
+        }
+
+        if(CheckpointDue(iter)){
+            struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+            int numFields = getCahnHilliardCheckpointFields(&databuffers, fields);
+            tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+            WriteCheckpoint(OutFileDir, "CAHNHILLIARD", &inpparams, sizeof(inpparams), iter+1, fields, numFields);
+            startMarker = EnqueueProfilingMarker();
+        }
+    }
+
+    tot_exec_time += GetMarkerIntervalTime(startMarker, EnqueueProfilingMarker());
+    printf("%2d%s: complete in time %5.2f mins\n",100,"%", tot_exec_time/60.0);
+    printf("   : %.2f MLUPS\n", MLUPS(GRID_CELLS, 2.0*(ITERS-StartIter), tot_exec_time));
+    SaveBufferAsync(databuffers.PHASE1buff, OutFileDir, "PHASE", ITERS);
+    StopDiagnostics(&diag);
+
+    clFinish(queue);
+    clReleaseMemObject(s.Zbuff);
+    clReleaseMemObject(s.Ztmpbuff);
+    clReleaseMemObject(s.MULTbuff);
+    clReleaseKernel(s.packKern);
+    clReleaseKernel(s.rowsKern);
+    clReleaseKernel(s.colsKern);
+    clReleaseKernel(s.updateKern);
+    clReleaseKernel(s.unpackKern);
+}
+
+#endif
+// END OF FILE
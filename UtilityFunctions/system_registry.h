@@ -0,0 +1,373 @@
+/**
+@file system_registry.h
+@brief Declares the registry of the simulated systems, the table main() picks a system from at runtime.
+
+Every system is described by a SystemDescriptor: its name, default input file, kernel file and the functions that read
+its input parameters, initialise its data buffers, make its build options, iterate it and list its checkpoint fields.
+The functions of a system take its own input parameters and data buffers structs, the descriptor reaches them through
+the small adapter functions below, which take the structs as void pointers. The systems with an ensemble kernel also
+list the parameters that may vary between the replicas of an ensemble (see ensemble_funcs.h). The following table lists the systems:
+|Name|System|Default input file|Kernel file|3D grids|Multi-device|MPI halo|
+|----|------|------------------|-----------|--------|------------|--------|
+|DIFFUSION|Diffusion|InputFiles/Diffusion.in|Kernels/DiffusionKern.cl|yes|yes|1, periodic|
+|CAHNHILLIARD|Spinodal decomposition|InputFiles/CahnHilliard.in|Kernels/CahnHilliardKern.cl|yes|yes|2, periodic|
+|KOBISO|Isotropic dendritic growth|InputFiles/KobayashiIso.in|Kernels/KobayashiIsoKern.cl|no|no|1|
+|KOBANISO|Anisotropic dendritic growth|InputFiles/KobayashiAniso.in|Kernels/KobayashiAnisoKern.cl|no|no|2|
+
+The CAHNHILLIARD iterate adapters run the spectral solver of spectral_funcs.h when SPECTRAL is set in the input file.
+The KOBANISO OpenCL iterate adapter runs over the active tiles of active_tiles_funcs.h when SparseTiles is set in the input file.
+Every system runs with the adaptive time step of adaptive_dt_funcs.h, on the OpenCL or the CPU backend.
+A new system is added with its adapters and one more entry in the Systems array, with designated initializers: the members it does not support are left out and stay NULL or 0.
+*/
+
+#ifndef SYSTEM_REGISTRY
+#define SYSTEM_REGISTRY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global_vars.h"
+#include "read_inp_file.h"
+#include "file_to_program.h"
+#include "init_CL_buffers.h"
+#include "iterate_kernels.h"
+#include "iterate_cpu.h"
+#include "spectral_funcs.h"
+#include "active_tiles_funcs.h"
+#include "adaptive_dt_funcs.h"
+#include "benchmark_funcs.h"
+#include "checkpoint_funcs.h"
+#include "ensemble_funcs.h"
+#include "multi_device_funcs.h"
+#include "mpi_funcs.h"
+
+/// The description of a simulated system. The params and buffers arguments point to the structs of the system.
+struct SystemDescriptor{
+    /// The name given with --system, also stored in the checkpoints.
+    const char *name ;
+    /// A one line description.
+    const char *description ;
+    /// The input file used when --input is not given.
+    const char *inputFile ;
+    /// The .cl file of the OpenCL kernels.
+    const char *kernelFile ;
+    /// The size of the input parameters struct.
+    size_t paramsBytes ;
+    /// The size of the data buffers struct.
+    size_t buffersBytes ;
+    /// Reads the input file into the input parameters struct.
+    void (*readParams)(const char InputFileName[], void *params) ;
+    /// Allocates and initialises the data buffers struct.
+    void (*initBuffers)(const void *params, void *buffers) ;
+    /// Writes the "-D" build options of the kernel file.
+    void (*buildOptions)(const void *params, char BuildProgOptions[], size_t bytes) ;
+    /// Iterates the system with the OpenCL kernels.
+    void (*iterateKernel)(const void *params, const void *buffers) ;
+    /// Iterates the system with the native CPU backend.
+    void (*iterateCPU)(const void *params, const void *buffers) ;
+    /// Lists the data buffers saved in a checkpoint, returns their number.
+    int (*checkpointFields)(void *buffers, struct CheckpointField fields[]) ;
+    /// Benchmarks the kernel variants (--bench), NULL if the system has a single variant.
+    void (*bench)(const void *params, const void *buffers) ;
+    /// The parameters that may vary between the replicas of an ensemble (--ensemble), NULL if the system has no ensemble kernel.
+    const struct EnsembleParam *ensembleParams ;
+    /// The number of entries of ensembleParams.
+    int numEnsembleParams ;
+    /// Allocates and initialises the data buffers struct of an ensemble.
+    void (*initEnsemble)(const struct Ensemble *ens, void *buffers) ;
+    /// Iterates an ensemble with the OpenCL ensemble kernel.
+    void (*iterateEnsemble)(const struct Ensemble *ens, const void *buffers) ;
+    /// 1 if the OpenCL kernels of the system also run 3D grids (NZ > 1).
+    int grid3D ;
+    /// Iterates the system on strips of the grid, one per device (--multi-device), NULL if the system has no strip kernels.
+    void (*iterateMultiDevice)(const void *params, const void *buffers) ;
+    /// The reach of one step of the CPU kernels, the halo of the blocks of a distributed run (see mpi_funcs.h).
+    int haloWidth ;
+    /// 1 if the boundaries of the grid are periodic.
+    int periodic ;
+    /// Iterates the block of this process of a distributed run, NULL if built without MPI.
+    void (*iterateDistributed)(const void *params, const void *buffers) ;
+    /// Times single steps on the current backend for the benchmark suite (see bench_suite.h), localWS is ignored by the CPU backend.
+    void (*timeSteps)(const void *params, const void *buffers, const size_t localWS[2], int steps, double latency[]) ;
+    /// Frees the data buffers struct.
+    void (*releaseBuffers)(const void *buffers) ;
+    /// The bytes a step has to read and write per cell, one read and one write of every evolved field. The effective bandwidth is computed from it.
+    int bytesPerCell ;
+    /// Iterates the system with the adaptive time step (AdaptiveDT = 1) on the current backend, see adaptive_dt_funcs.h .
+    void (*iterateAdaptive)(const void *params, const void *buffers) ;
+};
+
+#ifdef USE_MPI
+/// The distributed iterate adapter of a system, NULL if built without MPI.
+#define DISTRIBUTED(adapter) adapter
+
+// Distributed adapters
+static void iterateDiffusionSystemMPI(const void *params, const void *buffers){
+    iterateDiffusionMPI(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers);
+}
+static void iterateCahnHilliardSystemMPI(const void *params, const void *buffers){
+    if(CahnHilliardSpectralUnsupported((const struct CahnHilliardInputParams*)params, "MPI")){
+        // Every process reads the same parameters, so all of them stop here
+        exit(FailMPI());
+    }
+    iterateCahnHilliardMPI(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+}
+static void iterateKobayashiIsoSystemMPI(const void *params, const void *buffers){
+    iterateKobayashiIsoMPI(*(const struct KobIsoInputParams*)params, *(const struct KobIsoDataBuffers*)buffers);
+}
+static void iterateKobayashiAnisoSystemMPI(const void *params, const void *buffers){
+    iterateKobayashiAnisoMPI(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+}
+#else
+#define DISTRIBUTED(adapter) NULL
+#endif
+
+// Diffusion adapters
+static void readDiffusionSystem(const char InputFileName[], void *params){
+    *(struct DiffusionInputParams*)params = readDiffusionInParams(InputFileName);
+}
+static void initDiffusionSystem(const void *params, void *buffers){
+    *(struct DiffusionDataBuffers*)buffers = initDiffusionBuffers(*(const struct DiffusionInputParams*)params);
+}
+static void buildDiffusionSystem(const void *params, char BuildProgOptions[], size_t bytes){
+    getDiffusionBuildOptions((const struct DiffusionInputParams*)params, BuildProgOptions, bytes);
+}
+static void iterateDiffusionSystemKernel(const void *params, const void *buffers){
+    iterateDiffusionKernel(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers);
+}
+static void iterateDiffusionSystemCPU(const void *params, const void *buffers){
+    iterateDiffusionCPU(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers);
+}
+static int fieldsDiffusionSystem(void *buffers, struct CheckpointField fields[]){
+    return getDiffusionCheckpointFields((struct DiffusionDataBuffers*)buffers, fields);
+}
+static void iterateDiffusionSystemMultiDevice(const void *params, const void *buffers){
+    iterateDiffusionMultiDevice(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers);
+}
+static void iterateDiffusionSystemAdaptive(const void *params, const void *buffers){
+    if(Backend == BACKEND_CPU){
+        iterateDiffusionAdaptiveCPU(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers);
+    }else{
+        iterateDiffusionAdaptiveKernel(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers);
+    }
+}
+static void timeDiffusionSystem(const void *params, const void *buffers, const size_t localWS[2], int steps, double latency[]){
+    timeDiffusionSteps(*(const struct DiffusionInputParams*)params, *(const struct DiffusionDataBuffers*)buffers, localWS, steps, latency);
+}
+static void releaseDiffusionSystem(const void *buffers){
+    releaseDiffusionBuffers(*(const struct DiffusionDataBuffers*)buffers);
+}
+
+// Cahn-Hilliard adapters
+static void readCahnHilliardSystem(const char InputFileName[], void *params){
+    *(struct CahnHilliardInputParams*)params = readCahnHilliardInParams(InputFileName);
+}
+static void initCahnHilliardSystem(const void *params, void *buffers){
+    *(struct CahnHilliardDataBuffers*)buffers = initCahnHilliardBuffers(*(const struct CahnHilliardInputParams*)params);
+}
+static void buildCahnHilliardSystem(const void *params, char BuildProgOptions[], size_t bytes){
+    getCahnHilliardBuildOptions((const struct CahnHilliardInputParams*)params, BuildProgOptions, bytes);
+}
+static void iterateCahnHilliardSystemKernel(const void *params, const void *buffers){
+    if(((const struct CahnHilliardInputParams*)params)->SPECTRAL){
+        iterateCahnHilliardSpectralKernel(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+        return ;
+    }
+    iterateCahnHilliardKernel(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+}
+static void iterateCahnHilliardSystemCPU(const void *params, const void *buffers){
+    if(((const struct CahnHilliardInputParams*)params)->SPECTRAL){
+        iterateCahnHilliardSpectralCPU(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+        return ;
+    }
+    iterateCahnHilliardCPU(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+}
+static int fieldsCahnHilliardSystem(void *buffers, struct CheckpointField fields[]){
+    return getCahnHilliardCheckpointFields((struct CahnHilliardDataBuffers*)buffers, fields);
+}
+static void benchCahnHilliardSystem(const void *params, const void *buffers){
+    benchCahnHilliardKernels(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+}
+static void initCahnHilliardSystemEnsemble(const struct Ensemble *ens, void *buffers){
+    *(struct CahnHilliardDataBuffers*)buffers = initCahnHilliardEnsembleBuffers(ens);
+}
+static void iterateCahnHilliardSystemEnsemble(const struct Ensemble *ens, const void *buffers){
+    if(CahnHilliardSpectralUnsupported((const struct CahnHilliardInputParams*)ReplicaParams(ens, 0), "--ensemble")){
+        exit(1);
+    }
+    iterateCahnHilliardEnsembleKernel(ens, *(const struct CahnHilliardDataBuffers*)buffers);
+}
+static void iterateCahnHilliardSystemMultiDevice(const void *params, const void *buffers){
+    if(CahnHilliardSpectralUnsupported((const struct CahnHilliardInputParams*)params, "--multi-device")){
+        exit(1);
+    }
+    iterateCahnHilliardMultiDevice(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+}
+static void iterateCahnHilliardSystemAdaptive(const void *params, const void *buffers){
+    if(CahnHilliardSpectralUnsupported((const struct CahnHilliardInputParams*)params, "AdaptiveDT = 1")){
+        exit(1);
+    }
+    if(Backend == BACKEND_CPU){
+        iterateCahnHilliardAdaptiveCPU(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+    }else{
+        iterateCahnHilliardAdaptiveKernel(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers);
+    }
+}
+static void timeCahnHilliardSystem(const void *params, const void *buffers, const size_t localWS[2], int steps, double latency[]){
+    timeCahnHilliardSteps(*(const struct CahnHilliardInputParams*)params, *(const struct CahnHilliardDataBuffers*)buffers, localWS, steps, latency);
+}
+static void releaseCahnHilliardSystem(const void *buffers){
+    releaseCahnHilliardBuffers(*(const struct CahnHilliardDataBuffers*)buffers);
+}
+
+// Kobayashi isotropic adapters
+static void readKobayashiIsoSystem(const char InputFileName[], void *params){
+    *(struct KobIsoInputParams*)params = readKobIsoInParams(InputFileName);
+}
+static void initKobayashiIsoSystem(const void *params, void *buffers){
+    *(struct KobIsoDataBuffers*)buffers = initKobayashiIsoBuffers(*(const struct KobIsoInputParams*)params);
+}
+static void buildKobayashiIsoSystem(const void *params, char BuildProgOptions[], size_t bytes){
+    getKobayashiIsoBuildOptions((const struct KobIsoInputParams*)params, BuildProgOptions, bytes);
+}
+static void iterateKobayashiIsoSystemKernel(const void *params, const void *buffers){
+    iterateKobayashiIsoKernel(*(const struct KobIsoInputParams*)params, *(const struct KobIsoDataBuffers*)buffers);
+}
+static void iterateKobayashiIsoSystemCPU(const void *params, const void *buffers){
+    iterateKobayashiIsoCPU(*(const struct KobIsoInputParams*)params, *(const struct KobIsoDataBuffers*)buffers);
+}
+static int fieldsKobayashiIsoSystem(void *buffers, struct CheckpointField fields[]){
+    return getKobayashiIsoCheckpointFields((struct KobIsoDataBuffers*)buffers, fields);
+}
+static void iterateKobayashiIsoSystemAdaptive(const void *params, const void *buffers){
+    if(Backend == BACKEND_CPU){
+        iterateKobayashiIsoAdaptiveCPU(*(const struct KobIsoInputParams*)params, *(const struct KobIsoDataBuffers*)buffers);
+    }else{
+        iterateKobayashiIsoAdaptiveKernel(*(const struct KobIsoInputParams*)params, *(const struct KobIsoDataBuffers*)buffers);
+    }
+}
+static void timeKobayashiIsoSystem(const void *params, const void *buffers, const size_t localWS[2], int steps, double latency[]){
+    timeKobayashiIsoSteps(*(const struct KobIsoInputParams*)params, *(const struct KobIsoDataBuffers*)buffers, localWS, steps, latency);
+}
+static void releaseKobayashiIsoSystem(const void *buffers){
+    releaseKobayashiIsoBuffers(*(const struct KobIsoDataBuffers*)buffers);
+}
+
+// Kobayashi anisotropic adapters
+static void readKobayashiAnisoSystem(const char InputFileName[], void *params){
+    *(struct KobAnisoInputParams*)params = readKobAnisoInParams(InputFileName);
+}
+static void initKobayashiAnisoSystem(const void *params, void *buffers){
+    *(struct KobAnisoDataBuffers*)buffers = initKobayashiAnisoBuffers(*(const struct KobAnisoInputParams*)params);
+}
+static void buildKobayashiAnisoSystem(const void *params, char BuildProgOptions[], size_t bytes){
+    getKobayashiAnisoBuildOptions((const struct KobAnisoInputParams*)params, BuildProgOptions, bytes);
+}
+static void iterateKobayashiAnisoSystemKernel(const void *params, const void *buffers){
+    if(SparseTiles){
+        iterateKobayashiAnisoSparseKernel(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+        return ;
+    }
+    iterateKobayashiAnisoKernel(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+}
+static void iterateKobayashiAnisoSystemCPU(const void *params, const void *buffers){
+    iterateKobayashiAnisoCPU(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+}
+static int fieldsKobayashiAnisoSystem(void *buffers, struct CheckpointField fields[]){
+    return getKobayashiAnisoCheckpointFields((struct KobAnisoDataBuffers*)buffers, fields);
+}
+static void benchKobayashiAnisoSystem(const void *params, const void *buffers){
+    benchKobayashiAnisoKernels(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+}
+static void iterateKobayashiAnisoSystemAdaptive(const void *params, const void *buffers){
+    if(Backend == BACKEND_CPU){
+        iterateKobayashiAnisoAdaptiveCPU(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+    }else{
+        iterateKobayashiAnisoAdaptiveKernel(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers);
+    }
+}
+static void timeKobayashiAnisoSystem(const void *params, const void *buffers, const size_t localWS[2], int steps, double latency[]){
+    timeKobayashiAnisoSteps(*(const struct KobAnisoInputParams*)params, *(const struct KobAnisoDataBuffers*)buffers, localWS, steps, latency);
+}
+static void releaseKobayashiAnisoSystem(const void *buffers){
+    releaseKobayashiAnisoBuffers(*(const struct KobAnisoDataBuffers*)buffers);
+}
+static void initKobayashiAnisoSystemEnsemble(const struct Ensemble *ens, void *buffers){
+    *(struct KobAnisoDataBuffers*)buffers = initKobayashiAnisoEnsembleBuffers(ens);
+}
+static void iterateKobayashiAnisoSystemEnsemble(const struct Ensemble *ens, const void *buffers){
+    iterateKobayashiAnisoEnsembleKernel(ens, *(const struct KobAnisoDataBuffers*)buffers);
+}
+
+/// The registered systems, the fields left out are NULL or 0.
+static const struct SystemDescriptor Systems[] = {
+    {
+        .name = "DIFFUSION", .description = "Diffusion equation", .inputFile = "InputFiles/Diffusion.in", .kernelFile = "Kernels/DiffusionKern.cl",
+        .paramsBytes = sizeof(struct DiffusionInputParams), .buffersBytes = sizeof(struct DiffusionDataBuffers),
+        .readParams = readDiffusionSystem, .initBuffers = initDiffusionSystem, .buildOptions = buildDiffusionSystem, .releaseBuffers = releaseDiffusionSystem,
+        .iterateKernel = iterateDiffusionSystemKernel, .iterateCPU = iterateDiffusionSystemCPU, .iterateAdaptive = iterateDiffusionSystemAdaptive,
+        .checkpointFields = fieldsDiffusionSystem, .timeSteps = timeDiffusionSystem, .bytesPerCell = 8,
+        .grid3D = 1, .iterateMultiDevice = iterateDiffusionSystemMultiDevice,
+        .haloWidth = 1, .periodic = 1, .iterateDistributed = DISTRIBUTED(iterateDiffusionSystemMPI),
+    },
+    {
+        .name = "CAHNHILLIARD", .description = "Cahn-Hilliard spinodal decomposition", .inputFile = "InputFiles/CahnHilliard.in", .kernelFile = "Kernels/CahnHilliardKern.cl",
+        .paramsBytes = sizeof(struct CahnHilliardInputParams), .buffersBytes = sizeof(struct CahnHilliardDataBuffers),
+        .readParams = readCahnHilliardSystem, .initBuffers = initCahnHilliardSystem, .buildOptions = buildCahnHilliardSystem, .releaseBuffers = releaseCahnHilliardSystem,
+        .iterateKernel = iterateCahnHilliardSystemKernel, .iterateCPU = iterateCahnHilliardSystemCPU, .iterateAdaptive = iterateCahnHilliardSystemAdaptive,
+        .checkpointFields = fieldsCahnHilliardSystem, .bench = benchCahnHilliardSystem, .timeSteps = timeCahnHilliardSystem, .bytesPerCell = 8,
+        .ensembleParams = CahnHilliardEnsembleParams, .numEnsembleParams = NUM_ENSEMBLE_PARAMS(CahnHilliardEnsembleParams), .initEnsemble = initCahnHilliardSystemEnsemble, .iterateEnsemble = iterateCahnHilliardSystemEnsemble,
+        .grid3D = 1, .iterateMultiDevice = iterateCahnHilliardSystemMultiDevice,
+        .haloWidth = 2, .periodic = 1, .iterateDistributed = DISTRIBUTED(iterateCahnHilliardSystemMPI),
+    },
+    {
+        .name = "KOBISO", .description = "Kobayashi isotropic dendrite growth", .inputFile = "InputFiles/KobayashiIso.in", .kernelFile = "Kernels/KobayashiIsoKern.cl",
+        .paramsBytes = sizeof(struct KobIsoInputParams), .buffersBytes = sizeof(struct KobIsoDataBuffers),
+        .readParams = readKobayashiIsoSystem, .initBuffers = initKobayashiIsoSystem, .buildOptions = buildKobayashiIsoSystem, .releaseBuffers = releaseKobayashiIsoSystem,
+        .iterateKernel = iterateKobayashiIsoSystemKernel, .iterateCPU = iterateKobayashiIsoSystemCPU, .iterateAdaptive = iterateKobayashiIsoSystemAdaptive,
+        .checkpointFields = fieldsKobayashiIsoSystem, .timeSteps = timeKobayashiIsoSystem, .bytesPerCell = 16,
+        .grid3D = 0,
+        .haloWidth = 1, .periodic = 0, .iterateDistributed = DISTRIBUTED(iterateKobayashiIsoSystemMPI),
+    },
+    {
+        .name = "KOBANISO", .description = "Kobayashi anisotropic dendrite growth", .inputFile = "InputFiles/KobayashiAniso.in", .kernelFile = "Kernels/KobayashiAnisoKern.cl",
+        .paramsBytes = sizeof(struct KobAnisoInputParams), .buffersBytes = sizeof(struct KobAnisoDataBuffers),
+        .readParams = readKobayashiAnisoSystem, .initBuffers = initKobayashiAnisoSystem, .buildOptions = buildKobayashiAnisoSystem, .releaseBuffers = releaseKobayashiAnisoSystem,
+        .iterateKernel = iterateKobayashiAnisoSystemKernel, .iterateCPU = iterateKobayashiAnisoSystemCPU, .iterateAdaptive = iterateKobayashiAnisoSystemAdaptive,
+        .checkpointFields = fieldsKobayashiAnisoSystem, .bench = benchKobayashiAnisoSystem, .timeSteps = timeKobayashiAnisoSystem, .bytesPerCell = 16,
+        .ensembleParams = KobayashiAnisoEnsembleParams, .numEnsembleParams = NUM_ENSEMBLE_PARAMS(KobayashiAnisoEnsembleParams), .initEnsemble = initKobayashiAnisoSystemEnsemble, .iterateEnsemble = iterateKobayashiAnisoSystemEnsemble,
+        .grid3D = 0,
+        .haloWidth = 2, .periodic = 0, .iterateDistributed = DISTRIBUTED(iterateKobayashiAnisoSystemMPI),
+    },
+};
+
+/// Number of registered systems.
+#define NUM_SYSTEMS ((int)(sizeof(Systems)/sizeof(Systems[0])))
+
+/**
+@brief Finds a system by name.
+@param name The name given with --system, e.g. "KOBISO".
+@return The descriptor, or NULL if there is no such system.
+*/
+static const struct SystemDescriptor* FindSystem(const char *name){
+    for(int i = 0 ; name != NULL && i < NUM_SYSTEMS ; i++){
+        if(strcmp(Systems[i].name, name) == 0){
+            return &Systems[i] ;
+        }
+    }
+    return NULL ;
+}
+
+/**
+@brief Prints the names and descriptions of the registered systems.
+*/
+static void PrintSystems(){
+    printf("Systems (--system <name>) :\n");
+    for(int i = 0 ; i < NUM_SYSTEMS ; i++){
+        printf("   %-14s %s, input file %s\n", Systems[i].name, Systems[i].description, Systems[i].inputFile);
+    }
+}
+
+#endif
+// END OF FILE
@@ -0,0 +1,286 @@
+/**
+@file trace_funcs.h
+@brief Declares the timeline tracer: it records host spans and the profiling timestamps of OpenCL commands and writes them as a Chrome trace-event JSON file.
+
+Built with TRACE=1 (the USE_TRACE macro) and run with --trace <file>, the program writes a timeline of the run that opens in
+Perfetto (ui.perfetto.dev) or chrome://tracing. Without USE_TRACE every TRACE_* macro expands to nothing, or to its event
+argument, so the instrumentation costs nothing. The timeline has two processes:
+|Process|Track|Spans|
+|-------|-----|-----|
+|Host|main|Program build or cache load, CPU steps, waits for the device and for a staging buffer, checkpoints|
+|Host|output writer|Waits for the output reads and WriteFieldToFile()|
+|OpenCL device|execution|Every kernel and read from CL_PROFILING_COMMAND_START to CL_PROFILING_COMMAND_END|
+|OpenCL device|queue|Async spans from CL_PROFILING_COMMAND_QUEUED to START, the queued and submitted times are in the args|
+
+The instrumented code brackets host work with TRACE_SPAN_BEGIN() and TRACE_SPAN_END(). An enqueue gets its event from
+TRACE_CL_EVENT(), which returns a scratch event when the caller does not want one, and records it after the enqueue with
+TRACE_CL_KERNEL() or TRACE_CL_RECORD(). The events are kept until TRACE_MAX_PENDING of them are pending or the tracer stops,
+then their timestamps are read and written out. Reading them waits for the device, so a traced run flushes the queue every
+TRACE_MAX_PENDING commands. The device timestamps are put on the host clock by the offset of one marker, measured when the
+first event is recorded; it is late by the time clWaitForEvents() takes to return. Only the commands of the queue of the
+run are traced, not those of the per-device queues of --multi-device.
+*/
+
+#ifndef TRACE_FUNCS
+#define TRACE_FUNCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "global_vars.h"
+
+#ifdef USE_TRACE
+
+#include <stdarg.h>
+#include <pthread.h>
+#include "error_handle.h"
+#include "cpu_kernels.h"
+
+/// The OpenCL events kept before their timestamps are read.
+#define TRACE_MAX_PENDING 4096
+
+/// An OpenCL command waiting for its timestamps.
+struct TracePending{
+    cl_event event ;
+    char name[64] ;
+    const char *cat ;
+};
+
+/// The state of the tracer. The file is guarded by lock, the pending events are only recorded by the main thread.
+struct Tracer{
+    /// The trace file, NULL when the tracer is off.
+    FILE *file ;
+    pthread_mutex_t lock ;
+    /// 1 until the first trace event is written.
+    int first ;
+    /// The thread that started the tracer, the other threads are on the output writer track.
+    pthread_t mainThread ;
+    /// The host time of the start in seconds, the zero of the timeline.
+    double start ;
+    /// Host microseconds minus device nanoseconds/1000, set by TraceCalibrate().
+    double deviceOffset ;
+    /// 1 once deviceOffset is measured.
+    int calibrated ;
+    /// The id of the next async queue span.
+    unsigned long nextID ;
+    /// The event of an enqueue whose caller did not ask for one.
+    cl_event scratch ;
+    struct TracePending pending[TRACE_MAX_PENDING] ;
+    int numPending ;
+} Trace ;
+
+/**
+@brief The host time on the timeline.
+@return Microseconds since TraceStart().
+*/
+static inline double TraceNow(){
+    return (CPUWallTime() - Trace.start)*1.0e6 ;
+}
+
+/**
+@brief Writes one trace event, the comma before it and a new line.
+@param fmt The printf format of the JSON object.
+*/
+static void TraceWrite(const char *fmt, ...){
+    va_list args ;
+    va_start(args, fmt);
+    pthread_mutex_lock(&Trace.lock);
+    fprintf(Trace.file, "%s\n", Trace.first ? "" : ",");
+    vfprintf(Trace.file, fmt, args);
+    Trace.first = 0 ;
+    pthread_mutex_unlock(&Trace.lock);
+    va_end(args);
+}
+
+/**
+@brief Records a host span that started at begin and ends now.
+@param name The name of the span, a string constant.
+@param cat The category, e.g. "build", "io" or "sync".
+@param begin The start from TraceNow().
+*/
+static void TraceHostSpan(const char *name, const char *cat, double begin){
+    if(Trace.file == NULL){
+        return ;
+    }
+    double end = TraceNow();
+    int tid = pthread_equal(pthread_self(), Trace.mainThread) ? 1 : 2 ;
+    TraceWrite("{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+               name, cat, tid, begin, end - begin);
+}
+
+/**
+@brief Measures the offset of the device clock from the host clock with a marker on the queue.
+*/
+static void TraceCalibrate(){
+    cl_event marker ;
+    cl_ulong end ;
+    cl_int err = clEnqueueMarkerWithWaitList(queue, 0, NULL, &marker);
+    err |= clWaitForEvents(1, &marker);
+    double now = TraceNow();
+    err |= clGetEventProfilingInfo(marker, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    KernErrorHandle(err, "trace clock calibration");
+    clReleaseEvent(marker);
+    Trace.deviceOffset = now - end/1.0e3 ;
+    Trace.calibrated = 1 ;
+}
+
+/**
+@brief Waits for the pending OpenCL commands, writes their spans and releases their events.
+*/
+static void TraceFlushPending(){
+    if(Trace.numPending == 0){
+        return ;
+    }
+    for(int i = 0 ; i < Trace.numPending ; i++){
+        struct TracePending *p = &Trace.pending[i] ;
+        cl_ulong queued, submit, start, end ;
+        cl_int err = clWaitForEvents(1, &p->event);
+        err |= clGetEventProfilingInfo(p->event, CL_PROFILING_COMMAND_QUEUED, sizeof(queued), &queued, NULL);
+        err |= clGetEventProfilingInfo(p->event, CL_PROFILING_COMMAND_SUBMIT, sizeof(submit), &submit, NULL);
+        err |= clGetEventProfilingInfo(p->event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+        err |= clGetEventProfilingInfo(p->event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+        KernErrorHandle(err, "trace clGetEventProfilingInfo");
+        clReleaseEvent(p->event);
+        double q = queued/1.0e3 + Trace.deviceOffset, s = submit/1.0e3 + Trace.deviceOffset ;
+        double b = start/1.0e3 + Trace.deviceOffset, e = end/1.0e3 + Trace.deviceOffset ;
+        unsigned long id = Trace.nextID++ ;
+        TraceWrite("{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 2, \"tid\": 1, \"ts\": %.3f, \"dur\": %.3f, "
+                   "\"args\": {\"queued_us\": %.3f, \"submit_us\": %.3f, \"queue_wait_us\": %.3f}}",
+                   p->name, p->cat, b, e - b, q, s, b - q);
+        TraceWrite("{\"name\": \"%s\", \"cat\": \"queue\", \"ph\": \"b\", \"id\": %lu, \"pid\": 2, \"tid\": 2, \"ts\": %.3f, \"args\": {\"submit_us\": %.3f}}",
+                   p->name, id, q, s);
+        TraceWrite("{\"name\": \"%s\", \"cat\": \"queue\", \"ph\": \"e\", \"id\": %lu, \"pid\": 2, \"tid\": 2, \"ts\": %.3f}",
+                   p->name, id, b);
+    }
+    Trace.numPending = 0 ;
+}
+
+/**
+@brief The event an enqueue should return when traced.
+@param event The event the caller asked for, or NULL.
+@return event, or the scratch event if event is NULL and the tracer is on.
+*/
+static inline cl_event* TraceEventSlot(cl_event *event){
+    return (Trace.file != NULL && event == NULL) ? &Trace.scratch : event ;
+}
+
+/**
+@brief Keeps the event of an enqueued command for the timeline.
+@param event The event from TraceEventSlot(). The scratch event is taken over, the others are retained.
+@param name The name of the command.
+@param cat The category, "kernel" or "transfer".
+*/
+static void TraceRecordEvent(cl_event *event, const char *name, const char *cat){
+    if(Trace.file == NULL || event == NULL){
+        return ;
+    }
+    if(event != &Trace.scratch){
+        clRetainEvent(*event);
+    }
+    if(!Trace.calibrated){
+        TraceCalibrate();
+    }
+    if(Trace.numPending == TRACE_MAX_PENDING){
+        TraceFlushPending();
+    }
+    struct TracePending *p = &Trace.pending[Trace.numPending++] ;
+    p->event = *event ;
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->cat = cat ;
+}
+
+/**
+@brief Keeps the event of an enqueued kernel for the timeline, named after the kernel function.
+@param event The event from TraceEventSlot().
+@param kern The kernel.
+*/
+static void TraceRecordKernel(cl_event *event, cl_kernel kern){
+    if(Trace.file == NULL || event == NULL){
+        return ;
+    }
+    char name[64] = "kernel" ;
+    clGetKernelInfo(kern, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+    name[sizeof(name)-1] = '\0' ;
+    TraceRecordEvent(event, name, "kernel");
+}
+
+/**
+@brief Writes the pending events, closes the trace file and turns the tracer off. Called at exit.
+*/
+static void TraceStop(){
+    if(Trace.file == NULL){
+        return ;
+    }
+    TraceFlushPending();
+    fprintf(Trace.file, "\n]}\n");
+    fclose(Trace.file);
+    Trace.file = NULL ;
+    pthread_mutex_destroy(&Trace.lock);
+}
+
+/**
+@brief Opens the trace file and turns the tracer on until the program exits.
+@param TraceFileName The trace file, overwritten.
+*/
+void TraceStart(const char TraceFileName[]){
+    Trace.file = fopen(TraceFileName, "w");
+    if(Trace.file == NULL){
+        printf("Error: could not write the trace %s\n", TraceFileName);
+        exit(1);
+    }
+    pthread_mutex_init(&Trace.lock, NULL);
+    Trace.first = 1 ;
+    Trace.mainThread = pthread_self();
+    Trace.start = CPUWallTime();
+    Trace.calibrated = 0 ;
+    Trace.nextID = 0 ;
+    Trace.numPending = 0 ;
+    fprintf(Trace.file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    TraceWrite("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"Host\"}}");
+    TraceWrite("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"main\"}}");
+    TraceWrite("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"output writer\"}}");
+    TraceWrite("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 2, \"args\": {\"name\": \"OpenCL device\"}}");
+    TraceWrite("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 2, \"tid\": 1, \"args\": {\"name\": \"execution\"}}");
+    TraceWrite("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 2, \"tid\": 2, \"args\": {\"name\": \"queue\"}}");
+    atexit(TraceStop);
+    printf("   : Tracing the run to %s\n", TraceFileName);
+}
+
+/// Starts a host span, the variable span holds its start.
+#define TRACE_SPAN_BEGIN(span) double span = (Trace.file != NULL) ? TraceNow() : 0.0
+/// Ends the host span started with TRACE_SPAN_BEGIN(span).
+#define TRACE_SPAN_END(span, name, cat) TraceHostSpan(name, cat, span)
+/// The event argument of a traced enqueue.
+#define TRACE_CL_EVENT(event) TraceEventSlot(event)
+/// Records the enqueued kernel kern with the event from TRACE_CL_EVENT().
+#define TRACE_CL_KERNEL(event, kern) TraceRecordKernel(event, kern)
+/// Records the enqueued command with the event from TRACE_CL_EVENT().
+#define TRACE_CL_RECORD(event, name, cat) TraceRecordEvent(event, name, cat)
+
+#else
+
+/**
+@brief The tracer is compiled out, --trace only prints a note.
+@param TraceFileName The trace file.
+*/
+void TraceStart(const char TraceFileName[]){
+    printf("   : Built without TRACE=1, --trace %s ignored\n", TraceFileName);
+}
+
+#define TRACE_SPAN_BEGIN(span)
+#define TRACE_SPAN_END(span, name, cat)
+#define TRACE_CL_EVENT(event) (event)
+#define TRACE_CL_KERNEL(event, kern)
+#define TRACE_CL_RECORD(event, name, cat)
+
+#endif
+
+#endif
+// END OF FILE
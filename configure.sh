@@ -106,6 +106,21 @@ echo "" ;
 #echo ""
 #
 
+# Check for the zlib header, needed for the compressed output files
+ZLIB_EXISTS=$(echo '#include <zlib.h>' | cpp -H -o /dev/null 2>&1 | grep -m 1 zlib.h | sed 's/^\.* //') ;
+ZLIB_ERR="ZLIB_EXISTS_CHECK : Failed
+zlib.h not found on your device. It is needed to write compressed output files.
+You can install it using: sudo apt-get install zlib1g-dev" ;
+ZLIB_SUC="ZLIB_EXISTS_CHECK : Successful
+zlib found in $ZLIB_EXISTS" ;
+if [[ -z $ZLIB_EXISTS ]]; then
+	echo "$ZLIB_ERR" ;
+	exit 1 ;
+else
+	echo "$ZLIB_SUC" 
+fi
+echo ""
+
 # Check for doxygen
 DOXYGEN_EXISTS=$(which doxygen) ;
 DOXYGEN_ERR="DOXYGEN_EXISTS_CHECK : Failed
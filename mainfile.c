@@ -2,28 +2,74 @@
 @file mainfile.c
 @brief This is the mainfile of the program.
 
-The mainfile declares MACROs to link the functions specific to the declared system. The following MACROs are used:
-|MACRO|Description/function|
-|-----|--------------------|
-|INPUT_FILE |The relative path and name of the input file|
-|KERNEL_FILE |The relative path and name of the kernel file|
-|INP_PARAMS_STRUCT |A C struct/structure that holds the input parameters in its member variables|
-|DATA_BUFFERS_STRUCT |A C struct.structure that holds the data buffers/arrays in its member variables|
-|READ_INP_FUNCTION |The name of the function that reads the input file specific to the system into the INP_PARAMS STRUCT|
-|BUFFER_INIT_FUNCTION |The function that reads the INP_PARAMS_STRUCT and initialises the necessary data buffers/arrays for the program|
-|KERNEL_ITERATE_FUNCTION |The function that iterates the kernel of the declared SYSTEM |
+The mainfile picks the system to simulate at runtime from the registry of system_registry.h, so one binary runs all of them.
+Each registered system has a SystemDescriptor with the following members:
+|Member|Description/function|
+|------|--------------------|
+|name |The name given with --system, stored in and checked against the checkpoints |
+|inputFile |The relative path and name of the default input file |
+|kernelFile |The relative path and name of the kernel file |
+|paramsBytes |The size of the C struct/structure that holds the input parameters in its member variables|
+|buffersBytes |The size of the C struct/structure that holds the data buffers/arrays in its member variables|
+|readParams |Reads the input file specific to the system into the input parameters struct|
+|initBuffers |Reads the input parameters struct and initialises the necessary data buffers/arrays for the program|
+|buildOptions |Writes the input parameters as the "-D" build options of the kernel file|
+|iterateKernel |Iterates the kernel of the system |
+|iterateCPU |Iterates the system with the native CPU backend |
+|checkpointFields |Lists the data buffers saved in a checkpoint |
+|bench |Benchmarks the kernel variants of the system (only set for the systems that have variants) |
+|ensembleParams |The parameters that may vary between the replicas of an ensemble (only set for the systems that have an ensemble kernel) |
+|initEnsemble |Initialises the data buffers of all the replicas of an ensemble |
+|iterateEnsemble |Iterates all the replicas of an ensemble with one kernel launch per step |
+|iterateMultiDevice |Iterates the system on strips of the grid, one per device of the platform |
+|timeSteps |Times single steps of the system for the benchmark suite |
+|releaseBuffers |Frees the data buffers/arrays |
+|bytesPerCell |The bytes a step reads and writes per cell, for the effective bandwidth of the benchmark suite |
+|iterateAdaptive |Iterates the system with the adaptive time step, AdaptiveDT = 1 in the input file |
 
-The following table summarizes which MACRO if set to what and for which SYSTEM.
-|MACRO | DIFFUSION | CAHNHILLIARD | KOBISO | KOBANISO |
+The following table summarizes the functions behind the members for each system.
+|Member | DIFFUSION | CAHNHILLIARD | KOBISO | KOBANISO |
 |------|-----------|--------------|--------|----------|
 ||Diffusion|Spinodal decomposition| Isotropic dendtitic growth|Anisotropic dendtiric growth|
-|INPUT_FILE|InputFiles/Diffusion.in|"InputFiles/CahnHilliard.in"|InputFiles/KobayashiIso.in|InputFiles/KobayashiAniso.in|
-|KERNEL_FILE|Kernels/DiffusionKern.cl|Kernels/CahnHilliardKern.cl|Kernels/KobayashiIsoKern.cl|Kernels/KobayashiAnisoKern.cl|
-|INP_PARAMS_STRUCT|DiffusionInputParams|CahnHilliardInputParams|KobIsoInputParams|KobAnisoInputParams| 
-|DATA_BUFFERS_STRUCT|DiffusionDataBuffers|CahnHilliardDataBuffers|KobIsoDataBuffers|KobAnisoDataBuffers|
-|READ_INP_FUNCTION|readDiffusionInParams()|readCahnHilliardInParams()| readKobIsoInParams()|readKobAnisoInParams()|
-|BUFFER_INIT_FUNCTION|initDiffusionBuffers()|initCahnHilliardBuffers()|initKobayashiIsoBuffers()|initKobayashiAnisoBuffers()|
-|KERNEL_ITERATE_FUNCTION|iterateDiffusionKernel()|iterateCahnHilliardKernel()|iterateKobayashiKernel()|iterateKobayashiKernel()|
+|inputFile|InputFiles/Diffusion.in|InputFiles/CahnHilliard.in|InputFiles/KobayashiIso.in|InputFiles/KobayashiAniso.in|
+|kernelFile|Kernels/DiffusionKern.cl|Kernels/CahnHilliardKern.cl|Kernels/KobayashiIsoKern.cl|Kernels/KobayashiAnisoKern.cl|
+|paramsBytes|DiffusionInputParams|CahnHilliardInputParams|KobIsoInputParams|KobAnisoInputParams| 
+|buffersBytes|DiffusionDataBuffers|CahnHilliardDataBuffers|KobIsoDataBuffers|KobAnisoDataBuffers|
+|readParams|readDiffusionInParams()|readCahnHilliardInParams()| readKobIsoInParams()|readKobAnisoInParams()|
+|initBuffers|initDiffusionBuffers()|initCahnHilliardBuffers()|initKobayashiIsoBuffers()|initKobayashiAnisoBuffers()|
+|buildOptions|getDiffusionBuildOptions()|getCahnHilliardBuildOptions()|getKobayashiIsoBuildOptions()|getKobayashiAnisoBuildOptions()|
+|iterateKernel|iterateDiffusionKernel()|iterateCahnHilliardKernel()|iterateKobayashiIsoKernel()|iterateKobayashiAnisoKernel()|
+|iterateCPU|iterateDiffusionCPU()|iterateCahnHilliardCPU()|iterateKobayashiIsoCPU()|iterateKobayashiAnisoCPU()|
+|checkpointFields|getDiffusionCheckpointFields()|getCahnHilliardCheckpointFields()|getKobayashiIsoCheckpointFields()|getKobayashiAnisoCheckpointFields()|
+|bench| |benchCahnHilliardKernels()| |benchKobayashiAnisoKernels()|
+|initEnsemble| |initCahnHilliardEnsembleBuffers()| |initKobayashiAnisoEnsembleBuffers()|
+|iterateEnsemble| |iterateCahnHilliardEnsembleKernel()| |iterateKobayashiAnisoEnsembleKernel()|
+|iterateMultiDevice|iterateDiffusionMultiDevice()|iterateCahnHilliardMultiDevice()| | |
+|iterateDistributed|iterateDiffusionMPI()|iterateCahnHilliardMPI()|iterateKobayashiIsoMPI()|iterateKobayashiAnisoMPI()|
+|timeSteps|timeDiffusionSteps()|timeCahnHilliardSteps()|timeKobayashiIsoSteps()|timeKobayashiAnisoSteps()|
+|releaseBuffers|releaseDiffusionBuffers()|releaseCahnHilliardBuffers()|releaseKobayashiIsoBuffers()|releaseKobayashiAnisoBuffers()|
+|iterateAdaptive|iterateDiffusionAdaptiveKernel() / iterateDiffusionAdaptiveCPU()|iterateCahnHilliardAdaptiveKernel() / iterateCahnHilliardAdaptiveCPU()|iterateKobayashiIsoAdaptiveKernel() / iterateKobayashiIsoAdaptiveCPU()|iterateKobayashiAnisoAdaptiveKernel() / iterateKobayashiAnisoAdaptiveCPU()|
+
+The program takes the following command line flags:
+|Flag|Description|
+|----|-----------|
+|--system <name>|The system to simulate, one of the names above. Required.|
+|--input <file>|The input file. The default is the inputFile of the system.|
+|--cpu|Run on the native CPU backend (OpenMP + SIMD) instead of OpenCL. No OpenCL platform is needed.|
+|--opencl|Run the OpenCL kernels. This is the default.|
+|--autotune|Time the candidate work groups of the kernels and store the fastest in the autotune cache (see autotune_funcs.h).|
+|--bench|Benchmark the OpenCL kernel variants of the system instead of running the simulation.|
+|--bench-suite <file>|Time every system over several grid sizes and work group settings and write the results to a JSON file (see bench_suite.h). No --system is needed.|
+|--bench-sizes <list>|The comma separated grid sizes of --bench-suite, e.g. 128,256,512.|
+|--bench-steps <n>|The timed steps per setting of --bench-suite.|
+|--trace <file>|Write a Chrome trace-event timeline of the build, kernels, reads and output writes to the file (see trace_funcs.h). Needs a build with TRACE=1.|
+|--restart <file>|Continue the run from a checkpoint written with the CheckpointEvery input parameter.|
+|--ensemble <file>|Run one replica of the system per line of the file, each with its own parameters, in one NDRange (see ensemble_funcs.h). OpenCL only.|
+|--multi-device|Split the grid into strips of rows, one per device of the platform, and exchange the halo rows every step (see multi_device_funcs.h). OpenCL only.|
+|--precision <mode>|Store the device fields in single (default), half or double precision, over the Precision of the input file (see precision_funcs.h). OpenCL only, without --multi-device.|
+
+Built with MPI=1 and started with mpirun on more than one process, the grid is split into blocks, one per process (see mpi_funcs.h).
+Distributed runs need the --cpu flag.
 */
 
 // Define these to ensure a smooth functioing of OpenCL
@@ -34,6 +80,7 @@ The following table summarizes which MACRO if set to what and for which SYSTEM.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #ifdef MAC
@@ -42,79 +89,263 @@ The following table summarizes which MACRO if set to what and for which SYSTEM.
 #include <CL/cl.h>
 #endif
 
-#ifdef DIFFUSION
-
-#define INPUT_FILE "InputFiles/Diffusion.in"
-#define KERNEL_FILE "Kernels/DiffusionKern.cl"
-#define READ_INP_FUNCTION readDiffusionInParams
-#define BUFFER_INIT_FUNCTION initDiffusionBuffers
-#define KERNEL_ITERATE_FUNCTION iterateDiffusionKernel
-#define INP_PARAMS_STRUCT DiffusionInputParams
-#define DATA_BUFFERS_STRUCT DiffusionDataBuffers
-
-#elif CAHNHILLIARD
-
-#define INPUT_FILE "InputFiles/CahnHilliard.in"
-#define KERNEL_FILE "Kernels/CahnHilliardKern.cl"
-#define READ_INP_FUNCTION readCahnHilliardInParams
-#define BUFFER_INIT_FUNCTION initCahnHilliardBuffers
-#define KERNEL_ITERATE_FUNCTION iterateCahnHilliardKernel
-#define INP_PARAMS_STRUCT CahnHilliardInputParams
-#define DATA_BUFFERS_STRUCT CahnHilliardDataBuffers
-    
-#elif KOBISO
-
-#define INPUT_FILE "InputFiles/KobayashiIso.in"
-#define KERNEL_FILE "Kernels/KobayashiIsoKern.cl"
-#define READ_INP_FUNCTION readKobIsoInParams
-#define BUFFER_INIT_FUNCTION initKobayashiIsoBuffers
-#define KERNEL_ITERATE_FUNCTION iterateKobayashiIsoKernel
-#define INP_PARAMS_STRUCT KobIsoInputParams
-#define DATA_BUFFERS_STRUCT KobIsoDataBuffers
-
-#elif KOBANISO
-
-#define INPUT_FILE "InputFiles/KobayashiAniso.in"
-#define KERNEL_FILE "Kernels/KobayashiAnisoKern.cl"
-#define READ_INP_FUNCTION readKobAnisoInParams
-#define BUFFER_INIT_FUNCTION initKobayashiAnisoBuffers
-#define KERNEL_ITERATE_FUNCTION iterateKobayashiAnisoKernel
-#define INP_PARAMS_STRUCT KobAnisoInputParams
-#define DATA_BUFFERS_STRUCT KobAnisoDataBuffers
-
-#endif
-
 #include "UtilityFunctions/global_vars.h"
 #include "UtilityFunctions/error_handle.h"
 #include "UtilityFunctions/read_inp_file.h"
 #include "UtilityFunctions/CL_utility_funcs.h"
+#include "UtilityFunctions/precision_funcs.h"
 #include "UtilityFunctions/file_to_program.h"
 #include "UtilityFunctions/data_manip_funcs.h"
 #include "UtilityFunctions/init_CL_buffers.h"
+#include "UtilityFunctions/autotune_funcs.h"
+#include "UtilityFunctions/trace_funcs.h"
+#include "UtilityFunctions/reduce_funcs.h"
+#include "UtilityFunctions/diagnostics_funcs.h"
 #include "UtilityFunctions/iterate_kernels.h"
+#include "UtilityFunctions/iterate_cpu.h"
+#include "UtilityFunctions/spectral_funcs.h"
+#include "UtilityFunctions/active_tiles_funcs.h"
+#include "UtilityFunctions/adaptive_dt_funcs.h"
+#include "UtilityFunctions/benchmark_funcs.h"
 #include "UtilityFunctions/data_writing_funcs.h"
+#include "UtilityFunctions/output_spec_funcs.h"
+#include "UtilityFunctions/output_writer.h"
+#include "UtilityFunctions/checkpoint_funcs.h"
+#include "UtilityFunctions/ensemble_funcs.h"
+#include "UtilityFunctions/multi_device_funcs.h"
+#include "UtilityFunctions/mpi_funcs.h"
+#include "UtilityFunctions/system_registry.h"
+#include "UtilityFunctions/bench_suite.h"
 
 /** @brief The main function.
 
-The readCommonParams() function reads the INPUT_FILE and initialises the global variables common to all systems.\n
-The initCLDataStructures() function initillises the OpenCL data structures (platform to kernels).
+The system is looked up in the registry by its --system name.
+The readCommonParams() function reads the input file and initialises the global variables common to all systems.\n
+The initCLDataStructures() function initillises the OpenCL data structures (platform to kernels).\n
+With the --cpu flag the OpenCL structures are never touched and the iterateCPU function of the system runs instead.
 
 */
 int main(int argc, char **args){
+    StartMPI(&argc, &args);
+    
+    // Command line flags
+    Backend = BACKEND_OPENCL ;
+    cl_bool bench = CL_FALSE ;
+    const char *restartFile = NULL ;
+    const char *systemName = NULL ;
+    const char *inputFile = NULL ;
+    const char *ensembleFile = NULL ;
+    cl_bool multiDevice = CL_FALSE ;
+    cl_bool autotune = CL_FALSE ;
+    const char *benchSuiteFile = NULL ;
+    const char *benchSizes = NULL ;
+    int benchSteps = 0 ;
+    const char *traceFile = NULL ;
+    cl_int precision = -1 ;
+    for(int i=1; i<argc; i++){
+        if(strcmp(args[i],"--cpu")==0){
+            Backend = BACKEND_CPU ;
+        }else if(strcmp(args[i],"--opencl")==0){
+            Backend = BACKEND_OPENCL ;
+        }else if(strcmp(args[i],"--autotune")==0){
+            autotune = CL_TRUE ;
+        }else if(strcmp(args[i],"--bench")==0){
+            bench = CL_TRUE ;
+        }else if(strcmp(args[i],"--bench-suite")==0 && i+1<argc){
+            benchSuiteFile = args[++i] ;
+        }else if(strcmp(args[i],"--bench-sizes")==0 && i+1<argc){
+            benchSizes = args[++i] ;
+        }else if(strcmp(args[i],"--bench-steps")==0 && i+1<argc){
+            benchSteps = atoi(args[++i]);
+        }else if(strcmp(args[i],"--trace")==0 && i+1<argc){
+            traceFile = args[++i] ;
+        }else if(strcmp(args[i],"--restart")==0 && i+1<argc){
+            restartFile = args[++i] ;
+        }else if(strcmp(args[i],"--system")==0 && i+1<argc){
+            systemName = args[++i] ;
+        }else if(strcmp(args[i],"--input")==0 && i+1<argc){
+            inputFile = args[++i] ;
+        }else if(strcmp(args[i],"--ensemble")==0 && i+1<argc){
+            ensembleFile = args[++i] ;
+        }else if(strcmp(args[i],"--multi-device")==0){
+            multiDevice = CL_TRUE ;
+        }else if(strcmp(args[i],"--precision")==0 && i+1<argc){
+            i++ ;
+            if(strcmp(args[i],"single")==0){
+                precision = PRECISION_SINGLE ;
+            }else if(strcmp(args[i],"half")==0){
+                precision = PRECISION_HALF ;
+            }else if(strcmp(args[i],"double")==0){
+                precision = PRECISION_DOUBLE ;
+            }else{
+                printf("Error: unknown precision %s, use single, half or double\n", args[i]);
+                return FailMPI();
+            }
+        }else{
+            printf("Unknown flag %s ignored\n", args[i]);
+        }
+    }
+    if(traceFile != NULL){
+        // One timeline per process of a distributed run
+        char rankTraceFile[512] ;
+        if(NumProcs > 1){
+            snprintf(rankTraceFile, sizeof(rankTraceFile), "%s.%d", traceFile, ProcRank);
+            traceFile = rankTraceFile ;
+        }
+        TraceStart(traceFile);
+    }
+    if(benchSuiteFile != NULL){
+        if(NumProcs > 1 || precision > PRECISION_SINGLE){
+            printf("Error: the benchmark suite runs on one process in single precision\n");
+            return FailMPI();
+        }
+        RunBenchSuite(benchSuiteFile, benchSizes, benchSteps);
+        StopMPI();
+        return 0 ;
+    }
+    const struct SystemDescriptor *System = FindSystem(systemName);
+    if(System == NULL){
+        printf("Error: %s system %s\n", (systemName == NULL) ? "no" : "unknown", (systemName == NULL) ? "given" : systemName);
+        PrintSystems();
+        return FailMPI();
+    }
+    if(inputFile == NULL){
+        inputFile = System->inputFile ;
+    }
+    printf("System: %s, input file %s\n", System->description, inputFile);
+    if(ensembleFile != NULL && (System->iterateEnsemble == NULL || Backend != BACKEND_OPENCL || restartFile != NULL || bench)){
+        printf("Error: ensembles run the OpenCL ensemble kernel of the CAHNHILLIARD and KOBANISO systems, without --cpu, --restart or --bench\n");
+        return FailMPI();
+    }
+    if(multiDevice && (System->iterateMultiDevice == NULL || Backend != BACKEND_OPENCL || restartFile != NULL || ensembleFile != NULL || bench)){
+        printf("Error: the multi-device mode runs the strip kernels of the DIFFUSION and CAHNHILLIARD systems, without --cpu, --restart, --ensemble or --bench\n");
+        return FailMPI();
+    }
     
-    readCommonParams(INPUT_FILE);
-    // Initialize OpenCL data structures
-    initCLDataStructures() ;
-    struct INP_PARAMS_STRUCT InpParams ;
-    InpParams = READ_INP_FUNCTION(INPUT_FILE);
-    // Read the file into a program
-    kernel = getKernelFromFile(KERNEL_FILE, InpParams);
+    readCommonParams(inputFile);
+    if(autotune){
+        Autotune = 2 ;
+    }
+    if(precision >= 0){
+        Precision = precision ;
+    }
+    if(Precision != PRECISION_SINGLE && (Backend != BACKEND_OPENCL || multiDevice || NumProcs > 1)){
+        printf("Error: half and double precision run the OpenCL kernels on one device, without --cpu, --multi-device or MPI\n");
+        return FailMPI();
+    }
+    void *InpParams = calloc(1, System->paramsBytes);
+    System->readParams(inputFile, InpParams);
+    // Seed the noise, a restart replaces the seed and the parameters with the saved ones
+    SeedRandom((cl_ulong)time(NULL));
+    if(restartFile != NULL){
+        OpenCheckpoint(restartFile, System->name, InpParams, System->paramsBytes);
+    }
+    if(NZ > 1 && (!System->grid3D || Backend != BACKEND_OPENCL || ensembleFile != NULL || bench)){
+        printf("Error: 3D grids (NZ > 1) run the OpenCL kernels of the DIFFUSION and CAHNHILLIARD systems, without --cpu, --ensemble or --bench\n");
+        return FailMPI();
+    }
+    if(multiDevice && NZ > 1){
+        printf("Error: the multi-device mode runs 2D grids only\n");
+        return FailMPI();
+    }
+    if(AdaptiveDT){
+        if(NZ > 1 || restartFile != NULL || ensembleFile != NULL || bench || multiDevice || NumProcs > 1){
+            printf("Error: AdaptiveDT = 1 runs 2D grids on one OpenCL device or the CPU backend, without --restart, --ensemble, --bench, --multi-device or MPI\n");
+            return FailMPI();
+        }
+        if(CheckpointEvery > 0){
+            printf("   : No checkpoints are written with the adaptive time step\n");
+        }
+    }
+    if(ensembleFile != NULL && DiagnosticsEvery > 0){
+        printf("   : No diagnostics are written for ensembles\n");
+        DiagnosticsEvery = 0 ;
+    }
+    if(multiDevice){
+        // The cache holds the binary of one device, the strips need the program of every device
+        ProgramCache = 0 ;
+        if(CheckpointEvery > 0){
+            printf("   : No checkpoints are written in the multi-device mode\n");
+        }
+        if(DiagnosticsEvery > 0){
+            printf("   : No diagnostics are written in the multi-device mode\n");
+            DiagnosticsEvery = 0 ;
+        }
+    }
+#ifdef USE_MPI
+    if(NumProcs > 1){
+        if(Backend != BACKEND_CPU || restartFile != NULL || ensembleFile != NULL || bench || multiDevice || NZ > 1){
+            printf("Error: distributed runs use the CPU backend on 2D grids, with --cpu and without --restart, --ensemble, --bench or --multi-device\n");
+            return FailMPI();
+        }
+        if(CheckpointEvery > 0){
+            printf("   : No checkpoints are written in distributed runs\n");
+        }
+        if(DiagnosticsEvery > 0){
+            printf("   : No diagnostics are written in distributed runs\n");
+            DiagnosticsEvery = 0 ;
+        }
+        if(SplitGridMPI(System->haloWidth, System->periodic) != 0){
+            return FailMPI();
+        }
+    }
+#endif
+    if(Backend == BACKEND_OPENCL){
+        // Initialize OpenCL data structures
+        initCLDataStructures() ;
+        // Read the file into a program
+        char BuildProgOptions[1024] ;
+        System->buildOptions(InpParams, BuildProgOptions, sizeof(BuildProgOptions));
+        kernel = getKernelFromFile(System->kernelFile, BuildProgOptions);
+    }
     // Initialize data
-    struct DATA_BUFFERS_STRUCT dataBuffers ;
-    dataBuffers = BUFFER_INIT_FUNCTION(InpParams);
-    // Iterate kernel
-    KERNEL_ITERATE_FUNCTION(InpParams,dataBuffers) ;
+    void *dataBuffers = calloc(1, System->buffersBytes);
+    if(ensembleFile != NULL){
+        // Every replica starts from the input file parameters, the ensemble file overrides some of them
+        struct Ensemble ens = ReadEnsembleFile(ensembleFile, InpParams, System->paramsBytes, System->ensembleParams, System->numEnsembleParams);
+        System->initEnsemble(&ens, dataBuffers);
+        StartOutputWriter(GRID_CELLS);
+        System->iterateEnsemble(&ens, dataBuffers);
+        StopOutputWriter();
+        free(ens.params);
+        free(dataBuffers);
+        free(InpParams);
+        StopMPI();
+        return 0 ;
+    }
+    System->initBuffers(InpParams, dataBuffers);
+    if(restartFile != NULL){
+        struct CheckpointField fields[CHECKPOINT_MAX_FIELDS] ;
+        int numFields = System->checkpointFields(dataBuffers, fields);
+        LoadCheckpointFields(fields, numFields);
+    }
+    if(bench){
+        if(Backend == BACKEND_OPENCL && System->bench != NULL){
+            System->bench(InpParams, dataBuffers) ;
+        }else{
+            printf("No benchmark for this system and backend\n");
+        }
+        StopMPI();
+        return 0 ;
+    }
+    // Iterate kernel, the output files are written by a background thread
+    StartOutputWriter(GRID_CELLS);
+    if(NumProcs > 1){
+        System->iterateDistributed(InpParams,dataBuffers) ;
+    }else if(AdaptiveDT){
+        System->iterateAdaptive(InpParams,dataBuffers) ;
+    }else if(Backend == BACKEND_CPU){
+        System->iterateCPU(InpParams,dataBuffers) ;
+    }else if(multiDevice){
+        System->iterateMultiDevice(InpParams,dataBuffers) ;
+    }else{
+        System->iterateKernel(InpParams,dataBuffers) ;
+    }
+    StopOutputWriter();
+    free(dataBuffers);
+    free(InpParams);
+    StopMPI();
     
     return 0 ;
 }
-// END OF FILE
\ No newline at end of file
+// END OF FILE